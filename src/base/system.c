@@ -52,6 +52,7 @@
 	#include <ws2tcpip.h>
 	#include <fcntl.h>
 	#include <direct.h>
+	#include <io.h>
 	#include <errno.h>
 	#include <process.h>
 	#include <shellapi.h>
@@ -90,6 +91,25 @@ static int num_loggers = 0;
 
 static NETSTATS network_stats = {0};
 
+/* the network threads of the server update the stats concurrently */
+static void net_stats_add(int *counter, int value)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	InterlockedExchangeAdd((volatile LONG *)counter, value);
+#else
+	__atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+#endif
+}
+
+static int net_stats_get(int *counter)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	return InterlockedCompareExchange((volatile LONG *)counter, 0, 0);
+#else
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#endif
+}
+
 static NETSOCKET invalid_socket = {NETTYPE_INVALID, -1, -1};
 
 #define AF_WEBSOCKET_INET (0xee)
@@ -360,6 +380,17 @@ int io_flush(IOHANDLE io)
 	return fflush((FILE*)io);
 }
 
+int io_sync(IOHANDLE io)
+{
+	if(fflush((FILE*)io))
+		return -1;
+#if defined(CONF_FAMILY_WINDOWS)
+	return _commit(_fileno((FILE*)io));
+#else
+	return fsync(fileno((FILE*)io));
+#endif
+}
+
 
 #define ASYNC_BUFSIZE 8 * 1024
 #define ASYNC_LOCAL_BUFSIZE 64 * 1024
@@ -1508,6 +1539,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in(addr, &sa);
 
 			d = sendto((int)sock.ipv4sock, (const char*)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			net_stats_add(&network_stats.sent_syscalls, 1);
 		}
 		else
 			dbg_msg("net", "can't send ipv4 traffic to this socket");
@@ -1541,6 +1573,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in6(addr, &sa);
 
 			d = sendto((int)sock.ipv6sock, (const char*)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			net_stats_add(&network_stats.sent_syscalls, 1);
 		}
 		else
 			dbg_msg("net", "can't send ipv6 traffic to this socket");
@@ -1561,8 +1594,8 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 		dbg_msg("net", "\taddr = %s", addrstr);
 
 	}*/
-	network_stats.sent_bytes += size;
-	network_stats.sent_packets++;
+	net_stats_add(&network_stats.sent_bytes, size);
+	net_stats_add(&network_stats.sent_packets, 1);
 	return d;
 #else
 	return size;
@@ -1590,6 +1623,104 @@ void net_init_mmsgs(MMSGS* m)
 #endif
 }
 
+void net_udp_send_queue_init(NETSENDQUEUE *queue)
+{
+	queue->size = 0;
+#if defined(CONF_PLATFORM_LINUX)
+	{
+		int i;
+		mem_zero(queue->msgs, sizeof(queue->msgs));
+		for(i = 0; i < VLEN; ++i)
+		{
+			queue->iovecs[i].iov_base = queue->bufs[i];
+			queue->msgs[i].msg_hdr.msg_iov = &queue->iovecs[i];
+			queue->msgs[i].msg_hdr.msg_iovlen = 1;
+			queue->msgs[i].msg_hdr.msg_name = queue->sockaddrs[i];
+		}
+	}
+#endif
+}
+
+int net_udp_send_queued(NETSOCKET sock, NETSENDQUEUE *queue, const NETADDR *addr, const void *data, int size)
+{
+#ifndef FUZZING
+	int pos;
+	int fd;
+
+	/* only plain unicast packets to exactly one of the sockets are queued */
+	if(size > PACKETSIZE || (addr->type&NETTYPE_LINK_BROADCAST) ||
+		(addr->type&(NETTYPE_IPV4|NETTYPE_IPV6)) == (NETTYPE_IPV4|NETTYPE_IPV6) ||
+		(addr->type&~(NETTYPE_IPV4|NETTYPE_IPV6)))
+		return net_udp_send(sock, addr, data, size);
+
+	fd = addr->type&NETTYPE_IPV4 ? sock.ipv4sock : sock.ipv6sock;
+	if(fd < 0)
+		return net_udp_send(sock, addr, data, size);
+
+	if(queue->size == VLEN)
+		net_udp_send_flush(queue);
+
+	pos = queue->size++;
+	queue->socks[pos] = fd;
+	if(addr->type&NETTYPE_IPV4)
+	{
+		netaddr_to_sockaddr_in(addr, (struct sockaddr_in *)queue->sockaddrs[pos]);
+		queue->namelens[pos] = sizeof(struct sockaddr_in);
+	}
+	else
+	{
+		netaddr_to_sockaddr_in6(addr, (struct sockaddr_in6 *)queue->sockaddrs[pos]);
+		queue->namelens[pos] = sizeof(struct sockaddr_in6);
+	}
+	mem_copy(queue->bufs[pos], data, size);
+	queue->sizes[pos] = size;
+#if defined(CONF_PLATFORM_LINUX)
+	queue->iovecs[pos].iov_len = size;
+	queue->msgs[pos].msg_hdr.msg_namelen = queue->namelens[pos];
+#endif
+
+	net_stats_add(&network_stats.sent_bytes, size);
+	net_stats_add(&network_stats.sent_packets, 1);
+#endif /* FUZZING */
+	return size;
+}
+
+int net_udp_send_flush(NETSENDQUEUE *queue)
+{
+	int sent = 0;
+	int i = 0;
+#if defined(CONF_PLATFORM_LINUX)
+	while(i < queue->size)
+	{
+		/* one sendmmsg per run of packets going to the same socket */
+		int num = 1;
+		int result;
+		while(i + num < queue->size && queue->socks[i + num] == queue->socks[i])
+			num++;
+
+		result = sendmmsg(queue->socks[i], &queue->msgs[i], num, 0);
+		net_stats_add(&network_stats.sent_syscalls, 1);
+		if(result < 0)
+		{
+			/* drop the packet that failed, like a failed sendto would */
+			result = 1;
+		}
+		else
+			sent += result;
+		i += result;
+	}
+#else
+	for(; i < queue->size; i++)
+	{
+		if(sendto(queue->socks[i], queue->bufs[i], queue->sizes[i], 0, (struct sockaddr *)queue->sockaddrs[i], queue->namelens[i]) >= 0)
+			sent++;
+		net_stats_add(&network_stats.sent_syscalls, 1);
+	}
+#endif
+	queue->size = 0;
+	return sent;
+}
+
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS* m, unsigned char **data)
 {
 #ifndef FUZZING
@@ -1602,6 +1733,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS
 		if(m->pos >= m->size)
 		{
 			m->size = recvmmsg(sock.ipv4sock, m->msgs, VLEN, 0, NULL);
+			net_stats_add(&network_stats.recv_syscalls, 1);
 			m->pos = 0;
 		}
 	}
@@ -1611,6 +1743,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS
 		if(m->pos >= m->size)
 		{
 			m->size = recvmmsg(sock.ipv6sock, m->msgs, VLEN, 0, NULL);
+			net_stats_add(&network_stats.recv_syscalls, 1);
 			m->pos = 0;
 		}
 	}
@@ -1631,6 +1764,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS
 	{
 		socklen_t fromlen = sizeof(struct sockaddr_in);
 		bytes = recvfrom(sock.ipv4sock, (char*)buffer, maxsize, 0, (struct sockaddr *)&sockaddrbuf, &fromlen);
+		net_stats_add(&network_stats.recv_syscalls, 1);
 		*data = buffer;
 	}
 
@@ -1638,6 +1772,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS
 	{
 		socklen_t fromlen = sizeof(struct sockaddr_in6);
 		bytes = recvfrom(sock.ipv6sock, (char*)buffer, maxsize, 0, (struct sockaddr *)&sockaddrbuf, &fromlen);
+		net_stats_add(&network_stats.recv_syscalls, 1);
 		*data = buffer;
 	}
 #endif
@@ -1655,8 +1790,8 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS
 	if(bytes > 0)
 	{
 		sockaddr_to_netaddr((struct sockaddr *)&sockaddrbuf, addr);
-		network_stats.recv_bytes += bytes;
-		network_stats.recv_packets++;
+		net_stats_add(&network_stats.recv_bytes, bytes);
+		net_stats_add(&network_stats.recv_packets, 1);
 		return bytes;
 	}
 	else if(bytes == 0)
@@ -2786,7 +2921,12 @@ int mem_comp(const void *a, const void *b, int size)
 
 void net_stats(NETSTATS *stats_inout)
 {
-	*stats_inout = network_stats;
+	stats_inout->sent_packets = net_stats_get(&network_stats.sent_packets);
+	stats_inout->sent_bytes = net_stats_get(&network_stats.sent_bytes);
+	stats_inout->recv_packets = net_stats_get(&network_stats.recv_packets);
+	stats_inout->recv_bytes = net_stats_get(&network_stats.recv_bytes);
+	stats_inout->sent_syscalls = net_stats_get(&network_stats.sent_syscalls);
+	stats_inout->recv_syscalls = net_stats_get(&network_stats.recv_syscalls);
 }
 
 int str_isspace(char c) { return c == ' ' || c == '\n' || c == '\t'; }
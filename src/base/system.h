@@ -309,6 +309,18 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
+/*
+	Function: io_sync
+		Writes all pending data and waits until it reached the disk.
+
+	Parameters:
+		io - Handle to the file.
+
+	Returns:
+		Returns 0 on success.
+*/
+int io_sync(IOHANDLE io);
+
 /*
 	Function: io_error
 		Checks whether an error occurred during I/O with the file.
@@ -806,6 +818,62 @@ void net_init_mmsgs(MMSGS* m);
 */
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS* m, unsigned char **data);
 
+typedef struct
+{
+	int size;
+	int socks[VLEN];
+	int sizes[VLEN];
+	int namelens[VLEN];
+	char sockaddrs[VLEN][128];
+	char bufs[VLEN][PACKETSIZE];
+#ifdef CONF_PLATFORM_LINUX
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+#endif
+} NETSENDQUEUE;
+
+/*
+	Function: net_udp_send_queue_init
+		Prepares a queue for net_udp_send_queued.
+
+	Parameters:
+		queue - Queue to initialize.
+*/
+void net_udp_send_queue_init(NETSENDQUEUE *queue);
+
+/*
+	Function: net_udp_send_queued
+		Like net_udp_send, but copies the packet into a queue instead
+		of sending it right away. The queue is sent when it is full
+		or when net_udp_send_flush is called. Packets that can't be
+		queued (websocket, broadcast or too big) are sent directly.
+
+	Parameters:
+		sock - Socket to use.
+		queue - Queue to add the packet to.
+		addr - Where to send the packet.
+		data - Pointer to the packet data to send.
+		size - Size of the packet.
+
+	Returns:
+		The size of the packet, or the result of net_udp_send if it
+		was sent directly.
+*/
+int net_udp_send_queued(NETSOCKET sock, NETSENDQUEUE *queue, const NETADDR *addr, const void *data, int size);
+
+/*
+	Function: net_udp_send_flush
+		Sends all packets in the queue, using sendmmsg where it is
+		available.
+
+	Parameters:
+		queue - Queue to send.
+
+	Returns:
+		The number of packets sent successfully.
+*/
+int net_udp_send_flush(NETSENDQUEUE *queue);
+
 /*
 	Function: net_udp_close
 		Closes an UDP socket.
@@ -1651,6 +1719,8 @@ typedef struct
 	int sent_bytes;
 	int recv_packets;
 	int recv_bytes;
+	int sent_syscalls;
+	int recv_syscalls;
 } NETSTATS;
 
 
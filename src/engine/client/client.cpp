@@ -924,12 +924,25 @@ void CClient::SnapInvalidateItem(int SnapID, int Index)
 
 void *CClient::SnapFindItem(int SnapID, int Type, int ID)
 {
-	// TODO: linear search. should be fixed.
 	int i;
 
 	if(!m_aSnapshots[g_Config.m_ClDummy][SnapID])
 		return 0x0;
 
+	if(Type < CSnapshot::OFFSET_UUID_TYPE)
+	{
+		// look the key up in the unmodified snapshot, the alternative one can contain invalidated items
+		int Key = (Type<<16)|ID;
+		int Index = m_aSnapshots[g_Config.m_ClDummy][SnapID]->m_pSnap->GetItemIndex(Key);
+		if(Index == -1)
+			return 0x0;
+		CSnapshotItem *pItem = m_aSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItem(Index);
+		if(pItem->Key() != Key)
+			return 0x0;
+		return (void *)pItem->Data();
+	}
+
+	// extended item types have to be resolved through their uuid
 	for(i = 0; i < m_aSnapshots[g_Config.m_ClDummy][SnapID]->m_pSnap->NumItems(); i++)
 	{
 		CSnapshotItem *pItem = m_aSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItem(i);
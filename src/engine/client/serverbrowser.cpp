@@ -1,6 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <algorithm> // sort  TODO: remove this
+#include <ctype.h>
 
 #include <base/hash_ctxt.h>
 #include <base/math.h>
@@ -9,6 +10,7 @@
 #include <engine/shared/config.h>
 #include <engine/shared/memheap.h>
 #include <engine/shared/network.h>
+#include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
 
 #include <engine/config.h>
@@ -24,12 +26,20 @@
 #include "serverbrowser.h"
 class SortWrap
 {
-	typedef bool (CServerBrowser::*SortFunc)(int, int) const;
+	typedef CServerBrowser::FSortCompare SortFunc;
 	SortFunc m_pfnSort;
 	CServerBrowser *m_pThis;
 public:
 	SortWrap(CServerBrowser *t, SortFunc f) : m_pfnSort(f), m_pThis(t) {}
-	bool operator()(int a, int b) { return (g_Config.m_BrSortOrder ? (m_pThis->*m_pfnSort)(b, a) : (m_pThis->*m_pfnSort)(a, b)); }
+	bool operator()(int a, int b)
+	{
+		if(g_Config.m_BrSortOrder ? (m_pThis->*m_pfnSort)(b, a) : (m_pThis->*m_pfnSort)(a, b))
+			return true;
+		if(g_Config.m_BrSortOrder ? (m_pThis->*m_pfnSort)(a, b) : (m_pThis->*m_pfnSort)(b, a))
+			return false;
+		// keep equal servers in list order so single entries can be resorted
+		return a < b;
+	}
 };
 
 CServerBrowser::CServerBrowser()
@@ -44,9 +54,14 @@ CServerBrowser::CServerBrowser()
 
 	m_pFirstReqServer = 0; // request list
 	m_pLastReqServer = 0;
+	m_pNextReqServer = 0;
 	m_NumRequests = 0;
+	m_NumRequestsInFlight = 0;
+	m_RequestTokens = 0.0f;
+	m_LastRequestRefill = 0;
 
 	m_NeedRefresh = 0;
+	m_MasterServerCount = 0;
 
 	m_NumSortedServers = 0;
 	m_NumSortedServersCapacity = 0;
@@ -56,8 +71,17 @@ CServerBrowser::CServerBrowser()
 	m_Sorthash = 0;
 	m_aFilterString[0] = 0;
 	m_aFilterGametypeString[0] = 0;
+	m_aExcludeString[0] = 0;
+	m_aFilterAddressString[0] = 0;
+
+	for(int i = 0; i < NUM_NETWORKS; i++)
+	{
+		m_aNetworks[i].m_NumCountries = 0;
+		m_aNetworks[i].m_NumTypes = 0;
+	}
 
 	m_ServerlistType = 0;
+	m_CacheDirty = false;
 	m_BroadcastTime = 0;
 	secure_random_fill(m_aTokenSeed, sizeof(m_aTokenSeed));
 	m_RequestNumber = 0;
@@ -154,161 +178,205 @@ bool CServerBrowser::SortCompareNumClients(int Index1, int Index2) const
 	return a->m_Info.m_NumClients < b->m_Info.m_NumClients;
 }
 
-void CServerBrowser::Filter()
+// like str_find_nocase, but the needle is lowercase already
+static bool FindLower(const char *pHaystack, const char *pLowerNeedle)
 {
-	int i = 0, p = 0;
-	m_NumSortedServers = 0;
-
-	// allocate the sorted list
-	if(m_NumSortedServersCapacity < m_NumServers)
+	for(; *pHaystack; pHaystack++)
 	{
-		if(m_pSortedServerlist)
-			free(m_pSortedServerlist);
-		m_NumSortedServersCapacity = m_NumServers;
-		m_pSortedServerlist = (int *)calloc(m_NumSortedServersCapacity, sizeof(int));
+		if(tolower((unsigned char)*pHaystack) != pLowerNeedle[0])
+			continue;
+		const char *a = pHaystack + 1;
+		const char *b = pLowerNeedle + 1;
+		while(*a && *b && tolower((unsigned char)*a) == *b)
+		{
+			a++;
+			b++;
+		}
+		if(!(*b))
+			return true;
 	}
+	return false;
+}
 
-	// filter the servers
-	for(i = 0; i < m_NumServers; i++)
-	{
-		int Filtered = 0;
+static void StrToLower(char *pDst, const char *pSrc, int DstSize)
+{
+	int i = 0;
+	for(; i < DstSize - 1 && pSrc[i]; i++)
+		pDst[i] = tolower((unsigned char)pSrc[i]);
+	pDst[i] = 0;
+}
 
-		if(g_Config.m_BrFilterEmpty && m_ppServerlist[i]->m_Info.m_NumFilteredPlayers == 0)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterFull && Players(m_ppServerlist[i]->m_Info) == Max(m_ppServerlist[i]->m_Info))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterPw && m_ppServerlist[i]->m_Info.m_Flags&SERVER_FLAG_PASSWORD)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterPure &&
-			(str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "DM") != 0 &&
-			str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "TDM") != 0 &&
-			str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "CTF") != 0))
-		{
-			Filtered = 1;
-		}
-		else if(g_Config.m_BrFilterPureMap &&
-			!(str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm1") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm2") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm6") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm7") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm8") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm9") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf1") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf2") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf3") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf4") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf5") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf6") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf7") == 0)
-		)
+void CServerBrowser::PrepareFilter()
+{
+	StrToLower(m_aFilterString, g_Config.m_BrFilterString, sizeof(m_aFilterString));
+	StrToLower(m_aFilterGametypeString, g_Config.m_BrFilterGametype, sizeof(m_aFilterGametypeString));
+	StrToLower(m_aExcludeString, g_Config.m_BrExcludeString, sizeof(m_aExcludeString));
+	StrToLower(m_aFilterAddressString, g_Config.m_BrFilterServerAddress, sizeof(m_aFilterAddressString));
+}
+
+bool CServerBrowser::IsFiltered(CServerEntry *pEntry)
+{
+	int p = 0;
+	int Filtered = 0;
+
+	if(g_Config.m_BrFilterEmpty && pEntry->m_Info.m_NumFilteredPlayers == 0)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterFull && Players(pEntry->m_Info) == Max(pEntry->m_Info))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterPw && pEntry->m_Info.m_Flags&SERVER_FLAG_PASSWORD)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterPure &&
+		(str_comp(pEntry->m_Info.m_aGameType, "DM") != 0 &&
+		str_comp(pEntry->m_Info.m_aGameType, "TDM") != 0 &&
+		str_comp(pEntry->m_Info.m_aGameType, "CTF") != 0))
+	{
+		Filtered = 1;
+	}
+	else if(g_Config.m_BrFilterPureMap &&
+		!(str_comp(pEntry->m_Info.m_aMap, "dm1") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm2") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm6") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm7") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm8") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm9") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf1") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf2") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf3") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf4") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf5") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf6") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf7") == 0)
+	)
+	{
+		Filtered = 1;
+	}
+	else if(g_Config.m_BrFilterPing < pEntry->m_Info.m_Latency)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterCompatversion && str_comp_num(pEntry->m_Info.m_aVersion, m_aNetVersion, 3) != 0)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterServerAddress[0] && !FindLower(pEntry->m_Info.m_aAddress, m_aFilterAddressString))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && str_comp_nocase(pEntry->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
+		Filtered = 1;
+	else if(!g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && !FindLower(pEntry->m_Info.m_aGameType, m_aFilterGametypeString))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterUnfinishedMap && pEntry->m_Info.m_HasRank == 1)
+		Filtered = 1;
+	else
+	{
+		if(g_Config.m_BrFilterCountry)
 		{
 			Filtered = 1;
-		}
-		else if(g_Config.m_BrFilterPing < m_ppServerlist[i]->m_Info.m_Latency)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterCompatversion && str_comp_num(m_ppServerlist[i]->m_Info.m_aVersion, m_aNetVersion, 3) != 0)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterServerAddress[0] && !str_find_nocase(m_ppServerlist[i]->m_Info.m_aAddress, g_Config.m_BrFilterServerAddress))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && str_comp_nocase(m_ppServerlist[i]->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
-			Filtered = 1;
-		else if(!g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && !str_find_nocase(m_ppServerlist[i]->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterUnfinishedMap && m_ppServerlist[i]->m_Info.m_HasRank == 1)
-			Filtered = 1;
-		else
-		{
-			if(g_Config.m_BrFilterCountry)
+			// match against player country
+			for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
 			{
-				Filtered = 1;
-				// match against player country
-				for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
+				if(pEntry->m_Info.m_aClients[p].m_Country == g_Config.m_BrFilterCountryIndex)
 				{
-					if(m_ppServerlist[i]->m_Info.m_aClients[p].m_Country == g_Config.m_BrFilterCountryIndex)
-					{
-						Filtered = 0;
-						break;
-					}
+					Filtered = 0;
+					break;
 				}
 			}
+		}
 
-			if(!Filtered && g_Config.m_BrFilterString[0] != 0)
-			{
-				int MatchFound = 0;
-
-				m_ppServerlist[i]->m_Info.m_QuickSearchHit = 0;
+		if(!Filtered && g_Config.m_BrFilterString[0] != 0)
+		{
+			int MatchFound = 0;
 
-				// match against server name
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aName, g_Config.m_BrFilterString))
-				{
-					MatchFound = 1;
-					m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_SERVERNAME;
-				}
+			pEntry->m_Info.m_QuickSearchHit = 0;
 
-				// match against players
-				for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
-				{
-					if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aClients[p].m_aName, g_Config.m_BrFilterString) ||
-						str_find_nocase(m_ppServerlist[i]->m_Info.m_aClients[p].m_aClan, g_Config.m_BrFilterString))
-					{
-						MatchFound = 1;
-						m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_PLAYER;
-						break;
-					}
-				}
+			// match against server name
+			if(FindLower(pEntry->m_Info.m_aName, m_aFilterString))
+			{
+				MatchFound = 1;
+				pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_SERVERNAME;
+			}
 
-				// match against map
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aMap, g_Config.m_BrFilterString))
+			// match against players
+			for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
+			{
+				if(FindLower(pEntry->m_Info.m_aClients[p].m_aName, m_aFilterString) ||
+					FindLower(pEntry->m_Info.m_aClients[p].m_aClan, m_aFilterString))
 				{
 					MatchFound = 1;
-					m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_MAPNAME;
+					pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_PLAYER;
+					break;
 				}
-
-				if(!MatchFound)
-					Filtered = 1;
 			}
 
-			if(!Filtered && g_Config.m_BrExcludeString[0] != 0)
+			// match against map
+			if(FindLower(pEntry->m_Info.m_aMap, m_aFilterString))
 			{
-				int MatchFound = 0;
+				MatchFound = 1;
+				pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_MAPNAME;
+			}
 
-				// match against server name
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aName, g_Config.m_BrExcludeString))
-				{
-					MatchFound = 1;
-				}
+			if(!MatchFound)
+				Filtered = 1;
+		}
 
-				// match against map
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aMap, g_Config.m_BrExcludeString))
-				{
-					MatchFound = 1;
-				}
+		if(!Filtered && g_Config.m_BrExcludeString[0] != 0)
+		{
+			int MatchFound = 0;
 
-				// match against gametype
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aGameType, g_Config.m_BrExcludeString))
-				{
-					MatchFound = 1;
-				}
+			// match against server name
+			if(FindLower(pEntry->m_Info.m_aName, m_aExcludeString))
+			{
+				MatchFound = 1;
+			}
 
-				if(MatchFound)
-					Filtered = 1;
+			// match against map
+			if(FindLower(pEntry->m_Info.m_aMap, m_aExcludeString))
+			{
+				MatchFound = 1;
 			}
-		}
 
-		if(Filtered == 0)
-		{
-			// check for friend
-			m_ppServerlist[i]->m_Info.m_FriendState = IFriends::FRIEND_NO;
-			for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
+			// match against gametype
+			if(FindLower(pEntry->m_Info.m_aGameType, m_aExcludeString))
 			{
-				m_ppServerlist[i]->m_Info.m_aClients[p].m_FriendState = m_pFriends->GetFriendState(m_ppServerlist[i]->m_Info.m_aClients[p].m_aName,
-					m_ppServerlist[i]->m_Info.m_aClients[p].m_aClan);
-				m_ppServerlist[i]->m_Info.m_FriendState = maximum(m_ppServerlist[i]->m_Info.m_FriendState, m_ppServerlist[i]->m_Info.m_aClients[p].m_FriendState);
+				MatchFound = 1;
 			}
 
-			if(!g_Config.m_BrFilterFriends || m_ppServerlist[i]->m_Info.m_FriendState != IFriends::FRIEND_NO)
-				m_pSortedServerlist[m_NumSortedServers++] = i;
+			if(MatchFound)
+				Filtered = 1;
+		}
+	}
+
+	if(Filtered == 0)
+	{
+		// check for friend
+		pEntry->m_Info.m_FriendState = IFriends::FRIEND_NO;
+		for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
+		{
+			pEntry->m_Info.m_aClients[p].m_FriendState = m_pFriends->GetFriendState(pEntry->m_Info.m_aClients[p].m_aName,
+				pEntry->m_Info.m_aClients[p].m_aClan);
+			pEntry->m_Info.m_FriendState = maximum(pEntry->m_Info.m_FriendState, pEntry->m_Info.m_aClients[p].m_FriendState);
 		}
+
+		if(!g_Config.m_BrFilterFriends || pEntry->m_Info.m_FriendState != IFriends::FRIEND_NO)
+			return false;
+	}
+	return true;
+}
+
+void CServerBrowser::Filter()
+{
+	m_NumSortedServers = 0;
+
+	// allocate the sorted list
+	if(m_NumSortedServersCapacity < m_NumServers)
+	{
+		if(m_pSortedServerlist)
+			free(m_pSortedServerlist);
+		m_NumSortedServersCapacity = m_NumServers;
+		m_pSortedServerlist = (int *)calloc(m_NumSortedServersCapacity, sizeof(int));
+	}
+
+	// filter the servers
+	for(int i = 0; i < m_NumServers; i++)
+	{
+		m_ppServerlist[i]->m_Info.m_SortedIndex = -1;
+		if(!IsFiltered(m_ppServerlist[i]))
+			m_pSortedServerlist[m_NumSortedServers++] = i;
 	}
 }
 
@@ -352,6 +420,21 @@ void SetFilteredPlayers(const CServerInfo &Item)
 	}
 }
 
+CServerBrowser::FSortCompare CServerBrowser::SortCompare() const
+{
+	if(g_Config.m_BrSort == IServerBrowser::SORT_NAME)
+		return &CServerBrowser::SortCompareName;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_PING)
+		return &CServerBrowser::SortComparePing;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_MAP)
+		return &CServerBrowser::SortCompareMap;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS)
+		return &CServerBrowser::SortCompareNumPlayers;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_GAMETYPE)
+		return &CServerBrowser::SortCompareGametype;
+	return 0;
+}
+
 void CServerBrowser::Sort()
 {
 	int i;
@@ -363,33 +446,74 @@ void CServerBrowser::Sort()
 	}
 
 	// create filtered list
+	PrepareFilter();
 	Filter();
 
 	// sort
-	if(g_Config.m_BrSort == IServerBrowser::SORT_NAME)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareName));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_PING)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortComparePing));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_MAP)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareMap));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareNumPlayers));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_GAMETYPE)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareGametype));
+	FSortCompare pfnCompare = SortCompare();
+	if(pfnCompare)
+		std::sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, pfnCompare));
 
 	// set indexes
 	for(i = 0; i < m_NumSortedServers; i++)
 		m_ppServerlist[m_pSortedServerlist[i]]->m_Info.m_SortedIndex = i;
 
-	str_copy(m_aFilterGametypeString, g_Config.m_BrFilterGametype, sizeof(m_aFilterGametypeString));
-	str_copy(m_aFilterString, g_Config.m_BrFilterString, sizeof(m_aFilterString));
 	m_Sorthash = SortHash();
 }
 
+void CServerBrowser::ResortEntry(CServerEntry *pEntry)
+{
+	// take the entry out of the sorted list
+	int Index = pEntry->m_Info.m_SortedIndex;
+	if(Index >= 0)
+	{
+		mem_move(&m_pSortedServerlist[Index], &m_pSortedServerlist[Index+1], (m_NumSortedServers-Index-1)*sizeof(int));
+		m_NumSortedServers--;
+		for(int i = Index; i < m_NumSortedServers; i++)
+			m_ppServerlist[m_pSortedServerlist[i]]->m_Info.m_SortedIndex = i;
+		pEntry->m_Info.m_SortedIndex = -1;
+	}
+
+	SetFilteredPlayers(pEntry->m_Info);
+	PrepareFilter();
+	if(IsFiltered(pEntry))
+		return;
+
+	if(m_NumSortedServersCapacity < m_NumServers)
+	{
+		int *pNewList = (int *)calloc(m_NumServers, sizeof(int));
+		if(m_pSortedServerlist)
+		{
+			mem_copy(pNewList, m_pSortedServerlist, m_NumSortedServers*sizeof(int));
+			free(m_pSortedServerlist);
+		}
+		m_pSortedServerlist = pNewList;
+		m_NumSortedServersCapacity = m_NumServers;
+	}
+
+	// the filtered list is ordered by the server index without a sort function
+	int *pEnd = m_pSortedServerlist+m_NumSortedServers;
+	FSortCompare pfnCompare = SortCompare();
+	if(pfnCompare)
+		Index = std::lower_bound(m_pSortedServerlist, pEnd, pEntry->m_Info.m_ServerIndex, SortWrap(this, pfnCompare)) - m_pSortedServerlist;
+	else
+		Index = std::lower_bound(m_pSortedServerlist, pEnd, pEntry->m_Info.m_ServerIndex) - m_pSortedServerlist;
+	mem_move(&m_pSortedServerlist[Index+1], &m_pSortedServerlist[Index], (m_NumSortedServers-Index)*sizeof(int));
+	m_pSortedServerlist[Index] = pEntry->m_Info.m_ServerIndex;
+	m_NumSortedServers++;
+	for(int i = Index; i < m_NumSortedServers; i++)
+		m_ppServerlist[m_pSortedServerlist[i]]->m_Info.m_SortedIndex = i;
+}
+
 void CServerBrowser::RemoveRequest(CServerEntry *pEntry)
 {
 	if(pEntry->m_pPrevReq || pEntry->m_pNextReq || m_pFirstReqServer == pEntry)
 	{
+		if(m_pNextReqServer == pEntry)
+			m_pNextReqServer = pEntry->m_pNextReq;
+		else if(pEntry->m_RequestTime != 0)
+			m_NumRequestsInFlight--;
+
 		if(pEntry->m_pPrevReq)
 			pEntry->m_pPrevReq->m_pNextReq = pEntry->m_pNextReq;
 		else
@@ -428,6 +552,8 @@ void CServerBrowser::QueueRequest(CServerEntry *pEntry)
 		m_pFirstReqServer = pEntry;
 	m_pLastReqServer = pEntry;
 	pEntry->m_pNextReq = 0;
+	if(!m_pNextReqServer)
+		m_pNextReqServer = pEntry;
 	m_NumRequests++;
 }
 
@@ -435,9 +561,13 @@ void CServerBrowser::SetInfo(CServerEntry *pEntry, const CServerInfo &Info)
 {
 	bool Fav = pEntry->m_Info.m_Favorite;
 	bool Off = pEntry->m_Info.m_Official;
+	int ServerIndex = pEntry->m_Info.m_ServerIndex;
+	int SortedIndex = pEntry->m_Info.m_SortedIndex;
 	pEntry->m_Info = Info;
 	pEntry->m_Info.m_Favorite = Fav;
 	pEntry->m_Info.m_Official = Off;
+	pEntry->m_Info.m_ServerIndex = ServerIndex;
+	pEntry->m_Info.m_SortedIndex = SortedIndex;
 	pEntry->m_Info.m_NetAddr = pEntry->m_Addr;
 
 	// all these are just for nice compatibility
@@ -520,6 +650,7 @@ CServerBrowser::CServerEntry *CServerBrowser::Add(const NETADDR &Addr)
 	// add to list
 	m_ppServerlist[m_NumServers] = pEntry;
 	pEntry->m_Info.m_ServerIndex = m_NumServers;
+	pEntry->m_Info.m_SortedIndex = -1;
 	m_NumServers++;
 
 	return pEntry;
@@ -617,6 +748,7 @@ void CServerBrowser::Set(const NETADDR &Addr, int Type, int Token, const CServer
 				}
 			}
 			SetInfo(pEntry, *pInfo);
+			m_CacheDirty = true;
 			if (m_ServerlistType == IServerBrowser::TYPE_LAN)
 				pEntry->m_Info.m_Latency = minimum(static_cast<int>((time_get()-m_BroadcastTime)*1000/time_freq()), 999);
 			else if (pEntry->m_RequestTime > 0)
@@ -628,7 +760,16 @@ void CServerBrowser::Set(const NETADDR &Addr, int Type, int Token, const CServer
 		}
 	}
 
-	Sort();
+	// only the changed server needs to move, a full sort is done when the
+	// filter or the sort order changes
+	if(pEntry)
+		ResortEntry(pEntry);
+}
+
+// requests that may be sent at once, a tenth of a second worth of them
+static float RequestBurst()
+{
+	return maximum(1.0f, g_Config.m_BrRequestRate/10.0f);
 }
 
 void CServerBrowser::Refresh(int Type)
@@ -640,11 +781,15 @@ void CServerBrowser::Refresh(int Type)
 	mem_zero(m_aServerlistIp, sizeof(m_aServerlistIp));
 	m_pFirstReqServer = 0;
 	m_pLastReqServer = 0;
+	m_pNextReqServer = 0;
 	m_NumRequests = 0;
-	m_CurrentMaxRequests = g_Config.m_BrMaxRequests;
+	m_NumRequestsInFlight = 0;
+	m_RequestTokens = RequestBurst();
+	m_LastRequestRefill = time_get();
 	m_RequestNumber++;
 
 	m_ServerlistType = Type;
+	m_CacheDirty = false;
 
 	if(Type == IServerBrowser::TYPE_LAN)
 	{
@@ -728,6 +873,9 @@ void CServerBrowser::Refresh(int Type)
 			}
 		}
 	}
+
+	if(g_Config.m_BrCache)
+		LoadCache();
 }
 
 void CServerBrowser::RequestImpl(const NETADDR &Addr, CServerEntry *pEntry) const
@@ -803,8 +951,7 @@ void CServerBrowser::Update(bool ForceResort)
 {
 	int64 Timeout = time_freq();
 	int64 Now = time_get();
-	int Count;
-	CServerEntry *pEntry, *pNext;
+	CServerEntry *pEntry;
 
 	// do server list requests
 	if(m_NeedRefresh && !m_pMasterServer->IsRefreshing())
@@ -910,61 +1057,43 @@ void CServerBrowser::Update(bool ForceResort)
 		++m_LastPacketTick;
 		return; //wait for more packets
 	}
-	pEntry = m_pFirstReqServer;
-	Count = 0;
-	while(1)
+	// requests are sent in list order, so the oldest ones are at the front.
+	// retry the ones that timed out at the back of the list
+	while(m_pFirstReqServer && m_pFirstReqServer != m_pNextReqServer && m_pFirstReqServer->m_RequestTime+Timeout < Now)
 	{
-		if(!pEntry) // no more entries
-			break;
-		if(pEntry->m_RequestTime && pEntry->m_RequestTime+Timeout < Now)
-		{
-			pEntry = pEntry->m_pNextReq;
-			continue;
-		}
-		// no more then 10 concurrent requests
-		if(Count == m_CurrentMaxRequests)
-			break;
-
-		if(pEntry->m_RequestTime == 0)
-		{
-			if (pEntry->m_Request64Legacy)
-				RequestImpl64(pEntry->m_Addr, pEntry);
-			else
-				RequestImpl(pEntry->m_Addr, pEntry);
-		}
-
-		Count++;
-		pEntry = pEntry->m_pNextReq;
-	}
-
-	if(m_pFirstReqServer && Count == 0 && m_CurrentMaxRequests > 1) //NO More current Server Requests
-	{
-		//reset old ones
 		pEntry = m_pFirstReqServer;
-		while(1)
+		RemoveRequest(pEntry);
+		if(pEntry->m_RequestTries < MAX_REQUEST_TRIES)
 		{
-			if(!pEntry) // no more entries
-				break;
 			pEntry->m_RequestTime = 0;
-			pEntry = pEntry->m_pNextReq;
+			QueueRequest(pEntry);
 		}
+	}
+
+	// pace the requests, sending them in bursts overflows the buffers of
+	// the routers and the socket and the answers get lost
+	m_RequestTokens = minimum(m_RequestTokens + (float)(Now-m_LastRequestRefill)*g_Config.m_BrRequestRate/time_freq(), RequestBurst());
+	m_LastRequestRefill = Now;
 
-		//update max-requests
-		m_CurrentMaxRequests = m_CurrentMaxRequests/2;
-		if(m_CurrentMaxRequests < 1)
-			m_CurrentMaxRequests = 1;
+	while(m_pNextReqServer && m_NumRequestsInFlight < g_Config.m_BrMaxRequests && m_RequestTokens >= 1.0f)
+	{
+		pEntry = m_pNextReqServer;
+		m_pNextReqServer = pEntry->m_pNextReq;
+		if(pEntry->m_Request64Legacy)
+			RequestImpl64(pEntry->m_Addr, pEntry);
+		else
+			RequestImpl(pEntry->m_Addr, pEntry);
+		pEntry->m_RequestTries++;
+		m_NumRequestsInFlight++;
+		m_RequestTokens -= 1.0f;
 	}
-	else if(Count == 0 && m_CurrentMaxRequests == 1) //we reached the limit, just release all left requests. IF a server sends us a packet, a new request will be added automatically, so we can delete all
+
+	// remember the infos once all of them arrived
+	if(m_CacheDirty && !m_pFirstReqServer)
 	{
-		pEntry = m_pFirstReqServer;
-		while(1)
-		{
-			if(!pEntry) // no more entries
-				break;
-			pNext = pEntry->m_pNextReq;
-			RemoveRequest(pEntry);	//release request
-			pEntry = pNext;
-		}
+		if(g_Config.m_BrCache)
+			SaveCache();
+		m_CacheDirty = false;
 	}
 
 	// check if we need to resort
@@ -1178,6 +1307,200 @@ int CServerBrowser::HasRank(const char *pMap)
 	return 0;
 }
 
+static const char *CacheFilename(int Type)
+{
+	switch(Type)
+	{
+	case IServerBrowser::TYPE_INTERNET: return "serverbrowser_internet.cache";
+	case IServerBrowser::TYPE_FAVORITES: return "serverbrowser_favorites.cache";
+	case IServerBrowser::TYPE_DDNET: return "serverbrowser_ddnet.cache";
+	case IServerBrowser::TYPE_KOG: return "serverbrowser_kog.cache";
+	}
+	return 0;
+}
+
+// the cache is a list of chunks, each one made by a packer and prefixed
+// with its size
+static void WriteCacheChunk(IOHANDLE File, const CPacker *pPacker)
+{
+	unsigned char aSize[2] = {(unsigned char)(pPacker->Size()>>8), (unsigned char)pPacker->Size()};
+	io_write(File, aSize, sizeof(aSize));
+	io_write(File, pPacker->Data(), pPacker->Size());
+}
+
+static bool ReadCacheChunk(CUnpacker *pUnpacker, const unsigned char **ppData, const unsigned char *pEnd)
+{
+	if(pEnd - *ppData < 2)
+		return false;
+	int Size = ((*ppData)[0]<<8) | (*ppData)[1];
+	*ppData += 2;
+	if(pEnd - *ppData < Size)
+		return false;
+	pUnpacker->Reset(*ppData, Size);
+	*ppData += Size;
+	return true;
+}
+
+void CServerBrowser::SaveCache()
+{
+	const char *pFilename = CacheFilename(m_ServerlistType);
+	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
+	if(!pFilename || !pStorage)
+		return;
+
+	char aTmpFilename[64];
+	str_format(aTmpFilename, sizeof(aTmpFilename), "%s.tmp", pFilename);
+	IOHANDLE File = pStorage->OpenFile(aTmpFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+		return;
+
+	int NumServers = 0;
+	for(int i = 0; i < m_NumServers; i++)
+		if(m_ppServerlist[i]->m_GotInfo && !m_ppServerlist[i]->m_Info.m_Stale)
+			NumServers++;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(CACHE_VERSION);
+	Packer.AddInt(NumServers);
+	WriteCacheChunk(File, &Packer);
+
+	for(int i = 0; i < m_NumServers; i++)
+	{
+		const CServerEntry *pEntry = m_ppServerlist[i];
+		const CServerInfo *pInfo = &pEntry->m_Info;
+		if(!pEntry->m_GotInfo || pInfo->m_Stale)
+			continue;
+
+		Packer.Reset();
+		Packer.AddRaw(&pEntry->m_Addr, sizeof(pEntry->m_Addr));
+		Packer.AddInt(pInfo->m_Type);
+		Packer.AddInt(pInfo->m_Latency);
+		Packer.AddString(pInfo->m_aVersion, sizeof(pInfo->m_aVersion));
+		Packer.AddString(pInfo->m_aName, sizeof(pInfo->m_aName));
+		Packer.AddString(pInfo->m_aMap, sizeof(pInfo->m_aMap));
+		Packer.AddInt(pInfo->m_MapCrc);
+		Packer.AddInt(pInfo->m_MapSize);
+		Packer.AddString(pInfo->m_aGameType, sizeof(pInfo->m_aGameType));
+		Packer.AddInt(pInfo->m_Flags);
+		Packer.AddInt(pInfo->m_NumPlayers);
+		Packer.AddInt(pInfo->m_MaxPlayers);
+		Packer.AddInt(pInfo->m_NumClients);
+		Packer.AddInt(pInfo->m_MaxClients);
+		Packer.AddInt(pInfo->m_NumReceivedClients);
+		WriteCacheChunk(File, &Packer);
+
+		for(int c = 0; c < pInfo->m_NumReceivedClients; c++)
+		{
+			const CServerInfo::CClient *pClient = &pInfo->m_aClients[c];
+			Packer.Reset();
+			Packer.AddString(pClient->m_aName, sizeof(pClient->m_aName));
+			Packer.AddString(pClient->m_aClan, sizeof(pClient->m_aClan));
+			Packer.AddInt(pClient->m_Country);
+			Packer.AddInt(pClient->m_Score);
+			Packer.AddInt(pClient->m_Player);
+			WriteCacheChunk(File, &Packer);
+		}
+	}
+
+	io_close(File);
+	pStorage->RenameFile(aTmpFilename, pFilename, IStorage::TYPE_SAVE);
+}
+
+void CServerBrowser::LoadCache()
+{
+	const char *pFilename = CacheFilename(m_ServerlistType);
+	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
+	if(!pFilename || !pStorage)
+		return;
+
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return;
+	const int Length = io_length(File);
+	if(Length <= 0)
+	{
+		io_close(File);
+		return;
+	}
+	unsigned char *pBuf = (unsigned char *)malloc(Length);
+	int Read = io_read(File, pBuf, Length);
+	io_close(File);
+
+	const unsigned char *pData = pBuf;
+	const unsigned char *pEnd = pBuf + Read;
+	CUnpacker Unpacker;
+	if(!ReadCacheChunk(&Unpacker, &pData, pEnd) || Unpacker.GetInt() != CACHE_VERSION)
+	{
+		free(pBuf);
+		return;
+	}
+
+	int NumServers = Unpacker.GetInt();
+	for(int i = 0; i < NumServers && !Unpacker.Error(); i++)
+	{
+		if(!ReadCacheChunk(&Unpacker, &pData, pEnd))
+			break;
+
+		CServerInfo Info;
+		mem_zero(&Info, sizeof(Info));
+		NETADDR Addr;
+		const unsigned char *pAddr = Unpacker.GetRaw(sizeof(Addr));
+		if(!pAddr)
+			break;
+		mem_copy(&Addr, pAddr, sizeof(Addr));
+		Info.m_Type = Unpacker.GetInt();
+		Info.m_Latency = Unpacker.GetInt();
+		str_copy(Info.m_aVersion, Unpacker.GetString(CUnpacker::SANITIZE_CC), sizeof(Info.m_aVersion));
+		str_copy(Info.m_aName, Unpacker.GetString(CUnpacker::SANITIZE_CC), sizeof(Info.m_aName));
+		str_copy(Info.m_aMap, Unpacker.GetString(CUnpacker::SANITIZE_CC), sizeof(Info.m_aMap));
+		Info.m_MapCrc = Unpacker.GetInt();
+		Info.m_MapSize = Unpacker.GetInt();
+		str_copy(Info.m_aGameType, Unpacker.GetString(CUnpacker::SANITIZE_CC), sizeof(Info.m_aGameType));
+		Info.m_Flags = Unpacker.GetInt();
+		Info.m_NumPlayers = Unpacker.GetInt();
+		Info.m_MaxPlayers = Unpacker.GetInt();
+		Info.m_NumClients = Unpacker.GetInt();
+		Info.m_MaxClients = Unpacker.GetInt();
+		Info.m_NumReceivedClients = clamp(Unpacker.GetInt(), 0, (int)MAX_CLIENTS);
+
+		for(int c = 0; c < Info.m_NumReceivedClients && !Unpacker.Error(); c++)
+		{
+			if(!ReadCacheChunk(&Unpacker, &pData, pEnd))
+				break;
+			CServerInfo::CClient *pClient = &Info.m_aClients[c];
+			str_copy(pClient->m_aName, Unpacker.GetString(CUnpacker::SANITIZE_CC), sizeof(pClient->m_aName));
+			str_copy(pClient->m_aClan, Unpacker.GetString(CUnpacker::SANITIZE_CC), sizeof(pClient->m_aClan));
+			pClient->m_Country = Unpacker.GetInt();
+			pClient->m_Score = Unpacker.GetInt();
+			pClient->m_Player = Unpacker.GetInt() != 0;
+		}
+		if(Unpacker.Error())
+			break;
+
+		// only the internet list gets its servers from elsewhere, the other
+		// lists already know theirs
+		CServerEntry *pEntry = Find(Addr);
+		if(!pEntry && m_ServerlistType == IServerBrowser::TYPE_INTERNET)
+		{
+			pEntry = Add(Addr);
+			QueueRequest(pEntry);
+		}
+		if(!pEntry || pEntry->m_GotInfo)
+			continue;
+
+		net_addr_str(&Addr, Info.m_aAddress, sizeof(Info.m_aAddress), true);
+		Info.m_HasRank = Info.m_aMap[0] ? HasRank(Info.m_aMap) : -1;
+		Info.m_Stale = true;
+		SetInfo(pEntry, Info);
+		// the next info isn't an update of this one
+		pEntry->m_GotInfo = 0;
+	}
+
+	free(pBuf);
+	Sort();
+}
+
 void CServerBrowser::LoadDDNetInfoJson()
 {
 	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
@@ -15,6 +15,7 @@ public:
 	public:
 		NETADDR m_Addr;
 		int64 m_RequestTime;
+		int m_RequestTries;
 		int m_GotInfo;
 		bool m_Request64Legacy;
 		CServerInfo m_Info;
@@ -125,7 +126,18 @@ public:
 	CServerEntry *Find(const NETADDR &Addr);
 	int GetCurrentType() { return m_ServerlistType; };
 
+	int GenerateToken(const NETADDR &Addr) const;
+
+	typedef bool (CServerBrowser::*FSortCompare)(int Index1, int Index2) const;
+
 private:
+	enum
+	{
+		MAX_REQUEST_TRIES = 3,
+
+		CACHE_VERSION = 1,
+	};
+
 	CNetClient *m_pNetClient;
 	IMasterServer *m_pMasterServer;
 	class IConsole *m_pConsole;
@@ -147,11 +159,14 @@ private:
 
 	CServerEntry *m_pFirstReqServer; // request list
 	CServerEntry *m_pLastReqServer;
+	CServerEntry *m_pNextReqServer; // first server of the request list that wasn't requested yet
 	int m_NumRequests;
+	int m_NumRequestsInFlight;
 	int m_MasterServerCount;
 
-	//used instead of g_Config.br_max_requests to get more servers
-	int m_CurrentMaxRequests;
+	// token bucket for the request rate
+	float m_RequestTokens;
+	int64 m_LastRequestRefill;
 
 	int m_LastPacketTick;
 
@@ -163,15 +178,18 @@ private:
 	int m_NumServerCapacity;
 
 	int m_Sorthash;
+	// lowercase copies of the filter strings
 	char m_aFilterString[64];
 	char m_aFilterGametypeString[128];
+	char m_aExcludeString[64];
+	char m_aFilterAddressString[128];
 
 	int m_ServerlistType;
+	bool m_CacheDirty;
 	int64 m_BroadcastTime;
 	int m_RequestNumber;
 	unsigned char m_aTokenSeed[16];
 
-	int GenerateToken(const NETADDR &Addr) const;
 	static int GetBasicToken(int Token);
 	static int GetExtraToken(int Token);
 
@@ -183,9 +201,15 @@ private:
 	bool SortCompareNumPlayers(int Index1, int Index2) const;
 	bool SortCompareNumClients(int Index1, int Index2) const;
 
+	FSortCompare SortCompare() const;
+
 	//
+	void PrepareFilter();
+	bool IsFiltered(CServerEntry *pEntry);
 	void Filter();
 	void Sort();
+	// moves a changed server to its place in the sorted list
+	void ResortEntry(CServerEntry *pEntry);
 	int SortHash() const;
 
 	CServerEntry *Add(const NETADDR &Addr);
@@ -196,6 +220,10 @@ private:
 
 	void SetInfo(CServerEntry *pEntry, const CServerInfo &Info);
 
+	// the infos of the last refresh, shown until they are refreshed
+	void LoadCache();
+	void SaveCache();
+
 	static void ConfigSaveCallback(IConfig *pConfig, void *pUserData);
 };
 
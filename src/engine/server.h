@@ -220,6 +220,9 @@ public:
 
 	virtual bool IsClientReady(int ClientID) = 0;
 	virtual bool IsClientPlayer(int ClientID) = 0;
+	// the character of the client as it was after the last world tick, false
+	// if there was none
+	virtual bool GetTickCharacter(int ClientID, CNetObj_CharacterCore *pCore) = 0;
 
 	virtual CUuid GameUuid() = 0;
 	virtual const char *GameType() = 0;
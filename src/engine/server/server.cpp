@@ -14,6 +14,7 @@
 #include <engine/server.h>
 #include <engine/storage.h>
 
+#include <engine/external/json-parser/json.h>
 #include <engine/shared/compression.h>
 #include <engine/shared/config.h>
 #include <engine/shared/datafile.h>
@@ -35,6 +36,7 @@
 #include <vector>
 #include <engine/shared/linereader.h>
 #include <game/extrainfo.h>
+#include <game/server/teehistorian.h>
 
 #include "register.h"
 #include "server.h"
@@ -245,9 +247,8 @@ void CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 void CServer::CClient::Reset()
 {
 	// reset input
-	for(int i = 0; i < 200; i++)
+	for(int i = 0; i < INPUT_BUFFER_SIZE; i++)
 		m_aInputs[i].m_GameTick = -1;
-	m_CurrentInput = 0;
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
 
 	m_Snapshots.PurgeAll();
@@ -277,6 +278,7 @@ CServer::CServer()
 
 	m_MapReload = 0;
 	m_ReloadedWhenEmpty = false;
+	m_SnapshotBench = false;
 
 	m_RconClientID = IServer::RCON_CID_SERV;
 	m_RconAuthLevel = AUTHED_ADMIN;
@@ -286,6 +288,13 @@ CServer::CServer()
 	m_ServerInfoFirstRequest = 0;
 	m_ServerInfoNumRequests = 0;
 
+	m_NumSnapshotThreads = 0;
+	sphore_init(&m_SnapshotJobsDone);
+
+	mem_zero(&m_LastNetStats, sizeof(m_LastNetStats));
+	m_LastNetStatsTime = time_get();
+	m_LastTickProfileStream = 0;
+
 #ifdef CONF_FAMILY_UNIX
 	m_ConnLoggingSocketCreated = false;
 #endif
@@ -626,6 +635,10 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 	if(!pMsg)
 		return -1;
 
+	// dbg_snapshot_bench snaps the same tick many times, drop what the game sends while snapping
+	if(m_SnapshotBench)
+		return 0;
+
 	mem_zero(&Packet, sizeof(CNetChunk));
 
 	Packet.m_ClientID = ClientID;
@@ -669,6 +682,73 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 	return 0;
 }
 
+void CServer::CSnapshotDeltaJob::CreateDelta()
+{
+	m_DeltaSize = m_pSnapshotDelta->CreateDelta(m_pFrom, m_pTo, m_aDeltaData);
+	m_CompSize = 0;
+	if(m_DeltaSize)
+		m_CompSize = CVariableInt::Compress(m_aDeltaData, m_DeltaSize, m_aCompData, sizeof(m_aCompData));
+}
+
+void CServer::CSnapshotDeltaJob::Run()
+{
+	CreateDelta();
+	sphore_signal(m_pDone);
+}
+
+void CServer::SendSnapshot(int ClientID, const CSnapshotDeltaJob *pJob)
+{
+	int DeltaTick = pJob->m_DeltaTick;
+	int Crc = pJob->m_Crc;
+
+	if(pJob->m_DeltaSize)
+	{
+		// send the compressed delta
+		int SnapshotSize = pJob->m_CompSize;
+		m_TickProfiler.AddSnapshotSize(SnapshotSize);
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		int NumPackets;
+
+		NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+
+		for(int n = 0, Left = SnapshotSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick-DeltaTick);
+				Msg.AddInt(Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pJob->m_aCompData[n*MaxSize], Chunk);
+				SendMsgEx(&Msg, MSGFLAG_FLUSH, ClientID, true);
+			}
+			else
+			{
+				CMsgPacker Msg(NETMSG_SNAP);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick-DeltaTick);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pJob->m_aCompData[n*MaxSize], Chunk);
+				SendMsgEx(&Msg, MSGFLAG_FLUSH, ClientID, true);
+			}
+		}
+	}
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick-DeltaTick);
+		SendMsgEx(&Msg, MSGFLAG_FLUSH, ClientID, true);
+	}
+}
+
 void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
@@ -693,6 +773,8 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
+	int aSnapClients[MAX_CLIENTS];
+	int NumSnapClients = 0;
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		// client must be ingame to receive snapshots
@@ -710,15 +792,11 @@ void CServer::DoSnapshot()
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			char aCompData[CSnapshot::MAX_SIZE];
 			int SnapshotSize;
-			int Crc;
 			static CSnapshot EmptySnap;
 			CSnapshot *pDeltashot = &EmptySnap;
 			int DeltashotSize;
 			int DeltaTick = -1;
-			int DeltaSize;
 
 			m_SnapshotBuilder.Init();
 
@@ -737,8 +815,6 @@ void CServer::DoSnapshot()
 				m_aDemoRecorder[i].RecordSnapshot(Tick(), aExtraInfoRemoved, SnapshotSize);
 			}
 
-			Crc = pData->Crc();
-
 			// remove old snapshos
 			// keep 3 seconds worth of snapshots
 			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick-SERVER_TICK_SPEED*3);
@@ -761,58 +837,41 @@ void CServer::DoSnapshot()
 				}
 			}
 
-			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
-
-			if(DeltaSize)
+			if(!m_apSnapshotDeltaJobs[i])
 			{
-				// compress it
-				int SnapshotSize;
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-				int NumPackets;
-
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
-
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
-
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
-					}
-				}
-			}
-			else
-			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick-DeltaTick);
-				SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+				m_apSnapshotDeltaJobs[i] = std::make_shared<CSnapshotDeltaJob>();
+				m_apSnapshotDeltaJobs[i]->m_pSnapshotDelta = &m_SnapshotDelta;
+				m_apSnapshotDeltaJobs[i]->m_pDone = &m_SnapshotJobsDone;
 			}
+
+			// delta creation and compression only depend on the stored snapshots,
+			// so they can run independently for all clients
+			CSnapshotDeltaJob *pJob = m_apSnapshotDeltaJobs[i].get();
+			pJob->m_pFrom = pDeltashot;
+			pJob->m_pTo = m_aClients[i].m_Snapshots.m_pLast->m_pSnap;
+			pJob->m_DeltaTick = DeltaTick;
+			pJob->m_Crc = pData->Crc();
+			aSnapClients[NumSnapClients++] = i;
 		}
 	}
 
+	if(m_NumSnapshotThreads > 0 && NumSnapClients > 1)
+	{
+		for(int i = 0; i < NumSnapClients; i++)
+			m_SnapshotJobPool.Add(m_apSnapshotDeltaJobs[aSnapClients[i]]);
+		for(int i = 0; i < NumSnapClients; i++)
+			sphore_wait(&m_SnapshotJobsDone);
+	}
+	else
+	{
+		for(int i = 0; i < NumSnapClients; i++)
+			m_apSnapshotDeltaJobs[aSnapClients[i]]->CreateDelta();
+	}
+
+	// send in client order so the output doesn't depend on the job scheduling
+	for(int i = 0; i < NumSnapClients; i++)
+		SendSnapshot(aSnapClients[i], m_apSnapshotDeltaJobs[aSnapClients[i]].get());
+
 	GameServer()->OnPostSnap();
 }
 
@@ -1300,20 +1359,24 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			m_aClients[ClientID].m_LastInputTick = IntendedTick;
 
-			pInput = &m_aClients[ClientID].m_aInputs[m_aClients[ClientID].m_CurrentInput];
+			int GameTick = maximum(IntendedTick, Tick()+1);
+			pInput = &m_aClients[ClientID].m_aInputs[GameTick%CClient::INPUT_BUFFER_SIZE];
 
-			if(IntendedTick <= Tick())
-				IntendedTick = Tick()+1;
+			// late inputs all end up at the next tick, keep the newest one
+			// when they arrive out of order. inputs too far in the future
+			// would overwrite pending ones. both only update the latest input
+			if(GameTick - Tick() > CClient::INPUT_BUFFER_SIZE ||
+				(pInput->m_GameTick == GameTick && pInput->m_IntendedTick > IntendedTick))
+				pInput = &m_aClients[ClientID].m_LatestInput;
 
-			pInput->m_GameTick = IntendedTick;
+			pInput->m_GameTick = GameTick;
+			pInput->m_IntendedTick = IntendedTick;
 
 			for(int i = 0; i < Size/4; i++)
 				pInput->m_aData[i] = Unpacker.GetInt();
 
-			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
-
-			m_aClients[ClientID].m_CurrentInput++;
-			m_aClients[ClientID].m_CurrentInput %= 200;
+			if(pInput != &m_aClients[ClientID].m_LatestInput)
+				mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
 
 			// call the mod with the fresh input data
 			if(m_aClients[ClientID].m_State == CClient::STATE_INGAME)
@@ -1844,6 +1907,36 @@ void CServer::InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterS
 	m_Register.Init(pNetServer, pMasterServer, pConsole);
 }
 
+void CServer::RunTick()
+{
+	int64 PhaseStart = m_TickProfiler.Start();
+
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(m_aClients[c].m_State != CClient::STATE_INGAME)
+			continue;
+		CClient::CInput *pInput = m_aClients[c].Input(Tick() + 1);
+		if(pInput)
+			GameServer()->OnClientPredictedEarlyInput(c, pInput->m_aData);
+	}
+
+	m_CurrentGameTick++;
+
+	// apply new input
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(m_aClients[c].m_State != CClient::STATE_INGAME)
+			continue;
+		CClient::CInput *pInput = m_aClients[c].Input(Tick());
+		if(pInput)
+			GameServer()->OnClientPredictedInput(c, pInput->m_aData);
+	}
+
+	PhaseStart = m_TickProfiler.Lap(CTickProfiler::PHASE_INPUT, PhaseStart);
+	GameServer()->OnTick();
+	m_TickProfiler.Lap(CTickProfiler::PHASE_TICK, PhaseStart);
+}
+
 int CServer::Run()
 {
 	m_AuthManager.Init();
@@ -1885,7 +1978,18 @@ int CServer::Run()
 		return -1;
 	}
 
+	if(g_Config.m_SvSnapThreads > 0)
+	{
+		m_NumSnapshotThreads = g_Config.m_SvSnapThreads;
+		m_SnapshotJobPool.Init(m_NumSnapshotThreads);
+	}
+
 	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, this);
+	m_NetServer.SetSendBatching(g_Config.m_SvSendBatching);
+	if(g_Config.m_SvNetThread && !m_NetServer.StartIOThreads())
+		dbg_msg("server", "couldn't start the network threads, using the main thread");
+	net_stats(&m_LastNetStats);
+	m_LastNetStatsTime = time_get();
 
 	m_Econ.Init(Console(), &m_ServerBan);
 
@@ -1924,6 +2028,9 @@ int CServer::Run()
 
 		while(m_RunServer)
 		{
+			m_TickProfiler.SetEnabled(g_Config.m_SvTickProfiler);
+			int64 TotalStart = m_TickProfiler.Start();
+
 			if(NonActive)
 				PumpNetwork();
 
@@ -2019,31 +2126,8 @@ int CServer::Run()
 
 			while(t > TickStartTime(m_CurrentGameTick+1))
 			{
-				for(int c = 0; c < MAX_CLIENTS; c++)
-					if(m_aClients[c].m_State == CClient::STATE_INGAME)
-						for(int i = 0; i < 200; i++)
-							if(m_aClients[c].m_aInputs[i].m_GameTick == Tick() + 1)
-								GameServer()->OnClientPredictedEarlyInput(c, m_aClients[c].m_aInputs[i].m_aData);
-
-				m_CurrentGameTick++;
+				RunTick();
 				NewTicks++;
-
-				// apply new input
-				for(int c = 0; c < MAX_CLIENTS; c++)
-				{
-					if(m_aClients[c].m_State != CClient::STATE_INGAME)
-						continue;
-					for(int i = 0; i < 200; i++)
-					{
-						if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
-						{
-							GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
-							break;
-						}
-					}
-				}
-
-				GameServer()->OnTick();
 				if(ErrorShutdown())
 				{
 					break;
@@ -2053,21 +2137,31 @@ int CServer::Run()
 			// snap game
 			if(NewTicks)
 			{
+				int64 PhaseStart = m_TickProfiler.Start();
 				if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+				{
 					DoSnapshot();
+					PhaseStart = m_TickProfiler.Lap(CTickProfiler::PHASE_SNAP, PhaseStart);
+				}
 
 				UpdateClientRconCommands();
+				PhaseStart = m_TickProfiler.Lap(CTickProfiler::PHASE_RCON, PhaseStart);
 
 #if defined(CONF_FAMILY_UNIX)
 				m_Fifo.Update();
+				m_TickProfiler.Lap(CTickProfiler::PHASE_FIFO, PhaseStart);
 #endif
 			}
 
 			// master server stuff
 			m_Register.RegisterUpdate(m_NetServer.NetType());
 
+			int64 PhaseStart = m_TickProfiler.Start();
 			if(!NonActive)
+			{
 				PumpNetwork();
+				PhaseStart = m_TickProfiler.Lap(CTickProfiler::PHASE_NETWORK, PhaseStart);
+			}
 
 			NonActive = true;
 
@@ -2075,6 +2169,25 @@ int CServer::Run()
 				if(m_aClients[c].m_State != CClient::STATE_EMPTY)
 					NonActive = false;
 
+			// everything for this tick is sent now
+			m_NetServer.FlushSendQueue();
+			m_TickProfiler.Lap(CTickProfiler::PHASE_FLUSH, PhaseStart);
+			if(NewTicks)
+				m_TickProfiler.Lap(CTickProfiler::PHASE_TOTAL, TotalStart);
+
+			if(g_Config.m_EcTickProfile && m_TickProfiler.Enabled() && time_get() > m_LastTickProfileStream + g_Config.m_EcTickProfile*time_freq())
+			{
+				for(int i = 0; i <= CTickProfiler::NUM_PHASES; i++)
+				{
+					char aLine[256];
+					m_TickProfiler.Format(CTickProfiler::SET_INTERVAL, i, aLine, sizeof(aLine));
+					str_format(aBuf, sizeof(aBuf), "[tick_profile]: %s", aLine);
+					m_Econ.Send(-1, aBuf);
+				}
+				m_TickProfiler.Reset(CTickProfiler::SET_INTERVAL);
+				m_LastTickProfileStream = time_get();
+			}
+
 			// wait for incoming data
 			if (NonActive)
 			{
@@ -2092,7 +2205,7 @@ int CServer::Run()
 				if(g_Config.m_SvShutdownWhenEmpty)
 					m_RunServer = false;
 				else
-					net_socket_read_wait(m_NetServer.Socket(), 1000000);
+					m_NetServer.WaitForPackets(1000000);
 			}
 			else
 			{
@@ -2104,7 +2217,7 @@ int CServer::Run()
 
 				if(x > 0)
 				{
-					net_socket_read_wait(m_NetServer.Socket(), x);
+					m_NetServer.WaitForPackets(x);
 				}
 			}
 		}
@@ -2120,6 +2233,8 @@ int CServer::Run()
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 			m_NetServer.Drop(i, pDisconnectReason);
 	}
+	m_NetServer.FlushSendQueue();
+	m_NetServer.Close();
 
 	m_Econ.Shutdown();
 
@@ -2146,6 +2261,310 @@ int CServer::Run()
 	return ErrorShutdown();
 }
 
+static void ReplaySettings(IConsole *pConsole, const json_value *pSettings, bool Tuning)
+{
+	if(pSettings->type != json_object)
+		return;
+
+	for(unsigned i = 0; i < pSettings->u.object.length; i++)
+	{
+		const char *pName = pSettings->u.object.values[i].name;
+		const json_value *pValue = pSettings->u.object.values[i].value;
+		if(pValue->type != json_string)
+			continue;
+
+		char aLine[1024];
+		if(Tuning)
+		{
+			// the tuning is stored multiplied by 100
+			str_format(aLine, sizeof(aLine), "tune %s %.2f", pName, str_toint(pValue->u.string.ptr) / 100.0);
+		}
+		else
+		{
+			char aValue[512];
+			char *pDst = aValue;
+			str_escape(&pDst, pValue->u.string.ptr, aValue + sizeof(aValue));
+			str_format(aLine, sizeof(aLine), "%s \"%s\"", pName, aValue);
+		}
+		pConsole->ExecuteLine(aLine);
+	}
+}
+
+void CServer::ReplayCheckPlayers(const CReplayPlayer *pPlayers, int *pMismatches)
+{
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CNetObj_CharacterCore Core;
+		bool Alive = GameServer()->GetTickCharacter(i, &Core);
+		if(Alive == pPlayers[i].m_Alive && (!Alive || (Core.m_X == pPlayers[i].m_X && Core.m_Y == pPlayers[i].m_Y)))
+			continue;
+
+		if(*pMismatches < 20)
+		{
+			if(Alive && pPlayers[i].m_Alive)
+				dbg_msg("replay", "mismatch tick=%d cid=%d x=%d y=%d recorded_x=%d recorded_y=%d", Tick(), i, Core.m_X, Core.m_Y, pPlayers[i].m_X, pPlayers[i].m_Y);
+			else
+				dbg_msg("replay", "mismatch tick=%d cid=%d alive=%d recorded_alive=%d", Tick(), i, Alive, pPlayers[i].m_Alive);
+		}
+		(*pMismatches)++;
+	}
+}
+
+int CServer::Replay(const char *pFilename)
+{
+	IOHANDLE File = Storage()->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+		File = Storage()->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ABSOLUTE);
+	if(!File)
+	{
+		dbg_msg("replay", "failed to open '%s'", pFilename);
+		return -1;
+	}
+	unsigned DataSize = io_length(File);
+	char *pData = (char *)malloc(DataSize);
+	io_read(File, pData, DataSize);
+	io_close(File);
+
+	CTeeHistorianReader Reader;
+	if(!Reader.Init(pData, DataSize))
+	{
+		dbg_msg("replay", "'%s' is not a teehistorian file", pFilename);
+		free(pData);
+		return -1;
+	}
+
+	// run with the settings of the recording, but don't record again
+	ReplaySettings(Console(), json_object_get(Reader.Header(), "config"), false);
+	const char *pMapName = json_string_get(json_object_get(Reader.Header(), "map_name"));
+	if(pMapName)
+		str_copy(g_Config.m_SvMap, pMapName, sizeof(g_Config.m_SvMap));
+	g_Config.m_SvTeeHistorian = 0;
+
+	m_AuthManager.Init();
+	if(!LoadMap(g_Config.m_SvMap))
+	{
+		dbg_msg("replay", "failed to load map. mapname='%s'", g_Config.m_SvMap);
+		free(pData);
+		return -1;
+	}
+	char aSha256[SHA256_MAXSTRSIZE];
+	sha256_str(m_CurrentMapSha256, aSha256, sizeof(aSha256));
+	const char *pMapSha256 = json_string_get(json_object_get(Reader.Header(), "map_sha256"));
+	if(pMapSha256 && str_comp(pMapSha256, aSha256) != 0)
+		dbg_msg("replay", "the map differs from the recorded one, recorded_sha256=%s", pMapSha256);
+
+	// the clients are never connected, the socket only gives the network
+	// server its slots. everything sent to them is dropped
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = NETTYPE_IPV4;
+	BindAddr.ip[0] = 127;
+	BindAddr.ip[3] = 1;
+	if(!m_NetServer.Open(BindAddr, &m_ServerBan, g_Config.m_SvMaxClients, g_Config.m_SvMaxClientsPerIP, 0))
+	{
+		dbg_msg("replay", "couldn't open socket");
+		free(pData);
+		return -1;
+	}
+	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, this);
+
+	if(g_Config.m_SvSnapThreads > 0)
+	{
+		m_NumSnapshotThreads = g_Config.m_SvSnapThreads;
+		m_SnapshotJobPool.Init(m_NumSnapshotThreads);
+	}
+
+	GameServer()->OnInit();
+	if(ErrorShutdown())
+	{
+		free(pData);
+		return 1;
+	}
+	m_pConsole->StoreCommands(false);
+	ReplaySettings(Console(), json_object_get(Reader.Header(), "tuning"), true);
+
+	CReplayPlayer aPlayers[MAX_CLIENTS];
+	mem_zero(aPlayers, sizeof(aPlayers));
+	bool Checked = true;
+	int Mismatches = 0;
+	int LastSnapshot = 0;
+
+	m_TickProfiler.SetEnabled(true);
+	m_GameStartTime = time_get();
+	int64 Start = time_get();
+
+	CTeeHistorianReader::CItem Item;
+	while(Reader.Next(&Item) && Item.m_Type != CTeeHistorianReader::ITEM_FINISH)
+	{
+		bool PlayerData = Item.m_Type == CTeeHistorianReader::ITEM_PLAYER || Item.m_Type == CTeeHistorianReader::ITEM_PLAYER_DEAD;
+
+		// the positions are recorded right after the tick, before the
+		// inputs and messages that arrive until the next one
+		if(!Checked && (Item.m_Tick > Tick() || !PlayerData))
+		{
+			ReplayCheckPlayers(aPlayers, &Mismatches);
+			Checked = true;
+		}
+		while(Tick() < Item.m_Tick)
+		{
+			if(!Checked)
+				ReplayCheckPlayers(aPlayers, &Mismatches);
+
+			int64 TotalStart = m_TickProfiler.Start();
+			RunTick();
+			if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+			{
+				int64 PhaseStart = m_TickProfiler.Start();
+				DoSnapshot();
+				m_TickProfiler.Lap(CTickProfiler::PHASE_SNAP, PhaseStart);
+				LastSnapshot = Tick();
+			}
+			m_TickProfiler.Lap(CTickProfiler::PHASE_TOTAL, TotalStart);
+			Checked = false;
+			if(ErrorShutdown())
+				break;
+		}
+		if(ErrorShutdown())
+			break;
+
+		int ClientID = Item.m_ClientID;
+		CClient *pClient = ClientID >= 0 ? &m_aClients[ClientID] : 0;
+		switch(Item.m_Type)
+		{
+		case CTeeHistorianReader::ITEM_PLAYER:
+			aPlayers[ClientID].m_Alive = true;
+			aPlayers[ClientID].m_X = Item.m_X;
+			aPlayers[ClientID].m_Y = Item.m_Y;
+			break;
+		case CTeeHistorianReader::ITEM_PLAYER_DEAD:
+			aPlayers[ClientID].m_Alive = false;
+			break;
+		case CTeeHistorianReader::ITEM_JOIN:
+			if(pClient->m_State != CClient::STATE_EMPTY)
+				DelClientCallback(ClientID, "", this);
+			NewClientCallback(ClientID, this);
+			pClient->m_State = CClient::STATE_CONNECTING;
+			break;
+		case CTeeHistorianReader::ITEM_DROP:
+			// kicks during the replay already dropped the client
+			if(pClient->m_State != CClient::STATE_EMPTY)
+				DelClientCallback(ClientID, Item.m_pString, this);
+			break;
+		case CTeeHistorianReader::ITEM_MESSAGE:
+		{
+			// the ready message isn't recorded, the game messages only
+			// come after it
+			if(pClient->m_State == CClient::STATE_CONNECTING)
+			{
+				pClient->m_State = CClient::STATE_READY;
+				GameServer()->OnClientConnected(ClientID);
+			}
+			if(pClient->m_State < CClient::STATE_READY)
+				break;
+
+			CUnpacker Unpacker;
+			Unpacker.Reset(Item.m_pData, Item.m_DataSize);
+			CMsgPacker Packer(NETMSG_EX);
+			int Msg;
+			bool Sys;
+			CUuid Uuid;
+			if(UnpackMessageID(&Msg, &Sys, &Uuid, &Unpacker, &Packer) != UNPACKMESSAGE_ERROR && !Sys)
+				GameServer()->OnMessage(Msg, &Unpacker, ClientID);
+			break;
+		}
+		case CTeeHistorianReader::ITEM_INPUT:
+		{
+			// neither is the enter message, the inputs only come after it
+			if(pClient->m_State == CClient::STATE_READY && GameServer()->IsClientReady(ClientID))
+			{
+				pClient->m_State = CClient::STATE_INGAME;
+				GameServer()->OnClientEnter(ClientID);
+			}
+			if(pClient->m_State != CClient::STATE_INGAME)
+				break;
+
+			// the clients acknowledge the latest snapshot with each input, so
+			// the snapshots are deltas like on a real server
+			pClient->m_LastAckedSnapshot = LastSnapshot;
+			if(LastSnapshot > 0)
+				pClient->m_SnapRate = CClient::SNAPRATE_FULL;
+
+			// the intended tick isn't recorded, use the next one
+			int GameTick = Tick() + 1;
+			CClient::CInput *pInput = &pClient->m_aInputs[GameTick%CClient::INPUT_BUFFER_SIZE];
+			pInput->m_GameTick = GameTick;
+			pInput->m_IntendedTick = GameTick;
+			mem_copy(pInput->m_aData, &Item.m_Input, sizeof(Item.m_Input));
+			pClient->m_LastInputTick = GameTick;
+			mem_copy(pClient->m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
+			GameServer()->OnClientDirectInput(ClientID, pClient->m_LatestInput.m_aData);
+			break;
+		}
+		case CTeeHistorianReader::ITEM_CONSOLE_COMMAND:
+		{
+			// the chat commands run again with their chat messages
+			if(Item.m_FlagMask&CFGFLAG_CHAT)
+				break;
+
+			char aLine[1024];
+			str_copy(aLine, Item.m_pString, sizeof(aLine));
+			for(int i = 0; i < Item.m_NumArgs; i++)
+			{
+				// room for the quotes and the terminator
+				int Length = str_length(aLine);
+				if(Length + 4 > (int)sizeof(aLine))
+					break;
+				char *pDst = aLine + Length;
+				*pDst++ = ' ';
+				*pDst++ = '"';
+				str_escape(&pDst, Item.m_apArgs[i], aLine + sizeof(aLine) - 2);
+				*pDst++ = '"';
+				*pDst = 0;
+			}
+			m_RconClientID = ClientID >= 0 ? ClientID : IServer::RCON_CID_SERV;
+			Console()->ExecuteLineFlag(aLine, Item.m_FlagMask, ClientID);
+			m_RconClientID = IServer::RCON_CID_SERV;
+			break;
+		}
+		case CTeeHistorianReader::ITEM_AUTH_LOGIN:
+			pClient->m_Authed = Item.m_Level;
+			GameServer()->OnSetAuthed(ClientID, Item.m_Level);
+			break;
+		case CTeeHistorianReader::ITEM_AUTH_LOGOUT:
+			pClient->m_Authed = AUTHED_NO;
+			GameServer()->OnSetAuthed(ClientID, AUTHED_NO);
+			break;
+		}
+	}
+	if(!Checked)
+		ReplayCheckPlayers(aPlayers, &Mismatches);
+
+	int64 Time = time_get() - Start;
+	if(Reader.Error())
+		dbg_msg("replay", "the file is cut off or broken, stopped at tick %d", Tick());
+	dbg_msg("replay", "replayed %d ticks in %.3f s, %.0f ticks/s, %d position mismatches",
+		Tick(), Time / (double)time_freq(), Tick() * (double)time_freq() / maximum(Time, (int64)1), Mismatches);
+	for(int i = 0; i <= CTickProfiler::NUM_PHASES; i++)
+	{
+		char aBuf[256];
+		m_TickProfiler.Format(CTickProfiler::SET_TOTAL, i, aBuf, sizeof(aBuf));
+		dbg_msg("replay", "%s", aBuf);
+	}
+
+	for(int i = 0; i < MAX_CLIENTS; ++i)
+	{
+		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
+			DelClientCallback(i, "Replay end", this);
+	}
+	m_NetServer.Close();
+	GameServer()->OnShutdown(true);
+	m_pMap->Unload();
+	free(m_pCurrentMapData);
+	free(pData);
+
+	return Mismatches > 0 || Reader.Error();
+}
+
 void CServer::ConTestingCommands(CConsole::IResult *pResult, void *pUser)
 {
 	char aBuf[128];
@@ -2172,6 +2591,104 @@ void CServer::ConKick(IConsole::IResult *pResult, void *pUser)
 		((CServer *)pUser)->Kick(pResult->GetInteger(0), "Kicked by console");
 }
 
+void CServer::ConDbgSnapshotBench(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	int MaxClients = pResult->NumArguments() > 0 ? clamp(pResult->GetInteger(0), 1, (int)MAX_CLIENTS) : MAX_CLIENTS;
+	int Iterations = pResult->NumArguments() > 1 ? maximum(pResult->GetInteger(1), 1) : 100;
+
+	// snap for ingame clients and debug dummies, same as DoSnapshot without delta and sending
+	int aClients[MAX_CLIENTS];
+	int NumClients = 0;
+	for(int i = 0; i < MAX_CLIENTS && NumClients < MaxClients; i++)
+	{
+		bool Snap = pThis->m_aClients[i].m_State == CClient::STATE_INGAME;
+#ifdef CONF_DEBUG
+		Snap = Snap || (g_Config.m_DbgDummies && i >= MAX_CLIENTS-g_Config.m_DbgDummies);
+#endif
+		if(Snap)
+			aClients[NumClients++] = i;
+	}
+
+	char aData[CSnapshot::MAX_SIZE];
+	int64 Start = 0;
+	int64 SnapSize = 0;
+	// the first pass is untimed and sends what the next real snapshot would
+	// send, like the faketuning, the timed ones don't send anything
+	for(int n = -1; n < Iterations; n++)
+	{
+		if(n == 0)
+		{
+			pThis->m_SnapshotBench = true;
+			SnapSize = 0;
+			// time_get only changes once per tick
+			Start = time_get_impl();
+		}
+		pThis->GameServer()->OnPreSnap();
+		for(int c = 0; c < NumClients; c++)
+		{
+			pThis->m_SnapshotBuilder.Init();
+			pThis->GameServer()->OnSnap(aClients[c]);
+			SnapSize += pThis->m_SnapshotBuilder.Finish(aData);
+		}
+	}
+	int64 Elapsed = time_get_impl() - Start;
+	pThis->m_SnapshotBench = false;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "clients=%d iterations=%d avg_snapshot_time=%.2fus avg_client_time=%.2fus avg_snap_size=%d",
+		NumClients, Iterations, Elapsed * 1000000.0 / time_freq() / Iterations,
+		NumClients ? Elapsed * 1000000.0 / time_freq() / Iterations / NumClients : 0.0,
+		NumClients ? (int)(SnapSize / Iterations / NumClients) : 0);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CServer::ConDbgNetStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	NETSTATS Current;
+	net_stats(&Current);
+	int64 Now = time_get();
+	const NETSTATS &Last = pThis->m_LastNetStats;
+
+	float Seconds = maximum((Now - pThis->m_LastNetStatsTime) / (float)time_freq(), 0.001f);
+	int SentPackets = Current.sent_packets - Last.sent_packets;
+	int SentSyscalls = Current.sent_syscalls - Last.sent_syscalls;
+	int RecvPackets = Current.recv_packets - Last.recv_packets;
+	int RecvSyscalls = Current.recv_syscalls - Last.recv_syscalls;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "last %.1fs, send batching %s", Seconds, g_Config.m_SvSendBatching ? "on" : "off");
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", aBuf);
+	str_format(aBuf, sizeof(aBuf), "sent: packets=%d (%.0f/s) bytes=%d syscalls=%d (%.0f/s) packets_per_syscall=%.2f",
+		SentPackets, SentPackets / Seconds, Current.sent_bytes - Last.sent_bytes,
+		SentSyscalls, SentSyscalls / Seconds, SentSyscalls ? SentPackets / (float)SentSyscalls : 0.0f);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", aBuf);
+	str_format(aBuf, sizeof(aBuf), "recv: packets=%d (%.0f/s) syscalls=%d (%.0f/s)",
+		RecvPackets, RecvPackets / Seconds, RecvSyscalls, RecvSyscalls / Seconds);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", aBuf);
+
+	pThis->m_LastNetStats = Current;
+	pThis->m_LastNetStatsTime = Now;
+}
+
+void CServer::ConDbgTickProfile(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	if(!g_Config.m_SvTickProfiler)
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "tick_profile", "profiling is disabled, enable it with sv_tick_profiler 1");
+
+	char aBuf[256];
+	for(int i = 0; i <= CTickProfiler::NUM_PHASES; i++)
+	{
+		pThis->m_TickProfiler.Format(CTickProfiler::SET_TOTAL, i, aBuf, sizeof(aBuf));
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "tick_profile", aBuf);
+	}
+
+	if(pResult->NumArguments() && pResult->GetInteger(0))
+		pThis->m_TickProfiler.Reset(CTickProfiler::SET_TOTAL);
+}
+
 void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 {
 	char aBuf[1024];
@@ -2710,6 +3227,13 @@ void CServer::ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pU
 		((CServer *)pUserData)->m_NetServer.SetMaxClientsPerIP(pResult->GetInteger(0));
 }
 
+void CServer::ConchainSendBatchingUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		((CServer *)pUserData)->m_NetServer.SetSendBatching(pResult->GetInteger(0));
+}
+
 void CServer::ConchainCommandAccessUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	if(pResult->NumArguments() == 2)
@@ -2878,6 +3402,9 @@ void CServer::RegisterCommands()
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 	Console()->Register("show_ips", "?i[show]", CFGFLAG_SERVER, ConShowIps, this, "Show IP addresses in rcon commands (1 = on, 0 = off)");
+	Console()->Register("dbg_net_stats", "", CFGFLAG_SERVER, ConDbgNetStats, this, "Show packet and syscall counts since the last call");
+	Console()->Register("dbg_tick_profile", "?i[reset]", CFGFLAG_SERVER, ConDbgTickProfile, this, "Show p50/p99/max of the server tick phases and the snapshot sizes, reset afterwards if the argument is 1");
+	Console()->Register("dbg_snapshot_bench", "?i[clients] ?i[iterations]", CFGFLAG_SERVER, ConDbgSnapshotBench, this, "Measure the time needed to build the snapshots for the given number of clients");
 
 	Console()->Register("record", "?s[file]", CFGFLAG_SERVER|CFGFLAG_STORE, ConRecord, this, "Record to a file");
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
@@ -2904,6 +3431,7 @@ void CServer::RegisterCommands()
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
 
 	Console()->Chain("sv_max_clients_per_ip", ConchainMaxclientsperipUpdate, this);
+	Console()->Chain("sv_send_batching", ConchainSendBatchingUpdate, this);
 	Console()->Chain("access_level", ConchainCommandAccessUpdate, this);
 	Console()->Chain("console_output_level", ConchainConsoleOutputLevelUpdate, this);
 
@@ -2952,6 +3480,15 @@ static CServer *CreateServer() { return new CServer(); }
 int main(int argc, const char **argv) // ignore_convention
 {
 	bool Silent = false;
+	const char *pReplayFile = 0;
+	int FirstArgument = 1;
+
+	// DDNet-Server --replay <file> [commands]
+	if(argc > 2 && str_comp("--replay", argv[1]) == 0) // ignore_convention
+	{
+		pReplayFile = argv[2]; // ignore_convention
+		FirstArgument = 3;
+	}
 
 	for(int i = 1; i < argc; i++) // ignore_convention
 	{
@@ -3027,8 +3564,8 @@ int main(int argc, const char **argv) // ignore_convention
 	}
 
 	// parse the command line arguments
-	if(argc > 1) // ignore_convention
-		pConsole->ParseArguments(argc-1, &argv[1]); // ignore_convention
+	if(argc > FirstArgument) // ignore_convention
+		pConsole->ParseArguments(argc-FirstArgument, &argv[FirstArgument]); // ignore_convention
 
 	pConsole->Register("sv_test_cmds", "", CFGFLAG_SERVER, CServer::ConTestingCommands, pConsole, "Turns testing commands aka cheats on/off");
 	pConsole->Register("sv_rescue", "", CFGFLAG_SERVER, CServer::ConRescue, pConsole, "Allow /rescue command so players can teleport themselves out of freeze");
@@ -3036,8 +3573,16 @@ int main(int argc, const char **argv) // ignore_convention
 	pEngine->InitLogfile();
 
 	// run the server
-	dbg_msg("server", "starting...");
-	int Ret = pServer->Run();
+	int Ret;
+	if(pReplayFile)
+	{
+		Ret = pServer->Replay(pReplayFile);
+	}
+	else
+	{
+		dbg_msg("server", "starting...");
+		Ret = pServer->Run();
+	}
 
 	// free
 	delete pKernel;
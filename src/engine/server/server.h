@@ -25,6 +25,7 @@
 
 #include "authmanager.h"
 #include "name_ban.h"
+#include "tickprofiler.h"
 
 #if defined (CONF_SQL)
 	#include "sql_connector.h"
@@ -133,6 +134,9 @@ public:
 			DNSBL_STATE_PENDING,
 			DNSBL_STATE_BLACKLISTED,
 			DNSBL_STATE_WHITELISTED,
+
+			// inputs are stored at their game tick modulo this size
+			INPUT_BUFFER_SIZE=256,
 		};
 
 		class CInput
@@ -140,6 +144,7 @@ public:
 		public:
 			int m_aData[MAX_INPUT_SIZE];
 			int m_GameTick; // the tick that was chosen for the input
+			int m_IntendedTick; // the tick the client sent the input for
 		};
 
 		// connection state info
@@ -156,8 +161,14 @@ public:
 		CSnapshotStorage m_Snapshots;
 
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
-		int m_CurrentInput;
+		CInput m_aInputs[INPUT_BUFFER_SIZE];
+
+		// returns the input for the given game tick or 0 if there is none
+		CInput *Input(int GameTick)
+		{
+			CInput *pInput = &m_aInputs[GameTick%INPUT_BUFFER_SIZE];
+			return pInput->m_GameTick == GameTick ? pInput : 0;
+		}
 
 		char m_aName[MAX_NAME_LENGTH];
 		char m_aClan[MAX_CLAN_LENGTH];
@@ -183,11 +194,41 @@ public:
 		std::shared_ptr<CHostLookup> m_pDnsblLookup;
 	};
 
+	class CSnapshotDeltaJob : public IJob
+	{
+		virtual void Run();
+
+	public:
+		CSnapshotDelta *m_pSnapshotDelta;
+		SEMAPHORE *m_pDone;
+
+		CSnapshot *m_pFrom;
+		CSnapshot *m_pTo;
+		int m_DeltaTick;
+		int m_Crc;
+
+		int m_DeltaSize;
+		int m_CompSize;
+		char m_aDeltaData[CSnapshot::MAX_SIZE];
+		char m_aCompData[CSnapshot::MAX_SIZE];
+
+		void CreateDelta();
+	};
+
 	CClient m_aClients[MAX_CLIENTS];
 	int IdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+	std::shared_ptr<CSnapshotDeltaJob> m_apSnapshotDeltaJobs[MAX_CLIENTS];
+	CJobPool m_SnapshotJobPool;
+	int m_NumSnapshotThreads;
+	SEMAPHORE m_SnapshotJobsDone;
+
+	NETSTATS m_LastNetStats;
+	int64 m_LastNetStatsTime;
+	CTickProfiler m_TickProfiler;
+	int64 m_LastTickProfileStream;
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -203,6 +244,7 @@ public:
 	int m_RunServer;
 	int m_MapReload;
 	bool m_ReloadedWhenEmpty;
+	bool m_SnapshotBench;
 	int m_RconClientID;
 	int m_RconAuthLevel;
 	int m_PrintCBIndex;
@@ -270,6 +312,7 @@ public:
 	int SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System);
 
 	void DoSnapshot();
+	void SendSnapshot(int ClientID, const CSnapshotDeltaJob *pJob);
 
 	static int NewClientCallback(int ClientID, void *pUser);
 	static int NewClientNoAuthCallback(int ClientID, void *pUser);
@@ -306,8 +349,21 @@ public:
 	bool IsRecording(int ClientID);
 
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole);
+	void RunTick();
 	int Run();
 
+	class CReplayPlayer
+	{
+	public:
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+	};
+	void ReplayCheckPlayers(const CReplayPlayer *pPlayers, int *pMismatches);
+	// runs the inputs of a teehistorian file through the game as fast as
+	// possible, without network, and checks the recorded positions
+	int Replay(const char *pFilename);
+
 	static void ConTestingCommands(IConsole::IResult *pResult, void *pUser);
 	static void ConRescue(IConsole::IResult *pResult, void *pUser);
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
@@ -318,6 +374,9 @@ public:
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConShowIps(IConsole::IResult *pResult, void *pUser);
+	static void ConDbgSnapshotBench(IConsole::IResult *pResult, void *pUser);
+	static void ConDbgNetStats(IConsole::IResult *pResult, void *pUser);
+	static void ConDbgTickProfile(IConsole::IResult *pResult, void *pUser);
 
 	static void ConAuthAdd(IConsole::IResult *pResult, void *pUser);
 	static void ConAuthAddHashed(IConsole::IResult *pResult, void *pUser);
@@ -340,6 +399,7 @@ public:
 
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainSendBatchingUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainCommandAccessUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainConsoleOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
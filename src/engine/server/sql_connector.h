@@ -13,8 +13,10 @@ class CSqlConnector
 {
 public:
 	CSqlConnector();
+	// uses the given servers instead of the shared ones
+	CSqlConnector(CSqlServer **ppReadServers, CSqlServer **ppWriteServers);
 
-	CSqlServer* SqlServer(int i, bool ReadOnly = true) { return ReadOnly ? ms_ppSqlReadServers[i] : ms_ppSqlWriteServers[i]; }
+	CSqlServer* SqlServer(int i, bool ReadOnly = true) { return ReadOnly ? m_ppSqlReadServers[i] : m_ppSqlWriteServers[i]; }
 
 	// always returns the last connected sql-server
 	CSqlServer* SqlServer() { return m_pSqlServer; }
@@ -31,6 +33,8 @@ public:
 private:
 
 	CSqlServer *m_pSqlServer;
+	CSqlServer **m_ppSqlReadServers;
+	CSqlServer **m_ppSqlWriteServers;
 	static CSqlServer **ms_ppSqlReadServers;
 	static CSqlServer **ms_ppSqlWriteServers;
 
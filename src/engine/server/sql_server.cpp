@@ -30,11 +30,30 @@ CSqlServer::CSqlServer(const char *pDatabase, const char *pPrefix, const char *p
 	ReadOnly ? ms_NumReadServer++ : ms_NumWriteServer++;
 }
 
+CSqlServer::CSqlServer(const CSqlServer *pOther) :
+		m_Port(pOther->m_Port),
+		m_SetUpDB(false),
+		m_SqlLock(),
+		m_pGlobalLock(pOther->m_pGlobalLock)
+{
+	str_copy(m_aDatabase, pOther->m_aDatabase, sizeof(m_aDatabase));
+	str_copy(m_aPrefix, pOther->m_aPrefix, sizeof(m_aPrefix));
+	str_copy(m_aUser, pOther->m_aUser, sizeof(m_aUser));
+	str_copy(m_aPass, pOther->m_aPass, sizeof(m_aPass));
+	str_copy(m_aIp, pOther->m_aIp, sizeof(m_aIp));
+
+	m_pDriver = 0;
+	m_pConnection = 0;
+	m_pResults = 0;
+	m_pStatement = 0;
+}
+
 CSqlServer::~CSqlServer()
 {
 	scope_lock LockScope(&m_SqlLock);
 	try
 	{
+		ClearStatements();
 		if (m_pResults)
 			delete m_pResults;
 		if (m_pConnection)
@@ -217,4 +236,49 @@ void CSqlServer::executeSqlQuery(const char *pQuery)
 	m_pResults = m_pStatement->executeQuery(pQuery);
 }
 
+void CSqlServer::executeSqlQuery(sql::PreparedStatement *pStatement)
+{
+	if (m_pResults)
+		delete m_pResults;
+
+	m_pResults = 0;
+	m_pResults = pStatement->executeQuery();
+}
+
+sql::PreparedStatement* CSqlServer::PrepareStatement(const char *pQuery)
+{
+	std::map<std::string, sql::PreparedStatement *>::iterator it = m_Statements.find(pQuery);
+	if (it != m_Statements.end())
+		return it->second;
+
+	sql::PreparedStatement *pStatement = m_pConnection->prepareStatement(pQuery);
+	m_Statements[pQuery] = pStatement;
+	return pStatement;
+}
+
+bool CSqlServer::ClearStatements()
+{
+	if (m_Statements.empty())
+		return false;
+
+	// the results might belong to one of the statements
+	if (m_pResults)
+		delete m_pResults;
+	m_pResults = 0;
+
+	for (std::map<std::string, sql::PreparedStatement *>::iterator it = m_Statements.begin(); it != m_Statements.end(); ++it)
+	{
+		try
+		{
+			delete it->second;
+		}
+		catch (sql::SQLException &e)
+		{
+			dbg_msg("sql", "MySQL Error: %s", e.what());
+		}
+	}
+	m_Statements.clear();
+	return true;
+}
+
 #endif
@@ -7,12 +7,18 @@
 
 #include <cppconn/driver.h>
 #include <cppconn/exception.h>
+#include <cppconn/prepared_statement.h>
 #include <cppconn/statement.h>
 
+#include <map>
+#include <string>
+
 class CSqlServer
 {
 public:
 	CSqlServer(const char *pDatabase, const char *pPrefix, const char *pUser, const char *pPass, const char *pIp, int Port, lock *pGlobalLock, bool ReadOnly = true, bool SetUpDb = false);
+	// a copy with its own connection, doesn't count as another server
+	CSqlServer(const CSqlServer *pOther);
 	~CSqlServer();
 
 	bool Connect();
@@ -21,6 +27,12 @@ public:
 
 	void executeSql(const char *pCommand);
 	void executeSqlQuery(const char *pQuery);
+	void executeSqlQuery(sql::PreparedStatement *pStatement);
+
+	// prepared statements are kept per connection, keyed by the query
+	sql::PreparedStatement* PrepareStatement(const char *pQuery);
+	// returns whether there were any
+	bool ClearStatements();
 
 	sql::ResultSet* GetResults() { return m_pResults; }
 
@@ -39,6 +51,7 @@ private:
 	sql::Connection *m_pConnection;
 	sql::Statement *m_pStatement;
 	sql::ResultSet *m_pResults;
+	std::map<std::string, sql::PreparedStatement *> m_Statements;
 
 	// copy of config vars
 	char m_aDatabase[64];
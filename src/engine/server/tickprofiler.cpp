@@ -0,0 +1,102 @@
+#include "tickprofiler.h"
+
+void CHistogram::Reset()
+{
+	mem_zero(m_aBuckets, sizeof(m_aBuckets));
+	m_Count = 0;
+	m_Max = 0;
+}
+
+int CHistogram::BucketIndex(int64 Value)
+{
+	if(Value < NUM_SUB_BUCKETS)
+		return Value < 0 ? 0 : (int)Value;
+
+	int Exp = SUB_BUCKET_BITS;
+	while(Value >> (Exp + 1))
+		Exp++;
+	int Index = (Exp - SUB_BUCKET_BITS + 1) * NUM_SUB_BUCKETS + (int)((Value >> (Exp - SUB_BUCKET_BITS)) & (NUM_SUB_BUCKETS - 1));
+	return Index < NUM_BUCKETS ? Index : NUM_BUCKETS - 1;
+}
+
+int64 CHistogram::BucketUpperBound(int Index)
+{
+	if(Index < NUM_SUB_BUCKETS)
+		return Index;
+
+	int Shift = Index / NUM_SUB_BUCKETS - 1;
+	int64 Lower = (int64)(NUM_SUB_BUCKETS + Index % NUM_SUB_BUCKETS) << Shift;
+	return Lower + ((int64)1 << Shift) - 1;
+}
+
+void CHistogram::Add(int64 Value)
+{
+	m_aBuckets[BucketIndex(Value)]++;
+	m_Count++;
+	if(Value > m_Max)
+		m_Max = Value;
+}
+
+int64 CHistogram::Percentile(float Fraction) const
+{
+	if(!m_Count)
+		return 0;
+
+	int Rank = (int)(Fraction * m_Count + 0.5f);
+	if(Rank < 1)
+		Rank = 1;
+	int Seen = 0;
+	for(int i = 0; i < NUM_BUCKETS; i++)
+	{
+		Seen += m_aBuckets[i];
+		if(Seen >= Rank)
+		{
+			int64 Upper = BucketUpperBound(i);
+			return Upper < m_Max ? Upper : m_Max;
+		}
+	}
+	return m_Max;
+}
+
+void CTickProfiler::Add(int Phase, int64 Time)
+{
+	for(int i = 0; i < NUM_SETS; i++)
+		m_aaPhases[i][Phase].Add(Time);
+}
+
+void CTickProfiler::AddSnapshotSize(int Size)
+{
+	if(!m_Enabled)
+		return;
+	for(int i = 0; i < NUM_SETS; i++)
+		m_aSnapshotSizes[i].Add(Size);
+}
+
+void CTickProfiler::Reset(int Set)
+{
+	for(int i = 0; i < NUM_PHASES; i++)
+		m_aaPhases[Set][i].Reset();
+	m_aSnapshotSizes[Set].Reset();
+}
+
+const char *CTickProfiler::PhaseName(int Phase)
+{
+	static const char *s_apNames[NUM_PHASES] = {"input", "tick", "snap", "rcon", "fifo", "network", "flush", "total"};
+	return s_apNames[Phase];
+}
+
+void CTickProfiler::Format(int Set, int Line, char *pBuf, int BufSize) const
+{
+	if(Line < NUM_PHASES)
+	{
+		const CHistogram &Histogram = m_aaPhases[Set][Line];
+		str_format(pBuf, BufSize, "phase=%s n=%d p50=%dus p99=%dus max=%dus", PhaseName(Line),
+			Histogram.Count(), (int)Histogram.Percentile(0.5f), (int)Histogram.Percentile(0.99f), (int)Histogram.Max());
+	}
+	else
+	{
+		const CHistogram &Histogram = m_aSnapshotSizes[Set];
+		str_format(pBuf, BufSize, "snapshot_size n=%d p50=%dB p99=%dB max=%dB",
+			Histogram.Count(), (int)Histogram.Percentile(0.5f), (int)Histogram.Percentile(0.99f), (int)Histogram.Max());
+	}
+}
@@ -0,0 +1,93 @@
+#ifndef ENGINE_SERVER_TICKPROFILER_H
+#define ENGINE_SERVER_TICKPROFILER_H
+
+#include <base/system.h>
+
+// fixed size histogram with logarithmic buckets, each power of two is split
+// into 8 buckets so percentiles are off by at most 12.5%
+class CHistogram
+{
+public:
+	enum
+	{
+		SUB_BUCKET_BITS=3,
+		NUM_SUB_BUCKETS=1<<SUB_BUCKET_BITS,
+		NUM_BUCKETS=32*NUM_SUB_BUCKETS,
+	};
+
+	CHistogram() { Reset(); }
+
+	void Reset();
+	void Add(int64 Value);
+
+	int Count() const { return m_Count; }
+	int64 Max() const { return m_Max; }
+	// upper bound of the bucket that contains the given fraction of the values
+	int64 Percentile(float Fraction) const;
+
+	static int BucketIndex(int64 Value);
+	static int64 BucketUpperBound(int Index);
+
+private:
+	int m_aBuckets[NUM_BUCKETS];
+	int m_Count;
+	int64 m_Max;
+};
+
+class CTickProfiler
+{
+public:
+	enum
+	{
+		PHASE_INPUT=0,
+		PHASE_TICK,
+		PHASE_SNAP,
+		PHASE_RCON,
+		PHASE_FIFO,
+		PHASE_NETWORK,
+		PHASE_FLUSH,
+		PHASE_TOTAL,
+		NUM_PHASES
+	};
+
+	enum
+	{
+		// the interval histograms are reset each time they are streamed
+		SET_TOTAL=0,
+		SET_INTERVAL,
+		NUM_SETS
+	};
+
+	CTickProfiler() : m_Enabled(false) {}
+
+	void SetEnabled(bool Enabled) { m_Enabled = Enabled; }
+	bool Enabled() const { return m_Enabled; }
+
+	// returns the start time of the next phase, 0 if profiling is disabled
+	int64 Start() const { return m_Enabled ? time_get_microseconds() : 0; }
+	int64 Lap(int Phase, int64 Start)
+	{
+		if(!m_Enabled)
+			return 0;
+		int64 Now = time_get_microseconds();
+		Add(Phase, Now - Start);
+		return Now;
+	}
+	void Add(int Phase, int64 Time);
+	void AddSnapshotSize(int Size);
+
+	void Reset(int Set);
+	const CHistogram &Phase(int Set, int Phase) const { return m_aaPhases[Set][Phase]; }
+	const CHistogram &SnapshotSizes(int Set) const { return m_aSnapshotSizes[Set]; }
+
+	static const char *PhaseName(int Phase);
+	// writes NUM_PHASES+1 lines, the phases and the snapshot sizes
+	void Format(int Set, int Line, char *pBuf, int BufSize) const;
+
+private:
+	bool m_Enabled;
+	CHistogram m_aaPhases[NUM_SETS][NUM_PHASES];
+	CHistogram m_aSnapshotSizes[NUM_SETS];
+};
+
+#endif // ENGINE_SERVER_TICKPROFILER_H
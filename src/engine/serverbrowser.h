@@ -50,6 +50,7 @@ public:
 	int m_Flags;
 	bool m_Favorite;
 	bool m_Official;
+	bool m_Stale; // from the cache of the last refresh
 	int m_Latency; // in ms
 	int m_HasRank;
 	char m_aGameType[16];
@@ -62,7 +62,9 @@ MACRO_CONFIG_STR(BrFilterExcludeTypesKoG, br_filter_exclude_types_kog, 128, "",
 
 MACRO_CONFIG_INT(BrSort, br_sort, 4, 0, 256, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Sorting column in server browser")
 MACRO_CONFIG_INT(BrSortOrder, br_sort_order, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Sorting order in server browser")
-MACRO_CONFIG_INT(BrMaxRequests, br_max_requests, 25, 0, 1000, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Number of requests to use when refreshing server browser")
+MACRO_CONFIG_INT(BrMaxRequests, br_max_requests, 250, 1, 1000, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Number of unanswered requests to allow when refreshing server browser")
+MACRO_CONFIG_INT(BrRequestRate, br_request_rate, 500, 10, 5000, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Number of requests to send per second when refreshing server browser")
+MACRO_CONFIG_INT(BrCache, br_cache, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Show the servers of the last refresh until they are refreshed")
 
 MACRO_CONFIG_INT(BrDemoSort, br_demo_sort, 0, 0, 3, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Sorting column in demo browser")
 MACRO_CONFIG_INT(BrDemoSortOrder, br_demo_sort_order, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Sorting order in demo browser")
@@ -121,6 +123,11 @@ MACRO_CONFIG_STR(SvMap, sv_map, 128, "Kobra 4", CFGFLAG_SERVER, "Map to use on t
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, MAX_CLIENTS, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
+MACRO_CONFIG_INT(SvSendBatching, sv_send_batching, 1, 0, 1, CFGFLAG_SERVER, "Collect the packets sent during a server tick and send them together (with sendmmsg where available)")
+MACRO_CONFIG_INT(SvNetThread, sv_net_thread, 0, 0, 1, CFGFLAG_SERVER, "Receive, unpack and send packets on separate threads (needs a restart)")
+MACRO_CONFIG_INT(SvTickProfiler, sv_tick_profiler, 0, 0, 1, CFGFLAG_SERVER, "Record the time spent in each phase of the server tick (see dbg_tick_profile)")
+MACRO_CONFIG_INT(SvSnapThreads, sv_snap_threads, 0, 0, 32, CFGFLAG_SERVER, "Number of threads used to create and compress the snapshot deltas (0 = main thread only, needs restart)")
+MACRO_CONFIG_INT(SvTeamThreads, sv_team_threads, 0, 0, 32, CFGFLAG_SERVER, "Number of threads used to move the characters of independent teams (0 = main thread only, needs a map change)")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SERVER|CFGFLAG_NONTEEHISTORIC, "Remote console password (full access)")
 MACRO_CONFIG_STR(SvRconModPassword, sv_rcon_mod_password, 32, "", CFGFLAG_SERVER|CFGFLAG_NONTEEHISTORIC, "Remote console password for moderators (limited access)")
@@ -149,6 +156,7 @@ MACRO_CONFIG_STR(EcPassword, ec_password, 32, "", CFGFLAG_ECON, "External consol
 MACRO_CONFIG_INT(EcBantime, ec_bantime, 0, 0, 1440, CFGFLAG_ECON, "The time a client gets banned if econ authentication fails. 0 just closes the connection")
 MACRO_CONFIG_INT(EcAuthTimeout, ec_auth_timeout, 30, 1, 120, CFGFLAG_ECON, "Time in seconds before the the econ authentication times out")
 MACRO_CONFIG_INT(EcOutputLevel, ec_output_level, 1, 0, 2, CFGFLAG_ECON, "Adjusts the amount of information in the external console")
+MACRO_CONFIG_INT(EcTickProfile, ec_tick_profile, 0, 0, 3600, CFGFLAG_ECON, "Send the tick profile of the last interval to the external console every that many seconds (0 = off, needs sv_tick_profiler)")
 
 MACRO_CONFIG_INT(Debug, debug, 0, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SERVER, "Debug mode")
 MACRO_CONFIG_INT(DbgCurl, dbg_curl, 0, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SERVER, "Debug curl")
@@ -217,6 +225,13 @@ MACRO_CONFIG_INT(SvSaveGamesDelay, sv_savegames_delay, 60, 0, 10000, CFGFLAG_SER
 
 MACRO_CONFIG_STR(SvSqlFailureFile, sv_sql_failure_file, 64, "failed_sql.sql", CFGFLAG_SERVER, "File to store failed Sql-Inserts (ranks)")
 MACRO_CONFIG_INT(SvSqlQueriesDelay, sv_sql_queries_delay, 1, 0, 20, CFGFLAG_SERVER, "Delay in seconds between SQL queries of a single player")
+MACRO_CONFIG_INT(SvSqlWorkers, sv_sql_workers, 4, 1, 16, CFGFLAG_SERVER, "Number of threads running the SQL queries (takes effect on restart)")
+MACRO_CONFIG_INT(SvSqlBatchSize, sv_sql_batch_size, 16, 1, 256, CFGFLAG_SERVER, "Number of finishes that are saved to the SQL database together")
+MACRO_CONFIG_INT(SvSqlBatchInterval, sv_sql_batch_interval, 5, 0, 60, CFGFLAG_SERVER, "Seconds a finish may wait to be saved together with others")
+MACRO_CONFIG_STR(SvSqlJournalFolder, sv_sql_journal_folder, 64, "sql_journal", CFGFLAG_SERVER, "Folder to keep the finishes in until they are in the SQL database")
+MACRO_CONFIG_INT(SvSqlLeaderboard, sv_sql_leaderboard, 1, 0, 1, CFGFLAG_SERVER, "Answer /rank, /top5, /points and /toppoints from a copy of the SQL database in memory")
+MACRO_CONFIG_INT(SvSqlLeaderboardInterval, sv_sql_leaderboard_interval, 300, 10, 3600, CFGFLAG_SERVER, "Seconds between reloads of the leaderboards to include the finishes on other servers")
+MACRO_CONFIG_INT(SvSqlQueueSize, sv_sql_queue_size, 64, 1, 1024, CFGFLAG_SERVER, "How many reading SQL queries may wait for a worker before more are rejected")
 #endif
 
 MACRO_CONFIG_INT(SvDDRaceRules, sv_ddrace_rules, 1, 0, 1, CFGFLAG_SERVER, "Whether the default mod rules are displayed or not")
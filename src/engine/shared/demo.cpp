@@ -613,6 +613,17 @@ void CDemoPlayer::DoTick()
 			// process full snapshot
 			GotSnapshot = 1;
 
+			// snapshots recorded by older versions aren't sorted by key
+			if(!((CSnapshot *)aData)->IsSorted())
+				DataSize = CSnapshotBuilder::Sort(aData);
+
+			if(DataSize < 0)
+			{
+				if(m_pConsole)
+					m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error during sorting of snapshot");
+				continue;
+			}
+
 			m_LastSnapshotDataSize = DataSize;
 			mem_copy(m_aLastSnapshotData, aData, DataSize);
 			if(m_pListener)
@@ -67,6 +67,8 @@ void CJobPool::WorkerThread(void *pUser)
 		{
 			pJob = pPool->m_pFirstJob;
 			pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
+			// unlink so the job can be added again once it's done
+			pJob->m_pNext = 0;
 			if(!pPool->m_pFirstJob)
 				pPool->m_pLastJob = 0;
 		}
@@ -21,6 +21,26 @@ void CNetRecvUnpacker::Start(const NETADDR *pAddr, CNetConnection *pConnection,
 	m_Valid = true;
 }
 
+void CNetRecvUnpacker::ValidateChunks(CNetPacketConstruct *pPacket)
+{
+	if(pPacket->m_Flags&(NET_PACKETFLAG_CONNLESS|NET_PACKETFLAG_CONTROL))
+		return;
+
+	CNetChunkHeader Header;
+	unsigned char *pData = pPacket->m_aChunkData;
+	unsigned char *pEnd = pPacket->m_aChunkData + pPacket->m_DataSize;
+	for(int i = 0; i < pPacket->m_NumChunks; i++)
+	{
+		pData = Header.Unpack(pData);
+		if(pData+Header.m_Size > pEnd)
+		{
+			pPacket->m_NumChunks = i;
+			return;
+		}
+		pData += Header.m_Size;
+	}
+}
+
 // TODO: rename this function
 int CNetRecvUnpacker::FetchChunk(CNetChunk *pChunk)
 {
@@ -90,9 +110,16 @@ int CNetRecvUnpacker::FetchChunk(CNetChunk *pChunk)
 	}
 }
 
+int CNetBase::SendUdp(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int Size, NETSENDQUEUE *pSendQueue)
+{
+	if(pSendQueue)
+		return net_udp_send_queued(Socket, pSendQueue, pAddr, pData, Size);
+	return net_udp_send(Socket, pAddr, pData, Size);
+}
+
 static const unsigned char NET_HEADER_EXTENDED[] = {'x', 'e'};
 // packs the data tight and sends it
-void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize, bool Extended, unsigned char aExtra[4])
+void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize, bool Extended, unsigned char aExtra[4], NETSENDQUEUE *pSendQueue)
 {
 	unsigned char aBuffer[NET_MAX_PACKETSIZE];
 	const int DATA_OFFSET = 6;
@@ -107,10 +134,10 @@ void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *
 		mem_copy(aBuffer + sizeof(NET_HEADER_EXTENDED), aExtra, 4);
 	}
 	mem_copy(aBuffer + DATA_OFFSET, pData, DataSize);
-	net_udp_send(Socket, pAddr, aBuffer, DataSize + DATA_OFFSET);
+	SendUdp(Socket, pAddr, aBuffer, DataSize + DATA_OFFSET, pSendQueue);
 }
 
-void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket, SECURITY_TOKEN SecurityToken)
+void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket, SECURITY_TOKEN SecurityToken, NETSENDQUEUE *pSendQueue)
 {
 	unsigned char aBuffer[NET_MAX_PACKETSIZE];
 	int CompressedSize = -1;
@@ -160,7 +187,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 		aBuffer[0] = ((pPacket->m_Flags<<4)&0xf0)|((pPacket->m_Ack>>8)&0xf);
 		aBuffer[1] = pPacket->m_Ack&0xff;
 		aBuffer[2] = pPacket->m_NumChunks;
-		net_udp_send(Socket, pAddr, aBuffer, FinalSize);
+		SendUdp(Socket, pAddr, aBuffer, FinalSize, pSendQueue);
 
 		// log raw socket data
 		if(ms_DataLogSent)
@@ -259,7 +286,7 @@ int CNetBase::UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct
 }
 
 
-void CNetBase::SendControlMsg(NETSOCKET Socket, NETADDR *pAddr, int Ack, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken)
+void CNetBase::SendControlMsg(NETSOCKET Socket, NETADDR *pAddr, int Ack, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken, NETSENDQUEUE *pSendQueue)
 {
 	CNetPacketConstruct Construct;
 	Construct.m_Flags = NET_PACKETFLAG_CONTROL;
@@ -270,7 +297,7 @@ void CNetBase::SendControlMsg(NETSOCKET Socket, NETADDR *pAddr, int Ack, int Con
 	mem_copy(&Construct.m_aChunkData[1], pExtra, ExtraSize);
 
 	// send the control message
-	CNetBase::SendPacket(Socket, pAddr, &Construct, SecurityToken);
+	CNetBase::SendPacket(Socket, pAddr, &Construct, SecurityToken, pSendQueue);
 }
 
 
@@ -84,6 +84,8 @@ enum
 
 	NET_CONNLIMIT_IPS=16,
 
+	NET_SLOT_HASH_SIZE=256,
+
 	NET_ENUM_TERMINATOR
 };
 
@@ -182,6 +184,7 @@ private:
 
 	NETADDR m_PeerAddr;
 	NETSOCKET m_Socket;
+	NETSENDQUEUE *m_pSendQueue;
 	NETSTATS m_Stats;
 
 	//
@@ -202,6 +205,7 @@ public:
 
 	void Reset(bool Rejoin=false);
 	void Init(NETSOCKET Socket, bool BlockCloseMsg);
+	void SetSendQueue(NETSENDQUEUE *pSendQueue) { m_pSendQueue = pSendQueue; }
 	int Connect(NETADDR *pAddr);
 	void Disconnect(const char *pReason);
 
@@ -282,6 +286,10 @@ public:
 	void Clear();
 	void Start(const NETADDR *pAddr, CNetConnection *pConnection, int ClientID);
 	int FetchChunk(CNetChunk *pChunk);
+
+	// cuts the chunks off at the first one that doesn't fit into the
+	// packet, FetchChunk stops there anyway. needs no connection state
+	static void ValidateChunks(CNetPacketConstruct *pPacket);
 };
 
 // server side
@@ -291,6 +299,12 @@ class CNetServer
 	{
 	public:
 		CNetConnection m_Connection;
+
+		// chains of the address hashes, see UpdateSlotAddr
+		int m_AddrHash;
+		int m_NextByAddr;
+		int m_IPHash;
+		int m_NextByIP;
 	};
 
 	struct CSpamConn
@@ -302,11 +316,19 @@ class CNetServer
 
 	NETSOCKET m_Socket;
 	MMSGS m_MMSGS;
+	NETSENDQUEUE m_SendQueue;
+	bool m_SendBatching;
+	NETSENDQUEUE *m_pSendQueue;
+	class CNetServerIO *m_pIO;
 	class CNetBan *m_pNetBan;
 	CSlot m_aSlots[NET_MAX_CLIENTS];
 	int m_MaxClients;
 	int m_MaxClientsPerIP;
 
+	// first slot in each bucket, by full address and by address without port
+	int m_aSlotsByAddr[NET_SLOT_HASH_SIZE];
+	int m_aSlotsByIP[NET_SLOT_HASH_SIZE];
+
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_NEWCLIENT_NOAUTH m_pfnNewClientNoAuth;
 	NETFUNC_DELCLIENT m_pfnDelClient;
@@ -331,8 +353,13 @@ class CNetServer
 	void OnConnCtrlMsg(NETADDR &Addr, int ClientID, int ControlMsg, const CNetPacketConstruct &Packet);
 	bool ClientExists(const NETADDR &Addr) { return GetClientSlot(Addr) != -1; };
 	int GetClientSlot(const NETADDR &Addr);
+	void UpdateSlotAddr(int Slot);
 	void SendControl(NETADDR &Addr, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken);
 
+	bool ReplyIfBanned(NETADDR &Addr);
+	void SetSendQueue(NETSENDQUEUE *pSendQueue);
+	void CheckSendQueue();
+
 	int TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, bool VanillaAuth=false);
 	int NumClientsWithAddr(NETADDR Addr);
 	bool Connlimit(NETADDR Addr);
@@ -351,6 +378,19 @@ public:
 	int Send(CNetChunk *pChunk);
 	int Update();
 
+	// with batching, sent packets are held back until FlushSendQueue
+	void SetSendBatching(bool SendBatching);
+	void FlushSendQueue();
+	NETSENDQUEUE *SendQueue() { return m_pSendQueue; }
+
+	// moves receiving, unpacking, the chunk checks and sending to their own
+	// threads. Recv then reads the already unpacked packets, FlushSendQueue
+	// hands the queued packets to the send thread
+	bool StartIOThreads();
+	bool HasIOThreads() const { return m_pIO != 0; }
+	// sleeps until packets arrive or the time in microseconds is over
+	void WaitForPackets(int Time);
+
 	//
 	int Drop(int ClientID, const char *pReason);
 
@@ -466,9 +506,11 @@ public:
 	static int Compress(const void *pData, int DataSize, void *pOutput, int OutputSize);
 	static int Decompress(const void *pData, int DataSize, void *pOutput, int OutputSize);
 
-	static void SendControlMsg(NETSOCKET Socket, NETADDR *pAddr, int Ack, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken);
-	static void SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize, bool Extended, unsigned char aExtra[4]);
-	static void SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket, SECURITY_TOKEN SecurityToken);
+	// with a send queue the packets are only sent on net_udp_send_flush
+	static void SendControlMsg(NETSOCKET Socket, NETADDR *pAddr, int Ack, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken, NETSENDQUEUE *pSendQueue = 0);
+	static void SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize, bool Extended, unsigned char aExtra[4], NETSENDQUEUE *pSendQueue = 0);
+	static void SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket, SECURITY_TOKEN SecurityToken, NETSENDQUEUE *pSendQueue = 0);
+	static int SendUdp(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int Size, NETSENDQUEUE *pSendQueue);
 
 	static int UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct *pPacket);
 
@@ -11,6 +11,11 @@
 #include <engine/message.h>
 #include <engine/shared/protocol.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 const int DummyMapCrc = 0x6c760ac4;
 unsigned char g_aDummyMapData[] = {
 	0x44, 0x41, 0x54, 0x41, 0x04, 0x00, 0x00, 0x00, 0x22, 0x01, 0x00, 0x00,
@@ -47,6 +52,209 @@ static SECURITY_TOKEN ToSecurityToken(const unsigned char *pData)
 	return (int)pData[0] | (pData[1] << 8) | (pData[2] << 16) | (pData[3] << 24);
 }
 
+// ring buffer with one producer and one consumer thread, the producer fills
+// Back() and publishes it with Push, the consumer reads Front() until Pop
+template<class T, int SIZE>
+class CSpscRing
+{
+	T m_aItems[SIZE];
+	std::atomic<unsigned> m_Read;
+	std::atomic<unsigned> m_Write;
+
+public:
+	CSpscRing() : m_Read(0), m_Write(0) {}
+
+	T *Back() { return m_Write.load() - m_Read.load() < (unsigned)SIZE ? &m_aItems[m_Write.load(std::memory_order_relaxed) % SIZE] : 0; }
+	void Push() { m_Write.store(m_Write.load(std::memory_order_relaxed) + 1); }
+	T *Front() { return m_Read.load(std::memory_order_relaxed) != m_Write.load() ? &m_aItems[m_Read.load(std::memory_order_relaxed) % SIZE] : 0; }
+	void Pop() { m_Read.store(m_Read.load(std::memory_order_relaxed) + 1); }
+	bool Empty() { return m_Read.load() == m_Write.load(); }
+};
+
+class CNetServerIO
+{
+public:
+	enum
+	{
+		RECV_QUEUE_SIZE=1024,
+		NUM_SEND_QUEUES=8,
+	};
+
+	struct CRecvPacket
+	{
+		NETADDR m_Addr;
+		CNetPacketConstruct m_Packet;
+	};
+
+	NETSOCKET m_Socket;
+	std::atomic<bool> m_Shutdown;
+
+	// receive thread -> game thread
+	void *m_pRecvThread;
+	MMSGS m_MMSGS;
+	unsigned char m_aRecvBuffer[NET_MAX_PACKETSIZE];
+	CSpscRing<CRecvPacket, RECV_QUEUE_SIZE> m_RecvPackets;
+	// set by the receive thread while it waits for the game thread to
+	// make room in the ring
+	std::atomic<bool> m_RecvFull;
+	SEMAPHORE m_RecvSpace;
+	std::atomic<bool> m_Waiting;
+	std::mutex m_WaitMutex;
+	std::condition_variable m_WaitCond;
+
+	// game thread -> send thread, the queues are passed back and forth by index
+	void *m_pSendThread;
+	SEMAPHORE m_SendSignal;
+	NETSENDQUEUE m_aSendQueues[NUM_SEND_QUEUES];
+	CSpscRing<int, NUM_SEND_QUEUES> m_FullQueues;
+	CSpscRing<int, NUM_SEND_QUEUES> m_FreeQueues;
+	int m_CurrentQueue;
+
+	CNetServerIO(NETSOCKET Socket) : m_Socket(Socket), m_Shutdown(false), m_pRecvThread(0), m_RecvFull(false), m_Waiting(false), m_pSendThread(0)
+	{
+		net_init_mmsgs(&m_MMSGS);
+		sphore_init(&m_RecvSpace);
+		sphore_init(&m_SendSignal);
+		for(int i = 0; i < NUM_SEND_QUEUES; i++)
+		{
+			net_udp_send_queue_init(&m_aSendQueues[i]);
+			if(i > 0)
+			{
+				*m_FreeQueues.Back() = i;
+				m_FreeQueues.Push();
+			}
+		}
+		m_CurrentQueue = 0;
+	}
+
+	~CNetServerIO()
+	{
+		sphore_destroy(&m_RecvSpace);
+		sphore_destroy(&m_SendSignal);
+	}
+
+	static void RecvThread(void *pUser)
+	{
+		CNetServerIO *pThis = (CNetServerIO *)pUser;
+		while(!pThis->m_Shutdown)
+		{
+			CRecvPacket *pPacket = pThis->m_RecvPackets.Back();
+			if(!pPacket)
+			{
+				// the game thread is behind, let the socket buffer fill up
+				// until it pops a packet. check again after announcing it,
+				// the pop might have happened in between
+				pThis->m_RecvFull = true;
+				if(!pThis->m_RecvPackets.Back())
+					sphore_wait(&pThis->m_RecvSpace);
+				continue;
+			}
+
+			unsigned char *pData;
+			int Bytes = net_udp_recv(pThis->m_Socket, &pPacket->m_Addr, pThis->m_aRecvBuffer, NET_MAX_PACKETSIZE, &pThis->m_MMSGS, &pData);
+			if(Bytes <= 0)
+			{
+				net_socket_read_wait(pThis->m_Socket, 100000);
+				continue;
+			}
+
+			// invalid packets are dropped here already
+			if(CNetBase::UnpackPacket(pData, Bytes, &pPacket->m_Packet) != 0)
+				continue;
+			CNetRecvUnpacker::ValidateChunks(&pPacket->m_Packet);
+
+			pThis->m_RecvPackets.Push();
+			if(pThis->m_Waiting)
+			{
+				std::lock_guard<std::mutex> Lock(pThis->m_WaitMutex);
+				pThis->m_WaitCond.notify_one();
+			}
+		}
+	}
+
+	static void SendThread(void *pUser)
+	{
+		CNetServerIO *pThis = (CNetServerIO *)pUser;
+		while(1)
+		{
+			sphore_wait(&pThis->m_SendSignal);
+			int *pIndex;
+			while((pIndex = pThis->m_FullQueues.Front()))
+			{
+				int Index = *pIndex;
+				pThis->m_FullQueues.Pop();
+				net_udp_send_flush(&pThis->m_aSendQueues[Index]);
+				*pThis->m_FreeQueues.Back() = Index;
+				pThis->m_FreeQueues.Push();
+			}
+			if(pThis->m_Shutdown)
+				break;
+		}
+	}
+
+	// hands the current queue to the send thread and returns the next one
+	NETSENDQUEUE *SwapSendQueue()
+	{
+		NETSENDQUEUE *pCurrent = &m_aSendQueues[m_CurrentQueue];
+		int *pFree = m_FreeQueues.Front();
+		if(!pFree)
+		{
+			// the send thread is behind, send directly
+			net_udp_send_flush(pCurrent);
+			return pCurrent;
+		}
+
+		*m_FullQueues.Back() = m_CurrentQueue;
+		m_FullQueues.Push();
+		sphore_signal(&m_SendSignal);
+
+		m_CurrentQueue = *pFree;
+		m_FreeQueues.Pop();
+		return &m_aSendQueues[m_CurrentQueue];
+	}
+
+	void PopRecvPacket()
+	{
+		m_RecvPackets.Pop();
+		if(m_RecvFull.exchange(false))
+			sphore_signal(&m_RecvSpace);
+	}
+
+	void WaitForPackets(int Time)
+	{
+		std::unique_lock<std::mutex> Lock(m_WaitMutex);
+		m_Waiting = true;
+		m_WaitCond.wait_for(Lock, std::chrono::microseconds(Time), [this]() { return !m_RecvPackets.Empty(); });
+		m_Waiting = false;
+	}
+
+	void Stop()
+	{
+		m_Shutdown = true;
+		sphore_signal(&m_RecvSpace);
+		sphore_signal(&m_SendSignal);
+		if(m_pRecvThread)
+			thread_wait(m_pRecvThread);
+		if(m_pSendThread)
+			thread_wait(m_pSendThread);
+	}
+};
+
+static int AddrHash(const NETADDR &Addr, bool WithPort)
+{
+	// fnv-1a
+	unsigned Hash = 2166136261u;
+	Hash = (Hash ^ Addr.type) * 16777619u;
+	for(unsigned i = 0; i < sizeof(Addr.ip); i++)
+		Hash = (Hash ^ Addr.ip[i]) * 16777619u;
+	if(WithPort)
+	{
+		Hash = (Hash ^ (Addr.port & 0xff)) * 16777619u;
+		Hash = (Hash ^ (Addr.port >> 8)) * 16777619u;
+	}
+	return (Hash ^ (Hash >> 16)) & (NET_SLOT_HASH_SIZE - 1);
+}
+
 bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, int Flags)
 {
 	// zero out the whole structure
@@ -76,10 +284,26 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 
 	secure_random_fill(m_SecurityTokenSeed, sizeof(m_SecurityTokenSeed));
 
+	for(int i = 0; i < NET_SLOT_HASH_SIZE; i++)
+	{
+		m_aSlotsByAddr[i] = -1;
+		m_aSlotsByIP[i] = -1;
+	}
+
 	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
 		m_aSlots[i].m_Connection.Init(m_Socket, true);
+		m_aSlots[i].m_AddrHash = -1;
+		m_aSlots[i].m_NextByAddr = -1;
+		m_aSlots[i].m_IPHash = -1;
+		m_aSlots[i].m_NextByIP = -1;
+	}
 
 	net_init_mmsgs(&m_MMSGS);
+	net_udp_send_queue_init(&m_SendQueue);
+	m_SendBatching = false;
+	m_pSendQueue = 0;
+	m_pIO = 0;
 
 	return true;
 }
@@ -104,10 +328,48 @@ int CNetServer::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_NEWCLIENT_N
 
 int CNetServer::Close()
 {
+	if(m_pIO)
+	{
+		FlushSendQueue();
+		m_pIO->Stop();
+		delete m_pIO;
+		m_pIO = 0;
+		SetSendQueue(m_SendBatching ? &m_SendQueue : 0);
+	}
 	// TODO: implement me
 	return 0;
 }
 
+bool CNetServer::StartIOThreads()
+{
+	if(m_pIO)
+		return true;
+
+	m_pIO = new CNetServerIO(m_Socket);
+	m_pIO->m_pRecvThread = thread_init(CNetServerIO::RecvThread, m_pIO, "net recv");
+	m_pIO->m_pSendThread = thread_init(CNetServerIO::SendThread, m_pIO, "net send");
+	if(!m_pIO->m_pRecvThread || !m_pIO->m_pSendThread)
+	{
+		m_pIO->Stop();
+		delete m_pIO;
+		m_pIO = 0;
+		return false;
+	}
+
+	// the packets of the main thread always go through the send thread
+	FlushSendQueue();
+	SetSendQueue(&m_pIO->m_aSendQueues[m_pIO->m_CurrentQueue]);
+	return true;
+}
+
+void CNetServer::WaitForPackets(int Time)
+{
+	if(m_pIO)
+		m_pIO->WaitForPackets(Time);
+	else
+		net_socket_read_wait(m_Socket, Time);
+}
+
 int CNetServer::Drop(int ClientID, const char *pReason)
 {
 	// TODO: insert lots of checks here
@@ -130,6 +392,7 @@ int CNetServer::Update()
 {
 	for(int i = 0; i < MaxClients(); i++)
 	{
+		CheckSendQueue();
 		m_aSlots[i].m_Connection.Update();
 		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR &&
 			(!m_aSlots[i].m_Connection.m_TimeoutProtected ||
@@ -160,15 +423,16 @@ SECURITY_TOKEN CNetServer::GetToken(const NETADDR &Addr)
 
 void CNetServer::SendControl(NETADDR &Addr, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken)
 {
-	CNetBase::SendControlMsg(m_Socket, &Addr, 0, ControlMsg, pExtra, ExtraSize, SecurityToken);
+	CNetBase::SendControlMsg(m_Socket, &Addr, 0, ControlMsg, pExtra, ExtraSize, SecurityToken, SendQueue());
 }
 
 int CNetServer::NumClientsWithAddr(NETADDR Addr)
 {
 	int FoundAddr = 0;
-	for(int i = 0; i < MaxClients(); ++i)
+	for(int i = m_aSlotsByIP[AddrHash(Addr, false)]; i != -1; i = m_aSlots[i].m_NextByIP)
 	{
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE ||
+		if(i >= MaxClients() ||
+			m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE ||
 			(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR &&
 				(!m_aSlots[i].m_Connection.m_TimeoutProtected ||
 				 !m_aSlots[i].m_Connection.m_TimeoutSituation)))
@@ -219,7 +483,7 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 	if (Connlimit(Addr))
 	{
 		const char Msg[] = "Too many connections in a short time";
-		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, Msg, sizeof(Msg), SecurityToken);
+		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, Msg, sizeof(Msg), SecurityToken, SendQueue());
 		return -1; // failed to add client
 	}
 
@@ -228,7 +492,7 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 	{
 		char aBuf[128];
 		str_format(aBuf, sizeof(aBuf), "Only %d players with the same IP are allowed", m_MaxClientsPerIP);
-		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1, SecurityToken);
+		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1, SecurityToken, SendQueue());
 		return -1; // failed to add client
 	}
 
@@ -245,13 +509,14 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 	if (Slot == -1)
 	{
 		const char FullMsg[] = "This server is full";
-		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, FullMsg, sizeof(FullMsg), SecurityToken);
+		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, FullMsg, sizeof(FullMsg), SecurityToken, SendQueue());
 
 		return -1; // failed to add client
 	}
 
 	// init connection slot
 	m_aSlots[Slot].m_Connection.DirectInit(Addr, SecurityToken);
+	UpdateSlotAddr(Slot);
 
 	if (VanillaAuth)
 	{
@@ -301,7 +566,7 @@ void CNetServer::SendMsgs(NETADDR &Addr, const CMsgPacker *Msgs[], int num)
 
 	//
 	m_Construct.m_DataSize = (int)(pChunkData-m_Construct.m_aChunkData);
-	CNetBase::SendPacket(m_Socket, &Addr, &m_Construct, NET_SECURITY_TOKEN_UNSUPPORTED);
+	CNetBase::SendPacket(m_Socket, &Addr, &m_Construct, NET_SECURITY_TOKEN_UNSUPPORTED, SendQueue());
 }
 
 // connection-less msg packet without token-support
@@ -550,12 +815,13 @@ int CNetServer::GetClientSlot(const NETADDR &Addr)
 {
 	int Slot = -1;
 
-	for(int i = 0; i < MaxClients(); i++)
+	// the chains can contain slots that went offline, check them like before
+	for(int i = m_aSlotsByAddr[AddrHash(Addr, true)]; i != -1; i = m_aSlots[i].m_NextByAddr)
 	{
-		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
+		if(i < MaxClients() && i > Slot &&
+			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
 			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_ERROR &&
 			net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
-
 		{
 			Slot = i;
 		}
@@ -564,6 +830,44 @@ int CNetServer::GetClientSlot(const NETADDR &Addr)
 	return Slot;
 }
 
+// moves the slot to the hash chains of its current peer address. has to be
+// called whenever the address of a slot's connection changes
+void CNetServer::UpdateSlotAddr(int Slot)
+{
+	CSlot *pSlot = &m_aSlots[Slot];
+	const NETADDR *pAddr = pSlot->m_Connection.PeerAddress();
+	int AddrHashValue = AddrHash(*pAddr, true);
+	int IPHashValue = AddrHash(*pAddr, false);
+
+	if(pSlot->m_AddrHash != AddrHashValue)
+	{
+		if(pSlot->m_AddrHash != -1)
+		{
+			int *pLink = &m_aSlotsByAddr[pSlot->m_AddrHash];
+			while(*pLink != Slot)
+				pLink = &m_aSlots[*pLink].m_NextByAddr;
+			*pLink = pSlot->m_NextByAddr;
+		}
+		pSlot->m_AddrHash = AddrHashValue;
+		pSlot->m_NextByAddr = m_aSlotsByAddr[AddrHashValue];
+		m_aSlotsByAddr[AddrHashValue] = Slot;
+	}
+
+	if(pSlot->m_IPHash != IPHashValue)
+	{
+		if(pSlot->m_IPHash != -1)
+		{
+			int *pLink = &m_aSlotsByIP[pSlot->m_IPHash];
+			while(*pLink != Slot)
+				pLink = &m_aSlots[*pLink].m_NextByIP;
+			*pLink = pSlot->m_NextByIP;
+		}
+		pSlot->m_IPHash = IPHashValue;
+		pSlot->m_NextByIP = m_aSlotsByIP[IPHashValue];
+		m_aSlotsByIP[IPHashValue] = Slot;
+	}
+}
+
 static bool IsDDNetControlMsg(const CNetPacketConstruct *pPacket)
 {
 	if(!(pPacket->m_Flags&NET_PACKETFLAG_CONTROL)
@@ -590,6 +894,19 @@ static bool IsDDNetControlMsg(const CNetPacketConstruct *pPacket)
 /*
 	TODO: chopp up this function into smaller working parts
 */
+bool CNetServer::ReplyIfBanned(NETADDR &Addr)
+{
+	// check if we just should drop the packet
+	char aBuf[128];
+	if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+	{
+		// banned, reply with a message
+		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1, NET_SECURITY_TOKEN_UNSUPPORTED, SendQueue());
+		return true;
+	}
+	return false;
+}
+
 int CNetServer::Recv(CNetChunk *pChunk)
 {
 	while(1)
@@ -600,24 +917,43 @@ int CNetServer::Recv(CNetChunk *pChunk)
 		if(m_RecvUnpacker.FetchChunk(pChunk))
 			return 1;
 
-		// TODO: empty the recvinfo
-		unsigned char *pData;
-		int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE, &m_MMSGS, &pData);
+		CheckSendQueue();
 
-		// no more packets for now
-		if(Bytes <= 0)
-			break;
+		int Unpacked;
+		if(m_pIO)
+		{
+			// the receive thread has unpacked the packet and checked the chunk
+			// sizes already
+			CNetServerIO::CRecvPacket *pPacket = m_pIO->m_RecvPackets.Front();
 
-		// check if we just should drop the packet
-		char aBuf[128];
-		if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+			// no more packets for now
+			if(!pPacket)
+				break;
+
+			Addr = pPacket->m_Addr;
+			mem_copy(&m_RecvUnpacker.m_Data, &pPacket->m_Packet, sizeof(m_RecvUnpacker.m_Data));
+			m_pIO->PopRecvPacket();
+
+			if(ReplyIfBanned(Addr))
+				continue;
+			Unpacked = 0;
+		}
+		else
 		{
-			// banned, reply with a message
-			CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1, NET_SECURITY_TOKEN_UNSUPPORTED);
-			continue;
+			// TODO: empty the recvinfo
+			unsigned char *pData;
+			int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE, &m_MMSGS, &pData);
+
+			// no more packets for now
+			if(Bytes <= 0)
+				break;
+
+			if(ReplyIfBanned(Addr))
+				continue;
+			Unpacked = CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data);
 		}
 
-		if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data) == 0)
+		if(Unpacked == 0)
 		{
 			if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
 			{
@@ -676,6 +1012,8 @@ int CNetServer::Recv(CNetChunk *pChunk)
 
 int CNetServer::Send(CNetChunk *pChunk)
 {
+	CheckSendQueue();
+
 	if(pChunk->m_DataSize >= NET_MAX_PAYLOAD)
 	{
 		dbg_msg("netserver", "packet payload too big. %d. dropping packet", pChunk->m_DataSize);
@@ -686,7 +1024,7 @@ int CNetServer::Send(CNetChunk *pChunk)
 	{
 		// send connectionless packet
 		CNetBase::SendPacketConnless(m_Socket, &pChunk->m_Address, pChunk->m_pData, pChunk->m_DataSize,
-				pChunk->m_Flags&NETSENDFLAG_EXTENDED, pChunk->m_aExtraData);
+				pChunk->m_Flags&NETSENDFLAG_EXTENDED, pChunk->m_aExtraData, SendQueue());
 	}
 	else
 	{
@@ -710,6 +1048,38 @@ int CNetServer::Send(CNetChunk *pChunk)
 	return 0;
 }
 
+void CNetServer::SetSendQueue(NETSENDQUEUE *pSendQueue)
+{
+	m_pSendQueue = pSendQueue;
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+		m_aSlots[i].m_Connection.SetSendQueue(pSendQueue);
+}
+
+void CNetServer::SetSendBatching(bool SendBatching)
+{
+	// packets that are still queued go out with the next FlushSendQueue
+	m_SendBatching = SendBatching;
+	if(!m_pIO)
+		SetSendQueue(m_SendBatching ? &m_SendQueue : 0);
+}
+
+void CNetServer::FlushSendQueue()
+{
+	if(m_SendQueue.size)
+		net_udp_send_flush(&m_SendQueue);
+	if(m_pIO && m_pSendQueue->size)
+		SetSendQueue(m_pIO->SwapSendQueue());
+}
+
+// a full queue is sent right away by the thread that fills it. with the
+// send thread, hand it over before that can happen. every call site sends
+// at most a few packets before the next check
+void CNetServer::CheckSendQueue()
+{
+	if(m_pIO && m_pSendQueue->size > VLEN - 8)
+		FlushSendQueue();
+}
+
 void CNetServer::SetMaxClientsPerIP(int Max)
 {
 	// clamp
@@ -728,6 +1098,7 @@ bool CNetServer::SetTimedOut(int ClientID, int OrigID)
 
 	m_aSlots[ClientID].m_Connection.SetTimedOut(ClientAddr(OrigID), m_aSlots[OrigID].m_Connection.SeqSequence(), m_aSlots[OrigID].m_Connection.AckSequence(), m_aSlots[OrigID].m_Connection.SecurityToken(), m_aSlots[OrigID].m_Connection.ResendBuffer());
 	m_aSlots[OrigID].m_Connection.Reset();
+	UpdateSlotAddr(ClientID);
 	return true;
 }
 
@@ -4,6 +4,217 @@
 #include "compression.h"
 #include "uuid_manager.h"
 
+#include <base/math.h>
+
+#include <algorithm>
+
+#if defined(CONF_ARCH_AMD64) || defined(__SSE2__)
+	#define SNAPSHOT_SSE2 1
+	#include <emmintrin.h>
+	#if defined(__GNUC__)
+		#define SNAPSHOT_AVX2 1
+		#include <immintrin.h>
+	#endif
+#endif
+
+// item loops
+//
+// DiffItem, UndiffItem and Crc run over every item of every snapshot for
+// every client. They have scalar, SSE2 and AVX2 versions which all produce
+// the same results, the best one supported by the cpu is picked at startup.
+
+// number of bits CVariableInt::Pack needs for the value
+static inline int PackedBits(int Value)
+{
+	unsigned Folded = (unsigned)(Value^(Value>>31));
+	return 8 * (1 + (Folded >= (1u<<6)) + (Folded >= (1u<<13)) + (Folded >= (1u<<20)) + (Folded >= (1u<<27)));
+}
+
+static int DiffScalar(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	int Needed = 0;
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = (int)((unsigned)pCurrent[i] - (unsigned)pPast[i]);
+		Needed |= pOut[i];
+	}
+	return Needed;
+}
+
+static int UndiffScalar(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	int Bits = 0;
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = (int)((unsigned)pPast[i] + (unsigned)pDiff[i]);
+		Bits += PackedBits(pDiff[i]);
+	}
+	return Bits;
+}
+
+static int SumScalar(const int *pData, int Size)
+{
+	unsigned Sum = 0;
+	for(int i = 0; i < Size; i++)
+		Sum += (unsigned)pData[i];
+	return (int)Sum;
+}
+
+#if defined(SNAPSHOT_SSE2)
+static inline int HorizontalAdd(__m128i Value)
+{
+	Value = _mm_add_epi32(Value, _mm_shuffle_epi32(Value, 0x4e));
+	Value = _mm_add_epi32(Value, _mm_shuffle_epi32(Value, 0xb1));
+	return _mm_cvtsi128_si32(Value);
+}
+
+static inline int HorizontalOr(__m128i Value)
+{
+	Value = _mm_or_si128(Value, _mm_shuffle_epi32(Value, 0x4e));
+	Value = _mm_or_si128(Value, _mm_shuffle_epi32(Value, 0xb1));
+	return _mm_cvtsi128_si32(Value);
+}
+
+static int DiffSse2(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	__m128i Needed = _mm_setzero_si128();
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+	{
+		__m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent+i)), _mm_loadu_si128((const __m128i *)(pPast+i)));
+		_mm_storeu_si128((__m128i *)(pOut+i), Diff);
+		Needed = _mm_or_si128(Needed, Diff);
+	}
+	return HorizontalOr(Needed) | DiffScalar(pPast+i, pCurrent+i, pOut+i, Size-i);
+}
+
+static int UndiffSse2(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	// counts the extra bytes each packed value needs (compare masks are -1)
+	__m128i Extra = _mm_setzero_si128();
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+	{
+		__m128i Diff = _mm_loadu_si128((const __m128i *)(pDiff+i));
+		_mm_storeu_si128((__m128i *)(pOut+i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast+i)), Diff));
+		__m128i Folded = _mm_xor_si128(Diff, _mm_srai_epi32(Diff, 31));
+		Extra = _mm_add_epi32(Extra, _mm_cmpgt_epi32(Folded, _mm_set1_epi32((1<<6)-1)));
+		Extra = _mm_add_epi32(Extra, _mm_cmpgt_epi32(Folded, _mm_set1_epi32((1<<13)-1)));
+		Extra = _mm_add_epi32(Extra, _mm_cmpgt_epi32(Folded, _mm_set1_epi32((1<<20)-1)));
+		Extra = _mm_add_epi32(Extra, _mm_cmpgt_epi32(Folded, _mm_set1_epi32((1<<27)-1)));
+	}
+	return 8 * (i - HorizontalAdd(Extra)) + UndiffScalar(pPast+i, pDiff+i, pOut+i, Size-i);
+}
+
+static int SumSse2(const int *pData, int Size)
+{
+	__m128i Sum = _mm_setzero_si128();
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+		Sum = _mm_add_epi32(Sum, _mm_loadu_si128((const __m128i *)(pData+i)));
+	return (int)((unsigned)HorizontalAdd(Sum) + (unsigned)SumScalar(pData+i, Size-i));
+}
+#endif
+
+#if defined(SNAPSHOT_AVX2)
+__attribute__((target("avx2")))
+static int DiffAvx2(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	__m256i Needed = _mm256_setzero_si256();
+	int i = 0;
+	for(; i + 8 <= Size; i += 8)
+	{
+		__m256i Diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(pCurrent+i)), _mm256_loadu_si256((const __m256i *)(pPast+i)));
+		_mm256_storeu_si256((__m256i *)(pOut+i), Diff);
+		Needed = _mm256_or_si256(Needed, Diff);
+	}
+	__m128i Half = _mm_or_si128(_mm256_castsi256_si128(Needed), _mm256_extracti128_si256(Needed, 1));
+	return HorizontalOr(Half) | DiffSse2(pPast+i, pCurrent+i, pOut+i, Size-i);
+}
+
+__attribute__((target("avx2")))
+static int UndiffAvx2(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	__m256i Extra = _mm256_setzero_si256();
+	int i = 0;
+	for(; i + 8 <= Size; i += 8)
+	{
+		__m256i Diff = _mm256_loadu_si256((const __m256i *)(pDiff+i));
+		_mm256_storeu_si256((__m256i *)(pOut+i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(pPast+i)), Diff));
+		__m256i Folded = _mm256_xor_si256(Diff, _mm256_srai_epi32(Diff, 31));
+		Extra = _mm256_add_epi32(Extra, _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32((1<<6)-1)));
+		Extra = _mm256_add_epi32(Extra, _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32((1<<13)-1)));
+		Extra = _mm256_add_epi32(Extra, _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32((1<<20)-1)));
+		Extra = _mm256_add_epi32(Extra, _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32((1<<27)-1)));
+	}
+	__m128i Half = _mm_add_epi32(_mm256_castsi256_si128(Extra), _mm256_extracti128_si256(Extra, 1));
+	return 8 * (i - HorizontalAdd(Half)) + UndiffSse2(pPast+i, pDiff+i, pOut+i, Size-i);
+}
+
+__attribute__((target("avx2")))
+static int SumAvx2(const int *pData, int Size)
+{
+	__m256i Sum = _mm256_setzero_si256();
+	int i = 0;
+	for(; i + 8 <= Size; i += 8)
+		Sum = _mm256_add_epi32(Sum, _mm256_loadu_si256((const __m256i *)(pData+i)));
+	__m128i Half = _mm_add_epi32(_mm256_castsi256_si128(Sum), _mm256_extracti128_si256(Sum, 1));
+	return (int)((unsigned)HorizontalAdd(Half) + (unsigned)SumSse2(pData+i, Size-i));
+}
+#endif
+
+struct CItemLoops
+{
+	int (*m_pfnDiff)(const int *pPast, const int *pCurrent, int *pOut, int Size);
+	int (*m_pfnUndiff)(const int *pPast, const int *pDiff, int *pOut, int Size);
+	int (*m_pfnSum)(const int *pData, int Size);
+};
+
+static const CItemLoops s_aItemLoops[] = {
+	{DiffScalar, UndiffScalar, SumScalar},
+#if defined(SNAPSHOT_SSE2)
+	{DiffSse2, UndiffSse2, SumSse2},
+#endif
+#if defined(SNAPSHOT_AVX2)
+	{DiffAvx2, UndiffAvx2, SumAvx2},
+#endif
+};
+
+// scalar until the detection below ran, in case other static initializers use it
+static const CItemLoops *s_pItemLoops = &s_aItemLoops[CSnapshotDelta::SIMD_NONE];
+
+static int DetectSimd()
+{
+	int Level = CSnapshotDelta::SIMD_NONE;
+#if defined(SNAPSHOT_SSE2)
+	Level = CSnapshotDelta::SIMD_SSE2;
+#endif
+#if defined(SNAPSHOT_AVX2)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		Level = CSnapshotDelta::SIMD_AVX2;
+#endif
+	s_pItemLoops = &s_aItemLoops[Level];
+	return Level;
+}
+
+static const int s_SimdSupported = DetectSimd();
+
+int CSnapshotDelta::SimdSupported()
+{
+	return s_SimdSupported;
+}
+
+int CSnapshotDelta::Simd()
+{
+	return s_pItemLoops - s_aItemLoops;
+}
+
+void CSnapshotDelta::SetSimd(int Level)
+{
+	s_pItemLoops = &s_aItemLoops[clamp(Level, (int)SIMD_NONE, s_SimdSupported)];
+}
+
 // CSnapshot
 
 CSnapshotItem *CSnapshot::GetItem(int Index)
@@ -47,28 +258,57 @@ int CSnapshot::GetItemType(int Index)
 
 int CSnapshot::GetItemIndex(int Key)
 {
-	// TODO: OPT: this should not be a linear search. very bad
-	for(int i = 0; i < m_NumItems; i++)
+	// items are sorted by key, see CSnapshotBuilder::Finish
+	int Low = 0;
+	int High = m_NumItems - 1;
+	while(Low <= High)
 	{
-		if(GetItem(i)->Key() == Key)
-			return i;
+		int Mid = Low + (High - Low) / 2;
+		int MidKey = GetItem(Mid)->Key();
+		if(MidKey < Key)
+			Low = Mid + 1;
+		else if(MidKey > Key)
+			High = Mid - 1;
+		else
+			return Mid;
 	}
 	return -1;
 }
 
+bool CSnapshot::IsSorted()
+{
+	for(int i = 1; i < m_NumItems; i++)
+	{
+		if(GetItem(i - 1)->Key() > GetItem(i)->Key())
+			return false;
+	}
+	return true;
+}
+
 int CSnapshot::Crc()
 {
-	int Crc = 0;
+	// the crc is the sum of all item data. when the items are packed back to
+	// back, sum the whole data block at once and take the item keys out again
+	bool Packed = m_NumItems > 0 && Offsets()[0] == 0 && m_DataSize % sizeof(int) == 0;
+	unsigned Keys = 0;
+	for(int i = 0; i < m_NumItems && Packed; i++)
+	{
+		int Size = GetItemSize(i);
+		Packed = Size >= 0 && Size % sizeof(int) == 0;
+		Keys += (unsigned)GetItem(i)->Key();
+	}
+	if(Packed)
+		return (int)((unsigned)s_pItemLoops->m_pfnSum((int *)DataStart(), m_DataSize/sizeof(int)) - Keys);
 
+	unsigned Crc = 0;
 	for(int i = 0; i < m_NumItems; i++)
 	{
 		CSnapshotItem *pItem = GetItem(i);
 		int Size = GetItemSize(i);
-
-		for(int b = 0; b < Size/4; b++)
-			Crc += pItem->Data()[b];
+		if(Size > 0)
+			Crc += (unsigned)s_pItemLoops->m_pfnSum(pItem->Data(), Size/4);
 	}
-	return Crc;
+	return (int)Crc;
 }
 
 void CSnapshot::DebugDump()
@@ -87,84 +327,67 @@ void CSnapshot::DebugDump()
 
 // CSnapshotDelta
 
-struct CItemList
+// open addressing hash from item key to item index, sized so it never overflows
+class CItemHash
 {
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
+	enum
+	{
+		HASHLIST_SIZE = CSnapshot::MAX_ITEMS*2,
+	};
 
-enum
-{
-	HASHLIST_SIZE = 256,
-};
+	int m_aKeys[HASHLIST_SIZE];
+	int m_aIndex[HASHLIST_SIZE];
 
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
-{
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	static unsigned Hash(int Key) { return ((unsigned)Key * 2654435761u) >> 21; }
 
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+public:
+	void Clear()
+	{
+		for(int i = 0; i < HASHLIST_SIZE; i++)
+			m_aIndex[i] = -1;
+	}
+
+	void Add(int Key, int Index)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		if(pHashlist[HashID].m_Num != 64)
+		unsigned HashID = Hash(Key) & (HASHLIST_SIZE-1);
+		while(m_aIndex[HashID] != -1)
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			if(m_aKeys[HashID] == Key)
+				return; // keep the first item with this key
+			HashID = (HashID+1) & (HASHLIST_SIZE-1);
 		}
+		m_aKeys[HashID] = Key;
+		m_aIndex[HashID] = Index;
 	}
-}
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
-{
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		for(int i = 0; i < pHashlist[HashID].m_Num; i++)
+	int Find(int Key) const
+	{
+		unsigned HashID = Hash(Key) & (HASHLIST_SIZE-1);
+		while(m_aIndex[HashID] != -1)
 		{
-			if(pHashlist[HashID].m_aKeys[i] == Key)
-				return pHashlist[HashID].m_aIndex[i];
+			if(m_aKeys[HashID] == Key)
+				return m_aIndex[HashID];
+			HashID = (HashID+1) & (HASHLIST_SIZE-1);
+		}
+		return -1;
 	}
+};
 
-	return -1;
+static void GenerateHash(CItemHash *pHash, CSnapshot *pSnapshot)
+{
+	pHash->Clear();
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+		pHash->Add(pSnapshot->GetItem(i)->Key(), i);
 }
 
 int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
 {
-	int Needed = 0;
-	while(Size)
-	{
-		*pOut = *pCurrent-*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
-	}
-
-	return Needed;
+	return s_pItemLoops->m_pfnDiff(pPast, pCurrent, pOut, Size);
 }
 
 void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size)
 {
-	while(Size)
-	{
-		*pOut = *pPast+*pDiff;
-
-		if(*pDiff == 0)
-			m_aSnapshotDataRate[m_SnapshotCurrent] += 1;
-		else
-		{
-			unsigned char aBuf[16];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff);
-			m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char*)aBuf) * 8;
-		}
-
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
-	}
+	m_aSnapshotDataRate[m_SnapshotCurrent] += s_pItemLoops->m_pfnUndiff(pPast, pDiff, pOut, Size);
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -211,14 +434,14 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList Hashlist[HASHLIST_SIZE];
-	GenerateHash(Hashlist, pTo);
+	CItemHash Hash;
+	GenerateHash(&Hash, pTo);
 
 	// pack deleted stuff
 	for(i = 0; i < pFrom->NumItems(); i++)
 	{
 		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), Hashlist) == -1)
+		if(Hash.Find(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -227,8 +450,8 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 		}
 	}
 
-	GenerateHash(Hashlist, pFrom);
-	int aPastIndecies[1024];
+	GenerateHash(&Hash, pFrom);
+	int aPastIndecies[CSnapshot::MAX_ITEMS];
 
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
@@ -236,7 +459,7 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	for(i = 0; i < NumItems; i++)
 	{
 		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndecies[i] = GetItemIndexHashed(pCurItem->Key(), Hashlist); // O(n) .. O(n^n)
+		aPastIndecies[i] = Hash.Find(pCurItem->Key());
 	}
 
 	for(i = 0; i < NumItems; i++)
@@ -331,9 +554,15 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 	// unpack deleted stuff
 	pDeleted = pData;
-	pData += pDelta->m_NumDeletedItems;
-	if(pData > pEnd)
+	if(pDelta->m_NumDeletedItems < 0 || pDelta->m_NumDeletedItems > pEnd - pData)
 		return -1;
+	pData += pDelta->m_NumDeletedItems;
+
+	CItemHash Hash;
+	Hash.Clear();
+	for(int d = 0; d < pDelta->m_NumDeletedItems && d < CSnapshot::MAX_ITEMS; d++)
+		Hash.Add(pDeleted[d], d);
+	bool HashedDeleted = pDelta->m_NumDeletedItems <= CSnapshot::MAX_ITEMS;
 
 	// copy all non deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
@@ -342,12 +571,17 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 		pFromItem = pFrom->GetItem(i);
 		ItemSize = pFrom->GetItemSize(i);
 		Keep = 1;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+		if(HashedDeleted)
+			Keep = Hash.Find(pFromItem->Key()) == -1;
+		else
 		{
-			if(pDeleted[d] == pFromItem->Key())
+			for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
 			{
-				Keep = 0;
-				break;
+				if(pDeleted[d] == pFromItem->Key())
+				{
+					Keep = 0;
+					break;
+				}
 			}
 		}
 
@@ -360,6 +594,11 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 		}
 	}
 
+	// remember where the kept items ended up in the builder
+	Hash.Clear();
+	for(int i = 0; i < Builder.NumItems(); i++)
+		Hash.Add(Builder.GetItem(i)->Key(), i);
+
 	// unpack updated stuff
 	for(int i = 0; i < pDelta->m_NumUpdateItems; i++)
 	{
@@ -384,9 +623,15 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 		Key = (Type<<16)|ID;
 
 		// create the item if needed
-		pNewData = Builder.GetItemData(Key);
-		if(!pNewData)
+		int BuilderIndex = Hash.Find(Key);
+		if(BuilderIndex != -1)
+			pNewData = Builder.GetItem(BuilderIndex)->Data();
+		else
+		{
 			pNewData = (int *)Builder.NewItem(Key>>16, Key&0xffff, ItemSize);
+			if(pNewData)
+				Hash.Add(Key, Builder.NumItems()-1);
+		}
 
 		//if(range_check(pEnd, pNewData, ItemSize)) return -4;
 
@@ -502,9 +747,11 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 
 int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
 {
-	CHolder *pHolder = m_pFirst;
+	// snapshots are added in tick order and the requested one is usually
+	// among the most recent ones, so search from the back
+	CHolder *pHolder = m_pLast;
 
-	while(pHolder)
+	while(pHolder && pHolder->m_Tick >= Tick)
 	{
 		if(pHolder->m_Tick == Tick)
 		{
@@ -517,7 +764,7 @@ int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapsh
 			return pHolder->m_SnapSize;
 		}
 
-		pHolder = pHolder->m_pNext;
+		pHolder = pHolder->m_pPrev;
 	}
 
 	return -1;
@@ -563,11 +810,59 @@ int CSnapshotBuilder::Finish(void *SpnapData)
 	int OffsetSize = sizeof(int)*m_NumItems;
 	pSnap->m_DataSize = m_DataSize;
 	pSnap->m_NumItems = m_NumItems;
-	mem_copy(pSnap->Offsets(), m_aOffsets, OffsetSize);
-	mem_copy(pSnap->DataStart(), m_aData, m_DataSize);
+
+	// sort the items by key so CSnapshot::GetItemIndex can do a binary search
+	CSortItem aItems[MAX_ITEMS];
+	bool Sorted = true;
+	for(int i = 0; i < m_NumItems; i++)
+	{
+		aItems[i].m_Key = GetItem(i)->Key();
+		aItems[i].m_Index = i;
+		if(i > 0 && aItems[i - 1].m_Key > aItems[i].m_Key)
+			Sorted = false;
+	}
+
+	if(Sorted)
+	{
+		mem_copy(pSnap->Offsets(), m_aOffsets, OffsetSize);
+		mem_copy(pSnap->DataStart(), m_aData, m_DataSize);
+	}
+	else
+	{
+		std::sort(aItems, aItems + m_NumItems);
+
+		int *pOffsets = pSnap->Offsets();
+		char *pData = pSnap->DataStart();
+		int Offset = 0;
+		for(int i = 0; i < m_NumItems; i++)
+		{
+			int Index = aItems[i].m_Index;
+			int Size = (Index == m_NumItems - 1 ? m_DataSize : m_aOffsets[Index + 1]) - m_aOffsets[Index];
+			mem_copy(pData + Offset, m_aData + m_aOffsets[Index], Size);
+			pOffsets[i] = Offset;
+			Offset += Size;
+		}
+	}
 	return sizeof(CSnapshot) + OffsetSize + m_DataSize;
 }
 
+int CSnapshotBuilder::Sort(void *pSnapData)
+{
+	CSnapshot *pSnap = (CSnapshot *)pSnapData;
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int i = 0; i < pSnap->NumItems(); i++)
+	{
+		CSnapshotItem *pItem = pSnap->GetItem(i);
+		int Size = pSnap->GetItemSize(i);
+		void *pData = Builder.NewItem(pItem->Type(), pItem->ID(), Size);
+		if(!pData)
+			return -1;
+		mem_copy(pData, pItem->Data(), Size);
+	}
+	return Builder.Finish(pSnapData);
+}
+
 static int GetTypeFromIndex(int Index)
 {
 	return CSnapshot::MAX_TYPE - Index;
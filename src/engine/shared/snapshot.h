@@ -33,6 +33,7 @@ public:
 	{
 		OFFSET_UUID_TYPE=0x4000,
 		MAX_TYPE=0x7fff,
+		MAX_ITEMS=1024,
 		MAX_SIZE=64*1024
 	};
 
@@ -42,6 +43,7 @@ public:
 	int GetItemSize(int Index);
 	int GetItemIndex(int Key);
 	int GetItemType(int Index);
+	bool IsSorted();
 
 	int Crc();
 	void DebugDump();
@@ -74,6 +76,19 @@ private:
 	void UndiffItem(int *pPast, int *pDiff, int *pOut, int Size);
 
 public:
+	enum
+	{
+		SIMD_NONE=0,
+		SIMD_SSE2,
+		SIMD_AVX2,
+	};
+
+	// best instruction set for the item loops this build and cpu support, used by default
+	static int SimdSupported();
+	static int Simd();
+	// only for tests and benchmarks, levels above SimdSupported() are clamped
+	static void SetSimd(int Level);
+
 	static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size);
 	CSnapshotDelta();
 	CSnapshotDelta(const CSnapshotDelta &old);
@@ -120,7 +135,7 @@ class CSnapshotBuilder
 {
 	enum
 	{
-		MAX_ITEMS = 1024,
+		MAX_ITEMS = CSnapshot::MAX_ITEMS,
 		MAX_EXTENDED_ITEM_TYPES = 64,
 	};
 
@@ -133,6 +148,13 @@ class CSnapshotBuilder
 	int m_aExtendedItemTypes[MAX_EXTENDED_ITEM_TYPES];
 	int m_NumExtendedItemTypes;
 
+	struct CSortItem
+	{
+		int m_Key;
+		int m_Index;
+		bool operator<(const CSortItem &Other) const { return m_Key < Other.m_Key || (m_Key == Other.m_Key && m_Index < Other.m_Index); }
+	};
+
 	void AddExtendedItemType(int Index);
 	int GetExtendedItemTypeIndex(int TypeID);
 
@@ -143,10 +165,14 @@ public:
 
 	void *NewItem(int Type, int ID, int Size);
 
+	int NumItems() const { return m_NumItems; }
 	CSnapshotItem *GetItem(int Index);
 	int *GetItemData(int Key);
 
 	int Finish(void *Snapdata);
+
+	// sorts the items of a snapshot that wasn't created by Finish, e.g. from old demos
+	static int Sort(void *pSnapData);
 };
 
 
@@ -416,11 +416,13 @@ void CMenus::RenderServerbrowserServerList(CUIRect View)
 			else if(ID == COL_PING)
 			{
 				str_format(aTemp, sizeof(aTemp), "%i", pItem->m_Latency);
+				ColorRGBA rgb(1.0f, 1.0f, 1.0f, 1.0f);
 				if(g_Config.m_UiColorizePing)
-				{
-					ColorRGBA rgb = color_cast<ColorRGBA>(ColorHSLA((300.0f - clamp(pItem->m_Latency, 0, 300)) / 1000.0f, 1.0f, 0.5f));
-					TextRender()->TextColor(rgb);
-				}
+					rgb = color_cast<ColorRGBA>(ColorHSLA((300.0f - clamp(pItem->m_Latency, 0, 300)) / 1000.0f, 1.0f, 0.5f));
+				// the ping of the last refresh
+				if(pItem->m_Stale)
+					rgb.a = 0.5f;
+				TextRender()->TextColor(rgb);
 
 				UI()->DoLabelScaled(&Button, aTemp, 12.0f, 1);
 				TextRender()->TextColor(1.0f, 1.0f, 1.0f, 1.0f);
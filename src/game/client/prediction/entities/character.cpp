@@ -561,11 +561,18 @@ void CCharacter::Tick()
 	return;
 }
 
+void CCharacter::SetPos(vec2 Pos)
+{
+	m_Pos = Pos;
+	if(GameWorld())
+		GameWorld()->UpdateGrid(this);
+}
+
 void CCharacter::TickDefered()
 {
 	m_Core.Move();
 	m_Core.Quantize();
-	m_Pos = m_Core.m_Pos;
+	SetPos(m_Core.m_Pos);
 }
 
 bool CCharacter::TakeDamage(vec2 Force, int Dmg, int From, int Weapon)
@@ -892,11 +899,19 @@ void CCharacter::DDRacePostCoreTick()
 	HandleSkippableTiles(CurrentIndex);
 
 	// handle Anti-Skip tiles
-	std::list < int > Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!Indices.empty())
-		for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
-			HandleTiles(*i);
-	else
+	vec2 PrevPos = m_PrevPos;
+	vec2 Pos = m_Pos;
+	int aIndices[16];
+	int Cursor = 0;
+	int Found = 0;
+	while(Cursor >= 0)
+	{
+		int Num = Collision()->GetMapIndices(PrevPos, Pos, aIndices, 16, &Cursor);
+		for(int i = 0; i < Num; i++)
+			HandleTiles(aIndices[i]);
+		Found += Num;
+	}
+	if(!Found)
 	{
 		HandleTiles(CurrentIndex);
 	}
@@ -1132,7 +1147,7 @@ void CCharacter::Read(CNetObj_Character *pChar, CNetObj_DDNetCharacter *pExtende
 	}
 
 	vec2 PosBefore = m_Pos;
-	m_Pos = m_Core.m_Pos;
+	SetPos(m_Core.m_Pos);
 
 	if(distance(PosBefore, m_Pos) > 2.f) // misprediction, don't use prevpos
 		m_PrevPos = m_Pos;
@@ -38,6 +38,10 @@ public:
 	virtual void Tick();
 	virtual void TickDefered();
 
+	// every move of the character has to go through here, it keeps the
+	// grid of the world in sync
+	void SetPos(vec2 Pos);
+
 	bool IsGrounded();
 
 	void SetWeapon(int W);
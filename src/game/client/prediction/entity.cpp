@@ -19,6 +19,7 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType)
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+	m_GridNode.m_Bucket = -1;
 	m_SnapTicks = -1;
 
 	// DDRace
@@ -27,8 +27,10 @@ class CEntity
 {
 	MACRO_ALLOC_HEAP()
 	friend class CGameWorld;	// entity list handling
+	friend class CEntityGrid<CEntity>;
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CEntityGrid<CEntity>::CNode m_GridNode;
 protected:
 	class CGameWorld *m_pGameWorld;
 	bool m_MarkedForDestroy;
@@ -67,7 +69,7 @@ public:
 	void Keep() { m_SnapTicks = 0; m_MarkedForDestroy = false; }
 	void DetachFromGameWorld() { m_pGameWorld = 0; }
 
-	CEntity() { m_ID = -1; m_pGameWorld = 0; }
+	CEntity() { m_ID = -1; m_pGameWorld = 0; m_GridNode.m_Bucket = -1; }
 };
 
 #endif
@@ -61,6 +61,25 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 		return 0;
 
 	int Num = 0;
+	if(Type == ENTTYPE_CHARACTER)
+	{
+		CEntity *apCandidates[MAX_CLIENTS];
+		int NumCandidates = m_CharacterGrid.Query(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), apCandidates, MAX_CLIENTS);
+		for(int i = 0; i < NumCandidates; i++)
+		{
+			CEntity *pEnt = apCandidates[i];
+			if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
+			{
+				if(ppEnts)
+					ppEnts[Num] = pEnt;
+				Num++;
+				if(Num == Max)
+					break;
+			}
+		}
+		return Num;
+	}
+
 	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
@@ -107,6 +126,9 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 		pEnt->m_pNextTypeEntity = 0x0;
 	}
 
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+		m_CharacterGrid.Insert(pEnt, Last);
+
 	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
 	{
 		auto *pChar = (CCharacter*) pEnt;
@@ -148,6 +170,7 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
 	{
+		m_CharacterGrid.Remove(pEnt);
 		CCharacter *pChar = (CCharacter*) pEnt;
 		int ID = pChar->GetCID();
 		if(ID >= 0 && ID < MAX_CLIENTS)
@@ -184,8 +207,16 @@ bool distCompare(std::pair<float,int> a, std::pair<float,int> b)
 	return (a.first < b.first);
 }
 
+void CGameWorld::UpdateGrid(CEntity *pEnt)
+{
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+		m_CharacterGrid.Update(pEnt);
+}
+
 void CGameWorld::Tick()
 {
+	m_CharacterGrid.CheckCells();
+
 	// update all objects
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
@@ -204,6 +235,8 @@ void CGameWorld::Tick()
 			pEnt = m_pNextTraverseEntity;
 		}
 
+	m_CharacterGrid.CheckCells();
+
 	RemoveEntities();
 
 	OnModified();
@@ -217,9 +250,13 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	CEntity *apCandidates[MAX_CLIENTS];
+	int NumCandidates = m_CharacterGrid.Query(Min, Max, apCandidates, MAX_CLIENTS);
+	for(int i = 0; i < NumCandidates; i++)
 	{
+		CCharacter *p = (CCharacter *)apCandidates[i];
 		if(p == pNotThis)
 			continue;
 
@@ -247,9 +284,13 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 {
 	std::list< CCharacter * > listOfChars;
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	CEntity *apCandidates[MAX_CLIENTS];
+	int NumCandidates = m_CharacterGrid.Query(Min, Max, apCandidates, MAX_CLIENTS);
+	for(int i = 0; i < NumCandidates; i++)
 	{
+		CCharacter *pChr = (CCharacter *)apCandidates[i];
 		if(pChr == pNotThis)
 			continue;
 
@@ -3,6 +3,7 @@
 #ifndef GAME_CLIENT_PREDICTION_GAMEWORLD_H
 #define GAME_CLIENT_PREDICTION_GAMEWORLD_H
 
+#include <game/entitygrid.h>
 #include <game/gamecore.h>
 
 #include <list>
@@ -32,6 +33,9 @@ public:
 
 	CEntity *FindFirst(int Type);
 	CEntity *FindLast(int Type);
+
+	// has to be called whenever the position of an entity is written
+	void UpdateGrid(CEntity *pEnt);
 	int FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type);
 	class CCharacter *IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, vec2 &NewPos, class CCharacter *pNotThis = 0, int CollideWith = -1, class CCharacter *pThisOnly = 0);
 	void InsertEntity(CEntity *pEntity, bool Last = false);
@@ -99,6 +103,9 @@ private:
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// same as in the server world, only characters are in the grid
+	CEntityGrid<CEntity> m_CharacterGrid;
+
 	class CCharacter *m_apCharacters[MAX_CLIENTS];
 };
 
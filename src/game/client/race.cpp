@@ -78,16 +78,22 @@ bool CRaceHelper::IsStart(CGameClient *pClient, vec2 Prev, vec2 Pos)
 	}
 	else
 	{
-		std::list < int > Indices = pCollision->GetMapIndices(Prev, Pos);
-		if(!Indices.empty())
-			for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
+		int aIndices[16];
+		int Cursor = 0;
+		int Found = 0;
+		while(Cursor >= 0)
+		{
+			int Num = pCollision->GetMapIndices(Prev, Pos, aIndices, 16, &Cursor);
+			for(int i = 0; i < Num; i++)
 			{
-				if(pCollision->GetTileIndex(*i) == TILE_BEGIN)
+				if(pCollision->GetTileIndex(aIndices[i]) == TILE_BEGIN)
 					return true;
-				if(pCollision->GetFTileIndex(*i) == TILE_BEGIN)
+				if(pCollision->GetFTileIndex(aIndices[i]) == TILE_BEGIN)
 					return true;
 			}
-		else
+			Found += Num;
+		}
+		if(!Found)
 		{
 			if(pCollision->GetTileIndex(pCollision->GetPureMapIndex(Pos)) == TILE_BEGIN)
 				return true;
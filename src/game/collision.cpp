@@ -49,6 +49,7 @@ CCollision::CCollision()
 	m_pDoor = 0;
 	m_pSwitchers = 0;
 	m_pTune = 0;
+	m_pTileFlags = 0;
 }
 
 CCollision::~CCollision()
@@ -135,6 +136,10 @@ void CCollision::Init(class CLayers *pLayers)
 		}
 	}
 
+	m_pTileFlags = new unsigned short[m_Width * m_Height];
+	for(int i = 0; i < m_Width * m_Height; i++)
+		UpdateTileFlags(i);
+
 	if(m_NumSwitchers)
 	{
 		m_pSwitchers = new SSwitchers[m_NumSwitchers+1];
@@ -249,7 +254,7 @@ int CCollision::GetMoveRestrictions(CALLBACK_SWITCHACTIVE pfnSwitchActive, void
 		{
 			ModMapIndex = OverrideCenterTileIndex;
 		}
-		for(int Front = 0; Front < 2; Front++)
+		for(int Front = 0; Front < 2 && (m_pTileFlags[ModMapIndex]&COLFLAG_STOPPER); Front++)
 		{
 			int Tile;
 			int Flags;
@@ -293,30 +298,137 @@ int CCollision::GetTile(int x, int y)
 	return 0;
 }
 
-// TODO: rewrite this smarter!
+/*
+	Class: Line Samples
+		The points Pos0 + (Pos1 - Pos0) * i / Divisor for 0 <= i <= Last
+		that the ray casts used to check one pixel at a time.
+
+		All tile checks only depend on the tile of a sample (and of the
+		sample moved by a fixed offset). Both coordinates of the samples are
+		monotonic in i, so the samples in one tile are consecutive and only
+		the first of them has to be checked. NextTile skips to the first
+		sample of the next tile, which gives exactly the same collision
+		points as the pixel stepping while visiting each tile once.
+
+		The pixel of a sample is round_to_int(x) like in the ray casts, or
+		(int)x like in GetMapIndices.
+*/
+class CLineSamples
+{
+	vec2 m_Pos0;
+	vec2 m_Pos1;
+	float m_Divisor;
+	int m_Last;
+	int m_OffsetX;
+	int m_OffsetY;
+	bool m_Truncate; // the pixel of a sample is (int)x instead of round_to_int(x)
+
+	static int TileCoord(int Pixel) { return Pixel / 32; }
+	int ToPixel(float Value) const { return m_Truncate ? (int)Value : round_to_int(Value); }
+
+	bool SameTile(int i, int j) const
+	{
+		vec2 PosI = Pos(i);
+		vec2 PosJ = Pos(j);
+		int ix = ToPixel(PosI.x), iy = ToPixel(PosI.y);
+		int jx = ToPixel(PosJ.x), jy = ToPixel(PosJ.y);
+		return TileCoord(ix) == TileCoord(jx) && TileCoord(iy) == TileCoord(jy)
+			&& TileCoord(ix + m_OffsetX) == TileCoord(jx + m_OffsetX)
+			&& TileCoord(iy + m_OffsetY) == TileCoord(jy + m_OffsetY);
+	}
+
+	// sample index at which the line crosses the border of the tile of
+	// the pixel along one axis
+	float CrossBorder(float Start, float Delta, int Pixel) const
+	{
+		if(Delta == 0)
+			return m_Last + 1;
+		int First = (int)floorf(Pixel / 32.0f) * 32;
+		float Rounding = m_Truncate ? 0.0f : 0.5f;
+		float Border = Delta > 0 ? First + 32 - Rounding : First - Rounding;
+		return (Border - Start) / Delta * m_Divisor;
+	}
+
+public:
+	CLineSamples(vec2 Pos0, vec2 Pos1, float Divisor, int Last, int OffsetX = 0, int OffsetY = 0, bool Truncate = false) :
+		m_Pos0(Pos0), m_Pos1(Pos1), m_Divisor(Divisor), m_Last(Last), m_OffsetX(OffsetX), m_OffsetY(OffsetY), m_Truncate(Truncate)
+	{
+	}
+
+	vec2 Pos(int i) const { return mix(m_Pos0, m_Pos1, i / m_Divisor); }
+	// the sample checked before the given one
+	vec2 Before(int i) const { return i ? Pos(i - 1) : m_Pos0; }
+
+	// first sample after i in another tile, Last + 1 if there is none
+	int NextTile(int i) const
+	{
+		vec2 Cur = Pos(i);
+		float Estimate = minimum(CrossBorder(m_Pos0.x, m_Pos1.x - m_Pos0.x, ToPixel(Cur.x)),
+			CrossBorder(m_Pos0.y, m_Pos1.y - m_Pos0.y, ToPixel(Cur.y)));
+		int Guess = m_Last + 1;
+		if(Estimate < Guess)
+			Guess = maximum((int)ceilf(Estimate), i + 1);
+
+		// the estimate is usually right, correct it where rounding or the
+		// offset tiles disagree
+		int Same = i; // last sample known to be in the tile
+		int Other = m_Last + 1; // first sample known to be in another tile
+		if(Guess <= m_Last && SameTile(i, Guess))
+		{
+			Same = Guess;
+			for(int Step = 1; Same + Step <= m_Last; Step *= 2)
+			{
+				if(!SameTile(i, Same + Step))
+				{
+					Other = Same + Step;
+					break;
+				}
+				Same += Step;
+			}
+		}
+		else
+		{
+			if(Guess - 1 == i || SameTile(i, Guess - 1))
+				return Guess;
+			Other = Guess - 1;
+		}
+		while(Other - Same > 1)
+		{
+			int Mid = Same + (Other - Same) / 2;
+			if(SameTile(i, Mid))
+				Same = Mid;
+			else
+				Other = Mid;
+		}
+		return Other;
+	}
+};
+
+static int NumSteps(float Distance)
+{
+	// number of iterations of for(float f = 0; f < Distance; f++)
+	return Distance > 0 ? (int)ceilf(Distance) : 0;
+}
+
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance+1);
-	vec2 Last = Pos0;
-	int ix = 0, iy = 0; // Temporary position for checking collision
-	for(int i = 0; i <= End; i++)
+	CLineSamples Line(Pos0, Pos1, End, End);
+	for(int i = 0; i <= End; i = Line.NextTile(i))
 	{
-		float a = i/(float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		ix = round_to_int(Pos.x);
-		iy = round_to_int(Pos.y);
+		vec2 Pos = Line.Pos(i);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
 
 		if(CheckPoint(ix, iy))
 		{
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Line.Before(i);
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -329,16 +441,14 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance+1);
-	vec2 Last = Pos0;
-	int ix = 0, iy = 0; // Temporary position for checking collision
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
+	CLineSamples Line(Pos0, Pos1, End, End, dx, dy);
+	for(int i = 0; i <= End; i = Line.NextTile(i))
 	{
-		float a = i/(float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		ix = round_to_int(Pos.x);
-		iy = round_to_int(Pos.y);
+		vec2 Pos = Line.Pos(i);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
 
 		int Index = GetPureMapIndex(Pos);
 		if (g_Config.m_SvOldTeleportHook)
@@ -350,7 +460,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Line.Before(i);
 			return TILE_TELEINHOOK;
 		}
 
@@ -369,11 +479,9 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Line.Before(i);
 			return hit;
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -386,14 +494,12 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance+1);
-	vec2 Last = Pos0;
-	int ix = 0, iy = 0; // Temporary position for checking collision
-	for(int i = 0; i <= End; i++)
+	CLineSamples Line(Pos0, Pos1, End, End);
+	for(int i = 0; i <= End; i = Line.NextTile(i))
 	{
-		float a = i/(float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		ix = round_to_int(Pos.x);
-		iy = round_to_int(Pos.y);
+		vec2 Pos = Line.Pos(i);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
 
 		int Index = GetPureMapIndex(Pos);
 		if (g_Config.m_SvOldTeleportWeapons)
@@ -405,7 +511,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Line.Before(i);
 			return TILE_TELEINWEAPON;
 		}
 
@@ -414,11 +520,9 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Line.Before(i);
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -546,6 +650,8 @@ void CCollision::Dest()
 		delete[] m_pDoor;
 	if(m_pSwitchers)
 		delete[] m_pSwitchers;
+	if(m_pTileFlags)
+		delete[] m_pTileFlags;
 	m_pTiles = 0;
 	m_Width = 0;
 	m_Height = 0;
@@ -557,34 +663,47 @@ void CCollision::Dest()
 	m_pTune = 0;
 	m_pDoor = 0;
 	m_pSwitchers = 0;
+	m_pTileFlags = 0;
+}
+
+int CCollision::GetColFlags(int x, int y)
+{
+	if(!m_pTileFlags)
+		return 0;
+
+	int Nx = clamp(x/32, 0, m_Width-1);
+	int Ny = clamp(y/32, 0, m_Height-1);
+	return m_pTileFlags[Ny * m_Width + Nx];
 }
 
 int CCollision::IsSolid(int x, int y)
 {
-	int index = GetTile(x,y);
-	return index == TILE_SOLID || index == TILE_NOHOOK;
+	return (GetColFlags(x, y)&COLFLAG_SOLID) != 0;
 }
 
 bool CCollision::IsThrough(int x, int y, int xoff, int yoff, vec2 pos0, vec2 pos1)
 {
 	int pos = GetPureMapIndex(x, y);
-	if(m_pFront && (m_pFront[pos].m_Index == TILE_THROUGH_ALL || m_pFront[pos].m_Index == TILE_THROUGH_CUT))
-		return true;
-	if(m_pFront && m_pFront[pos].m_Index == TILE_THROUGH_DIR && (
-		(m_pFront[pos].m_Flags == ROTATION_0   && pos0.y > pos1.y) ||
-		(m_pFront[pos].m_Flags == ROTATION_90  && pos0.x < pos1.x) ||
-		(m_pFront[pos].m_Flags == ROTATION_180 && pos0.y < pos1.y) ||
-		(m_pFront[pos].m_Flags == ROTATION_270 && pos0.x > pos1.x) ))
-		return true;
+	if(m_pTileFlags[pos]&COLFLAG_FRONT_THROUGH)
+	{
+		if(m_pFront[pos].m_Index == TILE_THROUGH_ALL || m_pFront[pos].m_Index == TILE_THROUGH_CUT)
+			return true;
+		if(m_pFront[pos].m_Index == TILE_THROUGH_DIR && (
+			(m_pFront[pos].m_Flags == ROTATION_0   && pos0.y > pos1.y) ||
+			(m_pFront[pos].m_Flags == ROTATION_90  && pos0.x < pos1.x) ||
+			(m_pFront[pos].m_Flags == ROTATION_180 && pos0.y < pos1.y) ||
+			(m_pFront[pos].m_Flags == ROTATION_270 && pos0.x > pos1.x) ))
+			return true;
+	}
 	int offpos = GetPureMapIndex(x+xoff, y+yoff);
-	if(m_pTiles[offpos].m_Index == TILE_THROUGH || (m_pFront && m_pFront[offpos].m_Index == TILE_THROUGH))
-		return true;
-	return false;
+	return (m_pTileFlags[offpos]&COLFLAG_THROUGH) != 0;
 }
 
 bool CCollision::IsHookBlocker(int x, int y, vec2 pos0, vec2 pos1)
 {
 	int pos = GetPureMapIndex(x, y);
+	if(!(m_pTileFlags[pos]&COLFLAG_HOOKBLOCKER))
+		return false;
 	if(m_pTiles[pos].m_Index == TILE_THROUGH_ALL || (m_pFront && m_pFront[pos].m_Index == TILE_THROUGH_ALL))
 		return true;
 	if(m_pTiles[pos].m_Index == TILE_THROUGH_DIR && (
@@ -612,12 +731,12 @@ int CCollision::IsWallJump(int Index)
 
 int CCollision::IsNoLaser(int x, int y)
 {
-	return (CCollision::GetTile(x,y) == TILE_NOLASER);
+	return (GetColFlags(x, y)&COLFLAG_NOLASER) != 0;
 }
 
 int CCollision::IsFNoLaser(int x, int y)
 {
-	return (CCollision::GetFTile(x,y) == TILE_NOLASER);
+	return (GetColFlags(x, y)&COLFLAG_FRONT_NOLASER) != 0;
 }
 
 int CCollision::IsTeleport(int Index)
@@ -625,7 +744,7 @@ int CCollision::IsTeleport(int Index)
 	if(Index < 0 || !m_pTele)
 		return 0;
 
-	if(m_pTele[Index].m_Type == TILE_TELEIN)
+	if((m_pTileFlags[Index]&COLFLAG_TELE) && m_pTele[Index].m_Type == TILE_TELEIN)
 		return m_pTele[Index].m_Number;
 
 	return 0;
@@ -638,7 +757,7 @@ int CCollision::IsEvilTeleport(int Index)
 	if(!m_pTele)
 		return 0;
 
-	if(m_pTele[Index].m_Type == TILE_TELEINEVIL)
+	if((m_pTileFlags[Index]&COLFLAG_TELE) && m_pTele[Index].m_Type == TILE_TELEINEVIL)
 		return m_pTele[Index].m_Number;
 
 	return 0;
@@ -651,7 +770,7 @@ int CCollision::IsCheckTeleport(int Index)
 	if(!m_pTele)
 		return 0;
 
-	if(m_pTele[Index].m_Type == TILE_TELECHECKIN)
+	if((m_pTileFlags[Index]&COLFLAG_TELE) && m_pTele[Index].m_Type == TILE_TELECHECKIN)
 		return m_pTele[Index].m_Number;
 
 	return 0;
@@ -664,7 +783,7 @@ int CCollision::IsCheckEvilTeleport(int Index)
 	if(!m_pTele)
 		return 0;
 
-	if(m_pTele[Index].m_Type == TILE_TELECHECKINEVIL)
+	if((m_pTileFlags[Index]&COLFLAG_TELE) && m_pTele[Index].m_Type == TILE_TELECHECKINEVIL)
 		return m_pTele[Index].m_Number;
 
 	return 0;
@@ -678,7 +797,7 @@ int CCollision::IsTCheckpoint(int Index)
 	if(!m_pTele)
 		return 0;
 
-	if(m_pTele[Index].m_Type == TILE_TELECHECK)
+	if((m_pTileFlags[Index]&COLFLAG_TELE) && m_pTele[Index].m_Type == TILE_TELECHECK)
 		return m_pTele[Index].m_Number;
 
 	return 0;
@@ -689,7 +808,7 @@ int CCollision::IsTeleportWeapon(int Index)
 	if(Index < 0 || !m_pTele)
 		return 0;
 
-	if(m_pTele[Index].m_Type == TILE_TELEINWEAPON)
+	if((m_pTileFlags[Index]&COLFLAG_TELE) && m_pTele[Index].m_Type == TILE_TELEINWEAPON)
 		return m_pTele[Index].m_Number;
 
 	return 0;
@@ -700,7 +819,7 @@ int CCollision::IsTeleportHook(int Index)
 	if(Index < 0 || !m_pTele)
 		return 0;
 
-	if(m_pTele[Index].m_Type == TILE_TELEINHOOK)
+	if((m_pTileFlags[Index]&COLFLAG_TELE) && m_pTele[Index].m_Type == TILE_TELEINHOOK)
 		return m_pTele[Index].m_Number;
 
 	return 0;
@@ -712,7 +831,7 @@ int CCollision::IsSpeedup(int Index)
 	if(Index < 0 || !m_pSpeedup)
 		return 0;
 
-	if(m_pSpeedup[Index].m_Force > 0)
+	if(m_pTileFlags[Index]&COLFLAG_SPEEDUP)
 		return Index;
 
 	return 0;
@@ -745,7 +864,7 @@ int CCollision::IsSwitch(int Index)
 	if(Index < 0 || !m_pSwitch)
 		return 0;
 
-	if(m_pSwitch[Index].m_Type > 0)
+	if(m_pTileFlags[Index]&COLFLAG_SWITCH)
 		return m_pSwitch[Index].m_Type;
 
 	return 0;
@@ -828,6 +947,59 @@ int CCollision::GetPureMapIndex(float x, float y)
 }
 
 bool CCollision::TileExists(int Index)
+{
+	if(Index < 0)
+		return false;
+	return m_pTileFlags[Index] & COLFLAG_SPECIAL;
+}
+
+static bool IsStopper(int Tile)
+{
+	return Tile == TILE_STOP || Tile == TILE_STOPS || Tile == TILE_STOPA;
+}
+
+void CCollision::UpdateTileFlags(int Index)
+{
+	int Tile = m_pTiles[Index].m_Index;
+	int Front = m_pFront ? m_pFront[Index].m_Index : 0;
+	int Flags = 0;
+	if(Tile == TILE_SOLID || Tile == TILE_NOHOOK)
+		Flags |= COLFLAG_SOLID;
+	if(Tile == TILE_NOHOOK)
+		Flags |= COLFLAG_NOHOOK;
+	if(Tile == TILE_NOLASER)
+		Flags |= COLFLAG_NOLASER;
+	if(Front == TILE_NOLASER)
+		Flags |= COLFLAG_FRONT_NOLASER;
+	if(Front == TILE_THROUGH_ALL || Front == TILE_THROUGH_CUT || Front == TILE_THROUGH_DIR)
+		Flags |= COLFLAG_FRONT_THROUGH;
+	if(Tile == TILE_THROUGH || Front == TILE_THROUGH)
+		Flags |= COLFLAG_THROUGH;
+	if(Tile == TILE_THROUGH_ALL || Tile == TILE_THROUGH_DIR || Front == TILE_THROUGH_ALL || Front == TILE_THROUGH_DIR)
+		Flags |= COLFLAG_HOOKBLOCKER;
+	if(IsStopper(Tile) || IsStopper(Front))
+		Flags |= COLFLAG_STOPPER;
+	if(CheckTileExists(Index))
+		Flags |= COLFLAG_SPECIAL;
+	if(m_pTele && m_pTele[Index].m_Type)
+		Flags |= COLFLAG_TELE;
+	if(m_pSpeedup && m_pSpeedup[Index].m_Force > 0)
+		Flags |= COLFLAG_SPEEDUP;
+	if(m_pSwitch && m_pSwitch[Index].m_Type > 0)
+		Flags |= COLFLAG_SWITCH;
+	m_pTileFlags[Index] = Flags;
+}
+
+void CCollision::UpdateTileFlagsAround(int Index)
+{
+	// TileExistsNext looks at the direct neighbours
+	int aIndices[5] = {Index, Index - 1, Index + 1, Index - m_Width, Index + m_Width};
+	for(int i = 0; i < 5; i++)
+		if(aIndices[i] >= 0 && aIndices[i] < m_Width * m_Height)
+			UpdateTileFlags(aIndices[i]);
+}
+
+bool CCollision::CheckTileExists(int Index)
 {
 	if(Index < 0)
 		return false;
@@ -903,50 +1075,53 @@ int CCollision::GetMapIndex(vec2 Pos)
 		return -1;
 }
 
-std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices)
+int CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices, int *pCursor)
 {
-	std::list< int > Indices;
+	int Num = 0;
 	float d = distance(PrevPos, Pos);
-	int End(d + 1);
 	if(!d)
 	{
 		int Nx = clamp((int)Pos.x / 32, 0, m_Width - 1);
 		int Ny = clamp((int)Pos.y / 32, 0, m_Height - 1);
 		int Index = Ny * m_Width + Nx;
 
-		if(TileExists(Index))
-		{
-			Indices.push_back(Index);
-			return Indices;
-		}
-		else
-			return Indices;
+		if(*pCursor == 0 && MaxIndices > 0 && TileExists(Index))
+			pIndices[Num++] = Index;
+		*pCursor = -1;
+		return Num;
 	}
-	else
+	if(*pCursor < 0)
+		return 0;
+
+	int End(d + 1);
+	CLineSamples Line(PrevPos, Pos, d, End - 1, 0, 0, true);
+	int LastIndex = 0;
+	if(*pCursor > 0)
 	{
-		float a = 0.0f;
-		vec2 Tmp = vec2(0, 0);
-		int Nx = 0;
-		int Ny = 0;
-		int Index,LastIndex = 0;
-		for(int i = 0; i < End; i++)
+		// the tile before the cursor is different from the one at the
+		// cursor, which wasn't returned yet
+		vec2 Tmp = Line.Pos(*pCursor - 1);
+		LastIndex = clamp((int)Tmp.y / 32, 0, m_Height - 1) * m_Width + clamp((int)Tmp.x / 32, 0, m_Width - 1);
+	}
+	for(int i = *pCursor; i < End; i = Line.NextTile(i))
+	{
+		vec2 Tmp = Line.Pos(i);
+		int Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
+		int Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
+		int Index = Ny * m_Width + Nx;
+		if(TileExists(Index) && LastIndex != Index)
 		{
-			a = i/d;
-			Tmp = mix(PrevPos, Pos, a);
-			Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
-			Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
-			Index = Ny * m_Width + Nx;
-			if(TileExists(Index) && LastIndex != Index)
+			if(Num == MaxIndices)
 			{
-				if(MaxIndices && Indices.size() > MaxIndices)
-					return Indices;
-				Indices.push_back(Index);
-				LastIndex = Index;
+				*pCursor = i;
+				return Num;
 			}
+			pIndices[Num++] = Index;
+			LastIndex = Index;
 		}
-
-		return Indices;
 	}
+	*pCursor = -1;
+	return Num;
 }
 
 vec2 CCollision::GetPos(int Index)
@@ -1105,6 +1280,7 @@ void CCollision::SetCollisionAt(float x, float y, int id)
 	int Ny = clamp(round_to_int(y)/32, 0, m_Height-1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = id;
+	UpdateTileFlagsAround(Ny * m_Width + Nx);
 }
 
 void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1117,6 +1293,7 @@ void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Numb
 	m_pDoor[Ny * m_Width + Nx].m_Index = Type;
 	m_pDoor[Ny * m_Width + Nx].m_Flags = Flags;
 	m_pDoor[Ny * m_Width + Nx].m_Number = Number;
+	UpdateTileFlagsAround(Ny * m_Width + Nx);
 }
 
 int CCollision::GetDTileIndex(int Index)
@@ -1176,12 +1353,12 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *Ox, int *Oy)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
+	int Num = NumSteps(d);
+	CLineSamples Line(Pos0, Pos1, d, Num - 1);
 
-	for(float f = 0; f < d; f++)
+	for(int i = 0; i < Num; i = Line.NextTile(i))
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Line.Pos(i);
 		int Nx = clamp(round_to_int(Pos.x)/32, 0, m_Width-1);
 		int Ny = clamp(round_to_int(Pos.y)/32, 0, m_Height-1);
 		if(GetIndex(Nx, Ny) == TILE_SOLID
@@ -1192,12 +1369,11 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Line.Before(i);
 			if (GetFIndex(Nx, Ny) == TILE_NOLASER)	return GetFCollisionAt(Pos.x, Pos.y);
 			else return GetCollisionAt(Pos.x, Pos.y);
 
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1209,22 +1385,21 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
+	int Num = NumSteps(d);
+	CLineSamples Line(Pos0, Pos1, d, Num - 1);
 
-	for(float f = 0; f < d; f++)
+	for(int i = 0; i < Num; i = Line.NextTile(i))
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Line.Pos(i);
 		if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || IsFNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
 		{
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Line.Before(i);
 			if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y))) return GetCollisionAt(Pos.x, Pos.y);
 			else return  GetFCollisionAt(Pos.x, Pos.y);
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1236,25 +1411,24 @@ int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, ve
 int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
+	int Num = NumSteps(d);
+	CLineSamples Line(Pos0, Pos1, d, Num - 1);
 
-	for(float f = 0; f < d; f++)
+	for(int i = 0; i < Num; i = Line.NextTile(i))
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Line.Pos(i);
 		if(IsSolid(round_to_int(Pos.x), round_to_int(Pos.y)) || (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y))))
 		{
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Line.Before(i);
 			if(!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y)))
 				return -1;
 			else
 				if (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y))) return GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
 				else return GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
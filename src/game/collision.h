@@ -6,8 +6,6 @@
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
-#include <list>
-
 enum
 {
 	CANTMOVE_LEFT=1<<0,
@@ -71,7 +69,22 @@ public:
 	int Entity(int x, int y, int Layer);
 	int GetPureMapIndex(float x, float y);
 	int GetPureMapIndex(vec2 Pos) { return GetPureMapIndex(Pos.x, Pos.y); }
-	std::list<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0);
+	/*
+		Function: GetMapIndices
+			Finds the tiles with special behaviour that the line from
+			PrevPos to Pos touches, in order.
+
+		Arguments:
+			pIndices - Gets the map indices.
+			MaxIndices - Size of the buffer, at least one.
+			pCursor - Has to be 0 on the first call. Another call with
+				the same cursor continues where a full buffer stopped,
+				it is -1 once the end of the line is reached.
+
+		Returns:
+			The number of indices written.
+	*/
+	int GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices, int *pCursor);
 	int GetMapIndex(vec2 Pos);
 	bool TileExists(int Index);
 	bool TileExistsNext(int Index);
@@ -122,6 +135,29 @@ private:
 	class CSwitchTile *m_pSwitch;
 	class CTuneTile *m_pTune;
 	class CDoorTile *m_pDoor;
+
+	// per tile summary of the layers, so the hot checks only have to read
+	// the layers of the few tiles where something is
+	enum
+	{
+		COLFLAG_SOLID=1<<0, // TILE_SOLID or TILE_NOHOOK
+		COLFLAG_NOHOOK=1<<1,
+		COLFLAG_NOLASER=1<<2,
+		COLFLAG_FRONT_NOLASER=1<<3,
+		COLFLAG_FRONT_THROUGH=1<<4, // TILE_THROUGH_ALL, _CUT or _DIR in the front layer
+		COLFLAG_THROUGH=1<<5, // TILE_THROUGH in the game or front layer
+		COLFLAG_HOOKBLOCKER=1<<6, // TILE_THROUGH_ALL or _DIR in the game or front layer
+		COLFLAG_STOPPER=1<<7, // a stopper in the game or front layer
+		COLFLAG_SPECIAL=1<<8, // TileExists
+		COLFLAG_TELE=1<<9,
+		COLFLAG_SPEEDUP=1<<10,
+		COLFLAG_SWITCH=1<<11,
+	};
+	unsigned short *m_pTileFlags;
+	int GetColFlags(int x, int y);
+	bool CheckTileExists(int Index);
+	void UpdateTileFlags(int Index);
+	void UpdateTileFlagsAround(int Index);
 	struct SSwitchers
 	{
 		bool m_Status[MAX_CLIENTS];
@@ -0,0 +1,205 @@
+#ifndef GAME_ENTITYGRID_H
+#define GAME_ENTITYGRID_H
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <algorithm>
+
+/*
+	Class: Entity Grid
+		Uniform grid over the positions of the entities of one type, used
+		as broadphase for the range and line queries of the game world.
+		The cells are hashed into a fixed number of buckets, so the grid
+		doesn't depend on the map size.
+
+		The entity needs a public or friended member
+		"CEntityGrid<T>::CNode m_GridNode" next to m_Pos and
+		m_ProximityRadius. Every write of m_Pos has to be followed by
+		Update, the results are written to a buffer of the caller, so
+		queries can be nested.
+*/
+template<class T>
+class CEntityGrid
+{
+public:
+	enum
+	{
+		CELL_SHIFT=8, // 256 units or 8 tiles
+		NUM_BUCKETS=1024,
+		MAX_CELL=1<<20,
+	};
+
+	class CNode
+	{
+	public:
+		T *m_pPrev;
+		T *m_pNext;
+		int m_CellX;
+		int m_CellY;
+		int m_Bucket; // -1 if not in the grid
+		int m_Order; // position in the entity list
+	};
+
+private:
+	T *m_apBuckets[NUM_BUCKETS];
+	int m_Num;
+	int m_FirstOrder;
+	int m_LastOrder;
+	float m_MaxRadius;
+
+	static int Cell(float Value)
+	{
+		float Cell = Value / (1 << CELL_SHIFT);
+		// also catches NaN
+		if(!(Cell > -MAX_CELL))
+			return -MAX_CELL;
+		if(!(Cell < MAX_CELL))
+			return MAX_CELL;
+		return (int)floorf(Cell);
+	}
+
+	static int Bucket(int X, int Y)
+	{
+		return (int)(((unsigned)X * 73856093u ^ (unsigned)Y * 19349663u) & (NUM_BUCKETS - 1));
+	}
+
+	void Link(T *pEnt)
+	{
+		CNode *pNode = &pEnt->m_GridNode;
+		pNode->m_CellX = Cell(pEnt->m_Pos.x);
+		pNode->m_CellY = Cell(pEnt->m_Pos.y);
+		pNode->m_Bucket = Bucket(pNode->m_CellX, pNode->m_CellY);
+		pNode->m_pPrev = 0;
+		pNode->m_pNext = m_apBuckets[pNode->m_Bucket];
+		if(pNode->m_pNext)
+			pNode->m_pNext->m_GridNode.m_pPrev = pEnt;
+		m_apBuckets[pNode->m_Bucket] = pEnt;
+		if(pEnt->m_ProximityRadius > m_MaxRadius)
+			m_MaxRadius = pEnt->m_ProximityRadius;
+	}
+
+	void Unlink(T *pEnt)
+	{
+		CNode *pNode = &pEnt->m_GridNode;
+		if(pNode->m_pPrev)
+			pNode->m_pPrev->m_GridNode.m_pNext = pNode->m_pNext;
+		else
+			m_apBuckets[pNode->m_Bucket] = pNode->m_pNext;
+		if(pNode->m_pNext)
+			pNode->m_pNext->m_GridNode.m_pPrev = pNode->m_pPrev;
+		pNode->m_pPrev = 0;
+		pNode->m_pNext = 0;
+		pNode->m_Bucket = -1;
+	}
+
+	static bool CompareOrder(const T *pA, const T *pB)
+	{
+		return pA->m_GridNode.m_Order < pB->m_GridNode.m_Order;
+	}
+
+public:
+	CEntityGrid() { Clear(); }
+
+	void Clear()
+	{
+		mem_zero(m_apBuckets, sizeof(m_apBuckets));
+		m_Num = 0;
+		m_FirstOrder = 0;
+		m_LastOrder = 0;
+		m_MaxRadius = 0.0f;
+	}
+
+	int Num() const { return m_Num; }
+
+	// Last has to match where the entity is put into the entity list
+	void Insert(T *pEnt, bool Last)
+	{
+		pEnt->m_GridNode.m_Order = Last ? ++m_LastOrder : --m_FirstOrder;
+		Link(pEnt);
+		m_Num++;
+	}
+
+	void Remove(T *pEnt)
+	{
+		if(pEnt->m_GridNode.m_Bucket < 0)
+			return;
+		Unlink(pEnt);
+		m_Num--;
+	}
+
+	// has to be called whenever the position of the entity is written
+	void Update(T *pEnt)
+	{
+		CNode *pNode = &pEnt->m_GridNode;
+		if(pNode->m_Bucket < 0)
+			return;
+		if(pNode->m_CellX != Cell(pEnt->m_Pos.x) || pNode->m_CellY != Cell(pEnt->m_Pos.y) || pEnt->m_ProximityRadius > m_MaxRadius)
+		{
+			Unlink(pEnt);
+			Link(pEnt);
+		}
+	}
+
+	// whether the entity is in the cell of its position
+	bool InCell(const T *pEnt) const
+	{
+		const CNode *pNode = &pEnt->m_GridNode;
+		return pNode->m_Bucket < 0 || (pNode->m_CellX == Cell(pEnt->m_Pos.x) && pNode->m_CellY == Cell(pEnt->m_Pos.y));
+	}
+
+	// asserts that no entity moved without an update, only in debug builds
+	void CheckCells() const
+	{
+#ifdef CONF_DEBUG
+		for(int i = 0; i < NUM_BUCKETS; i++)
+			for(T *pEnt = m_apBuckets[i]; pEnt; pEnt = pEnt->m_GridNode.m_pNext)
+				dbg_assert(InCell(pEnt), "entity moved without updating the grid");
+#endif
+	}
+
+	/*
+		Function: Query
+			Finds the entities whose proximity circle might overlap the
+			given box, in the order of the entity list.
+
+		Arguments:
+			Min, Max - The box.
+			ppResult - Gets the candidates.
+			MaxResults - Size of ppResult, further candidates are dropped.
+
+		Returns:
+			The number of candidates.
+	*/
+	int Query(vec2 Min, vec2 Max, T **ppResult, int MaxResults) const
+	{
+		int MinX = Cell(Min.x - m_MaxRadius);
+		int MinY = Cell(Min.y - m_MaxRadius);
+		int MaxX = Cell(Max.x + m_MaxRadius);
+		int MaxY = Cell(Max.y + m_MaxRadius);
+
+		int Num = 0;
+		if((int64)(MaxX - MinX + 1) * (MaxY - MinY + 1) > NUM_BUCKETS)
+		{
+			// more cells than buckets, every bucket is only visited once
+			for(int i = 0; i < NUM_BUCKETS; i++)
+				for(T *pEnt = m_apBuckets[i]; pEnt && Num < MaxResults; pEnt = pEnt->m_GridNode.m_pNext)
+					if(pEnt->m_GridNode.m_CellX >= MinX && pEnt->m_GridNode.m_CellX <= MaxX && pEnt->m_GridNode.m_CellY >= MinY && pEnt->m_GridNode.m_CellY <= MaxY)
+						ppResult[Num++] = pEnt;
+		}
+		else
+		{
+			for(int y = MinY; y <= MaxY; y++)
+				for(int x = MinX; x <= MaxX; x++)
+					for(T *pEnt = m_apBuckets[Bucket(x, y)]; pEnt && Num < MaxResults; pEnt = pEnt->m_GridNode.m_pNext)
+						if(pEnt->m_GridNode.m_CellX == x && pEnt->m_GridNode.m_CellY == y)
+							ppResult[Num++] = pEnt;
+		}
+
+		std::sort(ppResult, ppResult + Num, CompareOrder);
+		return Num;
+	}
+};
+
+#endif
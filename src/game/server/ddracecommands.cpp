@@ -266,7 +266,7 @@ void CGameContext::ConToTeleporter(IConsole::IResult *pResult, void *pUserData)
 		if (pChr)
 		{
 			pChr->Core()->m_Pos = TelePos;
-			pChr->m_Pos = TelePos;
+			pChr->SetPos(TelePos);
 			pChr->m_PrevPos = TelePos;
 			pChr->m_DDRaceState = DDRACE_CHEAT;
 		}
@@ -286,7 +286,7 @@ void CGameContext::ConToCheckTeleporter(IConsole::IResult *pResult, void *pUserD
 		if (pChr)
 		{
 			pChr->Core()->m_Pos = TelePos;
-			pChr->m_Pos = TelePos;
+			pChr->SetPos(TelePos);
 			pChr->m_PrevPos = TelePos;
 			pChr->m_DDRaceState = DDRACE_CHEAT;
 			pChr->m_TeleCheckpoint = TeleTo;
@@ -304,7 +304,7 @@ void CGameContext::ConTeleport(IConsole::IResult *pResult, void *pUserData)
 	if(pChr && pSelf->GetPlayerChar(TeleTo))
 	{
 		pChr->Core()->m_Pos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
-		pChr->m_Pos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
+		pChr->SetPos(pSelf->m_apPlayers[TeleTo]->m_ViewPos);
 		pChr->m_PrevPos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
 		pChr->m_DDRaceState = DDRACE_CHEAT;
 	}
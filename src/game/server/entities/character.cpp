@@ -748,7 +748,20 @@ void CCharacter::Tick()
 	return;
 }
 
+void CCharacter::SetPos(vec2 Pos)
+{
+	m_Pos = Pos;
+	GameWorld()->UpdateGrid(this);
+}
+
 void CCharacter::TickDefered()
+{
+	AdvanceReckoningCore();
+	MoveCore();
+	FinishTickDefered();
+}
+
+void CCharacter::AdvanceReckoningCore()
 {
 	// advance the dummy
 	{
@@ -759,18 +772,32 @@ void CCharacter::TickDefered()
 		m_ReckoningCore.Move();
 		m_ReckoningCore.Quantize();
 	}
+}
 
+void CCharacter::MoveCore()
+{
 	//lastsentcore
-	vec2 StartPos = m_Core.m_Pos;
-	vec2 StartVel = m_Core.m_Vel;
-	bool StuckBefore = GameServer()->Collision()->TestBox(m_Core.m_Pos, vec2(28.0f, 28.0f));
+	m_MoveStartPos = m_Core.m_Pos;
+	m_MoveStartVel = m_Core.m_Vel;
+	m_StuckBeforeMove = GameServer()->Collision()->TestBox(m_Core.m_Pos, vec2(28.0f, 28.0f));
 
 	m_Core.m_Id = m_pPlayer->GetCID();
 	m_Core.Move();
-	bool StuckAfterMove = GameServer()->Collision()->TestBox(m_Core.m_Pos, vec2(28.0f, 28.0f));
+	m_StuckAfterMove = GameServer()->Collision()->TestBox(m_Core.m_Pos, vec2(28.0f, 28.0f));
 	m_Core.Quantize();
-	bool StuckAfterQuant = GameServer()->Collision()->TestBox(m_Core.m_Pos, vec2(28.0f, 28.0f));
-	m_Pos = m_Core.m_Pos;
+	m_StuckAfterQuant = GameServer()->Collision()->TestBox(m_Core.m_Pos, vec2(28.0f, 28.0f));
+}
+
+void CCharacter::FinishTickDefered()
+{
+	// not in MoveCore, the grid is shared by all teams
+	SetPos(m_Core.m_Pos);
+
+	vec2 StartPos = m_MoveStartPos;
+	vec2 StartVel = m_MoveStartVel;
+	bool StuckBefore = m_StuckBeforeMove;
+	bool StuckAfterMove = m_StuckAfterMove;
+	bool StuckAfterQuant = m_StuckAfterQuant;
 
 	if(!StuckBefore && (StuckAfterMove || StuckAfterQuant))
 	{
@@ -810,8 +837,7 @@ void CCharacter::TickDefered()
 
 	if(m_pPlayer->GetTeam() == TEAM_SPECTATORS)
 	{
-		m_Pos.x = m_Input.m_TargetX;
-		m_Pos.y = m_Input.m_TargetY;
+		SetPos(vec2(m_Input.m_TargetX, m_Input.m_TargetY));
 	}
 
 	// update the m_SendCore if needed
@@ -1674,7 +1700,7 @@ void CCharacter::HandleTiles(int Index)
 	}
 
 	// stopper
-	if(m_Core.m_Vel > 0 && (m_MoveRestrictions&CANTMOVE_DOWN))
+	if(m_Core.m_Vel.y > 0 && (m_MoveRestrictions&CANTMOVE_DOWN))
 	{
 		m_Core.m_Jumped = 0;
 		m_Core.m_JumpedTotal = 0;
@@ -2121,17 +2147,23 @@ void CCharacter::DDRacePostCoreTick()
 		return;
 
 	// handle Anti-Skip tiles
-	std::list < int > Indices = GameServer()->Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!Indices.empty())
-	{
-		for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
+	vec2 PrevPos = m_PrevPos;
+	vec2 Pos = m_Pos;
+	int aIndices[16];
+	int Cursor = 0;
+	int Found = 0;
+	while(Cursor >= 0)
+	{
+		int Num = GameServer()->Collision()->GetMapIndices(PrevPos, Pos, aIndices, 16, &Cursor);
+		for(int i = 0; i < Num; i++)
 		{
-			HandleTiles(*i);
+			HandleTiles(aIndices[i]);
 			if(!m_Alive)
 				return;
 		}
+		Found += Num;
 	}
-	else
+	if(!Found)
 	{
 		HandleTiles(CurrentIndex);
 		if(!m_Alive)
@@ -2312,7 +2344,7 @@ void CCharacter::Rescue()
 		if (GameServer()->Collision()->GetTileIndex(index) == TILE_FREEZE || GameServer()->Collision()->GetFTileIndex(index) == TILE_FREEZE) {
 			m_LastRescue = Server()->Tick();
 			m_Core.m_Pos = m_PrevSavePos;
-			m_Pos = m_PrevSavePos;
+			SetPos(m_PrevSavePos);
 			m_PrevPos = m_PrevSavePos;
 			m_Core.m_Vel = vec2(0, 0);
 			m_Core.m_HookedPlayer = -1;
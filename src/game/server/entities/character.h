@@ -46,10 +46,21 @@ public:
 	virtual void Tick();
 	virtual void TickDefered();
 	virtual void TickPaused();
+
+	// the parts of TickDefered, the world runs MoveCore of independent
+	// teams in parallel, it must not touch anything outside of the team
+	void AdvanceReckoningCore();
+	void MoveCore();
+	void FinishTickDefered();
+
 	virtual void Snap(int SnappingClient);
 	virtual int NetworkClipped(int SnappingClient);
 	virtual int NetworkClipped(int SnappingClient, vec2 CheckPos);
 
+	// every move of the character has to go through here, it keeps the
+	// grid of the world in sync
+	void SetPos(vec2 Pos);
+
 	bool IsGrounded();
 
 	void SetWeapon(int W);
@@ -157,6 +168,13 @@ private:
 	CCharacterCore m_SendCore; // core that we should send
 	CCharacterCore m_ReckoningCore; // the dead reckoning core
 
+	// state of MoveCore for FinishTickDefered
+	vec2 m_MoveStartPos;
+	vec2 m_MoveStartVel;
+	bool m_StuckBeforeMove;
+	bool m_StuckAfterMove;
+	bool m_StuckAfterQuant;
+
 	// DDRace
 
 	static bool IsSwitchActiveCb(int Number, void *pUser);
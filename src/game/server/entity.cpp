@@ -20,6 +20,7 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType)
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+	m_GridNode.m_Bucket = -1;
 }
 
 CEntity::~CEntity()
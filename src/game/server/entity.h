@@ -66,8 +66,10 @@ class CEntity
 	MACRO_ALLOC_HEAP()
 
 	friend class CGameWorld;	// entity list handling
+	friend class CEntityGrid<CEntity>;
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CEntityGrid<CEntity>::CNode m_GridNode;
 
 protected:
 	class CGameWorld *m_pGameWorld;
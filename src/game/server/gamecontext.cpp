@@ -56,6 +56,7 @@ void CGameContext::Construct(int Resetting)
 	m_ChatResponseTargetID = -1;
 	m_aDeleteTempfile[0] = 0;
 	m_TeeHistorianActive = false;
+	mem_zero(m_aTickCharacters, sizeof(m_aTickCharacters));
 
 	m_pRandomMapResult = nullptr;
 	m_pMapVoteResult = nullptr;
@@ -629,15 +630,22 @@ void CGameContext::OnTick()
 	//if(world.paused) // make sure that the game object always updates
 	m_pController->Tick();
 
+	// the characters after the world tick, before the players spawn or kill
+	// them
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_aTickCharacters[i].m_Alive = m_apPlayers[i] && m_apPlayers[i]->GetCharacter();
+		if(m_aTickCharacters[i].m_Alive)
+			m_apPlayers[i]->GetCharacter()->GetCore().Write(&m_aTickCharacters[i].m_Core);
+	}
+
 	if(m_TeeHistorianActive)
 	{
 		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
-			if(m_apPlayers[i] && m_apPlayers[i]->GetCharacter())
+			if(m_aTickCharacters[i].m_Alive)
 			{
-				CNetObj_CharacterCore Char;
-				m_apPlayers[i]->GetCharacter()->GetCore().Write(&Char);
-				m_TeeHistorian.RecordPlayer(i, &Char);
+				m_TeeHistorian.RecordPlayer(i, &m_aTickCharacters[i].m_Core);
 			}
 			else
 			{
@@ -896,6 +904,8 @@ void CGameContext::OnTick()
 		m_pMapVoteResult = NULL;
 	}
 
+	Score()->OnTick();
+
 #ifdef CONF_DEBUG
 	if(g_Config.m_DbgDummies)
 	{
@@ -2489,6 +2499,14 @@ void CGameContext::ConClearVotes(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+#if defined(CONF_SQL)
+void CGameContext::ConDumpSqlQueue(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	CSqlScore::WorkerPool()->Dump(pSelf->Console());
+}
+#endif
+
 void CGameContext::ConVote(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
@@ -2548,6 +2566,9 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("force_vote", "s[name] s[command] ?r[reason]", CFGFLAG_SERVER, ConForceVote, this, "Force a voting option");
 	Console()->Register("clear_votes", "", CFGFLAG_SERVER, ConClearVotes, this, "Clears the voting options");
 	Console()->Register("vote", "r['yes'|'no']", CFGFLAG_SERVER, ConVote, this, "Force a vote to yes/no");
+#if defined(CONF_SQL)
+	Console()->Register("dump_sql_queue", "", CFGFLAG_SERVER, ConDumpSqlQueue, this, "Shows the queue of the sql workers");
+#endif
 
 	Console()->Chain("sv_motd", ConchainSpecialMotdupdate, this);
 
@@ -3090,6 +3111,14 @@ bool CGameContext::IsClientPlayer(int ClientID)
 	return m_apPlayers[ClientID] && m_apPlayers[ClientID]->GetTeam() == TEAM_SPECTATORS ? false : true;
 }
 
+bool CGameContext::GetTickCharacter(int ClientID, CNetObj_CharacterCore *pCore)
+{
+	if(!m_aTickCharacters[ClientID].m_Alive)
+		return false;
+	*pCore = m_aTickCharacters[ClientID].m_Core;
+	return true;
+}
+
 CUuid CGameContext::GameUuid() { return m_GameUuid; }
 const char *CGameContext::GameType() { return m_pController && m_pController->m_pGameType ? m_pController->m_pGameType : ""; }
 const char *CGameContext::Version() { return GAME_VERSION; }
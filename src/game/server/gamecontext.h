@@ -74,6 +74,13 @@ class CGameContext : public IGameServer
 	bool m_TeeHistorianActive;
 	CTeeHistorian m_TeeHistorian;
 	ASYNCIO *m_pTeeHistorianFile;
+
+	struct CTickCharacter
+	{
+		bool m_Alive;
+		CNetObj_CharacterCore m_Core;
+	};
+	CTickCharacter m_aTickCharacters[MAX_CLIENTS];
 	CUuid m_GameUuid;
 	CMapBugs m_MapBugs;
 
@@ -111,6 +118,9 @@ class CGameContext : public IGameServer
 	static void ConClearVotes(IConsole::IResult *pResult, void *pUserData);
 	static void ConVote(IConsole::IResult *pResult, void *pUserData);
 	static void ConVoteNo(IConsole::IResult *pResult, void *pUserData);
+#if defined(CONF_SQL)
+	static void ConDumpSqlQueue(IConsole::IResult *pResult, void *pUserData);
+#endif
 	static void ConchainSpecialMotdupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
 	CGameContext(int Resetting);
@@ -239,6 +249,7 @@ public:
 
 	virtual bool IsClientReady(int ClientID);
 	virtual bool IsClientPlayer(int ClientID);
+	virtual bool GetTickCharacter(int ClientID, CNetObj_CharacterCore *pCore);
 
 	virtual CUuid GameUuid();
 	virtual const char *GameType();
@@ -4,6 +4,9 @@
 #include "gameworld.h"
 #include "entity.h"
 #include "gamecontext.h"
+#include "teams.h"
+#include "entities/character.h"
+#include "gamemodes/DDRace.h"
 #include <algorithm>
 #include <utility>
 #include <engine/shared/config.h>
@@ -20,6 +23,8 @@ CGameWorld::CGameWorld()
 	m_ResetRequested = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		m_apFirstEntityTypes[i] = 0;
+	m_NumTeamThreads = 0;
+	sphore_init(&m_TeamJobsDone);
 }
 
 CGameWorld::~CGameWorld()
@@ -28,12 +33,19 @@ CGameWorld::~CGameWorld()
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		while(m_apFirstEntityTypes[i])
 			delete m_apFirstEntityTypes[i];
+	sphore_destroy(&m_TeamJobsDone);
 }
 
 void CGameWorld::SetGameServer(CGameContext *pGameServer)
 {
 	m_pGameServer = pGameServer;
 	m_pServer = m_pGameServer->Server();
+
+	if(g_Config.m_SvTeamThreads > 0 && !m_NumTeamThreads)
+	{
+		m_NumTeamThreads = g_Config.m_SvTeamThreads;
+		m_TeamJobPool.Init(m_NumTeamThreads);
+	}
 }
 
 CEntity *CGameWorld::FindFirst(int Type)
@@ -47,6 +59,25 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 		return 0;
 
 	int Num = 0;
+	if(Type == ENTTYPE_CHARACTER)
+	{
+		CEntity *apCandidates[MAX_CLIENTS];
+		int NumCandidates = m_CharacterGrid.Query(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), apCandidates, MAX_CLIENTS);
+		for(int i = 0; i < NumCandidates; i++)
+		{
+			CEntity *pEnt = apCandidates[i];
+			if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
+			{
+				if(ppEnts)
+					ppEnts[Num] = pEnt;
+				Num++;
+				if(Num == Max)
+					break;
+			}
+		}
+		return Num;
+	}
+
 	for(CEntity *pEnt = m_apFirstEntityTypes[Type];	pEnt; pEnt = pEnt->m_pNextTypeEntity)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
@@ -75,6 +106,9 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+		m_CharacterGrid.Insert(pEnt, false);
 }
 
 void CGameWorld::DestroyEntity(CEntity *pEnt)
@@ -102,6 +136,15 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+		m_CharacterGrid.Remove(pEnt);
+}
+
+void CGameWorld::UpdateGrid(CEntity *pEnt)
+{
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+		m_CharacterGrid.Update(pEnt);
 }
 
 //
@@ -150,93 +193,126 @@ void CGameWorld::RemoveEntities()
 		}
 }
 
-bool distCompare(std::pair<float,int> a, std::pair<float,int> b)
-{
-	return (a.first < b.first);
-}
-
 void CGameWorld::UpdatePlayerMaps()
 {
 	if (Server()->Tick() % g_Config.m_SvMapUpdateRate != 0) return;
 
-	std::pair<float,int> Dist[MAX_CLIENTS];
+	CPlayerMaps::CClient aClients[MAX_CLIENTS];
 	for (int i = 0; i < MAX_CLIENTS; i++)
 	{
-		if (!Server()->ClientIngame(i)) continue;
-		int *pMap = Server()->GetIdMap(i);
-
-		// compute distances
-		for (int j = 0; j < MAX_CLIENTS; j++)
+		CPlayerMaps::CClient *pClient = &aClients[i];
+		CPlayer *pPlayer = GameServer()->m_apPlayers[i];
+		pClient->m_pMap = 0;
+		if (!Server()->ClientIngame(i) || !pPlayer)
 		{
-			Dist[j].second = j;
-			if (!Server()->ClientIngame(j) || !GameServer()->m_apPlayers[j])
-			{
-				Dist[j].first = 1e10;
-				continue;
-			}
-			CCharacter* ch = GameServer()->m_apPlayers[j]->GetCharacter();
-			if (!ch)
-			{
-				Dist[j].first = 1e9;
-				continue;
-			}
-			// copypasted chunk from character.cpp Snap() follows
-			CCharacter* SnapChar = GameServer()->GetPlayerChar(i);
-			if(SnapChar && !SnapChar->m_Super &&
-				!GameServer()->m_apPlayers[i]->IsPaused() && GameServer()->m_apPlayers[i]->GetTeam() != -1 &&
-				!ch->CanCollide(i) &&
-				(!GameServer()->m_apPlayers[i] ||
-					GameServer()->m_apPlayers[i]->m_ClientVersion == VERSION_VANILLA ||
-					(GameServer()->m_apPlayers[i]->m_ClientVersion >= VERSION_DDRACE &&
-					!GameServer()->m_apPlayers[i]->m_ShowOthers
-					)
+			pClient->m_Target = CPlayerMaps::TARGET_ABSENT;
+			continue;
+		}
+		CCharacter *pChr = pPlayer->GetCharacter();
+		pClient->m_Target = pChr ? CPlayerMaps::TARGET_CHARACTER : CPlayerMaps::TARGET_NO_CHARACTER;
+		pClient->m_Pos = pChr ? pChr->m_Pos : vec2(0, 0);
+		pClient->m_ViewPos = pPlayer->m_ViewPos;
+
+		// copypasted chunk from character.cpp Snap() follows
+		CCharacter* SnapChar = GameServer()->GetPlayerChar(i);
+		pClient->m_HideOthers = SnapChar && !SnapChar->m_Super &&
+			!pPlayer->IsPaused() && pPlayer->GetTeam() != -1 &&
+			(pPlayer->m_ClientVersion == VERSION_VANILLA ||
+				(pPlayer->m_ClientVersion >= VERSION_DDRACE &&
+				!pPlayer->m_ShowOthers
 				)
-			)
-				Dist[j].first = 1e8;
-			else
-				Dist[j].first = 0;
+			);
 
-			Dist[j].first += distance(GameServer()->m_apPlayers[i]->m_ViewPos, GameServer()->m_apPlayers[j]->GetCharacter()->m_Pos);
-		}
+		// newer clients know all 64 ids
+		if (pPlayer->m_ClientVersion < VERSION_DDNET_OLD)
+			pClient->m_pMap = Server()->GetIdMap(i);
+	}
 
-		// always send the player himself
-		Dist[i].first = 0;
+	m_PlayerMaps.Update(aClients, &((CGameControllerDDRace*)GameServer()->m_pController)->m_Teams.m_Core);
+}
 
-		// compute reverse map
-		int rMap[MAX_CLIENTS];
-		for (int j = 0; j < MAX_CLIENTS; j++)
-		{
-			rMap[j] = -1;
-		}
-		for (int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+void CGameWorld::CTeamMoveJob::Run()
+{
+	for(int i = 0; i < m_NumCharacters; i++)
+		m_ppCharacters[i]->MoveCore();
+	sphore_signal(m_pDone);
+}
+
+bool CGameWorld::TickDeferedTeams()
+{
+	if(!m_NumTeamThreads)
+		return false;
+
+	// characters only collide with the characters of their own team, so
+	// each team can move on its own. solo characters don't collide with
+	// anyone, super characters collide with everyone
+	int aTeamGroups[MAX_CLIENTS+1];
+	int aGroupSizes[MAX_CLIENTS];
+	int aCharacterGroups[MAX_CLIENTS];
+	for(int i = 0; i <= MAX_CLIENTS; i++)
+		aTeamGroups[i] = -1;
+	int NumGroups = 0;
+	int NumCharacters = 0;
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	{
+		CCharacter *pChr = (CCharacter *)pEnt;
+		int ClientID = pChr->GetPlayer()->GetCID();
+		CTeamsCore *pTeams = &pChr->Teams()->m_Core;
+		int Team = pTeams->Team(ClientID);
+		if(NumCharacters == MAX_CLIENTS || pChr->Core()->m_Super || Team < 0 || Team >= (pTeams->m_IsDDRace16 ? VANILLA_TEAM_SUPER : TEAM_SUPER))
+			return false;
+
+		bool Solo = pChr->Core()->m_Solo || pTeams->GetSolo(ClientID);
+		int Group = Solo ? -1 : aTeamGroups[Team];
+		if(Group < 0)
 		{
-			if (pMap[j] == -1) continue;
-			if (Dist[pMap[j]].first > 5e9) pMap[j] = -1;
-			else rMap[pMap[j]] = j;
+			Group = NumGroups++;
+			aGroupSizes[Group] = 0;
+			if(!Solo)
+				aTeamGroups[Team] = Group;
 		}
+		aGroupSizes[Group]++;
+		aCharacterGroups[NumCharacters++] = Group;
+	}
+	if(NumGroups < 2)
+		return false;
 
-		std::nth_element(&Dist[0], &Dist[VANILLA_MAX_CLIENTS - 1], &Dist[MAX_CLIENTS], distCompare);
+	// sort the characters by group, keeping the list order in the groups
+	int aGroupStarts[MAX_CLIENTS];
+	int Start = 0;
+	for(int i = 0; i < NumGroups; i++)
+	{
+		aGroupStarts[i] = Start;
+		Start += aGroupSizes[i];
+	}
+	int aFill[MAX_CLIENTS];
+	mem_copy(aFill, aGroupStarts, sizeof(int) * NumGroups);
+	int Index = 0;
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		m_apTeamCharacters[aFill[aCharacterGroups[Index++]]++] = (CCharacter *)pEnt;
 
-		int Mapc = 0;
-		int Demand = 0;
-		for (int j = 0; j < VANILLA_MAX_CLIENTS - 1; j++)
-		{
-			int k = Dist[j].second;
-			if (rMap[k] != -1 || Dist[j].first > 5e9) continue;
-			while (Mapc < VANILLA_MAX_CLIENTS && pMap[Mapc] != -1) Mapc++;
-			if (Mapc < VANILLA_MAX_CLIENTS - 1)
-				pMap[Mapc] = k;
-			else
-				Demand++;
-		}
-		for (int j = MAX_CLIENTS - 1; j > VANILLA_MAX_CLIENTS - 2; j--)
+	// the dead reckoning might use rand(), keep its order
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		((CCharacter *)pEnt)->AdvanceReckoningCore();
+
+	for(int i = 0; i < NumGroups; i++)
+	{
+		if(!m_apTeamMoveJobs[i])
 		{
-			int k = Dist[j].second;
-			if (rMap[k] != -1 && Demand-- > 0)
-				pMap[rMap[k]] = -1;
+			m_apTeamMoveJobs[i] = std::make_shared<CTeamMoveJob>();
+			m_apTeamMoveJobs[i]->m_pDone = &m_TeamJobsDone;
 		}
-		pMap[VANILLA_MAX_CLIENTS - 1] = -1; // player with empty name to say chat msgs
+		m_apTeamMoveJobs[i]->m_ppCharacters = &m_apTeamCharacters[aGroupStarts[i]];
+		m_apTeamMoveJobs[i]->m_NumCharacters = aGroupSizes[i];
+		m_TeamJobPool.Add(m_apTeamMoveJobs[i]);
 	}
+	for(int i = 0; i < NumGroups; i++)
+		sphore_wait(&m_TeamJobsDone);
+
+	// sounds and the debug output in the order of the entity list
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		((CCharacter *)pEnt)->FinishTickDefered();
+	return true;
 }
 
 void CGameWorld::Tick()
@@ -244,6 +320,8 @@ void CGameWorld::Tick()
 	if(m_ResetRequested)
 		Reset();
 
+	m_CharacterGrid.CheckCells();
+
 	if(!m_Paused)
 	{
 		if(GameServer()->m_pController->IsForceBalanced())
@@ -258,12 +336,16 @@ void CGameWorld::Tick()
 			}
 
 		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			if(i == ENTTYPE_CHARACTER && TickDeferedTeams())
+				continue;
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->TickDefered();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 	}
 	else
 	{
@@ -277,6 +359,8 @@ void CGameWorld::Tick()
 			}
 	}
 
+	m_CharacterGrid.CheckCells();
+
 	RemoveEntities();
 
 	UpdatePlayerMaps();
@@ -298,9 +382,13 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	CEntity *apCandidates[MAX_CLIENTS];
+	int NumCandidates = m_CharacterGrid.Query(Min, Max, apCandidates, MAX_CLIENTS);
+	for(int i = 0; i < NumCandidates; i++)
 	{
+		CCharacter *p = (CCharacter *)apCandidates[i];
 		if(p == pNotThis)
 			continue;
 
@@ -331,9 +419,11 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 	float ClosestRange = Radius*2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	CEntity *apCandidates[MAX_CLIENTS];
+	int NumCandidates = GameServer()->m_World.m_CharacterGrid.Query(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), apCandidates, MAX_CLIENTS);
+	for(int i = 0; i < NumCandidates; i++)
 	{
+		CCharacter *p = (CCharacter *)apCandidates[i];
 		if(p == pNotThis)
 			continue;
 
@@ -355,9 +445,13 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 {
 	std::list< CCharacter * > listOfChars;
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	CEntity *apCandidates[MAX_CLIENTS];
+	int NumCandidates = m_CharacterGrid.Query(Min, Max, apCandidates, MAX_CLIENTS);
+	for(int i = 0; i < NumCandidates; i++)
 	{
+		CCharacter *pChr = (CCharacter *)apCandidates[i];
 		if(pChr == pNotThis)
 			continue;
 
@@ -3,9 +3,14 @@
 #ifndef GAME_SERVER_GAMEWORLD_H
 #define GAME_SERVER_GAMEWORLD_H
 
+#include <engine/shared/jobs.h>
+
+#include <game/entitygrid.h>
 #include <game/gamecore.h>
+#include <game/server/playermaps.h>
 
 #include <list>
+#include <memory>
 
 class CEntity;
 class CCharacter;
@@ -35,10 +40,36 @@ private:
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// all queries of the world are for characters, so only they are in
+	// the grid
+	CEntityGrid<CEntity> m_CharacterGrid;
+
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
 
+	// moves the characters of teams that can't collide with any character
+	// of the other jobs, in the order of the entity list
+	class CTeamMoveJob : public IJob
+	{
+		virtual void Run();
+
+	public:
+		CCharacter **m_ppCharacters;
+		int m_NumCharacters;
+		SEMAPHORE *m_pDone;
+	};
+
+	CJobPool m_TeamJobPool;
+	int m_NumTeamThreads;
+	SEMAPHORE m_TeamJobsDone;
+	std::shared_ptr<CTeamMoveJob> m_apTeamMoveJobs[MAX_CLIENTS];
+	CCharacter *m_apTeamCharacters[MAX_CLIENTS];
+
+	CPlayerMaps m_PlayerMaps;
+
 	void UpdatePlayerMaps();
+	bool TickDeferedTeams();
+
 
 public:
 	class CGameContext *GameServer() { return m_pGameServer; }
@@ -55,6 +86,9 @@ public:
 
 	CEntity *FindFirst(int Type);
 
+	// has to be called whenever the position of an entity is written
+	void UpdateGrid(CEntity *pEnt);
+
 	/*
 		Function: find_entities
 			Finds entities close to a position and returns them in a list.
@@ -0,0 +1,172 @@
+#include "playermaps.h"
+
+#include <base/math.h>
+#include <base/system.h>
+#include <game/teamscore.h>
+
+#include <algorithm>
+#include <utility>
+
+static bool DistCompare(const std::pair<float, int> &a, const std::pair<float, int> &b)
+{
+	return a.first < b.first;
+}
+
+static int TargetState(const CPlayerMaps::CClient *pClient, CTeamsCore *pTeams, int ClientID)
+{
+	return pClient->m_Target | pTeams->Team(ClientID) << 2 | pTeams->GetSolo(ClientID) << 10;
+}
+
+static int ViewerState(const CPlayerMaps::CClient *pClient, CTeamsCore *pTeams, int ClientID)
+{
+	return pClient->m_HideOthers | pTeams->Team(ClientID) << 1 | pTeams->GetSolo(ClientID) << 9;
+}
+
+CPlayerMaps::CPlayerMaps()
+{
+	Reset();
+}
+
+void CPlayerMaps::Reset()
+{
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_aTargets[i].m_State = -1;
+		m_aViewers[i].m_Valid = false;
+	}
+}
+
+float CPlayerMaps::Distance(const CClient *pClients, CTeamsCore *pTeams, int Viewer, int Target)
+{
+	if(pClients[Target].m_Target == TARGET_ABSENT)
+		return 1e10;
+	if(pClients[Target].m_Target == TARGET_NO_CHARACTER)
+		return 1e9;
+
+	// the hidden characters come after all the visible ones
+	float Dist = 0;
+	if(pClients[Viewer].m_HideOthers && !pTeams->CanCollide(Target, Viewer))
+		Dist = 1e8;
+	return Dist + distance(pClients[Viewer].m_ViewPos, pClients[Target].m_Pos);
+}
+
+void CPlayerMaps::Rank(const CClient *pClients, CTeamsCore *pTeams, int Viewer)
+{
+	int *pMap = pClients[Viewer].m_pMap;
+	CViewerState *pState = &m_aViewers[Viewer];
+
+	std::pair<float, int> Dist[MAX_CLIENTS];
+	for(int j = 0; j < MAX_CLIENTS; j++)
+	{
+		Dist[j].first = Distance(pClients, pTeams, Viewer, j);
+		Dist[j].second = j;
+	}
+
+	// always send the player himself
+	Dist[Viewer].first = 0;
+
+	// compute reverse map
+	int rMap[MAX_CLIENTS];
+	for(int j = 0; j < MAX_CLIENTS; j++)
+		rMap[j] = -1;
+	for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+	{
+		if(pMap[j] == -1)
+			continue;
+		if(Dist[pMap[j]].first > 5e9)
+			pMap[j] = -1;
+		else
+			rMap[pMap[j]] = j;
+	}
+
+	std::nth_element(&Dist[0], &Dist[VANILLA_MAX_CLIENTS - 1], &Dist[MAX_CLIENTS], DistCompare);
+
+	int Mapc = 0;
+	int Demand = 0;
+	pState->m_Threshold = 0;
+	for(int j = 0; j < VANILLA_MAX_CLIENTS - 1; j++)
+	{
+		pState->m_Threshold = maximum(pState->m_Threshold, Dist[j].first);
+		int k = Dist[j].second;
+		if(rMap[k] != -1 || Dist[j].first > 5e9)
+			continue;
+		while(Mapc < VANILLA_MAX_CLIENTS && pMap[Mapc] != -1)
+			Mapc++;
+		if(Mapc < VANILLA_MAX_CLIENTS - 1)
+			pMap[Mapc] = k;
+		else
+			Demand++;
+	}
+	for(int j = MAX_CLIENTS - 1; j > VANILLA_MAX_CLIENTS - 2; j--)
+	{
+		int k = Dist[j].second;
+		if(rMap[k] != -1 && Demand-- > 0)
+			pMap[rMap[k]] = -1;
+	}
+	pMap[VANILLA_MAX_CLIENTS - 1] = -1; // player with empty name to say chat msgs
+
+	pState->m_Valid = true;
+	pState->m_Pending = Demand > 0;
+	pState->m_State = ViewerState(&pClients[Viewer], pTeams, Viewer);
+	pState->m_ViewPos = pClients[Viewer].m_ViewPos;
+	mem_copy(pState->m_aMap, pMap, sizeof(pState->m_aMap));
+}
+
+int CPlayerMaps::Update(const CClient *pClients, CTeamsCore *pTeams)
+{
+	// find the players that joined, left, changed team or moved noticeably
+	int aMoved[MAX_CLIENTS];
+	int NumMoved = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CTargetState *pTarget = &m_aTargets[i];
+		int State = TargetState(&pClients[i], pTeams, i);
+		if(State != pTarget->m_State || (pClients[i].m_Target == TARGET_CHARACTER && distance(pClients[i].m_Pos, pTarget->m_Pos) > MOVE_DISTANCE))
+		{
+			pTarget->m_State = State;
+			pTarget->m_Pos = pClients[i].m_Pos;
+			aMoved[NumMoved++] = i;
+		}
+	}
+
+	int NumRanked = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CClient *pViewer = &pClients[i];
+		CViewerState *pState = &m_aViewers[i];
+		if(!pViewer->m_pMap)
+		{
+			pState->m_Valid = false;
+			continue;
+		}
+
+		// the map is also reset from outside when a player joins
+		bool Changed = !pState->m_Valid || pState->m_Pending ||
+			pState->m_State != ViewerState(pViewer, pTeams, i) ||
+			distance(pViewer->m_ViewPos, pState->m_ViewPos) > MOVE_DISTANCE ||
+			mem_comp(pState->m_aMap, pViewer->m_pMap, sizeof(pState->m_aMap)) != 0;
+
+		// a moved player matters if it might lose its id or get one
+		for(int m = 0; m < NumMoved && !Changed; m++)
+		{
+			int Target = aMoved[m];
+			if(Target == i)
+				continue;
+			bool Mapped = false;
+			for(int j = 0; j < VANILLA_MAX_CLIENTS && !Mapped; j++)
+				Mapped = pViewer->m_pMap[j] == Target;
+			float Dist = Distance(pClients, pTeams, i, Target);
+			if(Mapped)
+				Changed = Dist > pState->m_Threshold || Dist > 5e9;
+			else
+				Changed = Dist <= pState->m_Threshold && Dist < 5e9;
+		}
+
+		if(Changed)
+		{
+			Rank(pClients, pTeams, i);
+			NumRanked++;
+		}
+	}
+	return NumRanked;
+}
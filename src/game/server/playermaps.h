@@ -0,0 +1,84 @@
+#ifndef GAME_SERVER_PLAYERMAPS_H
+#define GAME_SERVER_PLAYERMAPS_H
+
+#include <base/vmath.h>
+#include <engine/shared/protocol.h>
+
+class CTeamsCore;
+
+/*
+	Class: Player Maps
+		Maps the 64 client ids to the 16 ids of the vanilla clients, the
+		closest players get an id. Only the clients whose view or closest
+		players moved noticeably since their last update are ranked again,
+		the ids of the others stay as they are.
+*/
+class CPlayerMaps
+{
+public:
+	enum
+	{
+		// how far a player or a view has to move to count as moved
+		MOVE_DISTANCE=64,
+
+		TARGET_ABSENT=0,
+		TARGET_NO_CHARACTER,
+		TARGET_CHARACTER,
+	};
+
+	class CClient
+	{
+	public:
+		int m_Target; // TARGET_*
+		vec2 m_Pos; // position of the character
+		vec2 m_ViewPos;
+		bool m_HideOthers; // doesn't see the characters it can't collide with
+		int *m_pMap; // 0 if the client doesn't need a map
+	};
+
+private:
+	class CTargetState
+	{
+	public:
+		int m_State;
+		vec2 m_Pos; // where the character last moved noticeably
+	};
+
+	class CViewerState
+	{
+	public:
+		bool m_Valid;
+		bool m_Pending; // evicted ids are given out at the next update
+		int m_State;
+		vec2 m_ViewPos;
+		float m_Threshold; // distance of the farthest ranked player
+		int m_aMap[VANILLA_MAX_CLIENTS];
+	};
+
+	CTargetState m_aTargets[MAX_CLIENTS];
+	CViewerState m_aViewers[MAX_CLIENTS];
+
+	static float Distance(const CClient *pClients, CTeamsCore *pTeams, int Viewer, int Target);
+	void Rank(const CClient *pClients, CTeamsCore *pTeams, int Viewer);
+
+public:
+	CPlayerMaps();
+
+	void Reset();
+
+	/*
+		Function: Update
+			Updates the maps of the clients.
+
+		Arguments:
+			pClients - MAX_CLIENTS entries describing the clients.
+			pTeams - The teams, the characters of other teams might be
+				hidden.
+
+		Returns:
+			The number of clients that were ranked again.
+	*/
+	int Update(const CClient *pClients, CTeamsCore *pTeams);
+};
+
+#endif
@@ -0,0 +1,301 @@
+#include "journal.h"
+
+#include <algorithm>
+#include <string>
+
+static const char s_aExtension[] = ".journal";
+
+struct CListSegments
+{
+	char m_aPrefix[16];
+	std::vector<std::string> m_aNames;
+};
+
+static int ListSegmentsCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CListSegments *pList = (CListSegments *)pUser;
+	int Length = str_length(pName);
+	int ExtensionLength = sizeof(s_aExtension) - 1;
+	if(!IsDir && Length > ExtensionLength && str_comp(pName + Length - ExtensionLength, s_aExtension) == 0 &&
+		str_startswith(pName, pList->m_aPrefix))
+		pList->m_aNames.push_back(pName);
+	return 0;
+}
+
+// splits at the tabs, returns the number of fields
+static int Split(char *pLine, const char **ppFields, int MaxFields)
+{
+	int Num = 0;
+	ppFields[Num++] = pLine;
+	for(char *p = pLine; *p; p++)
+	{
+		if(*p != '\t')
+			continue;
+		if(Num == MaxFields)
+			return -1;
+		*p = 0;
+		ppFields[Num++] = p + 1;
+	}
+	return Num;
+}
+
+CScoreJournal::CScoreJournal()
+{
+	m_aFolder[0] = 0;
+	m_Instance = 0;
+	m_NumFinishes = 0;
+	m_FirstFinish = 0;
+	m_aStartTime[0] = 0;
+	m_aCurrent[0] = 0;
+	m_File = 0;
+	m_NextSegment = 0;
+	m_pThread = 0;
+	m_Lock = lock_create();
+	sphore_init(&m_Tasks);
+	sphore_init(&m_Done);
+}
+
+CScoreJournal::~CScoreJournal()
+{
+	// the writer finishes the tasks before it stops
+	if(m_pThread)
+	{
+		Push(TASK_STOP, "");
+		thread_wait(m_pThread);
+	}
+	if(m_File)
+		io_close(m_File);
+	sphore_destroy(&m_Done);
+	sphore_destroy(&m_Tasks);
+	lock_destroy(m_Lock);
+}
+
+bool CScoreJournal::Init(const char *pFolder, int Instance, std::vector<std::string> *pOldSegments)
+{
+	str_copy(m_aFolder, pFolder, sizeof(m_aFolder));
+	m_Instance = Instance;
+	str_timestamp(m_aStartTime, sizeof(m_aStartTime));
+	if(!m_pThread)
+		m_pThread = thread_init(WriterThread, this, "score journal");
+	if(fs_makedir(m_aFolder) != 0)
+	{
+		dbg_msg("journal", "failed to create folder '%s'", m_aFolder);
+		return false;
+	}
+
+	// the segments of other instances may still be written
+	CListSegments List;
+	str_format(List.m_aPrefix, sizeof(List.m_aPrefix), "%d_", m_Instance);
+	fs_listdir(m_aFolder, ListSegmentsCallback, 0, &List);
+	// oldest first
+	std::sort(List.m_aNames.begin(), List.m_aNames.end());
+	for(unsigned i = 0; i < List.m_aNames.size(); i++)
+		pOldSegments->push_back(std::string(m_aFolder) + "/" + List.m_aNames[i]);
+	return true;
+}
+
+void CScoreJournal::Push(int Type, const char *pLine)
+{
+	CTask Task;
+	Task.m_Type = Type;
+	Task.m_Line = pLine;
+	lock_wait(m_Lock);
+	m_aTasks.push_back(Task);
+	lock_unlock(m_Lock);
+	sphore_signal(&m_Tasks);
+}
+
+void CScoreJournal::Write(const char *pLine)
+{
+	if(!m_File)
+	{
+		str_format(m_aCurrent, sizeof(m_aCurrent), "%s/%d_%s_%04d%s", m_aFolder, m_Instance, m_aStartTime, m_NextSegment++, s_aExtension);
+		m_File = io_open(m_aCurrent, IOFLAG_APPEND);
+		if(!m_File)
+		{
+			dbg_msg("journal", "failed to open '%s'", m_aCurrent);
+			return;
+		}
+	}
+
+	io_write(m_File, pLine, str_length(pLine));
+	io_write_newline(m_File);
+}
+
+void CScoreJournal::Sync()
+{
+	if(m_File && io_sync(m_File) != 0)
+		dbg_msg("journal", "failed to write to '%s'", m_aCurrent);
+}
+
+void CScoreJournal::WriterThread(void *pUser)
+{
+	CScoreJournal *pJournal = (CScoreJournal *)pUser;
+	std::vector<CTask> aTasks;
+	bool Stop = false;
+	while(!Stop)
+	{
+		sphore_wait(&pJournal->m_Tasks);
+		lock_wait(pJournal->m_Lock);
+		aTasks.swap(pJournal->m_aTasks);
+		lock_unlock(pJournal->m_Lock);
+
+		// the lines added since the last pass are synced at once
+		bool Written = false;
+		int NumWaiting = 0;
+		for(unsigned i = 0; i < aTasks.size(); i++)
+		{
+			switch(aTasks[i].m_Type)
+			{
+			case TASK_LINE:
+				pJournal->Write(aTasks[i].m_Line.c_str());
+				Written = true;
+				break;
+			case TASK_SEAL:
+				if(!pJournal->m_File)
+					break;
+				pJournal->Sync();
+				Written = false;
+				io_close(pJournal->m_File);
+				pJournal->m_File = 0;
+				lock_wait(pJournal->m_Lock);
+				pJournal->m_aSealed.push_back(pJournal->m_aCurrent);
+				lock_unlock(pJournal->m_Lock);
+				break;
+			case TASK_WAIT:
+				NumWaiting++;
+				break;
+			case TASK_STOP:
+				Stop = true;
+				break;
+			}
+		}
+		if(Written)
+			pJournal->Sync();
+		for(int i = 0; i < NumWaiting; i++)
+			sphore_signal(&pJournal->m_Done);
+		aTasks.clear();
+	}
+}
+
+void CScoreJournal::Add(const CRaceFinish *pFinish)
+{
+	char aLine[1024];
+	str_format(aLine, sizeof(aLine), "race\t%d\t%s\t%s\t%s\t%.2f", pFinish->m_ClientID, pFinish->m_aMap, pFinish->m_aName, pFinish->m_aTimestamp, pFinish->m_Time);
+	for(int i = 0; i < NUM_CHECKPOINTS; i++)
+	{
+		char aCp[32];
+		str_format(aCp, sizeof(aCp), "\t%.2f", pFinish->m_aCpTime[i]);
+		str_append(aLine, aCp, sizeof(aLine));
+	}
+	str_append(aLine, "\t", sizeof(aLine));
+	str_append(aLine, pFinish->m_aGameUuid, sizeof(aLine));
+
+	if(m_NumFinishes++ == 0)
+		m_FirstFinish = time_get();
+	Push(TASK_LINE, aLine);
+}
+
+void CScoreJournal::Add(const CTeamFinish *pFinish)
+{
+	char aLine[MAX_CLIENTS * MAX_NAME_LENGTH + 512];
+	str_format(aLine, sizeof(aLine), "team\t%s\t%s\t%.2f\t%s\t%d", pFinish->m_aMap, pFinish->m_aTimestamp, pFinish->m_Time, pFinish->m_aGameUuid, pFinish->m_Size);
+	for(int i = 0; i < pFinish->m_Size; i++)
+	{
+		str_append(aLine, "\t", sizeof(aLine));
+		str_append(aLine, pFinish->m_aaNames[i], sizeof(aLine));
+	}
+
+	if(m_NumFinishes++ == 0)
+		m_FirstFinish = time_get();
+	Push(TASK_LINE, aLine);
+}
+
+bool CScoreJournal::Seal()
+{
+	if(!m_NumFinishes)
+		return false;
+	m_NumFinishes = 0;
+	Push(TASK_SEAL, "");
+	return true;
+}
+
+bool CScoreJournal::PopSealed(char *pPath, int PathSize)
+{
+	lock_wait(m_Lock);
+	bool Found = !m_aSealed.empty();
+	if(Found)
+	{
+		str_copy(pPath, m_aSealed.front().c_str(), PathSize);
+		m_aSealed.erase(m_aSealed.begin());
+	}
+	lock_unlock(m_Lock);
+	return Found;
+}
+
+void CScoreJournal::Wait()
+{
+	if(!m_pThread)
+		return;
+	Push(TASK_WAIT, "");
+	sphore_wait(&m_Done);
+}
+
+bool CScoreJournal::Read(const char *pPath, CSegment *pSegment)
+{
+	IOHANDLE File = io_open(pPath, IOFLAG_READ);
+	if(!File)
+		return false;
+	int Length = io_length(File);
+	char *pData = new char[Length + 1];
+	Length = io_read(File, pData, Length);
+	io_close(File);
+	pData[Length] = 0;
+
+	const int MAX_FIELDS = 6 + MAX_CLIENTS;
+	const char *apFields[MAX_FIELDS];
+	char *pLine = pData;
+	while(true)
+	{
+		// a line without newline was cut off
+		char *pEnd = (char *)str_find(pLine, "\n");
+		if(!pEnd)
+			break;
+		*pEnd = 0;
+		if(pEnd > pLine && pEnd[-1] == '\r')
+			pEnd[-1] = 0;
+
+		int Num = Split(pLine, apFields, MAX_FIELDS);
+		pLine = pEnd + 1;
+		if(Num == 7 + NUM_CHECKPOINTS && str_comp(apFields[0], "race") == 0)
+		{
+			CRaceFinish Finish;
+			Finish.m_ClientID = str_toint(apFields[1]);
+			str_copy(Finish.m_aMap, apFields[2], sizeof(Finish.m_aMap));
+			str_copy(Finish.m_aName, apFields[3], sizeof(Finish.m_aName));
+			str_copy(Finish.m_aTimestamp, apFields[4], sizeof(Finish.m_aTimestamp));
+			Finish.m_Time = str_tofloat(apFields[5]);
+			for(int i = 0; i < NUM_CHECKPOINTS; i++)
+				Finish.m_aCpTime[i] = str_tofloat(apFields[6 + i]);
+			str_copy(Finish.m_aGameUuid, apFields[6 + NUM_CHECKPOINTS], sizeof(Finish.m_aGameUuid));
+			pSegment->m_aRaceFinishes.push_back(Finish);
+		}
+		else if(Num >= 6 && str_comp(apFields[0], "team") == 0 && str_toint(apFields[5]) == Num - 6)
+		{
+			CTeamFinish Finish;
+			str_copy(Finish.m_aMap, apFields[1], sizeof(Finish.m_aMap));
+			str_copy(Finish.m_aTimestamp, apFields[2], sizeof(Finish.m_aTimestamp));
+			Finish.m_Time = str_tofloat(apFields[3]);
+			str_copy(Finish.m_aGameUuid, apFields[4], sizeof(Finish.m_aGameUuid));
+			Finish.m_Size = Num - 6;
+			for(int i = 0; i < Finish.m_Size; i++)
+				str_copy(Finish.m_aaNames[i], apFields[6 + i], sizeof(Finish.m_aaNames[i]));
+			pSegment->m_aTeamFinishes.push_back(Finish);
+		}
+		else if(Num > 1 || apFields[0][0])
+			dbg_msg("journal", "skipping invalid line in '%s'", pPath);
+	}
+
+	delete[] pData;
+	return true;
+}
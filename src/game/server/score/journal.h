@@ -0,0 +1,166 @@
+#ifndef GAME_SERVER_SCORE_JOURNAL_H
+#define GAME_SERVER_SCORE_JOURNAL_H
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+
+#include "../score.h"
+
+#include <string>
+#include <vector>
+
+/*
+	Class: Score Journal
+		Keeps the finishes that aren't in the database yet on the disk.
+		They are appended to a segment file, which is sealed when its
+		finishes are sent to the database as one batch and removed once
+		they are stored. The segments that are still there at startup
+		are sent again.
+
+		Servers can share the folder, the segment names start with the
+		instance, each server only sends its own ones again.
+
+		The files are written by a thread of the journal, which syncs
+		everything added since its last write at once.
+*/
+class CScoreJournal
+{
+public:
+	class CRaceFinish
+	{
+	public:
+		int m_ClientID;
+		char m_aMap[128];
+		char m_aName[MAX_NAME_LENGTH];
+		char m_aTimestamp[TIMESTAMP_STR_LENGTH];
+		float m_Time;
+		float m_aCpTime[NUM_CHECKPOINTS];
+		char m_aGameUuid[UUID_MAXSTRSIZE];
+	};
+
+	class CTeamFinish
+	{
+	public:
+		char m_aMap[128];
+		char m_aTimestamp[TIMESTAMP_STR_LENGTH];
+		float m_Time;
+		char m_aGameUuid[UUID_MAXSTRSIZE];
+		int m_Size;
+		char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
+	};
+
+	class CSegment
+	{
+	public:
+		std::vector<CRaceFinish> m_aRaceFinishes;
+		std::vector<CTeamFinish> m_aTeamFinishes;
+	};
+
+private:
+	enum
+	{
+		TASK_LINE=0,
+		TASK_SEAL,
+		TASK_WAIT,
+		TASK_STOP,
+	};
+
+	struct CTask
+	{
+		int m_Type;
+		std::string m_Line;
+	};
+
+	char m_aFolder[256];
+	int m_Instance;
+	int m_NumFinishes;
+	int64 m_FirstFinish;
+	char m_aStartTime[64];
+
+	// used by the writer thread only
+	char m_aCurrent[512];
+	IOHANDLE m_File;
+	int m_NextSegment;
+
+	void *m_pThread;
+	LOCK m_Lock;
+	SEMAPHORE m_Tasks;
+	SEMAPHORE m_Done;
+	std::vector<CTask> m_aTasks;
+	std::vector<std::string> m_aSealed;
+
+	void Push(int Type, const char *pLine);
+	void Write(const char *pLine);
+	void Sync();
+	static void WriterThread(void *pUser);
+
+public:
+	CScoreJournal();
+	~CScoreJournal();
+
+	/*
+		Function: Init
+			Creates the folder of the journal and starts its writer.
+
+		Arguments:
+			pFolder - Where to put the segments.
+			Instance - Tells the servers using the same folder apart,
+				usually the port.
+			pOldSegments - Receives the paths of the segments left from
+				earlier runs of the instance.
+
+		Returns:
+			False if the folder couldn't be created.
+	*/
+	bool Init(const char *pFolder, int Instance, std::vector<std::string> *pOldSegments);
+
+	/*
+		Function: Add
+			Appends a finish to the current segment. It reaches the
+			disk with the next write of the writer thread.
+	*/
+	void Add(const CRaceFinish *pFinish);
+	void Add(const CTeamFinish *pFinish);
+
+	int NumFinishes() const { return m_NumFinishes; }
+	// time_get() of the first finish in the current segment
+	int64 FirstFinish() const { return m_FirstFinish; }
+
+	/*
+		Function: Seal
+			Closes the current segment, the next finish starts a new one.
+			The segment can be taken with <PopSealed> once it is written.
+
+		Returns:
+			False if the current segment is empty.
+	*/
+	bool Seal();
+
+	/*
+		Function: PopSealed
+			Takes the path of a written sealed segment.
+
+		Returns:
+			False if there is none.
+	*/
+	bool PopSealed(char *pPath, int PathSize);
+
+	/*
+		Function: Wait
+			Waits until everything added so far is on the disk.
+	*/
+	void Wait();
+
+	/*
+		Function: Read
+			Reads a segment, lines that were cut off by a crash are
+			skipped. Can be called from any thread.
+
+		Returns:
+			False if the file couldn't be opened.
+	*/
+	static bool Read(const char *pPath, CSegment *pSegment);
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "leaderboard.h"
+
+#include <base/system.h>
+
+#include <algorithm>
+
+class CBefore
+{
+	const CLeaderboard *m_pBoard;
+
+public:
+	CBefore(const CLeaderboard *pBoard) :
+		m_pBoard(pBoard) {}
+	bool operator()(const CLeaderboard::CEntry &a, const CLeaderboard::CEntry &b) const;
+};
+
+CLeaderboard::CLeaderboard(bool HighFirst)
+{
+	m_HighFirst = HighFirst;
+}
+
+bool CLeaderboard::Before(const CEntry &a, const CEntry &b) const
+{
+	if(a.m_Score != b.m_Score)
+		return Better(a.m_Score, b.m_Score);
+	return str_comp(a.m_aName, b.m_aName) < 0;
+}
+
+bool CBefore::operator()(const CLeaderboard::CEntry &a, const CLeaderboard::CEntry &b) const
+{
+	return m_pBoard->Before(a, b);
+}
+
+int CLeaderboard::FirstAt(float Score) const
+{
+	int Low = 0;
+	int High = m_aEntries.size();
+	while(Low < High)
+	{
+		int Middle = (Low + High) / 2;
+		if(Better(m_aEntries[Middle].m_Score, Score))
+			Low = Middle + 1;
+		else
+			High = Middle;
+	}
+	return Low;
+}
+
+void CLeaderboard::Sort()
+{
+	m_aEntries.clear();
+	m_aEntries.reserve(m_Scores.size());
+	for(std::map<std::string, float>::const_iterator it = m_Scores.begin(); it != m_Scores.end(); ++it)
+	{
+		CEntry Entry;
+		str_copy(Entry.m_aName, it->first.c_str(), sizeof(Entry.m_aName));
+		Entry.m_Score = it->second;
+		m_aEntries.push_back(Entry);
+	}
+	std::sort(m_aEntries.begin(), m_aEntries.end(), CBefore(this));
+}
+
+void CLeaderboard::Clear()
+{
+	m_aEntries.clear();
+	m_Scores.clear();
+}
+
+void CLeaderboard::Set(const char *pName, float Score)
+{
+	CEntry Entry;
+	str_copy(Entry.m_aName, pName, sizeof(Entry.m_aName));
+
+	std::map<std::string, float>::iterator it = m_Scores.find(Entry.m_aName);
+	if(it != m_Scores.end())
+	{
+		Entry.m_Score = it->second;
+		std::vector<CEntry>::iterator Old = std::lower_bound(m_aEntries.begin(), m_aEntries.end(), Entry, CBefore(this));
+		m_aEntries.erase(Old);
+		it->second = Score;
+	}
+	else
+		m_Scores[Entry.m_aName] = Score;
+
+	Entry.m_Score = Score;
+	m_aEntries.insert(std::lower_bound(m_aEntries.begin(), m_aEntries.end(), Entry, CBefore(this)), Entry);
+}
+
+bool CLeaderboard::Improve(const char *pName, float Score)
+{
+	char aName[MAX_NAME_LENGTH];
+	str_copy(aName, pName, sizeof(aName));
+	std::map<std::string, float>::const_iterator it = m_Scores.find(aName);
+	if(it != m_Scores.end() && !Better(Score, it->second))
+		return false;
+	Set(aName, Score);
+	return true;
+}
+
+void CLeaderboard::Load(const std::vector<CEntry> &aEntries)
+{
+	m_Scores.clear();
+	Merge(aEntries);
+}
+
+void CLeaderboard::Merge(const std::vector<CEntry> &aEntries)
+{
+	for(unsigned i = 0; i < aEntries.size(); i++)
+	{
+		std::pair<std::map<std::string, float>::iterator, bool> Result = m_Scores.insert(std::make_pair(std::string(aEntries[i].m_aName), aEntries[i].m_Score));
+		if(!Result.second && Better(aEntries[i].m_Score, Result.first->second))
+			Result.first->second = aEntries[i].m_Score;
+	}
+	// cheaper than inserting the entries one by one
+	Sort();
+}
+
+void CLeaderboard::Swap(CLeaderboard &Other)
+{
+	dbg_assert(m_HighFirst == Other.m_HighFirst, "leaderboards of different order");
+	m_aEntries.swap(Other.m_aEntries);
+	m_Scores.swap(Other.m_Scores);
+}
+
+bool CLeaderboard::Find(const char *pName, int *pRank, float *pScore) const
+{
+	char aName[MAX_NAME_LENGTH];
+	str_copy(aName, pName, sizeof(aName));
+	std::map<std::string, float>::const_iterator it = m_Scores.find(aName);
+	if(it == m_Scores.end())
+		return false;
+	*pRank = FirstAt(it->second) + 1;
+	*pScore = it->second;
+	return true;
+}
+
+int CLeaderboard::Get(int Start, int Num, bool Reverse, CEntry *pEntries, int *pRanks) const
+{
+	int Size = m_aEntries.size();
+	if(Start < 0)
+		Start = 0;
+	int Count = 0;
+	for(int i = Start; i < Size && Count < Num; i++, Count++)
+	{
+		const CEntry &Entry = m_aEntries[Reverse ? Size - 1 - i : i];
+		pEntries[Count] = Entry;
+		pRanks[Count] = FirstAt(Entry.m_Score) + 1;
+	}
+	return Count;
+}
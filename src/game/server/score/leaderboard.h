@@ -0,0 +1,107 @@
+#ifndef GAME_SERVER_SCORE_LEADERBOARD_H
+#define GAME_SERVER_SCORE_LEADERBOARD_H
+
+#include <engine/shared/protocol.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+	Class: Leaderboard
+		The best score of each player, kept sorted to find the rank of a
+		player and the players at a rank quickly. Players with the same
+		score share the rank.
+*/
+class CLeaderboard
+{
+public:
+	class CEntry
+	{
+	public:
+		char m_aName[MAX_NAME_LENGTH];
+		float m_Score;
+	};
+
+private:
+	friend class CBefore;
+
+	bool m_HighFirst;
+	std::vector<CEntry> m_aEntries;
+	std::map<std::string, float> m_Scores;
+
+	bool Better(float a, float b) const { return m_HighFirst ? a > b : a < b; }
+	bool Before(const CEntry &a, const CEntry &b) const;
+	// index of the first entry not better than the score
+	int FirstAt(float Score) const;
+	void Sort();
+
+public:
+	CLeaderboard(bool HighFirst);
+
+	void Clear();
+	int Size() const { return m_aEntries.size(); }
+
+	/*
+		Function: Set
+			Sets the score of a player, adds the player if needed.
+	*/
+	void Set(const char *pName, float Score);
+
+	/*
+		Function: Improve
+			Sets the score of a player if it's better than the one on the
+			leaderboard.
+
+		Returns:
+			True if the score was set.
+	*/
+	bool Improve(const char *pName, float Score);
+
+	/*
+		Function: Load
+			Replaces all the entries.
+	*/
+	void Load(const std::vector<CEntry> &aEntries);
+
+	/*
+		Function: Merge
+			Keeps the better score of the entries and the leaderboard for
+			each player.
+	*/
+	void Merge(const std::vector<CEntry> &aEntries);
+
+	/*
+		Function: Swap
+			Exchanges the entries with another leaderboard of the same
+			order, to build a new one without blocking the readers.
+	*/
+	void Swap(CLeaderboard &Other);
+
+	/*
+		Function: Find
+			Looks up a player.
+
+		Returns:
+			False if the player isn't on the leaderboard.
+	*/
+	bool Find(const char *pName, int *pRank, float *pScore) const;
+
+	/*
+		Function: Get
+			Gets the entries starting at a position.
+
+		Arguments:
+			Start - Number of entries to skip.
+			Num - Maximum number of entries to get.
+			Reverse - Starts from the worst instead of the best.
+			pEntries - Receives the entries.
+			pRanks - Receives the ranks of the entries.
+
+		Returns:
+			The number of entries.
+	*/
+	int Get(int Start, int Num, bool Reverse, CEntry *pEntries, int *pRanks) const;
+};
+
+#endif
@@ -2,6 +2,7 @@
 /* Based on Race mod stuff and tweaked by GreYFoX@GTi and others to fit our DDRace needs. */
 /* CSqlScore class by Sushi */
 #if defined(CONF_SQL)
+#include <algorithm>
 #include <fstream>
 #include <cstring>
 
@@ -27,6 +28,19 @@ int CSqlData::ms_Instance = 0;
 volatile int CSqlExecData::ms_InstanceCount = 0;
 
 LOCK CSqlScore::ms_FailureFileLock = lock_create();
+CSqlWorkerPool CSqlScore::ms_WorkerPool;
+
+CScoreJournal CSqlScore::ms_Journal;
+bool CSqlScore::ms_JournalInitialized = false;
+std::vector<std::string> CSqlScore::ms_aFailedBatches;
+LOCK CSqlScore::ms_FailedBatchesLock = lock_create();
+int64 CSqlScore::ms_LastBatchRetry = 0;
+
+CLeaderboard CSqlScore::ms_MapTimes(false);
+CLeaderboard CSqlScore::ms_Points(true);
+std::vector<CLeaderboard::CEntry> CSqlScore::ms_aNewTimes;
+bool CSqlScore::ms_LeaderboardsLoaded = false;
+LOCK CSqlScore::ms_LeaderboardsLock = lock_create();
 
 CSqlTeamSave::~CSqlTeamSave()
 {
@@ -57,17 +71,39 @@ m_pServer(pGameServer->Server())
 
 	CSqlConnector::ResetReachable();
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(Init, new CSqlData()), "SqlScore constructor");
+	ms_WorkerPool.Start(g_Config.m_SvSqlWorkers);
+	AddJob(new CSqlExecData(Init, new CSqlData()), -1);
+
+	lock_wait(ms_LeaderboardsLock);
+	ms_MapTimes.Clear();
+	ms_aNewTimes.clear();
+	ms_LeaderboardsLoaded = false;
+	lock_unlock(ms_LeaderboardsLock);
+	LoadLeaderboards();
+
+	// save the finishes left from the last run
+	if(!ms_JournalInitialized)
+	{
+		ms_JournalInitialized = true;
+		std::vector<std::string> aSegments;
+		ms_Journal.Init(g_Config.m_SvSqlJournalFolder, g_Config.m_SvPort, &aSegments);
+		for(unsigned i = 0; i < aSegments.size(); i++)
+			AddBatch(aSegments[i].c_str(), true);
+		if(!aSegments.empty())
+			dbg_msg("sql", "saving %d journal segments left from the last run", (int)aSegments.size());
+	}
 }
 
 
 CSqlScore::~CSqlScore()
 {
+	FlushJournal();
 	CSqlData::ms_GameContextAvailable = false;
 }
 
 void CSqlScore::OnShutdown()
 {
+	FlushJournal();
 	CSqlData::ms_GameContextAvailable = false;
 	int i = 0;
 	while (CSqlExecData::ms_InstanceCount != 0)
@@ -84,14 +120,185 @@ void CSqlScore::OnShutdown()
 		thread_sleep(100000);
 	}
 
+	ms_WorkerPool.Stop();
 	lock_destroy(ms_FailureFileLock);
 }
 
-void CSqlScore::ExecSqlFunc(void *pUser)
+CSqlWorkerPool::CSqlWorkerPool() :
+m_NumWorkers(0),
+m_NumQueuedReads(0),
+m_PeakQueued(0),
+m_NumDone(0),
+m_NumRejected(0),
+m_WaitTime(0),
+m_MaxWaitTime(0),
+m_Full(false)
+{
+	m_Lock = lock_create();
+	sphore_init(&m_Semaphore);
+}
+
+CSqlWorkerPool::~CSqlWorkerPool()
+{
+	Stop();
+	sphore_destroy(&m_Semaphore);
+	lock_destroy(m_Lock);
+}
+
+void CSqlWorkerPool::Start(int NumWorkers)
+{
+	if(m_NumWorkers)
+		return;
+
+	m_NumWorkers = clamp(NumWorkers, 1, (int)MAX_SQL_WORKERS);
+	for(int i = 0; i < m_NumWorkers; i++)
+	{
+		CWorker *pWorker = &m_aWorkers[i];
+		pWorker->m_pPool = this;
+		for(int j = 0; j < MAX_SQLSERVERS; j++)
+		{
+			pWorker->m_apReadServers[j] = 0;
+			pWorker->m_apWriteServers[j] = 0;
+		}
+		pWorker->m_pThread = thread_init(WorkerThread, pWorker, "sql worker");
+	}
+	dbg_msg("sql", "started %d sql workers", m_NumWorkers);
+}
+
+void CSqlWorkerPool::Stop()
+{
+	if(!m_NumWorkers)
+		return;
+
+	// let the workers finish their current query, but not the queued ones
+	lock_wait(m_Lock);
+	for(int i = 0; i < m_NumWorkers; i++)
+		m_Queue.push_front(0);
+	lock_unlock(m_Lock);
+	for(int i = 0; i < m_NumWorkers; i++)
+		sphore_signal(&m_Semaphore);
+	for(int i = 0; i < m_NumWorkers; i++)
+		thread_wait(m_aWorkers[i].m_pThread);
+	m_NumWorkers = 0;
+
+	// the writes go where they would go without a database, into the
+	// failure file or back to the journal
+	int NumDropped = 0;
+	for(unsigned i = 0; i < m_Queue.size(); i++)
+	{
+		CSqlExecData *pData = m_Queue[i];
+		if(!pData)
+			continue;
+		if(!pData->m_ReadOnly)
+		{
+			try {
+				pData->m_pFuncPtr(0, pData->m_pSqlData, true);
+			} catch (...) {
+				dbg_msg("sql", "Unexpected exception caught");
+			}
+		}
+		else
+			NumDropped++;
+		delete pData->m_pSqlData;
+		delete pData;
+	}
+	if(NumDropped)
+		dbg_msg("sql", "dropped %d queued sql queries", NumDropped);
+	m_Queue.clear();
+	m_NumQueuedReads = 0;
+
+	// the semaphore might still count the dropped queries
+	sphore_destroy(&m_Semaphore);
+	sphore_init(&m_Semaphore);
+}
+
+bool CSqlWorkerPool::Add(CSqlExecData *pData)
+{
+	lock_wait(m_Lock);
+	if(pData->m_ReadOnly && m_NumQueuedReads >= g_Config.m_SvSqlQueueSize)
+	{
+		m_NumRejected++;
+		if(!m_Full)
+			dbg_msg("sql", "WARNING: sql queue is full (%d queued), rejecting queries", (int)m_Queue.size());
+		m_Full = true;
+		lock_unlock(m_Lock);
+		return false;
+	}
+	m_Full = false;
+	if(pData->m_ReadOnly)
+		m_NumQueuedReads++;
+	pData->m_QueueTime = time_get();
+	m_Queue.push_back(pData);
+	m_PeakQueued = maximum(m_PeakQueued, (int)m_Queue.size());
+	lock_unlock(m_Lock);
+
+	sphore_signal(&m_Semaphore);
+	return true;
+}
+
+void CSqlWorkerPool::Dump(IConsole *pConsole)
+{
+	lock_wait(m_Lock);
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "workers=%d queued=%d reads=%d peak=%d done=%lld rejected=%lld avg_wait=%.2fms max_wait=%.2fms",
+		m_NumWorkers, (int)m_Queue.size(), m_NumQueuedReads, m_PeakQueued, m_NumDone, m_NumRejected,
+		m_NumDone ? m_WaitTime * 1000.0 / time_freq() / m_NumDone : 0.0, m_MaxWaitTime * 1000.0 / time_freq());
+	lock_unlock(m_Lock);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+}
+
+void CSqlWorkerPool::WorkerThread(void *pUser)
+{
+	CWorker *pWorker = (CWorker *)pUser;
+	CSqlWorkerPool *pPool = pWorker->m_pPool;
+
+	while(true)
+	{
+		sphore_wait(&pPool->m_Semaphore);
+
+		lock_wait(pPool->m_Lock);
+		CSqlExecData *pData = pPool->m_Queue.front();
+		pPool->m_Queue.pop_front();
+		if(pData)
+		{
+			if(pData->m_ReadOnly)
+				pPool->m_NumQueuedReads--;
+			int64 Wait = time_get() - pData->m_QueueTime;
+			pPool->m_NumDone++;
+			pPool->m_WaitTime += Wait;
+			pPool->m_MaxWaitTime = maximum(pPool->m_MaxWaitTime, Wait);
+		}
+		lock_unlock(pPool->m_Lock);
+
+		if(!pData)
+			break;
+		Execute(pWorker, pData);
+	}
+
+	for(int i = 0; i < MAX_SQLSERVERS; i++)
+	{
+		delete pWorker->m_apReadServers[i];
+		delete pWorker->m_apWriteServers[i];
+	}
+}
+
+void CSqlWorkerPool::SyncServers(CWorker *pWorker)
 {
-	CSqlExecData* pData = (CSqlExecData *)pUser;
+	// copy the sql servers added since the last query
+	CSqlConnector Shared;
+	for(int i = 0; i < MAX_SQLSERVERS; i++)
+	{
+		if(!pWorker->m_apReadServers[i] && Shared.SqlServer(i, true))
+			pWorker->m_apReadServers[i] = new CSqlServer(Shared.SqlServer(i, true));
+		if(!pWorker->m_apWriteServers[i] && Shared.SqlServer(i, false))
+			pWorker->m_apWriteServers[i] = new CSqlServer(Shared.SqlServer(i, false));
+	}
+}
 
-	CSqlConnector connector;
+void CSqlWorkerPool::Execute(CWorker *pWorker, CSqlExecData *pData)
+{
+	SyncServers(pWorker);
+	CSqlConnector connector(pWorker->m_apReadServers, pWorker->m_apWriteServers);
 
 	bool Success = false;
 
@@ -102,6 +309,10 @@ void CSqlScore::ExecSqlFunc(void *pUser)
 			try {
 				if (pData->m_pFuncPtr(connector.SqlServer(), pData->m_pSqlData, false))
 					Success = true;
+				// the prepared statements are gone after a reconnect, reads
+				// can safely be tried again with new ones
+				else if (connector.SqlServer()->ClearStatements() && pData->m_ReadOnly)
+					Success = pData->m_pFuncPtr(connector.SqlServer(), pData->m_pSqlData, false);
 			} catch (...) {
 				dbg_msg("sql", "Unexpected exception caught");
 			}
@@ -122,6 +333,17 @@ void CSqlScore::ExecSqlFunc(void *pUser)
 	delete pData;
 }
 
+void CSqlScore::AddJob(CSqlExecData *pData, int ClientID)
+{
+	if(ms_WorkerPool.Add(pData))
+		return;
+
+	if(ClientID >= 0)
+		GameServer()->SendChatTarget(ClientID, "The database is busy, try again in a moment");
+	delete pData->m_pSqlData;
+	delete pData;
+}
+
 bool CSqlScore::Init(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
 {
 	const CSqlData* pData = pGameData;
@@ -165,7 +387,7 @@ void CSqlScore::CheckBirthday(int ClientID)
 	CSqlPlayerData *Tmp = new CSqlPlayerData();
 	Tmp->m_ClientID = ClientID;
 	Tmp->m_Name = Server()->ClientName(ClientID);
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(CheckBirthdayThread, Tmp), "birthday check");
+	AddJob(new CSqlExecData(CheckBirthdayThread, Tmp), ClientID);
 }
 
 bool CSqlScore::CheckBirthdayThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -216,7 +438,7 @@ void CSqlScore::LoadScore(int ClientID)
 	Tmp->m_ClientID = ClientID;
 	Tmp->m_Name = Server()->ClientName(ClientID);
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(LoadScoreThread, Tmp), "load score");
+	AddJob(new CSqlExecData(LoadScoreThread, Tmp), ClientID);
 }
 
 // update stuff
@@ -231,8 +453,11 @@ bool CSqlScore::LoadScoreThread(CSqlServer* pSqlServer, const CSqlData *pGameDat
 	{
 		char aBuf[512];
 
-		str_format(aBuf, sizeof(aBuf), "SELECT * FROM %s_race WHERE Map='%s' AND Name='%s' ORDER BY time ASC LIMIT 1;", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pData->m_Name.ClrStr());
-		pSqlServer->executeSqlQuery(aBuf);
+		str_format(aBuf, sizeof(aBuf), "SELECT * FROM %s_race WHERE Map=? AND Name=? ORDER BY time ASC LIMIT 1;", pSqlServer->GetPrefix());
+		sql::PreparedStatement *pStatement = pSqlServer->PrepareStatement(aBuf);
+		pStatement->setString(1, pData->m_Map.Str());
+		pStatement->setString(2, pData->m_Name.Str());
+		pSqlServer->executeSqlQuery(pStatement);
 		if(pSqlServer->GetResults()->next())
 		{
 			// get the best time
@@ -284,7 +509,7 @@ void CSqlScore::MapVote(std::shared_ptr<CMapVoteResult> *ppResult, int ClientID,
 	sqlstr::ClearString(Tmp->m_aFuzzyMap, sizeof(Tmp->m_aFuzzyMap));
 	sqlstr::FuzzyString(Tmp->m_aFuzzyMap, sizeof(Tmp->m_aFuzzyMap));
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(MapVoteThread, Tmp), "map vote");
+	AddJob(new CSqlExecData(MapVoteThread, Tmp), ClientID);
 }
 
 bool CSqlScore::MapVoteThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -372,7 +597,7 @@ void CSqlScore::MapInfo(int ClientID, const char* MapName)
 	sqlstr::ClearString(Tmp->m_aFuzzyMap, sizeof(Tmp->m_aFuzzyMap));
 	sqlstr::FuzzyString(Tmp->m_aFuzzyMap, sizeof(Tmp->m_aFuzzyMap));
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(MapInfoThread, Tmp), "map info");
+	AddJob(new CSqlExecData(MapInfoThread, Tmp), ClientID);
 }
 
 bool CSqlScore::MapInfoThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -466,268 +691,609 @@ void CSqlScore::SaveScore(int ClientID, float Time, const char *pTimestamp, floa
 	CConsole* pCon = (CConsole*)GameServer()->Console();
 	if(pCon->m_Cheated)
 		return;
-	CSqlScoreData *Tmp = new CSqlScoreData();
-	Tmp->m_ClientID = ClientID;
-	Tmp->m_Name = Server()->ClientName(ClientID);
-	Tmp->m_Time = Time;
-	str_copy(Tmp->m_aTimestamp, pTimestamp, sizeof(Tmp->m_aTimestamp));
-	Tmp->m_NotEligible = NotEligible;
+	if(NotEligible)
+	{
+		// only kept in the failure file, marked for the admins
+		CSqlNotEligible *Tmp = new CSqlNotEligible();
+		sqlstr::CSqlString<MAX_NAME_LENGTH> Name(Server()->ClientName(ClientID));
+		char aBuf[768];
+		str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %%s_race(Map, Name, Timestamp, Time, Server, cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25, GameID) VALUES ('%s', '%s', '%s', '%.2f', '%s'", Tmp->m_Map.ClrStr(), Name.ClrStr(), pTimestamp, Time, g_Config.m_SvSqlServerName);
+		for(int i = 0; i < NUM_CHECKPOINTS; i++)
+		{
+			char aCp[32];
+			str_format(aCp, sizeof(aCp), ", '%.2f'", CpTime[i]);
+			str_append(aBuf, aCp, sizeof(aBuf));
+		}
+		char aEnd[128];
+		str_format(aEnd, sizeof(aEnd), ", '%s'); -- not eligible", Tmp->m_GameUuid.ClrStr());
+		str_append(aBuf, aEnd, sizeof(aBuf));
+		Tmp->m_aLines.push_back(aBuf);
+		AddJob(new CSqlExecData(SaveNotEligibleThread, Tmp, false), -1);
+		return;
+	}
+
+	CScoreJournal::CRaceFinish Finish;
+	Finish.m_ClientID = ClientID;
+	str_copy(Finish.m_aMap, m_aMap, sizeof(Finish.m_aMap));
+	str_copy(Finish.m_aName, Server()->ClientName(ClientID), sizeof(Finish.m_aName));
+	str_copy(Finish.m_aTimestamp, pTimestamp, sizeof(Finish.m_aTimestamp));
+	Finish.m_Time = Time;
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
-		Tmp->m_aCpCurrent[i] = CpTime[i];
+		Finish.m_aCpTime[i] = CpTime[i];
+	str_copy(Finish.m_aGameUuid, m_aGameUuid, sizeof(Finish.m_aGameUuid));
+
+	ms_Journal.Add(&Finish);
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(SaveScoreThread, Tmp, false), "save score");
+	// ranked right away, the reloads keep it until it's in the database
+	lock_wait(ms_LeaderboardsLock);
+	if(ms_MapTimes.Improve(Finish.m_aName, Time))
+	{
+		CLeaderboard::CEntry Entry;
+		str_copy(Entry.m_aName, Finish.m_aName, sizeof(Entry.m_aName));
+		Entry.m_Score = Time;
+		ms_aNewTimes.push_back(Entry);
+	}
+	lock_unlock(ms_LeaderboardsLock);
 }
 
-bool CSqlScore::SaveScoreThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
+void CSqlScore::SaveTeamScore(int* aClientIDs, unsigned int Size, float Time, const char *pTimestamp)
 {
-	const CSqlScoreData *pData = dynamic_cast<const CSqlScoreData *>(pGameData);
+	CConsole* pCon = (CConsole*)GameServer()->Console();
+	if(pCon->m_Cheated)
+		return;
 
-	if (HandleFailure)
+	CScoreJournal::CTeamFinish Finish;
+	str_copy(Finish.m_aMap, m_aMap, sizeof(Finish.m_aMap));
+	str_copy(Finish.m_aTimestamp, pTimestamp, sizeof(Finish.m_aTimestamp));
+	Finish.m_Time = Time;
+	str_copy(Finish.m_aGameUuid, m_aGameUuid, sizeof(Finish.m_aGameUuid));
+	Finish.m_Size = Size;
+	bool NotEligible = false;
+	for(unsigned int i = 0; i < Size; i++)
 	{
-		if (!g_Config.m_SvSqlFailureFile[0])
-			return true;
+		str_copy(Finish.m_aaNames[i], Server()->ClientName(aClientIDs[i]), sizeof(Finish.m_aaNames[i]));
+		NotEligible = NotEligible || GameServer()->m_apPlayers[aClientIDs[i]]->m_NotEligibleForFinish;
+	}
 
-		lock_wait(ms_FailureFileLock);
-		IOHANDLE File = io_open(g_Config.m_SvSqlFailureFile, IOFLAG_APPEND);
-		if(File)
-		{
-			dbg_msg("sql", "ERROR: Could not save Score, writing insert to a file now...");
+	if(!NotEligible)
+	{
+		ms_Journal.Add(&Finish);
+		return;
+	}
 
-			char aBuf[768];
-				str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %%s_race(Map, Name, Timestamp, Time, Server, cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25, GameID) VALUES ('%s', '%s', '%s', '%.2f', '%s', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%s');%s", pData->m_Map.ClrStr(), pData->m_Name.ClrStr(), pData->m_aTimestamp, pData->m_Time, g_Config.m_SvSqlServerName, pData->m_aCpCurrent[0], pData->m_aCpCurrent[1], pData->m_aCpCurrent[2], pData->m_aCpCurrent[3], pData->m_aCpCurrent[4], pData->m_aCpCurrent[5], pData->m_aCpCurrent[6], pData->m_aCpCurrent[7], pData->m_aCpCurrent[8], pData->m_aCpCurrent[9], pData->m_aCpCurrent[10], pData->m_aCpCurrent[11], pData->m_aCpCurrent[12], pData->m_aCpCurrent[13], pData->m_aCpCurrent[14], pData->m_aCpCurrent[15], pData->m_aCpCurrent[16], pData->m_aCpCurrent[17], pData->m_aCpCurrent[18], pData->m_aCpCurrent[19], pData->m_aCpCurrent[20], pData->m_aCpCurrent[21], pData->m_aCpCurrent[22], pData->m_aCpCurrent[23], pData->m_aCpCurrent[24], pData->m_GameUuid.ClrStr(), pData->m_NotEligible ? " -- not eligible" : "");
-				io_write(File, aBuf, str_length(aBuf));
-				io_write_newline(File);
-				io_close(File);
-				lock_unlock(ms_FailureFileLock);
+	// only kept in the failure file, marked for the admins
+	CSqlNotEligible *Tmp = new CSqlNotEligible();
+	Tmp->m_aLines.push_back("SET @id = UUID();");
+	for(unsigned int i = 0; i < Size; i++)
+	{
+		sqlstr::CSqlString<MAX_NAME_LENGTH> Name(Finish.m_aaNames[i]);
+		char aBuf[512];
+		str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %%s_teamrace(Map, Name, Timestamp, Time, ID, GameID) VALUES ('%s', '%s', '%s', '%.2f', @id, '%s'); -- not eligible", Tmp->m_Map.ClrStr(), Name.ClrStr(), pTimestamp, Time, Tmp->m_GameUuid.ClrStr());
+		Tmp->m_aLines.push_back(aBuf);
+	}
+	AddJob(new CSqlExecData(SaveNotEligibleThread, Tmp, false), -1);
+}
 
-				pData->GameServer()->SendBroadcast("Database connection failed, score written to a file instead. Admins will add it manually in a few days.", -1);
+bool CSqlScore::SaveNotEligibleThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
+{
+	const CSqlNotEligible *pData = dynamic_cast<const CSqlNotEligible *>(pGameData);
 
-			return true;
+	// written the same with and without a database
+	if (!g_Config.m_SvSqlFailureFile[0])
+		return true;
+
+	lock_wait(ms_FailureFileLock);
+	IOHANDLE File = io_open(g_Config.m_SvSqlFailureFile, IOFLAG_APPEND);
+	if(File)
+	{
+		for(unsigned i = 0; i < pData->m_aLines.size(); i++)
+		{
+			io_write(File, pData->m_aLines[i].c_str(), pData->m_aLines[i].size());
+			io_write_newline(File);
 		}
-		lock_unlock(ms_FailureFileLock);
-		dbg_msg("sql", "ERROR: Could not save Score, NOT even to a file");
-		return false;
+		io_close(File);
 	}
+	lock_unlock(ms_FailureFileLock);
+	if(!File)
+		dbg_msg("sql", "ERROR: Could not write the finish that isn't eligible to a file");
+	return true;
+}
 
-	if(pData->m_NotEligible)
-	{
+void CSqlScore::AddBatch(const char *pPath, bool Replay)
+{
+	CSqlScoreBatch *Tmp = new CSqlScoreBatch();
+	str_copy(Tmp->m_aPath, pPath, sizeof(Tmp->m_aPath));
+	Tmp->m_Replay = Replay;
+	AddJob(new CSqlExecData(SaveScoresThread, Tmp, false), -1);
+}
+
+void CSqlScore::FlushJournal()
+{
+	ms_Journal.Seal();
+	ms_Journal.Wait();
+
+	char aPath[512];
+	while(ms_Journal.PopSealed(aPath, sizeof(aPath)))
+		AddBatch(aPath, false);
+}
+
+void CSqlScore::OnTick()
+{
+	int NumFinishes = ms_Journal.NumFinishes();
+	if(NumFinishes && (NumFinishes >= g_Config.m_SvSqlBatchSize || time_get() - ms_Journal.FirstFinish() >= g_Config.m_SvSqlBatchInterval * time_freq()))
+		ms_Journal.Seal();
+
+	// the segments are saved once the journal wrote them
+	char aPath[512];
+	while(ms_Journal.PopSealed(aPath, sizeof(aPath)))
+		AddBatch(aPath, false);
+
+	if(g_Config.m_SvSqlLeaderboard && time_get() - m_LastLeaderboardsLoad >= g_Config.m_SvSqlLeaderboardInterval * time_freq())
+		LoadLeaderboards();
+
+	// try the failed batches again about once a minute
+	if(time_get() - ms_LastBatchRetry < 60 * time_freq())
+		return;
+	ms_LastBatchRetry = time_get();
+
+	std::vector<std::string> aFailed;
+	lock_wait(ms_FailedBatchesLock);
+	aFailed.swap(ms_aFailedBatches);
+	lock_unlock(ms_FailedBatchesLock);
+	for(unsigned i = 0; i < aFailed.size(); i++)
+		AddBatch(aFailed[i].c_str(), true);
+}
+
+void CSqlScore::LoadLeaderboards()
+{
+	m_LastLeaderboardsLoad = time_get();
+	if(g_Config.m_SvSqlLeaderboard)
+		AddJob(new CSqlExecData(LoadLeaderboardsThread, new CSqlData()), -1);
+}
+
+bool CSqlScore::UseLeaderboards()
+{
+	if(!g_Config.m_SvSqlLeaderboard)
 		return false;
-	}
+	lock_wait(ms_LeaderboardsLock);
+	bool Loaded = ms_LeaderboardsLoaded;
+	lock_unlock(ms_LeaderboardsLock);
+	return Loaded;
+}
+
+bool CSqlScore::LoadLeaderboardsThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
+{
+	const CSqlData *pData = pGameData;
+
+	// the queries are answered by the database until the next try
+	if (HandleFailure)
+		return true;
 
 	try
 	{
-		char aBuf[768];
+		char aBuf[512];
+		std::vector<CLeaderboard::CEntry> aTimes;
+		str_format(aBuf, sizeof(aBuf), "SELECT Name, min(Time) as Time FROM %s_race WHERE Map = ? GROUP BY Name;", pSqlServer->GetPrefix());
+		sql::PreparedStatement *pStatement = pSqlServer->PrepareStatement(aBuf);
+		pStatement->setString(1, pData->m_Map.Str());
+		pSqlServer->executeSqlQuery(pStatement);
+		while(pSqlServer->GetResults()->next())
+		{
+			CLeaderboard::CEntry Entry;
+			str_copy(Entry.m_aName, pSqlServer->GetResults()->getString("Name").c_str(), sizeof(Entry.m_aName));
+			Entry.m_Score = (float)pSqlServer->GetResults()->getDouble("Time");
+			aTimes.push_back(Entry);
+		}
 
-		str_format(aBuf, sizeof(aBuf), "SELECT * FROM %s_race WHERE Map='%s' AND Name='%s' ORDER BY time ASC LIMIT 1;", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pData->m_Name.ClrStr());
+		std::vector<CLeaderboard::CEntry> aPoints;
+		str_format(aBuf, sizeof(aBuf), "SELECT Name, Points FROM %s_points;", pSqlServer->GetPrefix());
 		pSqlServer->executeSqlQuery(aBuf);
-		if(!pSqlServer->GetResults()->next())
+		while(pSqlServer->GetResults()->next())
 		{
-			str_format(aBuf, sizeof(aBuf), "SELECT Points FROM %s_maps WHERE Map ='%s'", pSqlServer->GetPrefix(), pData->m_Map.ClrStr());
-			pSqlServer->executeSqlQuery(aBuf);
-
-			if(pSqlServer->GetResults()->rowsCount() == 1)
-			{
-				pSqlServer->GetResults()->next();
-				int points = pSqlServer->GetResults()->getInt("Points");
-				if (points == 1)
-					str_format(aBuf, sizeof(aBuf), "You earned %d point for finishing this map!", points);
-				else
-					str_format(aBuf, sizeof(aBuf), "You earned %d points for finishing this map!", points);
-
-				try
-				{
-					pData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-				}
-				catch (CGameContextError &e) {} // just do nothing, it is not much of a problem if the player is not informed about points during mapchange
-
-				str_format(aBuf, sizeof(aBuf), "INSERT INTO %s_points(Name, Points) VALUES ('%s', '%d') ON duplicate key UPDATE Name=VALUES(Name), Points=Points+VALUES(Points);", pSqlServer->GetPrefix(), pData->m_Name.ClrStr(), points);
-				pSqlServer->executeSql(aBuf);
-			}
+			CLeaderboard::CEntry Entry;
+			str_copy(Entry.m_aName, pSqlServer->GetResults()->getString("Name").c_str(), sizeof(Entry.m_aName));
+			Entry.m_Score = pSqlServer->GetResults()->getInt("Points");
+			aPoints.push_back(Entry);
 		}
 
-		// if no entry found... create a new one
-		str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %s_race(Map, Name, Timestamp, Time, Server, cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25, GameID) VALUES ('%s', '%s', '%s', '%.2f', '%s', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%s');", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pData->m_Name.ClrStr(), pData->m_aTimestamp, pData->m_Time, g_Config.m_SvSqlServerName, pData->m_aCpCurrent[0], pData->m_aCpCurrent[1], pData->m_aCpCurrent[2], pData->m_aCpCurrent[3], pData->m_aCpCurrent[4], pData->m_aCpCurrent[5], pData->m_aCpCurrent[6], pData->m_aCpCurrent[7], pData->m_aCpCurrent[8], pData->m_aCpCurrent[9], pData->m_aCpCurrent[10], pData->m_aCpCurrent[11], pData->m_aCpCurrent[12], pData->m_aCpCurrent[13], pData->m_aCpCurrent[14], pData->m_aCpCurrent[15], pData->m_aCpCurrent[16], pData->m_aCpCurrent[17], pData->m_aCpCurrent[18], pData->m_aCpCurrent[19], pData->m_aCpCurrent[20], pData->m_aCpCurrent[21], pData->m_aCpCurrent[22], pData->m_aCpCurrent[23], pData->m_aCpCurrent[24], pData->m_GameUuid.ClrStr());
-		dbg_msg("sql", "%s", aBuf);
-		pSqlServer->executeSql(aBuf);
+		// the new leaderboards are sorted without the lock, the game
+		// only waits for the swap
+		int NumTimes = aTimes.size();
+		lock_wait(ms_LeaderboardsLock);
+		unsigned NumNew = ms_aNewTimes.size();
+		aTimes.insert(aTimes.end(), ms_aNewTimes.begin(), ms_aNewTimes.end());
+		lock_unlock(ms_LeaderboardsLock);
+
+		CLeaderboard Times(false);
+		Times.Load(aTimes);
+		CLeaderboard Points(true);
+		Points.Load(aPoints);
+
+		lock_wait(ms_LeaderboardsLock);
+		// the map might have changed in the meantime
+		if(pData->m_Instance == CSqlData::ms_Instance)
+		{
+			// and times might have been set
+			for(unsigned i = NumNew; i < ms_aNewTimes.size(); i++)
+				Times.Improve(ms_aNewTimes[i].m_aName, ms_aNewTimes[i].m_Score);
+			ms_MapTimes.Swap(Times);
+			ms_Points.Swap(Points);
+			ms_LeaderboardsLoaded = true;
+		}
+		lock_unlock(ms_LeaderboardsLock);
 
-		dbg_msg("sql", "Updating time done");
+		dbg_msg("sql", "Loading leaderboards done (%d times, %d players with points)", NumTimes, (int)aPoints.size());
 		return true;
 	}
 	catch (sql::SQLException &e)
 	{
 		dbg_msg("sql", "MySQL Error: %s", e.what());
-		dbg_msg("sql", "ERROR: Could not update time");
+		dbg_msg("sql", "ERROR: Could not load leaderboards");
 	}
 	return false;
 }
 
-void CSqlScore::SaveTeamScore(int* aClientIDs, unsigned int Size, float Time, const char *pTimestamp)
-{
-	CConsole* pCon = (CConsole*)GameServer()->Console();
-	if(pCon->m_Cheated)
-		return;
-	CSqlTeamScoreData *Tmp = new CSqlTeamScoreData();
-	Tmp->m_NotEligible = false;
-	for(unsigned int i = 0; i < Size; i++)
-	{
-		Tmp->m_aClientIDs[i] = aClientIDs[i];
-		Tmp->m_aNames[i] = Server()->ClientName(aClientIDs[i]);
-		Tmp->m_NotEligible = Tmp->m_NotEligible || GameServer()->m_apPlayers[aClientIDs[i]]->m_NotEligibleForFinish;
-	}
-	Tmp->m_Size = Size;
-	Tmp->m_Time = Time;
-	str_copy(Tmp->m_aTimestamp, pTimestamp, sizeof(Tmp->m_aTimestamp));
-
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(SaveTeamScoreThread, Tmp, false), "save team score");
-}
-
-bool CSqlScore::SaveTeamScoreThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
+bool CSqlScore::SaveScoresThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
 {
-	const CSqlTeamScoreData *pData = dynamic_cast<const CSqlTeamScoreData *>(pGameData);
+	const CSqlScoreBatch *pData = dynamic_cast<const CSqlScoreBatch *>(pGameData);
 
 	if (HandleFailure)
 	{
-		if (!g_Config.m_SvSqlFailureFile[0])
-			return true;
+		// the finishes stay in the journal
+		dbg_msg("sql", "ERROR: Could not save scores, keeping '%s' to try again", pData->m_aPath);
+		lock_wait(ms_FailedBatchesLock);
+		ms_aFailedBatches.push_back(pData->m_aPath);
+		lock_unlock(ms_FailedBatchesLock);
 
-		dbg_msg("sql", "ERROR: Could not save TeamScore, writing insert to a file now...");
-
-		lock_wait(ms_FailureFileLock);
-		IOHANDLE File = io_open(g_Config.m_SvSqlFailureFile, IOFLAG_APPEND);
-		if(File)
+		try
 		{
-			const char pUUID[] = "SET @id = UUID();";
-			io_write(File, pUUID, sizeof(pUUID) - 1);
-			io_write_newline(File);
+			if(!pData->m_Replay)
+				pData->GameServer()->SendBroadcast("Database connection failed, the scores will be saved once it is back.", -1);
+		}
+		catch (CGameContextError &e) {}
+		return true;
+	}
 
-			char aBuf[2300];
-			for(unsigned int i = 0; i < pData->m_Size; i++)
-			{
-				str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %%s_teamrace(Map, Name, Timestamp, Time, ID, GameID) VALUES ('%s', '%s', '%s', '%.2f', @id, '%s');%s", pData->m_Map.ClrStr(), pData->m_aNames[i].ClrStr(), pData->m_aTimestamp, pData->m_Time, pData->m_GameUuid.ClrStr(), pData->m_NotEligible ? " -- not eligible" : "");
-				io_write(File, aBuf, str_length(aBuf));
-				io_write_newline(File);
-			}
-			io_close(File);
-			lock_unlock(ms_FailureFileLock);
-			return true;
+	CScoreJournal::CSegment Segment;
+	if(!CScoreJournal::Read(pData->m_aPath, &Segment))
+	{
+		dbg_msg("sql", "ERROR: Could not read '%s'", pData->m_aPath);
+		return true;
+	}
+
+	// the points earned by each finish, -1 if none
+	std::vector<int> aPoints;
+	try
+	{
+		pSqlServer->executeSql("START TRANSACTION;");
+		if(pData->m_Replay)
+			RemoveSavedFinishes(pSqlServer, &Segment);
+		SaveRaceFinishes(pSqlServer, Segment.m_aRaceFinishes, &aPoints);
+		for(unsigned i = 0; i < Segment.m_aTeamFinishes.size(); i++)
+			SaveTeamFinish(pSqlServer, &Segment.m_aTeamFinishes[i]);
+		pSqlServer->executeSql("COMMIT;");
+	}
+	catch (sql::SQLException &e)
+	{
+		dbg_msg("sql", "MySQL Error: %s", e.what());
+		dbg_msg("sql", "ERROR: Could not save scores");
+		try
+		{
+			pSqlServer->executeSql("ROLLBACK;");
 		}
-		lock_unlock(ms_FailureFileLock);
+		catch (sql::SQLException &e) {}
 		return false;
 	}
 
-	if(pData->m_NotEligible)
+	fs_remove(pData->m_aPath);
+	dbg_msg("sql", "Saving %d times and %d team times done", (int)Segment.m_aRaceFinishes.size(), (int)Segment.m_aTeamFinishes.size());
+
+	lock_wait(ms_LeaderboardsLock);
+	for(unsigned i = 0; i < Segment.m_aRaceFinishes.size(); i++)
 	{
-		return false;
+		if(aPoints[i] < 0)
+			continue;
+		int Rank;
+		float Points = 0;
+		ms_Points.Find(Segment.m_aRaceFinishes[i].m_aName, &Rank, &Points);
+		ms_Points.Set(Segment.m_aRaceFinishes[i].m_aName, Points + aPoints[i]);
 	}
+	lock_unlock(ms_LeaderboardsLock);
 
 	try
 	{
-		char aBuf[2300];
-		char aUpdateID[17];
-		aUpdateID[0] = 0;
+		char aBuf[128];
+		for(unsigned i = 0; i < Segment.m_aRaceFinishes.size(); i++)
+		{
+			const CScoreJournal::CRaceFinish *pFinish = &Segment.m_aRaceFinishes[i];
+			// only the players of the current game are still there, and the
+			// slot may have been taken by someone else since the finish
+			if(aPoints[i] < 0 || str_comp(pFinish->m_aGameUuid, pData->m_GameUuid.Str()) != 0 ||
+				str_comp(pData->Server()->ClientName(pFinish->m_ClientID), pFinish->m_aName) != 0)
+				continue;
+			if (aPoints[i] == 1)
+				str_format(aBuf, sizeof(aBuf), "You earned %d point for finishing this map!", aPoints[i]);
+			else
+				str_format(aBuf, sizeof(aBuf), "You earned %d points for finishing this map!", aPoints[i]);
+			pData->GameServer()->SendChatTarget(pFinish->m_ClientID, aBuf);
+		}
+	}
+	catch (CGameContextError &e) {} // just do nothing, it is not much of a problem if the player is not informed about points during mapchange
 
-		str_format(aBuf, sizeof(aBuf), "SELECT Name, l.ID, Time FROM ((SELECT ID FROM %s_teamrace WHERE Map = '%s' AND Name = '%s') as l) LEFT JOIN %s_teamrace as r ON l.ID = r.ID ORDER BY ID;", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pData->m_aNames[0].ClrStr(), pSqlServer->GetPrefix());
-		pSqlServer->executeSqlQuery(aBuf);
+	return true;
+}
 
-		if (pSqlServer->GetResults()->rowsCount() > 0)
+void CSqlScore::RemoveSavedFinishes(CSqlServer* pSqlServer, CScoreJournal::CSegment *pSegment)
+{
+	// the finishes of a game have its id, look for the ones of each game
+	for(int Team = 0; Team < 2; Team++)
+	{
+		std::vector<std::string> aGames;
+		std::vector<std::string> aSaved;
+		int Num = Team ? pSegment->m_aTeamFinishes.size() : pSegment->m_aRaceFinishes.size();
+		for(int i = 0; i < Num; i++)
 		{
-			char aID[17];
-			char aID2[17];
-			char aName[64];
-			unsigned int Count = 0;
-			bool ValidNames = true;
+			const char *pMap = Team ? pSegment->m_aTeamFinishes[i].m_aMap : pSegment->m_aRaceFinishes[i].m_aMap;
+			const char *pGameUuid = Team ? pSegment->m_aTeamFinishes[i].m_aGameUuid : pSegment->m_aRaceFinishes[i].m_aGameUuid;
+			std::string Game = std::string(pMap) + "\t" + pGameUuid;
+			if(std::find(aGames.begin(), aGames.end(), Game) != aGames.end())
+				continue;
+			aGames.push_back(Game);
 
-			pSqlServer->GetResults()->first();
-			float Time = (float)pSqlServer->GetResults()->getDouble("Time");
-			strcpy(aID, pSqlServer->GetResults()->getString("ID").c_str());
+			char aBuf[512];
+			sqlstr::CSqlString<128> Map(pMap);
+			sqlstr::CSqlString<UUID_MAXSTRSIZE> GameUuid(pGameUuid);
+			str_format(aBuf, sizeof(aBuf), "SELECT Name, Timestamp FROM %s_%s WHERE Map = '%s' AND GameID = '%s';", pSqlServer->GetPrefix(), Team ? "teamrace" : "race", Map.ClrStr(), GameUuid.ClrStr());
+			pSqlServer->executeSqlQuery(aBuf);
+			while(pSqlServer->GetResults()->next())
+				aSaved.push_back(Game + "\t" + pSqlServer->GetResults()->getString("Name").c_str() + "\t" + pSqlServer->GetResults()->getString("Timestamp").c_str());
+		}
 
-			do
+		int NumRemoved = 0;
+		for(int i = Num - 1; i >= 0; i--)
+		{
+			std::string Finish;
+			if(Team)
 			{
-				strcpy(aID2, pSqlServer->GetResults()->getString("ID").c_str());
-				strcpy(aName, pSqlServer->GetResults()->getString("Name").c_str());
-				sqlstr::ClearString(aName);
-				if (str_comp(aID, aID2) != 0)
-				{
-					if (ValidNames && Count == pData->m_Size)
-					{
-						if (pData->m_Time < Time)
-							strcpy(aUpdateID, aID);
-						else
-							goto end;
-						break;
-					}
+				const CScoreJournal::CTeamFinish *pFinish = &pSegment->m_aTeamFinishes[i];
+				Finish = std::string(pFinish->m_aMap) + "\t" + pFinish->m_aGameUuid + "\t" + pFinish->m_aaNames[0] + "\t" + pFinish->m_aTimestamp;
+			}
+			else
+			{
+				const CScoreJournal::CRaceFinish *pFinish = &pSegment->m_aRaceFinishes[i];
+				Finish = std::string(pFinish->m_aMap) + "\t" + pFinish->m_aGameUuid + "\t" + pFinish->m_aName + "\t" + pFinish->m_aTimestamp;
+			}
+			if(std::find(aSaved.begin(), aSaved.end(), Finish) == aSaved.end())
+				continue;
+			if(Team)
+				pSegment->m_aTeamFinishes.erase(pSegment->m_aTeamFinishes.begin() + i);
+			else
+				pSegment->m_aRaceFinishes.erase(pSegment->m_aRaceFinishes.begin() + i);
+			NumRemoved++;
+		}
+		if(NumRemoved)
+			dbg_msg("sql", "%d %s were saved already", NumRemoved, Team ? "team times" : "times");
+	}
+}
 
-					Time = (float)pSqlServer->GetResults()->getDouble("Time");
-					ValidNames = true;
-					Count = 0;
-					strcpy(aID, aID2);
-				}
+void CSqlScore::SaveRaceFinishes(CSqlServer* pSqlServer, const std::vector<CScoreJournal::CRaceFinish> &aFinishes, std::vector<int> *pPoints)
+{
+	pPoints->assign(aFinishes.size(), -1);
+	std::vector<bool> aDone(aFinishes.size(), false);
+	char aBuf[1024];
 
-				if (!ValidNames)
-					continue;
+	for(unsigned First = 0; First < aFinishes.size(); First++)
+	{
+		if(aDone[First])
+			continue;
 
-				ValidNames = false;
+		// all finishes on the map of this one
+		sqlstr::CSqlString<128> Map(aFinishes[First].m_aMap);
+		std::vector<int> aIndices;
+		for(unsigned i = First; i < aFinishes.size(); i++)
+		{
+			if(!aDone[i] && str_comp(aFinishes[i].m_aMap, aFinishes[First].m_aMap) == 0)
+			{
+				aIndices.push_back(i);
+				aDone[i] = true;
+			}
+		}
 
-				for(unsigned int i = 0; i < pData->m_Size; i++)
-				{
-					if (str_comp(aName, pData->m_aNames[i].ClrStr()) == 0)
-					{
-						ValidNames = true;
-						Count++;
-						break;
-					}
-				}
-			} while (pSqlServer->GetResults()->next());
+		int Points = -1;
+		str_format(aBuf, sizeof(aBuf), "SELECT Points FROM %s_maps WHERE Map ='%s'", pSqlServer->GetPrefix(), Map.ClrStr());
+		pSqlServer->executeSqlQuery(aBuf);
+		if(pSqlServer->GetResults()->rowsCount() == 1)
+		{
+			pSqlServer->GetResults()->next();
+			Points = pSqlServer->GetResults()->getInt("Points");
+		}
 
-			if (ValidNames && Count == pData->m_Size)
+		// the players finishing the map for the first time get its points
+		std::vector<std::string> aFinished;
+		if(Points >= 0)
+		{
+			str_format(aBuf, sizeof(aBuf), "SELECT DISTINCT Name FROM %s_race WHERE Map = '%s' AND Name IN (", pSqlServer->GetPrefix(), Map.ClrStr());
+			std::string Query = aBuf;
+			for(unsigned j = 0; j < aIndices.size(); j++)
 			{
-				if (pData->m_Time < Time)
-					strcpy(aUpdateID, aID);
-				else
-					goto end;
+				sqlstr::CSqlString<MAX_NAME_LENGTH> Name(aFinishes[aIndices[j]].m_aName);
+				Query += j ? ", '" : "'";
+				Query += Name.ClrStr();
+				Query += "'";
 			}
+			Query += ");";
+			pSqlServer->executeSqlQuery(Query.c_str());
+			while(pSqlServer->GetResults()->next())
+				aFinished.push_back(pSqlServer->GetResults()->getString("Name").c_str());
+
+			str_format(aBuf, sizeof(aBuf), "INSERT INTO %s_points(Name, Points) VALUES ", pSqlServer->GetPrefix());
+			Query = aBuf;
+			int NumFirst = 0;
+			for(unsigned j = 0; j < aIndices.size(); j++)
+			{
+				const CScoreJournal::CRaceFinish *pFinish = &aFinishes[aIndices[j]];
+				if(std::find(aFinished.begin(), aFinished.end(), pFinish->m_aName) != aFinished.end())
+					continue;
+				aFinished.push_back(pFinish->m_aName);
+				(*pPoints)[aIndices[j]] = Points;
+
+				sqlstr::CSqlString<MAX_NAME_LENGTH> Name(pFinish->m_aName);
+				str_format(aBuf, sizeof(aBuf), "%s('%s', '%d')", NumFirst++ ? ", " : "", Name.ClrStr(), Points);
+				Query += aBuf;
+			}
+			Query += " ON duplicate key UPDATE Name=VALUES(Name), Points=Points+VALUES(Points);";
+			if(NumFirst)
+				pSqlServer->executeSql(Query.c_str());
 		}
 
-		if (aUpdateID[0])
+		str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %s_race(Map, Name, Timestamp, Time, Server, cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25, GameID) VALUES ", pSqlServer->GetPrefix());
+		std::string Query = aBuf;
+		for(unsigned j = 0; j < aIndices.size(); j++)
 		{
-			str_format(aBuf, sizeof(aBuf), "UPDATE %s_teamrace SET Time='%.2f', Timestamp='%s' WHERE ID = '%s';", pSqlServer->GetPrefix(), pData->m_Time, pData->m_aTimestamp, aUpdateID);
-			dbg_msg("sql", "%s", aBuf);
-			pSqlServer->executeSql(aBuf);
+			const CScoreJournal::CRaceFinish *pFinish = &aFinishes[aIndices[j]];
+			sqlstr::CSqlString<MAX_NAME_LENGTH> Name(pFinish->m_aName);
+			sqlstr::CSqlString<UUID_MAXSTRSIZE> GameUuid(pFinish->m_aGameUuid);
+			const float *pCp = pFinish->m_aCpTime;
+			str_format(aBuf, sizeof(aBuf), "%s('%s', '%s', '%s', '%.2f', '%s', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%s')", j ? ", " : "", Map.ClrStr(), Name.ClrStr(), pFinish->m_aTimestamp, pFinish->m_Time, g_Config.m_SvSqlServerName, pCp[0], pCp[1], pCp[2], pCp[3], pCp[4], pCp[5], pCp[6], pCp[7], pCp[8], pCp[9], pCp[10], pCp[11], pCp[12], pCp[13], pCp[14], pCp[15], pCp[16], pCp[17], pCp[18], pCp[19], pCp[20], pCp[21], pCp[22], pCp[23], pCp[24], GameUuid.ClrStr());
+			Query += aBuf;
 		}
-		else
+		Query += ";";
+		pSqlServer->executeSql(Query.c_str());
+	}
+}
+
+void CSqlScore::SaveTeamFinish(CSqlServer* pSqlServer, const CScoreJournal::CTeamFinish *pFinish)
+{
+	sqlstr::CSqlString<128> Map(pFinish->m_aMap);
+	sqlstr::CSqlString<UUID_MAXSTRSIZE> GameUuid(pFinish->m_aGameUuid);
+	sqlstr::CSqlString<MAX_NAME_LENGTH> aNames[MAX_CLIENTS];
+	for(int i = 0; i < pFinish->m_Size; i++)
+		aNames[i] = pFinish->m_aaNames[i];
+
+	char aBuf[2300];
+	char aUpdateID[17];
+	aUpdateID[0] = 0;
+
+	str_format(aBuf, sizeof(aBuf), "SELECT Name, l.ID, Time FROM ((SELECT ID FROM %s_teamrace WHERE Map = '%s' AND Name = '%s') as l) LEFT JOIN %s_teamrace as r ON l.ID = r.ID ORDER BY ID;", pSqlServer->GetPrefix(), Map.ClrStr(), aNames[0].ClrStr(), pSqlServer->GetPrefix());
+	pSqlServer->executeSqlQuery(aBuf);
+
+	if (pSqlServer->GetResults()->rowsCount() > 0)
+	{
+		char aID[17];
+		char aID2[17];
+		char aName[64];
+		int Count = 0;
+		bool ValidNames = true;
+
+		pSqlServer->GetResults()->first();
+		float Time = (float)pSqlServer->GetResults()->getDouble("Time");
+		strcpy(aID, pSqlServer->GetResults()->getString("ID").c_str());
+
+		do
 		{
-			pSqlServer->executeSql("SET @id = UUID();");
+			strcpy(aID2, pSqlServer->GetResults()->getString("ID").c_str());
+			strcpy(aName, pSqlServer->GetResults()->getString("Name").c_str());
+			sqlstr::ClearString(aName);
+			if (str_comp(aID, aID2) != 0)
+			{
+				if (ValidNames && Count == pFinish->m_Size)
+				{
+					// the same team has a time already
+					if (pFinish->m_Time >= Time)
+						return;
+					strcpy(aUpdateID, aID);
+					break;
+				}
+
+				Time = (float)pSqlServer->GetResults()->getDouble("Time");
+				ValidNames = true;
+				Count = 0;
+				strcpy(aID, aID2);
+			}
 
-			for(unsigned int i = 0; i < pData->m_Size; i++)
+			if (!ValidNames)
+				continue;
+
+			ValidNames = false;
+
+			for(int i = 0; i < pFinish->m_Size; i++)
 			{
-			// if no entry found... create a new one
-				str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %s_teamrace(Map, Name, Timestamp, Time, ID, GameID) VALUES ('%s', '%s', '%s', '%.2f', @id, '%s');", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pData->m_aNames[i].ClrStr(), pData->m_aTimestamp, pData->m_Time, pData->m_GameUuid.ClrStr());
-				dbg_msg("sql", "%s", aBuf);
-				pSqlServer->executeSql(aBuf);
+				if (str_comp(aName, aNames[i].ClrStr()) == 0)
+				{
+					ValidNames = true;
+					Count++;
+					break;
+				}
 			}
+		} while (pSqlServer->GetResults()->next());
+
+		if (!aUpdateID[0] && ValidNames && Count == pFinish->m_Size)
+		{
+			if (pFinish->m_Time >= Time)
+				return;
+			strcpy(aUpdateID, aID);
 		}
+	}
 
-		end:
-		dbg_msg("sql", "Updating team time done");
-		return true;
+	if (aUpdateID[0])
+	{
+		str_format(aBuf, sizeof(aBuf), "UPDATE %s_teamrace SET Time='%.2f', Timestamp='%s' WHERE ID = '%s';", pSqlServer->GetPrefix(), pFinish->m_Time, pFinish->m_aTimestamp, aUpdateID);
+		dbg_msg("sql", "%s", aBuf);
+		pSqlServer->executeSql(aBuf);
 	}
-	catch (sql::SQLException &e)
+	else
 	{
-		dbg_msg("sql", "MySQL Error: %s", e.what());
-		dbg_msg("sql", "ERROR: Could not update time");
+		pSqlServer->executeSql("SET @id = UUID();");
+
+		// all members of the team in one insert
+		str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %s_teamrace(Map, Name, Timestamp, Time, ID, GameID) VALUES ", pSqlServer->GetPrefix());
+		std::string Query = aBuf;
+		for(int i = 0; i < pFinish->m_Size; i++)
+		{
+			str_format(aBuf, sizeof(aBuf), "%s('%s', '%s', '%s', '%.2f', @id, '%s')", i ? ", " : "", Map.ClrStr(), aNames[i].ClrStr(), pFinish->m_aTimestamp, pFinish->m_Time, GameUuid.ClrStr());
+			Query += aBuf;
+		}
+		Query += ";";
+		pSqlServer->executeSql(Query.c_str());
 	}
-	return false;
 }
 
 void CSqlScore::ShowRank(int ClientID, const char* pName, bool Search)
 {
+	if(UseLeaderboards())
+	{
+		int Rank;
+		float Time;
+		lock_wait(ms_LeaderboardsLock);
+		bool Ranked = ms_MapTimes.Find(pName, &Rank, &Time);
+		lock_unlock(ms_LeaderboardsLock);
+
+		char aBuf[600];
+		if(!Ranked)
+		{
+			str_format(aBuf, sizeof(aBuf), "%s is not ranked", pName);
+			GameServer()->SendChatTarget(ClientID, aBuf);
+		}
+		else if(g_Config.m_SvHideScore)
+		{
+			str_format(aBuf, sizeof(aBuf), "Your time: %02d:%05.2f", (int)(Time/60), Time-((int)Time/60*60));
+			GameServer()->SendChatTarget(ClientID, aBuf);
+		}
+		else
+		{
+			str_format(aBuf, sizeof(aBuf), "%d. %s Time: %02d:%05.2f, requested by %s", Rank, pName, (int)(Time/60), Time-((int)Time/60*60), Server()->ClientName(ClientID));
+			GameServer()->SendChat(-1, CGameContext::CHAT_ALL, aBuf, ClientID);
+		}
+		return;
+	}
+
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_ClientID = ClientID;
 	Tmp->m_Name = pName;
 	Tmp->m_Search = Search;
 	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientID), sizeof(Tmp->m_aRequestingPlayer));
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(ShowRankThread, Tmp), "show rank");
+	AddJob(new CSqlExecData(ShowRankThread, Tmp), ClientID);
 }
 
 bool CSqlScore::ShowRankThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -745,9 +1311,11 @@ bool CSqlScore::ShowRankThread(CSqlServer* pSqlServer, const CSqlData *pGameData
 		pSqlServer->executeSql("SET @prev := NULL;");
 		pSqlServer->executeSql("SET @rank := 1;");
 		pSqlServer->executeSql("SET @pos := 0;");
-		str_format(aBuf, sizeof(aBuf), "SELECT Rank, Name, Time FROM (SELECT Name, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank, @pos)) rank, (@prev := Time) Time FROM (SELECT Name, min(Time) as Time FROM %s_race WHERE Map = '%s' GROUP BY Name ORDER BY `Time` ASC) as a) as b WHERE Name = '%s';", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pData->m_Name.ClrStr());
-
-		pSqlServer->executeSqlQuery(aBuf);
+		str_format(aBuf, sizeof(aBuf), "SELECT Rank, Name, Time FROM (SELECT Name, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank, @pos)) rank, (@prev := Time) Time FROM (SELECT Name, min(Time) as Time FROM %s_race WHERE Map = ? GROUP BY Name ORDER BY `Time` ASC) as a) as b WHERE Name = ?;", pSqlServer->GetPrefix());
+		sql::PreparedStatement *pStatement = pSqlServer->PrepareStatement(aBuf);
+		pStatement->setString(1, pData->m_Map.Str());
+		pStatement->setString(2, pData->m_Name.Str());
+		pSqlServer->executeSqlQuery(pStatement);
 
 		if(pSqlServer->GetResults()->rowsCount() != 1)
 		{
@@ -796,7 +1364,7 @@ void CSqlScore::ShowTeamRank(int ClientID, const char* pName, bool Search)
 	Tmp->m_Search = Search;
 	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientID), sizeof(Tmp->m_aRequestingPlayer));
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(ShowTeamRankThread, Tmp), "show team rank");
+	AddJob(new CSqlExecData(ShowTeamRankThread, Tmp), ClientID);
 }
 
 bool CSqlScore::ShowTeamRankThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -877,11 +1445,31 @@ bool CSqlScore::ShowTeamRankThread(CSqlServer* pSqlServer, const CSqlData *pGame
 
 void CSqlScore::ShowTop5(IConsole::IResult *pResult, int ClientID, void *pUserData, int Debut)
 {
+	if(UseLeaderboards())
+	{
+		CLeaderboard::CEntry aEntries[5];
+		int aRanks[5];
+		lock_wait(ms_LeaderboardsLock);
+		int Num = ms_MapTimes.Get(maximum(abs(Debut)-1, 0), 5, Debut < 0, aEntries, aRanks);
+		lock_unlock(ms_LeaderboardsLock);
+
+		GameServer()->SendChatTarget(ClientID, "----------- Top 5 -----------");
+		for(int i = 0; i < Num; i++)
+		{
+			char aBuf[512];
+			float Time = aEntries[i].m_Score;
+			str_format(aBuf, sizeof(aBuf), "%d. %s Time: %02d:%05.2f", aRanks[i], aEntries[i].m_aName, (int)(Time/60), Time-((int)Time/60*60));
+			GameServer()->SendChatTarget(ClientID, aBuf);
+		}
+		GameServer()->SendChatTarget(ClientID, "-------------------------------");
+		return;
+	}
+
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_Num = Debut;
 	Tmp->m_ClientID = ClientID;
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(ShowTop5Thread, Tmp), "show top5");
+	AddJob(new CSqlExecData(ShowTop5Thread, Tmp), ClientID);
 }
 
 bool CSqlScore::ShowTop5Thread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -901,8 +1489,11 @@ bool CSqlScore::ShowTop5Thread(CSqlServer* pSqlServer, const CSqlData *pGameData
 		pSqlServer->executeSql("SET @prev := NULL;");
 		pSqlServer->executeSql("SET @rank := 1;");
 		pSqlServer->executeSql("SET @pos := 0;");
-		str_format(aBuf, sizeof(aBuf), "SELECT Name, Time, Rank FROM (SELECT Name, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank, @pos)) Rank, (@prev := Time) Time FROM (SELECT Name, min(Time) as Time FROM %s_race WHERE Map = '%s' GROUP BY Name ORDER BY `Time` ASC) as a) as b ORDER BY Rank %s LIMIT %d, 5;", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pOrder, LimitStart);
-		pSqlServer->executeSqlQuery(aBuf);
+		str_format(aBuf, sizeof(aBuf), "SELECT Name, Time, Rank FROM (SELECT Name, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank, @pos)) Rank, (@prev := Time) Time FROM (SELECT Name, min(Time) as Time FROM %s_race WHERE Map = ? GROUP BY Name ORDER BY `Time` ASC) as a) as b ORDER BY Rank %s LIMIT ?, 5;", pSqlServer->GetPrefix(), pOrder);
+		sql::PreparedStatement *pStatement = pSqlServer->PrepareStatement(aBuf);
+		pStatement->setString(1, pData->m_Map.Str());
+		pStatement->setInt(2, LimitStart);
+		pSqlServer->executeSqlQuery(pStatement);
 
 		// show top5
 		pData->GameServer()->SendChatTarget(pData->m_ClientID, "----------- Top 5 -----------");
@@ -941,7 +1532,7 @@ void CSqlScore::ShowTeamTop5(IConsole::IResult *pResult, int ClientID, void *pUs
 	Tmp->m_Num = Debut;
 	Tmp->m_ClientID = ClientID;
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(ShowTeamTop5Thread, Tmp), "show team top5");
+	AddJob(new CSqlExecData(ShowTeamTop5Thread, Tmp), ClientID);
 }
 
 bool CSqlScore::ShowTeamTop5Thread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -1049,7 +1640,7 @@ void CSqlScore::ShowTimes(int ClientID, int Debut)
 	Tmp->m_ClientID = ClientID;
 	Tmp->m_Search = false;
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(ShowTimesThread, Tmp), "show times");
+	AddJob(new CSqlExecData(ShowTimesThread, Tmp), ClientID);
 }
 
 void CSqlScore::ShowTimes(int ClientID, const char* pName, int Debut)
@@ -1060,7 +1651,7 @@ void CSqlScore::ShowTimes(int ClientID, const char* pName, int Debut)
 	Tmp->m_Name = pName;
 	Tmp->m_Search = true;
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(ShowTimesThread, Tmp), "show name's times");
+	AddJob(new CSqlExecData(ShowTimesThread, Tmp), ClientID);
 }
 
 bool CSqlScore::ShowTimesThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -1077,12 +1668,24 @@ bool CSqlScore::ShowTimesThread(CSqlServer* pSqlServer, const CSqlData *pGameDat
 	{
 		char aBuf[512];
 
+		sql::PreparedStatement *pStatement;
 		if(pData->m_Search) // last 5 times of a player
-			str_format(aBuf, sizeof(aBuf), "SELECT Time, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago, UNIX_TIMESTAMP(Timestamp) as Stamp FROM %s_race WHERE Map = '%s' AND Name = '%s' ORDER BY Timestamp %s LIMIT %d, 5;", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pData->m_Name.ClrStr(), pOrder, LimitStart);
+		{
+			str_format(aBuf, sizeof(aBuf), "SELECT Time, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago, UNIX_TIMESTAMP(Timestamp) as Stamp FROM %s_race WHERE Map = ? AND Name = ? ORDER BY Timestamp %s LIMIT ?, 5;", pSqlServer->GetPrefix(), pOrder);
+			pStatement = pSqlServer->PrepareStatement(aBuf);
+			pStatement->setString(1, pData->m_Map.Str());
+			pStatement->setString(2, pData->m_Name.Str());
+			pStatement->setInt(3, LimitStart);
+		}
 		else// last 5 times of server
-			str_format(aBuf, sizeof(aBuf), "SELECT Name, Time, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago, UNIX_TIMESTAMP(Timestamp) as Stamp FROM %s_race WHERE Map = '%s' ORDER BY Timestamp %s LIMIT %d, 5;", pSqlServer->GetPrefix(), pData->m_Map.ClrStr(), pOrder, LimitStart);
+		{
+			str_format(aBuf, sizeof(aBuf), "SELECT Name, Time, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago, UNIX_TIMESTAMP(Timestamp) as Stamp FROM %s_race WHERE Map = ? ORDER BY Timestamp %s LIMIT ?, 5;", pSqlServer->GetPrefix(), pOrder);
+			pStatement = pSqlServer->PrepareStatement(aBuf);
+			pStatement->setString(1, pData->m_Map.Str());
+			pStatement->setInt(2, LimitStart);
+		}
 
-		pSqlServer->executeSqlQuery(aBuf);
+		pSqlServer->executeSqlQuery(pStatement);
 
 		// show top5
 		if(pSqlServer->GetResults()->rowsCount() == 0)
@@ -1142,13 +1745,35 @@ bool CSqlScore::ShowTimesThread(CSqlServer* pSqlServer, const CSqlData *pGameDat
 
 void CSqlScore::ShowPoints(int ClientID, const char* pName, bool Search)
 {
+	if(UseLeaderboards())
+	{
+		int Rank;
+		float Points;
+		lock_wait(ms_LeaderboardsLock);
+		bool Found = ms_Points.Find(pName, &Rank, &Points);
+		lock_unlock(ms_LeaderboardsLock);
+
+		char aBuf[512];
+		if(!Found)
+		{
+			str_format(aBuf, sizeof(aBuf), "%s has not collected any points so far", pName);
+			GameServer()->SendChatTarget(ClientID, aBuf);
+		}
+		else
+		{
+			str_format(aBuf, sizeof(aBuf), "%d. %s Points: %d, requested by %s", Rank, pName, (int)Points, Server()->ClientName(ClientID));
+			GameServer()->SendChat(-1, CGameContext::CHAT_ALL, aBuf, ClientID);
+		}
+		return;
+	}
+
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_ClientID = ClientID;
 	Tmp->m_Name = pName;
 	Tmp->m_Search = Search;
 	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientID), sizeof(Tmp->m_aRequestingPlayer));
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(ShowPointsThread, Tmp), "show points");
+	AddJob(new CSqlExecData(ShowPointsThread, Tmp), ClientID);
 }
 
 bool CSqlScore::ShowPointsThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -1200,11 +1825,30 @@ bool CSqlScore::ShowPointsThread(CSqlServer* pSqlServer, const CSqlData *pGameDa
 
 void CSqlScore::ShowTopPoints(IConsole::IResult *pResult, int ClientID, void *pUserData, int Debut)
 {
+	if(UseLeaderboards())
+	{
+		CLeaderboard::CEntry aEntries[5];
+		int aRanks[5];
+		lock_wait(ms_LeaderboardsLock);
+		int Num = ms_Points.Get(maximum(abs(Debut)-1, 0), 5, Debut < 0, aEntries, aRanks);
+		lock_unlock(ms_LeaderboardsLock);
+
+		GameServer()->SendChatTarget(ClientID, "-------- Top Points --------");
+		for(int i = 0; i < Num; i++)
+		{
+			char aBuf[512];
+			str_format(aBuf, sizeof(aBuf), "%d. %s Points: %d", aRanks[i], aEntries[i].m_aName, (int)aEntries[i].m_Score);
+			GameServer()->SendChatTarget(ClientID, aBuf);
+		}
+		GameServer()->SendChatTarget(ClientID, "-------------------------------");
+		return;
+	}
+
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_Num = Debut;
 	Tmp->m_ClientID = ClientID;
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(ShowTopPointsThread, Tmp), "show top points");
+	AddJob(new CSqlExecData(ShowTopPointsThread, Tmp), ClientID);
 }
 
 bool CSqlScore::ShowTopPointsThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -1264,7 +1908,7 @@ void CSqlScore::RandomMap(std::shared_ptr<CRandomMapResult> *ppResult, int Clien
 	Tmp->m_Name = GameServer()->Server()->ClientName(ClientID);
 	Tmp->m_pResult = *ppResult;
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(RandomMapThread, Tmp), "random map");
+	AddJob(new CSqlExecData(RandomMapThread, Tmp), ClientID);
 }
 
 bool CSqlScore::RandomMapThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -1322,7 +1966,7 @@ void CSqlScore::RandomUnfinishedMap(std::shared_ptr<CRandomMapResult> *ppResult,
 	Tmp->m_Name = GameServer()->Server()->ClientName(ClientID);
 	Tmp->m_pResult = *ppResult;
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(RandomUnfinishedMapThread, Tmp), "random unfinished map");
+	AddJob(new CSqlExecData(RandomUnfinishedMapThread, Tmp), ClientID);
 }
 
 bool CSqlScore::RandomUnfinishedMapThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -1390,7 +2034,7 @@ void CSqlScore::SaveTeam(int Team, const char* Code, int ClientID, const char* S
 	Tmp->m_Code = Code;
 	str_copy(Tmp->m_Server, Server, sizeof(Tmp->m_Server));
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(SaveTeamThread, Tmp, false), "save team");
+	AddJob(new CSqlExecData(SaveTeamThread, Tmp, false), ClientID);
 }
 
 bool CSqlScore::SaveTeamThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
@@ -1510,7 +2154,9 @@ bool CSqlScore::SaveTeamThread(CSqlServer* pSqlServer, const CSqlData *pGameData
 		dbg_msg("sql", "WARNING: Aborted saving team due to reload/change of map.");
 	}
 
-	pSqlServer->executeSql("unlock tables;");
+	// the failure handling has no server
+	if(pSqlServer)
+		pSqlServer->executeSql("unlock tables;");
 	return true;
 }
 
@@ -1520,7 +2166,7 @@ void CSqlScore::LoadTeam(const char* Code, int ClientID)
 	Tmp->m_Code = Code;
 	Tmp->m_ClientID = ClientID;
 
-	thread_init_and_detach(ExecSqlFunc, new CSqlExecData(LoadTeamThread, Tmp), "load team");
+	AddJob(new CSqlExecData(LoadTeamThread, Tmp), ClientID);
 }
 
 bool CSqlScore::LoadTeamThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure)
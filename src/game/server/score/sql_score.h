@@ -4,7 +4,10 @@
 #ifndef GAME_SERVER_SCORE_SQL_SCORE_H
 #define GAME_SERVER_SCORE_SQL_SCORE_H
 
+#include <deque>
 #include <exception>
+#include <string>
+#include <vector>
 
 #include <base/system.h>
 #include <engine/console.h>
@@ -12,6 +15,8 @@
 #include <engine/server/sql_string_helpers.h>
 
 #include "../score.h"
+#include "journal.h"
+#include "leaderboard.h"
 
 
 class CGameContextError : public std::runtime_error
@@ -74,11 +79,63 @@ struct CSqlExecData
 	bool (*m_pFuncPtr) (CSqlServer*, const CSqlData *, bool);
 	CSqlData *m_pSqlData;
 	bool m_ReadOnly;
+	int64 m_QueueTime;
 
 	// keeps track of score-threads
 	volatile static int ms_InstanceCount;
 };
 
+enum
+{
+	MAX_SQL_WORKERS=16
+};
+
+// a fixed number of threads running the queued score queries, each with its
+// own connections to the sql servers which stay open between the queries
+class CSqlWorkerPool
+{
+	struct CWorker
+	{
+		CSqlWorkerPool *m_pPool;
+		void *m_pThread;
+		CSqlServer *m_apReadServers[MAX_SQLSERVERS];
+		CSqlServer *m_apWriteServers[MAX_SQLSERVERS];
+	};
+
+	CWorker m_aWorkers[MAX_SQL_WORKERS];
+	int m_NumWorkers;
+
+	// a null entry stops a worker
+	std::deque<CSqlExecData *> m_Queue;
+	LOCK m_Lock;
+	SEMAPHORE m_Semaphore;
+	int m_NumQueuedReads;
+
+	// statistics
+	int m_PeakQueued;
+	int64 m_NumDone;
+	int64 m_NumRejected;
+	int64 m_WaitTime;
+	int64 m_MaxWaitTime;
+	bool m_Full;
+
+	static void WorkerThread(void *pUser);
+	static void SyncServers(CWorker *pWorker);
+	static void Execute(CWorker *pWorker, CSqlExecData *pData);
+
+public:
+	CSqlWorkerPool();
+	~CSqlWorkerPool();
+
+	void Start(int NumWorkers);
+	void Stop();
+
+	// writes are always queued, reads are rejected if too many are waiting
+	bool Add(CSqlExecData *pData);
+
+	void Dump(IConsole *pConsole);
+};
+
 struct CSqlPlayerData : CSqlData
 {
 	int m_ClientID;
@@ -107,23 +164,23 @@ struct CSqlScoreData : CSqlData
 
 	sqlstr::CSqlString<MAX_NAME_LENGTH> m_Name;
 
-	bool m_NotEligible;
-	float m_Time;
-	char m_aTimestamp[TIMESTAMP_STR_LENGTH];
-	float m_aCpCurrent[NUM_CHECKPOINTS];
 	int m_Num;
 	bool m_Search;
 	char m_aRequestingPlayer[MAX_NAME_LENGTH];
 };
 
-struct CSqlTeamScoreData : CSqlData
+// a sealed segment of the journal
+struct CSqlScoreBatch : CSqlData
 {
-	bool m_NotEligible;
-	float m_Time;
-	char m_aTimestamp[TIMESTAMP_STR_LENGTH];
-	unsigned int m_Size;
-	int m_aClientIDs[MAX_CLIENTS];
-	sqlstr::CSqlString<MAX_NAME_LENGTH> m_aNames[MAX_CLIENTS];
+	char m_aPath[512];
+	// some of the finishes might be saved already
+	bool m_Replay;
+};
+
+// the inserts of a finish that isn't eligible
+struct CSqlNotEligible : CSqlData
+{
+	std::vector<std::string> m_aLines;
 };
 
 struct CSqlTeamSave : CSqlData
@@ -155,7 +212,9 @@ class CSqlScore: public IScore
 	CGameContext *m_pGameServer;
 	IServer *m_pServer;
 
-	static void ExecSqlFunc(void *pUser);
+	static CSqlWorkerPool ms_WorkerPool;
+
+	void AddJob(CSqlExecData *pData, int ClientID);
 
 	static bool Init(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure);
 
@@ -164,12 +223,42 @@ class CSqlScore: public IScore
 
 	static LOCK ms_FailureFileLock;
 
+	static CScoreJournal ms_Journal;
+	static bool ms_JournalInitialized;
+	// segments that couldn't be saved, they are tried again later
+	static std::vector<std::string> ms_aFailedBatches;
+	static LOCK ms_FailedBatchesLock;
+	static int64 ms_LastBatchRetry;
+
+	// the best times on the current map and the points of all players,
+	// kept to answer the rank queries without asking the database
+	static CLeaderboard ms_MapTimes;
+	static CLeaderboard ms_Points;
+	// the times set on the current map, the reloads keep them until
+	// they are in the database
+	static std::vector<CLeaderboard::CEntry> ms_aNewTimes;
+	static bool ms_LeaderboardsLoaded;
+	static LOCK ms_LeaderboardsLock;
+	int64 m_LastLeaderboardsLoad;
+
+	void LoadLeaderboards();
+	bool UseLeaderboards();
+
+	void AddBatch(const char *pPath, bool Replay);
+	// seals the current segment and waits until it can be saved
+	void FlushJournal();
+
+	static void RemoveSavedFinishes(CSqlServer* pSqlServer, CScoreJournal::CSegment *pSegment);
+	static void SaveRaceFinishes(CSqlServer* pSqlServer, const std::vector<CScoreJournal::CRaceFinish> &aFinishes, std::vector<int> *pPoints);
+	static void SaveTeamFinish(CSqlServer* pSqlServer, const CScoreJournal::CTeamFinish *pFinish);
+
 	static bool CheckBirthdayThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
 	static bool MapInfoThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
 	static bool MapVoteThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
 	static bool LoadScoreThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
-	static bool SaveScoreThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
-	static bool SaveTeamScoreThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
+	static bool LoadLeaderboardsThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
+	static bool SaveNotEligibleThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
+	static bool SaveScoresThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
 	static bool ShowRankThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
 	static bool ShowTop5Thread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
 	static bool ShowTeamRankThread(CSqlServer* pSqlServer, const CSqlData *pGameData, bool HandleFailure = false);
@@ -210,7 +299,10 @@ public:
 	virtual void SaveTeam(int Team, const char* Code, int ClientID, const char* Server);
 	virtual void LoadTeam(const char* Code, int ClientID);
 
+	virtual void OnTick();
 	virtual void OnShutdown();
+
+	static CSqlWorkerPool *WorkerPool() { return &ms_WorkerPool; }
 };
 
 #endif // GAME_SERVER_SCORE_SQL_SCORE_H
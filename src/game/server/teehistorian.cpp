@@ -1,5 +1,6 @@
 #include "teehistorian.h"
 
+#include <engine/external/json-parser/json.h>
 #include <engine/shared/config.h>
 #include <engine/shared/snapshot.h>
 #include <engine/shared/json.h>
@@ -558,3 +559,223 @@ void CTeeHistorian::Finish()
 
 	Write(Buffer.Data(), Buffer.Size());
 }
+
+CTeeHistorianReader::CTeeHistorianReader()
+{
+	m_pHeader = 0;
+	m_Finished = true;
+	m_Error = false;
+}
+
+CTeeHistorianReader::~CTeeHistorianReader()
+{
+	if(m_pHeader)
+		json_value_free(m_pHeader);
+}
+
+bool CTeeHistorianReader::Init(const void *pData, int DataSize)
+{
+	if(m_pHeader)
+	{
+		json_value_free(m_pHeader);
+		m_pHeader = 0;
+	}
+	m_Finished = true;
+	m_Error = true;
+
+	const char *pStart = (const char *)pData;
+	if(DataSize < (int)sizeof(TEEHISTORIAN_UUID) || mem_comp(pStart, &TEEHISTORIAN_UUID, sizeof(TEEHISTORIAN_UUID)) != 0)
+		return false;
+
+	// the json header is null terminated
+	const char *pJson = pStart + sizeof(TEEHISTORIAN_UUID);
+	const char *pEnd = pStart + DataSize;
+	const char *pJsonEnd = pJson;
+	while(pJsonEnd < pEnd && *pJsonEnd)
+		pJsonEnd++;
+	if(pJsonEnd == pEnd)
+		return false;
+
+	m_pHeader = json_parse(pJson, pJsonEnd - pJson);
+	if(!m_pHeader || m_pHeader->type != json_object)
+		return false;
+
+	m_Unpacker.Reset(pJsonEnd + 1, pEnd - pJsonEnd - 1);
+	m_Finished = false;
+	m_Error = false;
+
+	// tick 0 is implicit, see CTeeHistorian::Reset
+	m_Tick = 0;
+	m_MaxClientID = MAX_CLIENTS;
+	mem_zero(m_aPlayers, sizeof(m_aPlayers));
+	return true;
+}
+
+bool CTeeHistorianReader::ReadPlayerClientID(CItem *pItem, int ClientID)
+{
+	if(ClientID < 0 || ClientID >= MAX_CLIENTS)
+		return false;
+
+	// the player data is written in ascending order, a smaller id starts the
+	// next tick
+	if(ClientID <= m_MaxClientID)
+		m_Tick++;
+	m_MaxClientID = ClientID;
+
+	pItem->m_Tick = m_Tick;
+	pItem->m_ClientID = ClientID;
+	return true;
+}
+
+bool CTeeHistorianReader::Next(CItem *pItem)
+{
+	while(!m_Finished && !m_Error)
+	{
+		int Type = m_Unpacker.GetInt();
+		if(m_Unpacker.Error())
+			break;
+
+		pItem->m_Tick = m_Tick;
+		pItem->m_ClientID = -1;
+		bool Valid = true;
+
+		if(Type >= 0)
+		{
+			// position diff, the type is the client id
+			int dx = m_Unpacker.GetInt();
+			int dy = m_Unpacker.GetInt();
+			Valid = ReadPlayerClientID(pItem, Type);
+			if(Valid)
+			{
+				CPlayer *pPlayer = &m_aPlayers[Type];
+				pPlayer->m_X += dx;
+				pPlayer->m_Y += dy;
+				pItem->m_Type = ITEM_PLAYER;
+				pItem->m_X = pPlayer->m_X;
+				pItem->m_Y = pPlayer->m_Y;
+			}
+		}
+		else if(Type == -TEEHISTORIAN_FINISH)
+		{
+			pItem->m_Type = ITEM_FINISH;
+			m_Finished = true;
+		}
+		else if(Type == -TEEHISTORIAN_TICK_SKIP)
+		{
+			m_Tick += m_Unpacker.GetInt() + 1;
+			m_MaxClientID = -1;
+			continue;
+		}
+		else if(Type == -TEEHISTORIAN_PLAYER_NEW)
+		{
+			int ClientID = m_Unpacker.GetInt();
+			int x = m_Unpacker.GetInt();
+			int y = m_Unpacker.GetInt();
+			Valid = ReadPlayerClientID(pItem, ClientID);
+			if(Valid)
+			{
+				m_aPlayers[ClientID].m_X = x;
+				m_aPlayers[ClientID].m_Y = y;
+				pItem->m_Type = ITEM_PLAYER;
+				pItem->m_X = x;
+				pItem->m_Y = y;
+			}
+		}
+		else if(Type == -TEEHISTORIAN_PLAYER_OLD)
+		{
+			Valid = ReadPlayerClientID(pItem, m_Unpacker.GetInt());
+			pItem->m_Type = ITEM_PLAYER_DEAD;
+		}
+		else if(Type == -TEEHISTORIAN_INPUT_DIFF || Type == -TEEHISTORIAN_INPUT_NEW)
+		{
+			int ClientID = m_Unpacker.GetInt();
+			int aData[sizeof(CNetObj_PlayerInput) / sizeof(int)];
+			for(int i = 0; i < (int)(sizeof(aData) / sizeof(int)); i++)
+				aData[i] = m_Unpacker.GetInt();
+			Valid = ClientID >= 0 && ClientID < MAX_CLIENTS;
+			if(Valid)
+			{
+				int *pInput = (int *)&m_aPlayers[ClientID].m_Input;
+				for(int i = 0; i < (int)(sizeof(aData) / sizeof(int)); i++)
+					pInput[i] = Type == -TEEHISTORIAN_INPUT_DIFF ? pInput[i] + aData[i] : aData[i];
+				pItem->m_Type = ITEM_INPUT;
+				pItem->m_ClientID = ClientID;
+				pItem->m_Input = m_aPlayers[ClientID].m_Input;
+			}
+		}
+		else if(Type == -TEEHISTORIAN_MESSAGE)
+		{
+			pItem->m_Type = ITEM_MESSAGE;
+			pItem->m_ClientID = m_Unpacker.GetInt();
+			pItem->m_DataSize = m_Unpacker.GetInt();
+			pItem->m_pData = m_Unpacker.GetRaw(pItem->m_DataSize);
+			Valid = pItem->m_ClientID >= 0 && pItem->m_ClientID < MAX_CLIENTS;
+		}
+		else if(Type == -TEEHISTORIAN_JOIN)
+		{
+			pItem->m_Type = ITEM_JOIN;
+			pItem->m_ClientID = m_Unpacker.GetInt();
+			Valid = pItem->m_ClientID >= 0 && pItem->m_ClientID < MAX_CLIENTS;
+		}
+		else if(Type == -TEEHISTORIAN_DROP)
+		{
+			pItem->m_Type = ITEM_DROP;
+			pItem->m_ClientID = m_Unpacker.GetInt();
+			pItem->m_pString = m_Unpacker.GetString(0);
+			Valid = pItem->m_ClientID >= 0 && pItem->m_ClientID < MAX_CLIENTS;
+		}
+		else if(Type == -TEEHISTORIAN_CONSOLE_COMMAND)
+		{
+			pItem->m_Type = ITEM_CONSOLE_COMMAND;
+			pItem->m_ClientID = m_Unpacker.GetInt();
+			pItem->m_FlagMask = m_Unpacker.GetInt();
+			pItem->m_pString = m_Unpacker.GetString(0);
+			int NumArgs = m_Unpacker.GetInt();
+			pItem->m_NumArgs = 0;
+			for(int i = 0; i < NumArgs && !m_Unpacker.Error(); i++)
+			{
+				const char *pArg = m_Unpacker.GetString(0);
+				if(i < MAX_ARGS)
+					pItem->m_apArgs[pItem->m_NumArgs++] = pArg;
+			}
+			Valid = pItem->m_ClientID >= -1 && pItem->m_ClientID < MAX_CLIENTS && NumArgs >= 0;
+		}
+		else if(Type == -TEEHISTORIAN_EX)
+		{
+			const CUuid *pUuid = (const CUuid *)m_Unpacker.GetRaw(sizeof(CUuid));
+			pItem->m_Type = ITEM_EX;
+			pItem->m_DataSize = m_Unpacker.GetInt();
+			pItem->m_pData = m_Unpacker.GetRaw(pItem->m_DataSize);
+			if(pUuid && pItem->m_pData)
+			{
+				pItem->m_Uuid = *pUuid;
+				CUnpacker Ex;
+				Ex.Reset(pItem->m_pData, pItem->m_DataSize);
+				if(pItem->m_Uuid == UUID_TEEHISTORIAN_AUTH_INIT || pItem->m_Uuid == UUID_TEEHISTORIAN_AUTH_LOGIN)
+				{
+					pItem->m_Type = ITEM_AUTH_LOGIN;
+					pItem->m_ClientID = Ex.GetInt();
+					pItem->m_Level = Ex.GetInt();
+					pItem->m_pString = Ex.GetString(0);
+				}
+				else if(pItem->m_Uuid == UUID_TEEHISTORIAN_AUTH_LOGOUT)
+				{
+					pItem->m_Type = ITEM_AUTH_LOGOUT;
+					pItem->m_ClientID = Ex.GetInt();
+				}
+				Valid = !Ex.Error() && (pItem->m_Type == ITEM_EX || (pItem->m_ClientID >= 0 && pItem->m_ClientID < MAX_CLIENTS));
+			}
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if(!Valid || m_Unpacker.Error())
+			break;
+		return true;
+	}
+	if(!m_Finished)
+		m_Error = true;
+	return false;
+}
@@ -12,6 +12,7 @@
 struct CConfiguration;
 class CTuningParams;
 class CUuidManager;
+typedef struct _json_value json_value;
 
 class CTeeHistorian
 {
@@ -112,4 +113,109 @@ private:
 	CPlayer m_aPrevPlayers[MAX_CLIENTS];
 };
 
+/*
+	Class: Teehistorian Reader
+		Reads back what CTeeHistorian wrote. The position and input diffs
+		are applied, each item carries the full values and the tick it was
+		recorded in.
+*/
+class CTeeHistorianReader
+{
+public:
+	enum
+	{
+		ITEM_FINISH=0,
+		ITEM_PLAYER,
+		ITEM_PLAYER_DEAD,
+		ITEM_INPUT,
+		ITEM_MESSAGE,
+		ITEM_JOIN,
+		ITEM_DROP,
+		ITEM_CONSOLE_COMMAND,
+		ITEM_AUTH_LOGIN,
+		ITEM_AUTH_LOGOUT,
+		ITEM_EX,
+
+		MAX_ARGS=16,
+	};
+
+	struct CItem
+	{
+		int m_Type;
+		int m_Tick;
+		int m_ClientID;
+
+		// ITEM_PLAYER
+		int m_X;
+		int m_Y;
+
+		// ITEM_INPUT
+		CNetObj_PlayerInput m_Input;
+
+		// ITEM_MESSAGE, ITEM_EX, unknown extra chunks
+		CUuid m_Uuid;
+		const void *m_pData;
+		int m_DataSize;
+
+		// ITEM_AUTH_LOGIN
+		int m_Level;
+
+		// ITEM_DROP reason, ITEM_CONSOLE_COMMAND command, ITEM_AUTH_LOGIN
+		// auth name
+		const char *m_pString;
+		int m_FlagMask;
+		int m_NumArgs;
+		const char *m_apArgs[MAX_ARGS];
+	};
+
+	CTeeHistorianReader();
+	~CTeeHistorianReader();
+
+	/*
+		Function: Init
+			Reads the header.
+
+		Arguments:
+			pData - The whole file, it has to stay around while reading.
+			DataSize - The size of the file.
+
+		Returns:
+			false if the data doesn't start with a teehistorian header.
+	*/
+	bool Init(const void *pData, int DataSize);
+
+	// the parsed json header, with map_name, config, tuning and so on
+	const json_value *Header() const { return m_pHeader; }
+
+	/*
+		Function: Next
+			Reads the next item.
+
+		Returns:
+			false after the ITEM_FINISH or if the data is broken, see
+			<Error>.
+	*/
+	bool Next(CItem *pItem);
+	bool Error() const { return m_Error; }
+
+private:
+	struct CPlayer
+	{
+		int m_X;
+		int m_Y;
+		CNetObj_PlayerInput m_Input;
+	};
+
+	bool ReadPlayerClientID(CItem *pItem, int ClientID);
+
+	json_value *m_pHeader;
+	CUnpacker m_Unpacker;
+	bool m_Finished;
+	bool m_Error;
+
+	int m_Tick;
+	int m_MaxClientID;
+	CPlayer m_aPlayers[MAX_CLIENTS];
+};
+
 #endif // GAME_SERVER_TEEHISTORIAN_H
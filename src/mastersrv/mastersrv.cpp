@@ -16,9 +16,20 @@
 enum {
 	MTU = 1400,
 	MAX_SERVERS_PER_PACKET=75,
+	// the count packets have 16 bits for it
+	MAX_SERVERS=1<<15,
+	// a list request can be sent with any source address, answer it with
+	// at most as many packets as before the server limit was raised
 	MAX_PACKETS=16,
-	MAX_SERVERS=MAX_SERVERS_PER_PACKET*MAX_PACKETS,
-	EXPIRE_TIME = 90
+	EXPIRE_TIME = 90,
+	SERVER_HASH_SIZE=1<<16,
+	// one slot per second, has to be longer than the expire time
+	EXPIRE_WHEEL_SIZE=128,
+	// an address gets LIST_BURST lists at once and then one every
+	// LIST_INTERVAL seconds
+	LIST_INTERVAL=2,
+	LIST_BURST=3,
+	MAX_LIST_LIMITS=1<<16
 };
 
 struct CCheckServer
@@ -28,20 +39,66 @@ struct CCheckServer
 	NETADDR m_AltAddress;
 	int m_TryCount;
 	int64 m_TryTime;
+
+	bool m_Used;
+	// the next entry in the same hash bucket of the address, or the next
+	// free entry
+	int m_HashNext;
+	// the next entry in the same hash bucket of the alternative address
+	int m_AltHashNext;
 };
 
+// the entries don't move, the free ones are reused
 static CCheckServer m_aCheckServers[MAX_SERVERS];
 static int m_NumCheckServers = 0;
+static int m_CheckServersEnd = 0;
+static int m_FirstFreeCheckServer = -1;
+
+static int m_aCheckHash[SERVER_HASH_SIZE];
+static int m_aCheckAltHash[SERVER_HASH_SIZE];
 
 struct CServerEntry
 {
 	enum ServerType m_Type;
 	NETADDR m_Address;
 	int64 m_Expire;
+
+	bool m_Used;
+	// the next entry in the same hash bucket, or the next free entry
+	int m_HashNext;
+	// the neighbours in the same slot of the expire wheel
+	int m_WheelPrev;
+	int m_WheelNext;
 };
 
+// the entries don't move, the free ones are reused
 static CServerEntry m_aServers[MAX_SERVERS];
 static int m_NumServers = 0;
+static int m_ServersEnd = 0;
+static int m_FirstFreeServer = -1;
+
+static int m_aServerHash[SERVER_HASH_SIZE];
+static int m_aExpireWheel[EXPIRE_WHEEL_SIZE];
+static int64 m_NextExpireSecond = 0;
+
+// the list packets are only built again if a server was added or removed
+static bool m_PacketsDirty = false;
+
+struct CListLimit
+{
+	NETADDR m_Address;
+	// when the address has its full burst of lists again
+	int64 m_FullTime;
+	// the next entry in the same hash bucket
+	int m_HashNext;
+};
+
+// the oldest entry is reused when all are taken
+static CListLimit m_aListLimits[MAX_LIST_LIMITS];
+static int m_NumListLimits = 0;
+static int m_NextListLimit = 0;
+
+static int m_aListLimitHash[SERVER_HASH_SIZE];
 
 struct CPacketData
 {
@@ -87,84 +144,250 @@ static CNetClient m_NetOp; // main
 
 IConsole *m_pConsole;
 
+void InitServers()
+{
+	for(int i = 0; i < SERVER_HASH_SIZE; i++)
+		m_aServerHash[i] = -1;
+	for(int i = 0; i < EXPIRE_WHEEL_SIZE; i++)
+		m_aExpireWheel[i] = -1;
+	m_NextExpireSecond = time_get()/time_freq();
+	for(int i = 0; i < SERVER_HASH_SIZE; i++)
+	{
+		m_aCheckHash[i] = -1;
+		m_aCheckAltHash[i] = -1;
+	}
+	for(int i = 0; i < SERVER_HASH_SIZE; i++)
+		m_aListLimitHash[i] = -1;
+}
+
+unsigned ServerHash(const NETADDR *pAddr)
+{
+	// FNV-1a
+	unsigned Hash = 2166136261u;
+	for(unsigned i = 0; i < sizeof(pAddr->ip); i++)
+		Hash = (Hash ^ pAddr->ip[i]) * 16777619u;
+	Hash = (Hash ^ (pAddr->port&0xff)) * 16777619u;
+	Hash = (Hash ^ (pAddr->port>>8)) * 16777619u;
+	Hash = (Hash ^ pAddr->type) * 16777619u;
+	return Hash&(SERVER_HASH_SIZE-1);
+}
+
+int FindServer(const NETADDR *pAddr)
+{
+	for(int i = m_aServerHash[ServerHash(pAddr)]; i != -1; i = m_aServers[i].m_HashNext)
+		if(net_addr_comp(&m_aServers[i].m_Address, pAddr) == 0)
+			return i;
+	return -1;
+}
+
+int FindCheckServer(const NETADDR *pAddr, bool Alt)
+{
+	if(Alt)
+	{
+		for(int i = m_aCheckAltHash[ServerHash(pAddr)]; i != -1; i = m_aCheckServers[i].m_AltHashNext)
+			if(net_addr_comp(&m_aCheckServers[i].m_AltAddress, pAddr) == 0)
+				return i;
+		return -1;
+	}
+	for(int i = m_aCheckHash[ServerHash(pAddr)]; i != -1; i = m_aCheckServers[i].m_HashNext)
+		if(net_addr_comp(&m_aCheckServers[i].m_Address, pAddr) == 0)
+			return i;
+	return -1;
+}
+
+void RemoveCheckServer(int Index)
+{
+	CCheckServer *pCheck = &m_aCheckServers[Index];
+	int *pLink = &m_aCheckHash[ServerHash(&pCheck->m_Address)];
+	while(*pLink != Index)
+		pLink = &m_aCheckServers[*pLink].m_HashNext;
+	*pLink = pCheck->m_HashNext;
+	pLink = &m_aCheckAltHash[ServerHash(&pCheck->m_AltAddress)];
+	while(*pLink != Index)
+		pLink = &m_aCheckServers[*pLink].m_AltHashNext;
+	*pLink = pCheck->m_AltHashNext;
+
+	pCheck->m_Used = false;
+	pCheck->m_HashNext = m_FirstFreeCheckServer;
+	m_FirstFreeCheckServer = Index;
+	m_NumCheckServers--;
+}
+
+// whether a list may be sent to the address again
+bool AllowList(const NETADDR *pAddr)
+{
+	int64 Now = time_get();
+	int64 Interval = time_freq()*LIST_INTERVAL;
+
+	int Index = -1;
+	for(int i = m_aListLimitHash[ServerHash(pAddr)]; i != -1; i = m_aListLimits[i].m_HashNext)
+	{
+		if(net_addr_comp(&m_aListLimits[i].m_Address, pAddr) == 0)
+		{
+			Index = i;
+			break;
+		}
+	}
+
+	if(Index == -1)
+	{
+		// the reused entry forgets its address, which then gets a full
+		// burst again, so flooding the table doesn't block anyone
+		Index = m_NextListLimit;
+		m_NextListLimit = (m_NextListLimit+1)%MAX_LIST_LIMITS;
+		CListLimit *pLimit = &m_aListLimits[Index];
+		if(m_NumListLimits < MAX_LIST_LIMITS)
+			m_NumListLimits++;
+		else
+		{
+			int *pLink = &m_aListLimitHash[ServerHash(&pLimit->m_Address)];
+			while(*pLink != Index)
+				pLink = &m_aListLimits[*pLink].m_HashNext;
+			*pLink = pLimit->m_HashNext;
+		}
+
+		pLimit->m_Address = *pAddr;
+		pLimit->m_FullTime = Now;
+		int *pBucket = &m_aListLimitHash[ServerHash(pAddr)];
+		pLimit->m_HashNext = *pBucket;
+		*pBucket = Index;
+	}
+
+	// every list takes LIST_INTERVAL seconds off the burst
+	CListLimit *pLimit = &m_aListLimits[Index];
+	int64 FullTime = maximum(pLimit->m_FullTime, Now)+Interval;
+	if(FullTime > Now+Interval*LIST_BURST)
+		return false;
+	pLimit->m_FullTime = FullTime;
+	return true;
+}
+
+int ExpireSlot(int64 Expire)
+{
+	return (Expire/time_freq())%EXPIRE_WHEEL_SIZE;
+}
+
+void WheelInsert(int Index)
+{
+	CServerEntry *pServer = &m_aServers[Index];
+	int *pSlot = &m_aExpireWheel[ExpireSlot(pServer->m_Expire)];
+	pServer->m_WheelPrev = -1;
+	pServer->m_WheelNext = *pSlot;
+	if(*pSlot != -1)
+		m_aServers[*pSlot].m_WheelPrev = Index;
+	*pSlot = Index;
+}
+
+void WheelRemove(int Index)
+{
+	CServerEntry *pServer = &m_aServers[Index];
+	if(pServer->m_WheelPrev != -1)
+		m_aServers[pServer->m_WheelPrev].m_WheelNext = pServer->m_WheelNext;
+	else
+		m_aExpireWheel[ExpireSlot(pServer->m_Expire)] = pServer->m_WheelNext;
+	if(pServer->m_WheelNext != -1)
+		m_aServers[pServer->m_WheelNext].m_WheelPrev = pServer->m_WheelPrev;
+}
+
+void RemoveServer(int Index)
+{
+	CServerEntry *pServer = &m_aServers[Index];
+	int *pLink = &m_aServerHash[ServerHash(&pServer->m_Address)];
+	while(*pLink != Index)
+		pLink = &m_aServers[*pLink].m_HashNext;
+	*pLink = pServer->m_HashNext;
+	WheelRemove(Index);
+
+	pServer->m_Used = false;
+	pServer->m_HashNext = m_FirstFreeServer;
+	m_FirstFreeServer = Index;
+	m_NumServers--;
+	m_PacketsDirty = true;
+}
+
 void BuildPackets()
 {
-	CServerEntry *pCurrent = &m_aServers[0];
-	int ServersLeft = m_NumServers;
 	m_NumPackets = 0;
 	m_NumPacketsLegacy = 0;
 	int PacketIndex = 0;
 	int PacketIndexLegacy = 0;
-	while(ServersLeft-- && (m_NumPackets + m_NumPacketsLegacy) < MAX_PACKETS)
+	for(int i = 0; i < m_ServersEnd; i++)
 	{
+		CServerEntry *pCurrent = &m_aServers[i];
+		if(!pCurrent->m_Used)
+			continue;
+
 		if(pCurrent->m_Type == SERVERTYPE_NORMAL)
 		{
+			// the list is full, the server stays registered
+			if(PacketIndex == MAX_SERVERS_PER_PACKET && m_NumPackets == MAX_PACKETS)
+				continue;
 			if(PacketIndex % MAX_SERVERS_PER_PACKET == 0)
 			{
 				PacketIndex = 0;
 				m_NumPackets++;
 			}
+			CPacketData *pPacket = &m_aPackets[m_NumPackets-1];
 
 			// copy header
-			mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+			mem_copy(pPacket->m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
 
 			// copy server addresses
 			if(pCurrent->m_Address.type == NETTYPE_IPV6)
 			{
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, pCurrent->m_Address.ip,
-					sizeof(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp));
+				mem_copy(pPacket->m_Data.m_aServers[PacketIndex].m_aIp, pCurrent->m_Address.ip,
+					sizeof(pPacket->m_Data.m_aServers[PacketIndex].m_aIp));
 			}
 			else
 			{
 				static char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, (char)0xFF, (char)0xFF };
 
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[12] = pCurrent->m_Address.ip[0];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[13] = pCurrent->m_Address.ip[1];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[14] = pCurrent->m_Address.ip[2];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[15] = pCurrent->m_Address.ip[3];
+				mem_copy(pPacket->m_Data.m_aServers[PacketIndex].m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
+				pPacket->m_Data.m_aServers[PacketIndex].m_aIp[12] = pCurrent->m_Address.ip[0];
+				pPacket->m_Data.m_aServers[PacketIndex].m_aIp[13] = pCurrent->m_Address.ip[1];
+				pPacket->m_Data.m_aServers[PacketIndex].m_aIp[14] = pCurrent->m_Address.ip[2];
+				pPacket->m_Data.m_aServers[PacketIndex].m_aIp[15] = pCurrent->m_Address.ip[3];
 			}
 
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[0] = (pCurrent->m_Address.port>>8)&0xff;
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[1] = pCurrent->m_Address.port&0xff;
+			pPacket->m_Data.m_aServers[PacketIndex].m_aPort[0] = (pCurrent->m_Address.port>>8)&0xff;
+			pPacket->m_Data.m_aServers[PacketIndex].m_aPort[1] = pCurrent->m_Address.port&0xff;
 
 			PacketIndex++;
 
-			m_aPackets[m_NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*PacketIndex;
-
-			pCurrent++;
+			pPacket->m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*PacketIndex;
 		}
 		else if(pCurrent->m_Type == SERVERTYPE_LEGACY)
 		{
+			if(PacketIndexLegacy == MAX_SERVERS_PER_PACKET && m_NumPacketsLegacy == MAX_PACKETS)
+				continue;
 			if(PacketIndexLegacy % MAX_SERVERS_PER_PACKET == 0)
 			{
 				PacketIndexLegacy = 0;
 				m_NumPacketsLegacy++;
 			}
+			CPacketDataLegacy *pPacket = &m_aPacketsLegacy[m_NumPacketsLegacy-1];
 
 			// copy header
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
+			mem_copy(pPacket->m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
 
 			// copy server addresses
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp, pCurrent->m_Address.ip,
-				sizeof(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp));
+			mem_copy(pPacket->m_Data.m_aServers[PacketIndexLegacy].m_aIp, pCurrent->m_Address.ip,
+				sizeof(pPacket->m_Data.m_aServers[PacketIndexLegacy].m_aIp));
 			// 0.5 has the port in little endian on the network
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[0] = pCurrent->m_Address.port&0xff;
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[1] = (pCurrent->m_Address.port>>8)&0xff;
+			pPacket->m_Data.m_aServers[PacketIndexLegacy].m_aPort[0] = pCurrent->m_Address.port&0xff;
+			pPacket->m_Data.m_aServers[PacketIndexLegacy].m_aPort[1] = (pCurrent->m_Address.port>>8)&0xff;
 
 			PacketIndexLegacy++;
 
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*PacketIndexLegacy;
-
-			pCurrent++;
+			pPacket->m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*PacketIndexLegacy;
 		}
 		else
 		{
-			*pCurrent = m_aServers[m_NumServers-1];
-			m_NumServers--;
+			RemoveServer(i);
 			dbg_msg("mastersrv", "ERROR: server of invalid type, dropping it");
 		}
 	}
+	m_PacketsDirty = false;
 }
 
 void SendOk(NETADDR *pAddr)
@@ -205,8 +428,21 @@ void SendCheck(NETADDR *pAddr)
 
 void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type)
 {
+	// the heartbeats of a server that is being checked don't start
+	// another check
+	if(FindCheckServer(pInfo, false) != -1)
+		return;
+
 	// add server
-	if(m_NumCheckServers == MAX_SERVERS)
+	int Index;
+	if(m_FirstFreeCheckServer != -1)
+	{
+		Index = m_FirstFreeCheckServer;
+		m_FirstFreeCheckServer = m_aCheckServers[Index].m_HashNext;
+	}
+	else if(m_CheckServersEnd < MAX_SERVERS)
+		Index = m_CheckServersEnd++;
+	else
 	{
 		dbg_msg("mastersrv", "ERROR: mastersrv is full");
 		return;
@@ -217,31 +453,46 @@ void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type)
 	char aAltAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pAlt, aAltAddrStr, sizeof(aAltAddrStr), true);
 	dbg_msg("mastersrv", "checking: %s (%s)", aAddrStr, aAltAddrStr);
-	m_aCheckServers[m_NumCheckServers].m_Address = *pInfo;
-	m_aCheckServers[m_NumCheckServers].m_AltAddress = *pAlt;
-	m_aCheckServers[m_NumCheckServers].m_TryCount = 0;
-	m_aCheckServers[m_NumCheckServers].m_TryTime = 0;
-	m_aCheckServers[m_NumCheckServers].m_Type = Type;
+	CCheckServer *pCheck = &m_aCheckServers[Index];
+	pCheck->m_Address = *pInfo;
+	pCheck->m_AltAddress = *pAlt;
+	pCheck->m_TryCount = 0;
+	pCheck->m_TryTime = 0;
+	pCheck->m_Type = Type;
+	pCheck->m_Used = true;
+	int *pBucket = &m_aCheckHash[ServerHash(pInfo)];
+	pCheck->m_HashNext = *pBucket;
+	*pBucket = Index;
+	pBucket = &m_aCheckAltHash[ServerHash(pAlt)];
+	pCheck->m_AltHashNext = *pBucket;
+	*pBucket = Index;
 	m_NumCheckServers++;
 }
 
 void AddServer(NETADDR *pInfo, ServerType Type)
 {
 	// see if server already exists in list
-	for(int i = 0; i < m_NumServers; i++)
+	int Index = FindServer(pInfo);
+	if(Index != -1)
 	{
-		if(net_addr_comp(&m_aServers[i].m_Address, pInfo) == 0)
-		{
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "updated: %s", aAddrStr);
-			m_aServers[i].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-			return;
-		}
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
+		dbg_msg("mastersrv", "updated: %s", aAddrStr);
+		WheelRemove(Index);
+		m_aServers[Index].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+		WheelInsert(Index);
+		return;
 	}
 
 	// add server
-	if(m_NumServers == MAX_SERVERS)
+	if(m_FirstFreeServer != -1)
+	{
+		Index = m_FirstFreeServer;
+		m_FirstFreeServer = m_aServers[Index].m_HashNext;
+	}
+	else if(m_ServersEnd < MAX_SERVERS)
+		Index = m_ServersEnd++;
+	else
 	{
 		dbg_msg("mastersrv", "ERROR: mastersrv is full");
 		return;
@@ -250,18 +501,27 @@ void AddServer(NETADDR *pInfo, ServerType Type)
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	dbg_msg("mastersrv", "added: %s", aAddrStr);
-	m_aServers[m_NumServers].m_Address = *pInfo;
-	m_aServers[m_NumServers].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-	m_aServers[m_NumServers].m_Type = Type;
+	CServerEntry *pServer = &m_aServers[Index];
+	pServer->m_Address = *pInfo;
+	pServer->m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+	pServer->m_Type = Type;
+	pServer->m_Used = true;
+	int *pBucket = &m_aServerHash[ServerHash(pInfo)];
+	pServer->m_HashNext = *pBucket;
+	*pBucket = Index;
+	WheelInsert(Index);
 	m_NumServers++;
+	m_PacketsDirty = true;
 }
 
 void UpdateServers()
 {
 	int64 Now = time_get();
 	int64 Freq = time_freq();
-	for(int i = 0; i < m_NumCheckServers; i++)
+	for(int i = 0; i < m_CheckServersEnd; i++)
 	{
+		if(!m_aCheckServers[i].m_Used)
+			continue;
 		if(Now > m_aCheckServers[i].m_TryTime+Freq)
 		{
 			if(m_aCheckServers[i].m_TryCount == 10)
@@ -274,9 +534,7 @@ void UpdateServers()
 
 				// FAIL!!
 				SendError(&m_aCheckServers[i].m_Address);
-				m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers-1];
-				m_NumCheckServers--;
-				i--;
+				RemoveCheckServer(i);
 			}
 			else
 			{
@@ -294,20 +552,27 @@ void UpdateServers()
 void PurgeServers()
 {
 	int64 Now = time_get();
-	int i = 0;
-	while(i < m_NumServers)
+	int64 NowSecond = Now/time_freq();
+	// everything in the slots of the past seconds expired, unless we were
+	// stuck for a whole turn of the wheel
+	if(NowSecond - m_NextExpireSecond > EXPIRE_WHEEL_SIZE)
+		m_NextExpireSecond = NowSecond - EXPIRE_WHEEL_SIZE;
+	for(; m_NextExpireSecond < NowSecond; m_NextExpireSecond++)
 	{
-		if(m_aServers[i].m_Expire < Now)
+		int i = m_aExpireWheel[m_NextExpireSecond%EXPIRE_WHEEL_SIZE];
+		while(i != -1)
 		{
-			// remove server
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(&m_aServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "expired: %s", aAddrStr);
-			m_aServers[i] = m_aServers[m_NumServers-1];
-			m_NumServers--;
+			int Next = m_aServers[i].m_WheelNext;
+			if(m_aServers[i].m_Expire < Now)
+			{
+				// remove server
+				char aAddrStr[NETADDR_MAXSTRSIZE];
+				net_addr_str(&m_aServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
+				dbg_msg("mastersrv", "expired: %s", aAddrStr);
+				RemoveServer(i);
+			}
+			i = Next;
 		}
-		else
-			i++;
 	}
 }
 
@@ -326,6 +591,8 @@ int main(int argc, const char **argv) // ignore_convention
 	dbg_logger_stdout();
 	net_init();
 
+	InitServers();
+
 	mem_copy(m_CountData.m_Header, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT));
 	mem_copy(m_CountDataLegacy.m_Header, SERVERBROWSE_COUNT_LEGACY, sizeof(SERVERBROWSE_COUNT_LEGACY));
 
@@ -449,6 +716,9 @@ int main(int argc, const char **argv) // ignore_convention
 			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETLIST) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETLIST, sizeof(SERVERBROWSE_GETLIST)) == 0)
 			{
+				if(!AllowList(&Packet.m_Address))
+					continue;
+
 				// someone requested the list
 				dbg_msg("mastersrv", "requested, responding with %d m_aServers", m_NumServers);
 
@@ -467,6 +737,9 @@ int main(int argc, const char **argv) // ignore_convention
 			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETLIST_LEGACY) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETLIST_LEGACY, sizeof(SERVERBROWSE_GETLIST_LEGACY)) == 0)
 			{
+				if(!AllowList(&Packet.m_Address))
+					continue;
+
 				// someone requested the list
 				dbg_msg("mastersrv", "requested, responding with %d m_aServers", m_NumServers);
 
@@ -494,23 +767,16 @@ int main(int argc, const char **argv) // ignore_convention
 			if(Packet.m_DataSize == sizeof(SERVERBROWSE_FWRESPONSE) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_FWRESPONSE, sizeof(SERVERBROWSE_FWRESPONSE)) == 0)
 			{
-				Type = SERVERTYPE_INVALID;
 				// remove it from checking
-				for(int i = 0; i < m_NumCheckServers; i++)
-				{
-					if(net_addr_comp(&m_aCheckServers[i].m_Address, &Packet.m_Address) == 0 ||
-						net_addr_comp(&m_aCheckServers[i].m_AltAddress, &Packet.m_Address) == 0)
-					{
-						Type = m_aCheckServers[i].m_Type;
-						m_NumCheckServers--;
-						m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers];
-						break;
-					}
-				}
+				int Index = FindCheckServer(&Packet.m_Address, false);
+				if(Index == -1)
+					Index = FindCheckServer(&Packet.m_Address, true);
 
 				// drops servers that were not in the CheckServers list
-				if(Type == SERVERTYPE_INVALID)
+				if(Index == -1)
 					continue;
+				Type = m_aCheckServers[Index].m_Type;
+				RemoveCheckServer(Index);
 
 				AddServer(&Packet.m_Address, Type);
 				SendOk(&Packet.m_Address);
@@ -530,7 +796,8 @@ int main(int argc, const char **argv) // ignore_convention
 
 			PurgeServers();
 			UpdateServers();
-			BuildPackets();
+			if(m_PacketsDirty)
+				BuildPackets();
 		}
 
 		// be nice to the CPU
@@ -0,0 +1,566 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <vector>
+
+static unsigned s_Seed = 1;
+static int Random(int Max)
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) % Max;
+}
+
+static float RandomFloat(float Max)
+{
+	return Random(1000000) / 1000000.0f * Max;
+}
+
+// map with one group and a game, front and tele layer of random tiles
+class CRandomMap : public IMap
+{
+	enum
+	{
+		LAYER_GAME=0,
+		LAYER_FRONT,
+		LAYER_TELE,
+		NUM_LAYERS
+	};
+
+	CMapItemGroup m_Group;
+	CMapItemLayerTilemap m_aLayers[NUM_LAYERS];
+	std::vector<CTile> m_vGame;
+	std::vector<CTile> m_vFront;
+	std::vector<CTeleTile> m_vTele;
+
+public:
+	CRandomMap(int Width, int Height)
+	{
+		mem_zero(&m_Group, sizeof(m_Group));
+		m_Group.m_Version = CMapItemGroup::CURRENT_VERSION;
+		m_Group.m_NumLayers = NUM_LAYERS;
+		static const int s_aFlags[NUM_LAYERS] = {TILESLAYERFLAG_GAME, TILESLAYERFLAG_FRONT, TILESLAYERFLAG_TELE};
+		for(int i = 0; i < NUM_LAYERS; i++)
+		{
+			mem_zero(&m_aLayers[i], sizeof(m_aLayers[i]));
+			m_aLayers[i].m_Layer.m_Type = LAYERTYPE_TILES;
+			m_aLayers[i].m_Version = 3;
+			m_aLayers[i].m_Width = Width;
+			m_aLayers[i].m_Height = Height;
+			m_aLayers[i].m_Flags = s_aFlags[i];
+			m_aLayers[i].m_Data = LAYER_GAME;
+		}
+		m_aLayers[LAYER_FRONT].m_Front = LAYER_FRONT;
+		m_aLayers[LAYER_TELE].m_Tele = LAYER_TELE;
+
+		static const int s_aGameTiles[] = {TILE_SOLID, TILE_NOHOOK, TILE_NOLASER, TILE_DEATH, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_DIR, TILE_THROUGH_CUT, TILE_FREEZE, TILE_UNFREEZE, TILE_STOP, TILE_STOPA};
+		static const int s_aFrontTiles[] = {TILE_NOLASER, TILE_DEATH, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_DIR, TILE_THROUGH_CUT};
+		static const int s_aTeleTiles[] = {TILE_TELEIN, TILE_TELEINEVIL, TILE_TELEINWEAPON, TILE_TELEINHOOK};
+		static const int s_aRotations[] = {ROTATION_0, ROTATION_90, ROTATION_180, ROTATION_270};
+		m_vGame.resize(Width * Height);
+		m_vFront.resize(Width * Height);
+		m_vTele.resize(Width * Height);
+		for(int i = 0; i < Width * Height; i++)
+		{
+			mem_zero(&m_vGame[i], sizeof(CTile));
+			mem_zero(&m_vFront[i], sizeof(CTile));
+			mem_zero(&m_vTele[i], sizeof(CTeleTile));
+			if(Random(6) == 0)
+			{
+				m_vGame[i].m_Index = s_aGameTiles[Random(sizeof(s_aGameTiles) / sizeof(int))];
+				m_vGame[i].m_Flags = s_aRotations[Random(4)];
+			}
+			if(Random(12) == 0)
+			{
+				m_vFront[i].m_Index = s_aFrontTiles[Random(sizeof(s_aFrontTiles) / sizeof(int))];
+				m_vFront[i].m_Flags = s_aRotations[Random(4)];
+			}
+			if(Random(40) == 0)
+			{
+				m_vTele[i].m_Type = s_aTeleTiles[Random(sizeof(s_aTeleTiles) / sizeof(int))];
+				m_vTele[i].m_Number = 1 + Random(10);
+			}
+		}
+	}
+
+	virtual void *GetData(int Index)
+	{
+		if(Index == LAYER_GAME)
+			return &m_vGame[0];
+		if(Index == LAYER_FRONT)
+			return &m_vFront[0];
+		return &m_vTele[0];
+	}
+	virtual int GetDataSize(int Index)
+	{
+		if(Index == LAYER_TELE)
+			return m_vTele.size() * sizeof(CTeleTile);
+		return m_vGame.size() * sizeof(CTile);
+	}
+	virtual void *GetDataSwapped(int Index) { return GetData(Index); }
+	virtual void UnloadData(int Index) {}
+	// item 0 is the group, the layers follow
+	virtual void *GetItem(int Index, int *pType, int *pID)
+	{
+		if(pType)
+			*pType = Index ? MAPITEMTYPE_LAYER : MAPITEMTYPE_GROUP;
+		if(pID)
+			*pID = Index ? Index - 1 : 0;
+		return Index ? (void *)&m_aLayers[Index - 1] : (void *)&m_Group;
+	}
+	virtual int GetItemSize(int Index) { return Index ? sizeof(CMapItemLayerTilemap) : sizeof(CMapItemGroup); }
+	virtual void GetType(int Type, int *pStart, int *pNum)
+	{
+		*pStart = Type == MAPITEMTYPE_GROUP ? 0 : 1;
+		*pNum = Type == MAPITEMTYPE_GROUP ? 1 : Type == MAPITEMTYPE_LAYER ? NUM_LAYERS : 0;
+	}
+	virtual void *FindItem(int Type, int ID) { return 0; }
+	virtual int NumItems() { return 1 + NUM_LAYERS; }
+};
+
+static vec2 RandomPos(CCollision *pCollision)
+{
+	// also outside of the map and on tile borders
+	float Width = pCollision->GetWidth() * 32.0f;
+	float Height = pCollision->GetHeight() * 32.0f;
+	vec2 Pos = vec2(RandomFloat(Width + 400.0f) - 200.0f, RandomFloat(Height + 400.0f) - 200.0f);
+	if(Random(8) == 0)
+		Pos.x = round_to_int(Pos.x / 32) * 32 - 0.5f;
+	if(Random(8) == 0)
+		Pos.y = round_to_int(Pos.y / 32) * 32 + (Random(2) ? 0.5f : 0.0f);
+	return Pos;
+}
+
+// a ray cast with the results the pixel stepping ray casts gave
+struct CRay
+{
+	enum
+	{
+		LINE=0,
+		TELEHOOK,
+		TELEWEAPON,
+		NOLASER,
+		NOLASERNW,
+		AIR,
+	};
+	int m_Function;
+	bool m_OldTeleport;
+	vec2 m_Pos0;
+	vec2 m_Pos1;
+	int m_Result;
+	vec2 m_Collision;
+	vec2 m_BeforeCollision;
+	int m_TeleNr;
+};
+
+// along tile borders, through tele tiles and through the different kinds of tiles
+static const CRay s_aRandomMapRays[] = {
+	{CRay::LINE, false, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0},
+	{CRay::TELEHOOK, false, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0},
+	{CRay::TELEWEAPON, false, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0},
+	{CRay::NOLASER, false, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0},
+	{CRay::NOLASERNW, false, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0},
+	{CRay::AIR, false, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0, {991.5f, 467.089355f}, {991.5f, 467.089355f}, 0},
+	{CRay::LINE, true, {255.5f, 220.302399f}, {865.992798f, 813.211182f}, 0, {865.992798f, 813.211182f}, {865.992798f, 813.211182f}, 0},
+	{CRay::TELEHOOK, true, {255.5f, 220.302399f}, {865.992798f, 813.211182f}, 0, {865.992798f, 813.211182f}, {865.992798f, 813.211182f}, 0},
+	{CRay::TELEWEAPON, true, {255.5f, 220.302399f}, {865.992798f, 813.211182f}, 0, {865.992798f, 813.211182f}, {865.992798f, 813.211182f}, 0},
+	{CRay::NOLASER, true, {255.5f, 220.302399f}, {865.992798f, 813.211182f}, 4, {358.082825f, 319.930542f}, {357.365448f, 319.233826f}, 0},
+	{CRay::NOLASERNW, true, {255.5f, 220.302399f}, {865.992798f, 813.211182f}, 4, {358.082825f, 319.930542f}, {357.365448f, 319.233826f}, 0},
+	{CRay::AIR, true, {255.5f, 220.302399f}, {865.992798f, 813.211182f}, -1, {255.5f, 220.302399f}, {255.5f, 220.302399f}, 0},
+	{CRay::LINE, false, {-45.2931213f, -32.2973633f}, {539.559692f, -344.340546f}, 0, {539.559692f, -344.340546f}, {539.559692f, -344.340546f}, 0},
+	{CRay::TELEHOOK, false, {-45.2931213f, -32.2973633f}, {539.559692f, -344.340546f}, 3, {384.304626f, -261.505554f}, {383.422516f, -261.034912f}, 0},
+	{CRay::TELEWEAPON, false, {-45.2931213f, -32.2973633f}, {539.559692f, -344.340546f}, 0, {539.559692f, -344.340546f}, {539.559692f, -344.340546f}, 0},
+	{CRay::NOLASER, false, {-45.2931213f, -32.2973633f}, {539.559692f, -344.340546f}, 4, {479.661469f, -312.382385f}, {478.779205f, -311.911652f}, 0},
+	{CRay::NOLASERNW, false, {-45.2931213f, -32.2973633f}, {539.559692f, -344.340546f}, 4, {479.661469f, -312.382385f}, {478.779205f, -311.911652f}, 0},
+	{CRay::AIR, false, {-45.2931213f, -32.2973633f}, {539.559692f, -344.340546f}, -1, {-45.2931213f, -32.2973633f}, {-45.2931213f, -32.2973633f}, 0},
+	{CRay::LINE, true, {-197.104645f, 704.243225f}, {530.724121f, -23.5855103f}, 1, {28.3102722f, 478.828308f}, {27.603653f, 479.534912f}, 0},
+	{CRay::TELEHOOK, true, {-197.104645f, 704.243225f}, {530.724121f, -23.5855103f}, 1, {28.3102722f, 478.828308f}, {27.603653f, 479.534912f}, 0},
+	{CRay::TELEWEAPON, true, {-197.104645f, 704.243225f}, {530.724121f, -23.5855103f}, 1, {28.3102722f, 478.828308f}, {27.603653f, 479.534912f}, 0},
+	{CRay::NOLASER, true, {-197.104645f, 704.243225f}, {530.724121f, -23.5855103f}, 1, {27.7553101f, 479.38327f}, {27.0481873f, 480.090393f}, 0},
+	{CRay::NOLASERNW, true, {-197.104645f, 704.243225f}, {530.724121f, -23.5855103f}, 4, {479.596527f, 27.5420532f}, {478.889374f, 28.2492065f}, 0},
+	{CRay::AIR, true, {-197.104645f, 704.243225f}, {530.724121f, -23.5855103f}, -1, {-197.104645f, 704.243225f}, {-197.104645f, 704.243225f}, 0},
+	{CRay::LINE, false, {1818.1239f, 678.51062f}, {2331.32373f, -80.119751f}, 3, {2256.24854f, 30.8589478f}, {2255.68848f, 31.6871338f}, 0},
+	{CRay::TELEHOOK, false, {1818.1239f, 678.51062f}, {2331.32373f, -80.119751f}, 3, {1855.6615f, 623.021301f}, {1855.1012f, 623.849487f}, 0},
+	{CRay::TELEWEAPON, false, {1818.1239f, 678.51062f}, {2331.32373f, -80.119751f}, 3, {2256.24854f, 30.8589478f}, {2255.68848f, 31.6871338f}, 0},
+	{CRay::NOLASER, false, {1818.1239f, 678.51062f}, {2331.32373f, -80.119751f}, 4, {2083.15332f, 286.73465f}, {2082.59302f, 287.562897f}, 0},
+	{CRay::NOLASERNW, false, {1818.1239f, 678.51062f}, {2331.32373f, -80.119751f}, 4, {2083.15332f, 286.73465f}, {2082.59302f, 287.562897f}, 0},
+	{CRay::AIR, false, {1818.1239f, 678.51062f}, {2331.32373f, -80.119751f}, -1, {1818.1239f, 678.51062f}, {1818.1239f, 678.51062f}, 0},
+	{CRay::LINE, true, {1618.70129f, 1175.39246f}, {1424.30762f, 1175.39246f}, 0, {1424.30762f, 1175.39246f}, {1424.30762f, 1175.39246f}, 0},
+	{CRay::TELEHOOK, true, {1618.70129f, 1175.39246f}, {1424.30762f, 1175.39246f}, 3, {1618.70129f, 1175.39246f}, {1618.70129f, 1175.39246f}, 0},
+	{CRay::TELEWEAPON, true, {1618.70129f, 1175.39246f}, {1424.30762f, 1175.39246f}, 14, {1471.1615f, 1175.39246f}, {1472.15833f, 1175.39246f}, 10},
+	{CRay::NOLASER, true, {1618.70129f, 1175.39246f}, {1424.30762f, 1175.39246f}, 0, {1424.30762f, 1175.39246f}, {1424.30762f, 1175.39246f}, 0},
+	{CRay::NOLASERNW, true, {1618.70129f, 1175.39246f}, {1424.30762f, 1175.39246f}, 0, {1424.30762f, 1175.39246f}, {1424.30762f, 1175.39246f}, 0},
+	{CRay::AIR, true, {1618.70129f, 1175.39246f}, {1424.30762f, 1175.39246f}, -1, {1618.70129f, 1175.39246f}, {1618.70129f, 1175.39246f}, 0},
+	{CRay::LINE, true, {432.62915f, 356.138794f}, {-337.436462f, -413.926819f}, 3, {127.428833f, 50.9384766f}, {128.135315f, 51.6449585f}, 0},
+	{CRay::TELEHOOK, true, {432.62915f, 356.138794f}, {-337.436462f, -413.926819f}, 3, {235.520615f, 159.030258f}, {236.227097f, 159.73674f}, 0},
+	{CRay::TELEWEAPON, true, {432.62915f, 356.138794f}, {-337.436462f, -413.926819f}, 3, {127.428833f, 50.9384766f}, {128.135315f, 51.6449585f}, 0},
+	{CRay::NOLASER, true, {432.62915f, 356.138794f}, {-337.436462f, -413.926819f}, 3, {127.159027f, 50.6686707f}, {127.866119f, 51.3757629f}, 0},
+	{CRay::NOLASERNW, true, {432.62915f, 356.138794f}, {-337.436462f, -413.926819f}, 0, {-337.436462f, -413.926819f}, {-337.436462f, -413.926819f}, 0},
+	{CRay::AIR, true, {432.62915f, 356.138794f}, {-337.436462f, -413.926819f}, -1, {432.62915f, 356.138794f}, {432.62915f, 356.138794f}, 0},
+	{CRay::LINE, false, {1519.61426f, 1309.20276f}, {1519.61426f, 656.524353f}, 0, {1519.61426f, 656.524353f}, {1519.61426f, 656.524353f}, 0},
+	{CRay::TELEHOOK, false, {1519.61426f, 1309.20276f}, {1519.61426f, 656.524353f}, 3, {1519.61426f, 959.375122f}, {1519.61426f, 960.374634f}, 0},
+	{CRay::TELEWEAPON, false, {1519.61426f, 1309.20276f}, {1519.61426f, 656.524353f}, 0, {1519.61426f, 656.524353f}, {1519.61426f, 656.524353f}, 0},
+	{CRay::NOLASER, false, {1519.61426f, 1309.20276f}, {1519.61426f, 656.524353f}, 4, {1519.61426f, 735.202759f}, {1519.61426f, 736.202759f}, 0},
+	{CRay::NOLASERNW, false, {1519.61426f, 1309.20276f}, {1519.61426f, 656.524353f}, 4, {1519.61426f, 735.202759f}, {1519.61426f, 736.202759f}, 0},
+	{CRay::AIR, false, {1519.61426f, 1309.20276f}, {1519.61426f, 656.524353f}, -1, {1519.61426f, 1309.20276f}, {1519.61426f, 1309.20276f}, 0},
+	{CRay::LINE, false, {1427.59839f, 282.998352f}, {709.238403f, -435.361633f}, 3, {1335.68225f, 191.082214f}, {1336.38928f, 191.789261f}, 0},
+	{CRay::TELEHOOK, false, {1427.59839f, 282.998352f}, {709.238403f, -435.361633f}, 3, {1151.14294f, 6.5428772f}, {1151.84998f, 7.24993896f}, 0},
+	{CRay::TELEWEAPON, false, {1427.59839f, 282.998352f}, {709.238403f, -435.361633f}, 3, {1335.68225f, 191.082214f}, {1336.38928f, 191.789261f}, 0},
+	{CRay::NOLASER, false, {1427.59839f, 282.998352f}, {709.238403f, -435.361633f}, 3, {1335.67456f, 191.074463f}, {1336.38159f, 191.781586f}, 0},
+	{CRay::NOLASERNW, false, {1427.59839f, 282.998352f}, {709.238403f, -435.361633f}, 4, {1303.85474f, 159.254669f}, {1304.56177f, 159.961761f}, 0},
+	{CRay::AIR, false, {1427.59839f, 282.998352f}, {709.238403f, -435.361633f}, -1, {1427.59839f, 282.998352f}, {1427.59839f, 282.998352f}, 0},
+	{CRay::LINE, false, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0},
+	{CRay::TELEHOOK, false, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 15, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 9},
+	{CRay::TELEWEAPON, false, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0},
+	{CRay::NOLASER, false, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0},
+	{CRay::NOLASERNW, false, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0},
+	{CRay::AIR, false, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0, {513.23761f, 656.319519f}, {513.23761f, 656.319519f}, 0},
+	{CRay::LINE, true, {997.502808f, 1437.47253f}, {1777.9812f, 1437.47253f}, 0, {1777.9812f, 1437.47253f}, {1777.9812f, 1437.47253f}, 0},
+	{CRay::TELEHOOK, true, {997.502808f, 1437.47253f}, {1777.9812f, 1437.47253f}, 15, {1472.18555f, 1437.47253f}, {1471.18628f, 1437.47253f}, 6},
+	{CRay::TELEWEAPON, true, {997.502808f, 1437.47253f}, {1777.9812f, 1437.47253f}, 14, {1472.18555f, 1437.47253f}, {1471.18628f, 1437.47253f}, 6},
+	{CRay::NOLASER, true, {997.502808f, 1437.47253f}, {1777.9812f, 1437.47253f}, 0, {1777.9812f, 1437.47253f}, {1777.9812f, 1437.47253f}, 0},
+	{CRay::NOLASERNW, true, {997.502808f, 1437.47253f}, {1777.9812f, 1437.47253f}, 0, {1777.9812f, 1437.47253f}, {1777.9812f, 1437.47253f}, 0},
+	{CRay::AIR, true, {997.502808f, 1437.47253f}, {1777.9812f, 1437.47253f}, -1, {997.502808f, 1437.47253f}, {997.502808f, 1437.47253f}, 0},
+	{CRay::LINE, false, {986.635864f, -71.9588013f}, {1382.86633f, -28.3267822f}, 3, {1375.91492f, -29.0922546f}, {1374.92188f, -29.2016106f}, 0},
+	{CRay::TELEHOOK, false, {986.635864f, -71.9588013f}, {1382.86633f, -28.3267822f}, 3, {986.635864f, -71.9588013f}, {986.635864f, -71.9588013f}, 0},
+	{CRay::TELEWEAPON, false, {986.635864f, -71.9588013f}, {1382.86633f, -28.3267822f}, 14, {991.601135f, -71.4120331f}, {990.608093f, -71.5213852f}, 5},
+	{CRay::NOLASER, false, {986.635864f, -71.9588013f}, {1382.86633f, -28.3267822f}, 3, {1376.28052f, -29.0519905f}, {1375.28662f, -29.1614456f}, 0},
+	{CRay::NOLASERNW, false, {986.635864f, -71.9588013f}, {1382.86633f, -28.3267822f}, 0, {1382.86633f, -28.3267822f}, {1382.86633f, -28.3267822f}, 0},
+	{CRay::AIR, false, {986.635864f, -71.9588013f}, {1382.86633f, -28.3267822f}, -1, {986.635864f, -71.9588013f}, {986.635864f, -71.9588013f}, 0},
+};
+
+static const CRay s_aKobraRays[] = {
+	{CRay::LINE, false, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0},
+	{CRay::TELEHOOK, false, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0},
+	{CRay::TELEWEAPON, false, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0},
+	{CRay::NOLASER, false, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0},
+	{CRay::NOLASERNW, false, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0},
+	{CRay::AIR, false, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0, {4162.81006f, 15059.6592f}, {4162.81006f, 15059.6592f}, 0},
+	{CRay::LINE, true, {9567.5f, 5662.47559f}, {10086.0635f, 5143.91211f}, 1, {9792.16406f, 5437.81201f}, {9791.45703f, 5438.51855f}, 0},
+	{CRay::TELEHOOK, true, {9567.5f, 5662.47559f}, {10086.0635f, 5143.91211f}, 1, {9792.16406f, 5437.81201f}, {9791.45703f, 5438.51855f}, 0},
+	{CRay::TELEWEAPON, true, {9567.5f, 5662.47559f}, {10086.0635f, 5143.91211f}, 1, {9792.16406f, 5437.81201f}, {9791.45703f, 5438.51855f}, 0},
+	{CRay::NOLASER, true, {9567.5f, 5662.47559f}, {10086.0635f, 5143.91211f}, 1, {9791.65332f, 5438.32275f}, {9790.94531f, 5439.02979f}, 0},
+	{CRay::NOLASERNW, true, {9567.5f, 5662.47559f}, {10086.0635f, 5143.91211f}, 0, {10086.0635f, 5143.91211f}, {10086.0635f, 5143.91211f}, 0},
+	{CRay::AIR, true, {9567.5f, 5662.47559f}, {10086.0635f, 5143.91211f}, -1, {9567.5f, 5662.47559f}, {9567.5f, 5662.47559f}, 0},
+	{CRay::LINE, false, {3296.79175f, 1006.08875f}, {3827.84766f, 1426.82483f}, 3, {3803.56641f, 1407.58765f}, {3802.7832f, 1406.96704f}, 0},
+	{CRay::TELEHOOK, false, {3296.79175f, 1006.08875f}, {3827.84766f, 1426.82483f}, 3, {3803.56641f, 1407.58765f}, {3802.7832f, 1406.96704f}, 0},
+	{CRay::TELEWEAPON, false, {3296.79175f, 1006.08875f}, {3827.84766f, 1426.82483f}, 3, {3803.56641f, 1407.58765f}, {3802.7832f, 1406.96704f}, 0},
+	{CRay::NOLASER, false, {3296.79175f, 1006.08875f}, {3827.84766f, 1426.82483f}, 3, {3803.92212f, 1407.86951f}, {3803.13818f, 1407.24854f}, 0},
+	{CRay::NOLASERNW, false, {3296.79175f, 1006.08875f}, {3827.84766f, 1426.82483f}, 0, {3827.84766f, 1426.82483f}, {3827.84766f, 1426.82483f}, 0},
+	{CRay::AIR, false, {3296.79175f, 1006.08875f}, {3827.84766f, 1426.82483f}, -1, {3296.79175f, 1006.08875f}, {3296.79175f, 1006.08875f}, 0},
+	{CRay::LINE, true, {2701.40601f, 8682.74805f}, {2109.75806f, 8682.74805f}, 3, {2302.64331f, 8682.74805f}, {2303.64258f, 8682.74805f}, 0},
+	{CRay::TELEHOOK, true, {2701.40601f, 8682.74805f}, {2109.75806f, 8682.74805f}, 3, {2302.64331f, 8682.74805f}, {2303.64258f, 8682.74805f}, 0},
+	{CRay::TELEWEAPON, true, {2701.40601f, 8682.74805f}, {2109.75806f, 8682.74805f}, 3, {2302.64331f, 8682.74805f}, {2303.64258f, 8682.74805f}, 0},
+	{CRay::NOLASER, true, {2701.40601f, 8682.74805f}, {2109.75806f, 8682.74805f}, 3, {2303.40601f, 8682.74805f}, {2304.40601f, 8682.74805f}, 0},
+	{CRay::NOLASERNW, true, {2701.40601f, 8682.74805f}, {2109.75806f, 8682.74805f}, 0, {2109.75806f, 8682.74805f}, {2109.75806f, 8682.74805f}, 0},
+	{CRay::AIR, true, {2701.40601f, 8682.74805f}, {2109.75806f, 8682.74805f}, -1, {2701.40601f, 8682.74805f}, {2701.40601f, 8682.74805f}, 0},
+	{CRay::LINE, false, {2698.56885f, 1856.0f}, {2205.22974f, 1970.37756f}, 3, {2285.99341f, 1951.65308f}, {2286.96631f, 1951.42749f}, 0},
+	{CRay::TELEHOOK, false, {2698.56885f, 1856.0f}, {2205.22974f, 1970.37756f}, 15, {2430.97852f, 1918.03906f}, {2431.95166f, 1917.81348f}, 51},
+	{CRay::TELEWEAPON, false, {2698.56885f, 1856.0f}, {2205.22974f, 1970.37756f}, 3, {2285.99341f, 1951.65308f}, {2286.96631f, 1951.42749f}, 0},
+	{CRay::NOLASER, false, {2698.56885f, 1856.0f}, {2205.22974f, 1970.37756f}, 3, {2286.49854f, 1951.53589f}, {2287.47266f, 1951.31006f}, 0},
+	{CRay::NOLASERNW, false, {2698.56885f, 1856.0f}, {2205.22974f, 1970.37756f}, 0, {2205.22974f, 1970.37756f}, {2205.22974f, 1970.37756f}, 0},
+	{CRay::AIR, false, {2698.56885f, 1856.0f}, {2205.22974f, 1970.37756f}, -1, {2698.56885f, 1856.0f}, {2698.56885f, 1856.0f}, 0},
+};
+
+static void CheckRays(CCollision *pCollision, const CRay *pRays, int NumRays)
+{
+	for(int i = 0; i < NumRays; i++)
+	{
+		const CRay *pRay = &pRays[i];
+		g_Config.m_SvOldTeleportHook = pRay->m_OldTeleport;
+		g_Config.m_SvOldTeleportWeapons = pRay->m_OldTeleport;
+		SCOPED_TRACE(testing::Message() << "ray " << i << " from " << pRay->m_Pos0.x << "," << pRay->m_Pos0.y << " to " << pRay->m_Pos1.x << "," << pRay->m_Pos1.y);
+
+		vec2 Col, Before;
+		int TeleNr = 0;
+		int Result = 0;
+		switch(pRay->m_Function)
+		{
+		case CRay::LINE: Result = pCollision->IntersectLine(pRay->m_Pos0, pRay->m_Pos1, &Col, &Before); break;
+		case CRay::TELEHOOK: Result = pCollision->IntersectLineTeleHook(pRay->m_Pos0, pRay->m_Pos1, &Col, &Before, &TeleNr); break;
+		case CRay::TELEWEAPON: Result = pCollision->IntersectLineTeleWeapon(pRay->m_Pos0, pRay->m_Pos1, &Col, &Before, &TeleNr); break;
+		case CRay::NOLASER: Result = pCollision->IntersectNoLaser(pRay->m_Pos0, pRay->m_Pos1, &Col, &Before); break;
+		case CRay::NOLASERNW: Result = pCollision->IntersectNoLaserNW(pRay->m_Pos0, pRay->m_Pos1, &Col, &Before); break;
+		case CRay::AIR: Result = pCollision->IntersectAir(pRay->m_Pos0, pRay->m_Pos1, &Col, &Before); break;
+		}
+		EXPECT_EQ(Result, pRay->m_Result);
+		EXPECT_FLOAT_EQ(Col.x, pRay->m_Collision.x);
+		EXPECT_FLOAT_EQ(Col.y, pRay->m_Collision.y);
+		EXPECT_FLOAT_EQ(Before.x, pRay->m_BeforeCollision.x);
+		EXPECT_FLOAT_EQ(Before.y, pRay->m_BeforeCollision.y);
+		EXPECT_EQ(TeleNr, pRay->m_TeleNr);
+	}
+	g_Config.m_SvOldTeleportHook = 0;
+	g_Config.m_SvOldTeleportWeapons = 0;
+}
+
+// a move with the tiles the pixel stepping GetMapIndices found
+struct CMapIndicesLine
+{
+	vec2 m_PrevPos;
+	vec2 m_Pos;
+	int m_NumIndices;
+	int m_aIndices[8];
+};
+
+static const CMapIndicesLine s_aRandomMapLines[] = {
+	{{1495.44214f, 700.597595f}, {1495.44214f, 700.597595f}, 1, {1306}},
+	{{1872.44434f, 401.21991f}, {2579.48096f, 744.661438f}, 3, {959, 1019, 1139}},
+	{{1032.47913f, 95.4683228f}, {1218.26465f, 95.4683228f}, 1, {158}},
+	{{859.277222f, 381.474915f}, {388.678802f, 59.5133057f}, 3, {563, 255, 194}},
+	{{1185.69897f, 29.2074432f}, {1182.36304f, 296.826721f}, 3, {37, 337, 516}},
+	{{1192.18323f, 637.196106f}, {666.94165f, 222.19931f}, 5, {1116, 931, 871, 870, 563}},
+	{{1535.41565f, 192.500092f}, {1001.9325f, 280.197723f}, 8, {404, 403, 458, 457, 455, 515, 514, 511}},
+	{{1887.5f, 297.286713f}, {2679.99438f, 1089.78113f}, 5, {959, 1019, 1139, 1919, 2099}},
+	{{1383.26074f, 1067.38696f}, {2053.0144f, 995.682983f}, 5, {2023, 1966, 1970, 1915, 1919}},
+	{{1182.82214f, 480.0f}, {699.031738f, 1157.07043f}, 5, {1411, 1648, 2062, 2122, 2181}},
+};
+
+static const CMapIndicesLine s_aKobraLines[] = {
+	{{6253.05566f, 3584.5f}, {6253.05566f, 3584.5f}, 1, {56195}},
+	{{3742.69116f, 14214.1406f}, {4154.61621f, 14924.2764f}, 6, {231627, 231628, 232128, 232129, 232629, 233129}},
+	{{8251.16602f, 8128.31348f}, {8251.16602f, 8128.31348f}, 1, {127257}},
+	{{8396.46973f, 12753.2939f}, {8105.81543f, 13180.3213f}, 5, {199262, 199762, 199761, 200261, 200260}},
+};
+
+static void GetMapIndices(CCollision *pCollision, vec2 PrevPos, vec2 Pos, int BufferSize, std::vector<int> *pvIndices)
+{
+	pvIndices->clear();
+	int aIndices[16];
+	int Cursor = 0;
+	while(Cursor >= 0)
+	{
+		int Num = pCollision->GetMapIndices(PrevPos, Pos, aIndices, BufferSize, &Cursor);
+		pvIndices->insert(pvIndices->end(), aIndices, aIndices + Num);
+	}
+}
+
+static void CheckMapIndices(CCollision *pCollision, const CMapIndicesLine *pLines, int NumLines)
+{
+	std::vector<int> vIndices;
+	for(int i = 0; i < NumLines; i++)
+	{
+		const CMapIndicesLine *pLine = &pLines[i];
+		std::vector<int> vExpected(pLine->m_aIndices, pLine->m_aIndices + pLine->m_NumIndices);
+		SCOPED_TRACE(testing::Message() << "line " << i << " from " << pLine->m_PrevPos.x << "," << pLine->m_PrevPos.y << " to " << pLine->m_Pos.x << "," << pLine->m_Pos.y);
+		// also in parts
+		for(int BufferSize = 1; BufferSize <= 8; BufferSize++)
+		{
+			GetMapIndices(pCollision, pLine->m_PrevPos, pLine->m_Pos, BufferSize, &vIndices);
+			ASSERT_EQ(vIndices, vExpected);
+		}
+	}
+}
+
+// a point and a move with the results the checks on the layers gave
+struct CTileCheck
+{
+	vec2 m_Pos;
+	vec2 m_Pos1;
+	bool m_Solid;
+	bool m_Through;
+	bool m_HookBlocker;
+};
+
+static const CTileCheck s_aRandomMapTileChecks[] = {
+	{{534.978333f, 864.5f}, {354.783142f, 1044.69519f}, false, false, false},
+	{{863.5f, 992.5f}, {863.5f, 1704.29675f}, false, false, false},
+	{{29.4897614f, 1105.44067f}, {29.4897614f, 1105.44067f}, false, false, false},
+	{{2093.66333f, 1254.24487f}, {1371.61206f, 1592.59363f}, false, false, false},
+	{{1958.20312f, 497.223511f}, {1958.20312f, 497.223511f}, false, true, true},
+	{{313.926392f, 915.479736f}, {-114.291199f, 1673.9469f}, false, false, true},
+	{{1722.06897f, 693.575134f}, {1722.06897f, 693.575134f}, false, true, false},
+	{{-36.2636871f, 96.0f}, {-263.830078f, -645.305603f}, true, false, false},
+	{{2020.17041f, -73.403595f}, {1269.72083f, 677.046021f}, true, false, false},
+	{{947.764282f, 1292.43799f}, {812.452271f, 1427.75f}, true, false, false},
+	{{1549.70459f, 1216.56592f}, {1559.56702f, 1206.70349f}, false, true, true},
+	{{1648.59216f, 542.465942f}, {1641.27698f, 549.781128f}, false, true, false},
+	{{590.35437f, 95.9487915f}, {1348.84241f, 89.9407959f}, true, false, false},
+	{{799.5f, 18.5444946f}, {1085.2041f, 369.155701f}, false, false, true},
+	{{-128.5f, 33.147049f}, {-528.12085f, -625.400146f}, false, true, false},
+	{{666.559448f, 704.5f}, {898.48584f, 704.5f}, false, true, false},
+};
+
+static const CTileCheck s_aKobraTileChecks[] = {
+	{{4641.19824f, 15335.8682f}, {4642.88965f, 15334.0146f}, false, false, false},
+	{{15753.7891f, 2311.61084f}, {15753.7891f, 2311.61084f}, false, false, false},
+	{{4013.07812f, 14696.4971f}, {4013.07812f, 14696.4971f}, false, true, false},
+	{{3876.03955f, 15435.3662f}, {4265.3916f, 16100.8066f}, true, false, false},
+	{{39.1447906f, 7868.43896f}, {39.1447906f, 7868.43896f}, true, false, false},
+	{{8360.68457f, 3373.96997f}, {7632.85107f, 3373.96997f}, true, true, false},
+};
+
+static void CheckTileChecks(CCollision *pCollision, const CTileCheck *pChecks, int NumChecks)
+{
+	for(int i = 0; i < NumChecks; i++)
+	{
+		const CTileCheck *pCheck = &pChecks[i];
+		int x = round_to_int(pCheck->m_Pos.x), y = round_to_int(pCheck->m_Pos.y);
+		int dx, dy;
+		ThroughOffset(pCheck->m_Pos, pCheck->m_Pos1, &dx, &dy);
+		SCOPED_TRACE(testing::Message() << "point " << i << " at " << x << "," << y);
+
+		EXPECT_EQ((bool)pCollision->IsSolid(x, y), pCheck->m_Solid);
+		EXPECT_EQ(pCollision->IsThrough(x, y, dx, dy, pCheck->m_Pos, pCheck->m_Pos1), pCheck->m_Through);
+		EXPECT_EQ(pCollision->IsHookBlocker(x, y, pCheck->m_Pos, pCheck->m_Pos1), pCheck->m_HookBlocker);
+	}
+}
+
+// the flags that stand for a single tile of a layer
+static void CompareTileFlags(CCollision *pCollision, int NumPoints)
+{
+	for(int i = 0; i < NumPoints; i++)
+	{
+		vec2 Pos = RandomPos(pCollision);
+		int x = round_to_int(Pos.x), y = round_to_int(Pos.y);
+		int Index = pCollision->GetPureMapIndex(Pos);
+		CTeleTile *pTele = pCollision->TeleLayer();
+		int TeleType = pTele ? pTele[Index].m_Type : 0;
+		int TeleNumber = pTele ? pTele[Index].m_Number : 0;
+		SCOPED_TRACE(testing::Message() << "point " << i << " at " << x << "," << y);
+
+		ASSERT_EQ((bool)pCollision->IsNoLaser(x, y), pCollision->GetTile(x, y) == TILE_NOLASER);
+		ASSERT_EQ((bool)pCollision->IsFNoLaser(x, y), pCollision->GetFTile(x, y) == TILE_NOLASER);
+		ASSERT_EQ(pCollision->IsTeleport(Index), TeleType == TILE_TELEIN ? TeleNumber : 0);
+		ASSERT_EQ(pCollision->IsEvilTeleport(Index), TeleType == TILE_TELEINEVIL ? TeleNumber : 0);
+		ASSERT_EQ(pCollision->IsTeleportWeapon(Index), TeleType == TILE_TELEINWEAPON ? TeleNumber : 0);
+		ASSERT_EQ(pCollision->IsTeleportHook(Index), TeleType == TILE_TELEINHOOK ? TeleNumber : 0);
+	}
+}
+
+class CCollisionWithMap
+{
+	IKernel *m_pKernel;
+	IEngineMap *m_pMap;
+	CLayers m_Layers;
+
+public:
+	CCollision m_Collision;
+
+	CCollisionWithMap() : m_pKernel(IKernel::Create()), m_pMap(0)
+	{
+		m_pKernel->RegisterInterface(CreateLocalStorage());
+	}
+	~CCollisionWithMap()
+	{
+		delete m_pKernel;
+	}
+
+	// the maps are copied into the build directory
+	bool Load(const char *pMap)
+	{
+		m_pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(m_pMap);
+		m_pKernel->RegisterInterface(static_cast<IMap *>(m_pMap), false);
+		if(!m_pMap->Load(pMap))
+			return false;
+		m_Layers.Init(m_pKernel);
+		m_Collision.Init(&m_Layers);
+		return true;
+	}
+};
+
+TEST(Collision, RaysRandomMap)
+{
+	s_Seed = 1;
+	CRandomMap Map(60, 40);
+	IKernel *pKernel = IKernel::Create();
+	pKernel->RegisterInterface(static_cast<IMap *>(&Map), false);
+	CLayers Layers;
+	Layers.Init(pKernel);
+	CCollision Collision;
+	Collision.Init(&Layers);
+
+	CheckRays(&Collision, s_aRandomMapRays, sizeof(s_aRandomMapRays) / sizeof(s_aRandomMapRays[0]));
+	delete pKernel;
+}
+
+TEST(Collision, RaysRealMap)
+{
+	CCollisionWithMap Map;
+	ASSERT_TRUE(Map.Load("data/maps/Kobra 4.map"));
+	CheckRays(&Map.m_Collision, s_aKobraRays, sizeof(s_aKobraRays) / sizeof(s_aKobraRays[0]));
+}
+
+TEST(Collision, TileFlagsRandomMap)
+{
+	s_Seed = 1;
+	CRandomMap Map(60, 40);
+	IKernel *pKernel = IKernel::Create();
+	pKernel->RegisterInterface(static_cast<IMap *>(&Map), false);
+	CLayers Layers;
+	Layers.Init(pKernel);
+	CCollision Collision;
+	Collision.Init(&Layers);
+
+	CheckTileChecks(&Collision, s_aRandomMapTileChecks, sizeof(s_aRandomMapTileChecks) / sizeof(s_aRandomMapTileChecks[0]));
+	CompareTileFlags(&Collision, 50000);
+
+	// changes of the map reach the flags
+	vec2 Pos = Collision.GetPos(10 * Collision.GetWidth() + 10);
+	Collision.SetCollisionAt(Pos.x, Pos.y, TILE_SOLID);
+	EXPECT_TRUE(Collision.CheckPoint(Pos));
+	Collision.SetCollisionAt(Pos.x, Pos.y, TILE_NOLASER);
+	EXPECT_FALSE(Collision.CheckPoint(Pos));
+	EXPECT_TRUE(Collision.IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)));
+	delete pKernel;
+}
+
+TEST(Collision, TileFlagsRealMaps)
+{
+	static const char *s_apMaps[] = {"data/maps/Kobra 4.map", "data/maps/Goo!.map", "data/maps/ctf5.map"};
+	for(unsigned i = 0; i < sizeof(s_apMaps) / sizeof(s_apMaps[0]); i++)
+	{
+		SCOPED_TRACE(s_apMaps[i]);
+		s_Seed = 1 + i;
+		CCollisionWithMap Map;
+		ASSERT_TRUE(Map.Load(s_apMaps[i]));
+		CompareTileFlags(&Map.m_Collision, 20000);
+	}
+
+	CCollisionWithMap Map;
+	ASSERT_TRUE(Map.Load("data/maps/Kobra 4.map"));
+	CheckTileChecks(&Map.m_Collision, s_aKobraTileChecks, sizeof(s_aKobraTileChecks) / sizeof(s_aKobraTileChecks[0]));
+}
+
+TEST(Collision, MapIndicesRandomMap)
+{
+	s_Seed = 1;
+	CRandomMap Map(60, 40);
+	IKernel *pKernel = IKernel::Create();
+	pKernel->RegisterInterface(static_cast<IMap *>(&Map), false);
+	CLayers Layers;
+	Layers.Init(pKernel);
+	CCollision Collision;
+	Collision.Init(&Layers);
+
+	CheckMapIndices(&Collision, s_aRandomMapLines, sizeof(s_aRandomMapLines) / sizeof(s_aRandomMapLines[0]));
+
+	// the special tiles follow changes of the map
+	int Index = 10 * Collision.GetWidth() + 10;
+	vec2 Pos = Collision.GetPos(Index);
+	Collision.SetCollisionAt(Pos.x, Pos.y, TILE_FREEZE);
+	EXPECT_TRUE(Collision.TileExists(Index));
+	Collision.SetCollisionAt(Pos.x, Pos.y, TILE_AIR);
+	Collision.SetCollisionAt(Pos.x + 32, Pos.y, TILE_AIR);
+	Collision.SetCollisionAt(Pos.x - 32, Pos.y, TILE_STOPA);
+	EXPECT_TRUE(Collision.TileExists(Index));
+	Collision.SetCollisionAt(Pos.x - 32, Pos.y, TILE_AIR);
+	EXPECT_EQ(Collision.TileExists(Index), Collision.TileExistsNext(Index));
+	delete pKernel;
+}
+
+TEST(Collision, MapIndicesRealMap)
+{
+	CCollisionWithMap Map;
+	ASSERT_TRUE(Map.Load("data/maps/Kobra 4.map"));
+	CheckMapIndices(&Map.m_Collision, s_aKobraLines, sizeof(s_aKobraLines) / sizeof(s_aKobraLines[0]));
+}
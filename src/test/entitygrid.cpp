@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <game/entitygrid.h>
+
+#include <vector>
+
+class CTestEntity
+{
+public:
+	vec2 m_Pos;
+	float m_ProximityRadius;
+	CEntityGrid<CTestEntity>::CNode m_GridNode;
+};
+
+static unsigned s_Seed = 1;
+static float Random(float Max)
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) % 100000 / 100000.0f * Max;
+}
+
+static void FindLinear(const std::vector<CTestEntity *> &vpList, vec2 Pos, float Radius, std::vector<CTestEntity *> *pvResult)
+{
+	pvResult->clear();
+	for(CTestEntity *pEnt : vpList)
+		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
+			pvResult->push_back(pEnt);
+}
+
+static void FindGrid(const CEntityGrid<CTestEntity> *pGrid, vec2 Pos, float Radius, std::vector<CTestEntity *> *pvResult)
+{
+	CTestEntity *apCandidates[512];
+	int NumCandidates = pGrid->Query(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), apCandidates, 512);
+	pvResult->clear();
+	for(int i = 0; i < NumCandidates; i++)
+		if(distance(apCandidates[i]->m_Pos, Pos) < Radius + apCandidates[i]->m_ProximityRadius)
+			pvResult->push_back(apCandidates[i]);
+}
+
+TEST(EntityGrid, SameAsLinear)
+{
+	const int NUM = 300;
+	CTestEntity aEntities[NUM];
+	CEntityGrid<CTestEntity> Grid;
+	std::vector<CTestEntity *> vpList;
+	for(int i = 0; i < NUM; i++)
+	{
+		aEntities[i].m_GridNode.m_Bucket = -1;
+		aEntities[i].m_Pos = vec2(Random(8000.0f) - 1000.0f, Random(8000.0f) - 1000.0f);
+		aEntities[i].m_ProximityRadius = i % 10 ? 28.0f : 64.0f;
+		// every other entity goes to the front of the list
+		if(i % 2)
+		{
+			Grid.Insert(&aEntities[i], true);
+			vpList.push_back(&aEntities[i]);
+		}
+		else
+		{
+			Grid.Insert(&aEntities[i], false);
+			vpList.insert(vpList.begin(), &aEntities[i]);
+		}
+	}
+	EXPECT_EQ(Grid.Num(), NUM);
+
+	std::vector<CTestEntity *> vpExpected, vpResult;
+	for(int Round = 0; Round < 20; Round++)
+	{
+		// move some entities, some of them far
+		for(int i = 0; i < NUM; i++)
+		{
+			if(i % 3 == Round % 3)
+				aEntities[i].m_Pos += vec2(Random(600.0f) - 300.0f, Random(600.0f) - 300.0f);
+			Grid.Update(&aEntities[i]);
+		}
+
+		for(int q = 0; q < 200; q++)
+		{
+			vec2 Pos = vec2(Random(8000.0f) - 1000.0f, Random(8000.0f) - 1000.0f);
+			// the biggest ones cover more cells than there are buckets
+			float Radius = q % 4 ? Random(300.0f) : Random(6000.0f);
+			FindLinear(vpList, Pos, Radius, &vpExpected);
+			FindGrid(&Grid, Pos, Radius, &vpResult);
+			ASSERT_EQ(vpExpected, vpResult);
+		}
+	}
+
+	for(int i = 0; i < NUM; i += 2)
+		Grid.Remove(&aEntities[i]);
+	EXPECT_EQ(Grid.Num(), NUM / 2);
+	Grid.Remove(&aEntities[0]);
+	EXPECT_EQ(Grid.Num(), NUM / 2);
+}
+
+TEST(EntityGrid, InvalidPositions)
+{
+	CTestEntity aEntities[8];
+	CEntityGrid<CTestEntity> Grid;
+	for(int i = 0; i < 8; i++)
+		aEntities[i].m_Pos = vec2(-10000.0f, i * 1000.0f);
+	aEntities[0].m_Pos = vec2(1e30f, -1e30f);
+	aEntities[1].m_Pos = vec2(0.0f / 0.0f, 5.0f);
+	aEntities[2].m_Pos = vec2(5.0f, 5.0f);
+	for(int i = 0; i < 8; i++)
+	{
+		aEntities[i].m_ProximityRadius = 28.0f;
+		Grid.Insert(&aEntities[i], true);
+	}
+
+	CTestEntity *apResult[8];
+	ASSERT_EQ(Grid.Query(vec2(0.0f, 0.0f), vec2(10.0f, 10.0f), apResult, 8), 1);
+	EXPECT_EQ(apResult[0], &aEntities[2]);
+}
+
+TEST(EntityGrid, Nested)
+{
+	CTestEntity aEntities[4];
+	CEntityGrid<CTestEntity> Grid;
+	for(int i = 0; i < 4; i++)
+	{
+		aEntities[i].m_Pos = vec2(i * 1000.0f, 0.0f);
+		aEntities[i].m_ProximityRadius = 28.0f;
+		Grid.Insert(&aEntities[i], true);
+	}
+
+	// a query while iterating over the results of another one
+	CTestEntity *apOuter[4];
+	ASSERT_EQ(Grid.Query(vec2(-10.0f, -10.0f), vec2(1010.0f, 10.0f), apOuter, 4), 2);
+	CTestEntity *apInner[4];
+	ASSERT_EQ(Grid.Query(vec2(2990.0f, -10.0f), vec2(3010.0f, 10.0f), apInner, 4), 1);
+	EXPECT_EQ(apInner[0], &aEntities[3]);
+	EXPECT_EQ(apOuter[0], &aEntities[0]);
+	EXPECT_EQ(apOuter[1], &aEntities[1]);
+
+	// only as many results as fit
+	EXPECT_EQ(Grid.Query(vec2(-10.0f, -10.0f), vec2(1010.0f, 10.0f), apOuter, 1), 1);
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/jobs.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+#include <game/teamscore.h>
+
+#include <memory>
+
+static unsigned s_Seed = 1;
+static int Random(int Max)
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) % Max;
+}
+
+class CMoveJob : public IJob
+{
+	virtual void Run()
+	{
+		for(int i = 0; i < m_NumCores; i++)
+			m_apCores[i]->Move();
+		sphore_signal(m_pDone);
+	}
+
+public:
+	CCharacterCore *m_apCores[MAX_CLIENTS];
+	int m_NumCores;
+	SEMAPHORE *m_pDone;
+};
+
+class CCoreWorld
+{
+public:
+	CWorldCore m_World;
+	CCharacterCore m_aCores[MAX_CLIENTS];
+	std::map<int, std::vector<vec2> > m_TeleOuts;
+
+	void Init(CCollision *pCollision, CTeamsCore *pTeams, const vec2 *pPositions)
+	{
+		// the cores don't initialize everything
+		mem_zero(m_aCores, sizeof(m_aCores));
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aCores[i].Init(&m_World, pCollision, pTeams, &m_TeleOuts);
+			m_aCores[i].Reset();
+			m_aCores[i].m_Id = i;
+			m_aCores[i].m_Pos = pPositions[i];
+			m_World.m_apCharacters[i] = &m_aCores[i];
+		}
+	}
+
+	void Tick(const CNetObj_PlayerInput *pInputs, int Tick)
+	{
+		srand(Tick);
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aCores[i].m_Input = pInputs[i];
+			m_aCores[i].Tick(true);
+		}
+	}
+};
+
+TEST(GameCore, TeamsMoveIndependently)
+{
+	IKernel *pKernel = IKernel::Create();
+	pKernel->RegisterInterface(CreateLocalStorage());
+	IEngineMap *pMap = CreateEngineMap();
+	pKernel->RegisterInterface(pMap);
+	pKernel->RegisterInterface(static_cast<IMap *>(pMap), false);
+	// the maps are copied into the build directory
+	ASSERT_TRUE(pMap->Load("data/maps/Kobra 4.map"));
+	CLayers Layers;
+	Layers.Init(pKernel);
+	CCollision Collision;
+	Collision.Init(&Layers);
+
+	// crowd the characters of several teams into a small free area
+	vec2 Center;
+	do
+		Center = vec2(Random(Collision.GetWidth() * 32), Random(Collision.GetHeight() * 32));
+	while(Collision.TestBox(Center, vec2(400.0f, 200.0f)));
+	vec2 aPositions[MAX_CLIENTS];
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		aPositions[i] = Center + vec2(Random(340) - 170, Random(140) - 70);
+
+	CTeamsCore Teams;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		Teams.Team(i, i % 6);
+		Teams.SetSolo(i, i % 11 == 0);
+	}
+
+	CCoreWorld Serial, Parallel;
+	Serial.Init(&Collision, &Teams, aPositions);
+	Parallel.Init(&Collision, &Teams, aPositions);
+
+	// one job per team, the solo characters get their own jobs
+	CJobPool Pool;
+	Pool.Init(4);
+	SEMAPHORE Done;
+	sphore_init(&Done);
+	std::shared_ptr<CMoveJob> apJobs[MAX_CLIENTS];
+	int aTeamJobs[MAX_CLIENTS];
+	int NumJobs = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		aTeamJobs[i] = -1;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		int Job = Teams.GetSolo(i) ? -1 : aTeamJobs[Teams.Team(i)];
+		if(Job < 0)
+		{
+			Job = NumJobs++;
+			apJobs[Job] = std::make_shared<CMoveJob>();
+			apJobs[Job]->m_NumCores = 0;
+			apJobs[Job]->m_pDone = &Done;
+			if(!Teams.GetSolo(i))
+				aTeamJobs[Teams.Team(i)] = Job;
+		}
+		apJobs[Job]->m_apCores[apJobs[Job]->m_NumCores++] = &Parallel.m_aCores[i];
+	}
+
+	CNetObj_PlayerInput aInputs[MAX_CLIENTS];
+	mem_zero(aInputs, sizeof(aInputs));
+	for(int Tick = 0; Tick < 1000; Tick++)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			aInputs[i].m_Direction = Random(3) - 1;
+			aInputs[i].m_TargetX = Random(512) - 256;
+			aInputs[i].m_TargetY = Random(512) - 256;
+			if(!Random(8))
+				aInputs[i].m_Jump ^= 1;
+			if(!Random(12))
+				aInputs[i].m_Hook ^= 1;
+		}
+
+		Serial.Tick(aInputs, Tick);
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			Serial.m_aCores[i].Move();
+
+		Parallel.Tick(aInputs, Tick);
+		for(int i = 0; i < NumJobs; i++)
+			Pool.Add(apJobs[i]);
+		for(int i = 0; i < NumJobs; i++)
+			sphore_wait(&Done);
+
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			Serial.m_aCores[i].Quantize();
+			Parallel.m_aCores[i].Quantize();
+			CNetObj_CharacterCore SerialCore, ParallelCore;
+			mem_zero(&SerialCore, sizeof(SerialCore));
+			mem_zero(&ParallelCore, sizeof(ParallelCore));
+			Serial.m_aCores[i].Write(&SerialCore);
+			Parallel.m_aCores[i].Write(&ParallelCore);
+			ASSERT_EQ(mem_comp(&SerialCore, &ParallelCore, sizeof(SerialCore)), 0) << "tick " << Tick << " character " << i;
+		}
+	}
+
+	sphore_destroy(&Done);
+	delete pKernel;
+}
@@ -105,3 +105,34 @@ TEST_F(Jobs, Many)
 	}
 	new(&m_Pool) CJobPool();
 }
+
+TEST_F(Jobs, Reuse)
+{
+	static const int NUM_JOBS = 16;
+	static const int NUM_ROUNDS = 4;
+	std::atomic<int> Runs(0);
+	std::vector<std::shared_ptr<IJob>> apJobs;
+	SEMAPHORE sphore;
+	sphore_init(&sphore);
+	for(int i = 0; i < NUM_JOBS; i++)
+	{
+		apJobs.push_back(std::make_shared<CJob>([&]
+		{
+			Runs.fetch_add(1);
+			sphore_signal(&sphore);
+		}));
+	}
+	for(int r = 0; r < NUM_ROUNDS; r++)
+	{
+		for(auto &pJob: apJobs)
+		{
+			Add(pJob);
+		}
+		for(int i = 0; i < NUM_JOBS; i++)
+		{
+			sphore_wait(&sphore);
+		}
+		EXPECT_EQ(Runs.load(), (r + 1) * NUM_JOBS);
+	}
+	sphore_destroy(&sphore);
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/score/leaderboard.h>
+
+#include <vector>
+
+static CLeaderboard::CEntry Entry(const char *pName, float Score)
+{
+	CLeaderboard::CEntry Result;
+	str_copy(Result.m_aName, pName, sizeof(Result.m_aName));
+	Result.m_Score = Score;
+	return Result;
+}
+
+TEST(Leaderboard, Times)
+{
+	CLeaderboard Board(false);
+	int Rank;
+	float Score;
+	EXPECT_FALSE(Board.Find("nameless tee", &Rank, &Score));
+
+	EXPECT_TRUE(Board.Improve("nameless tee", 30.0f));
+	EXPECT_TRUE(Board.Improve("brainless tee", 20.0f));
+	EXPECT_TRUE(Board.Improve("headless tee", 30.0f));
+	EXPECT_FALSE(Board.Improve("brainless tee", 25.0f));
+	EXPECT_EQ(Board.Size(), 3);
+
+	ASSERT_TRUE(Board.Find("brainless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 1);
+	EXPECT_EQ(Score, 20.0f);
+	ASSERT_TRUE(Board.Find("nameless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 2);
+	ASSERT_TRUE(Board.Find("headless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 2);
+
+	EXPECT_TRUE(Board.Improve("nameless tee", 10.0f));
+	ASSERT_TRUE(Board.Find("nameless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 1);
+	ASSERT_TRUE(Board.Find("headless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 3);
+
+	CLeaderboard::CEntry aEntries[5];
+	int aRanks[5];
+	ASSERT_EQ(Board.Get(0, 5, false, aEntries, aRanks), 3);
+	EXPECT_STREQ(aEntries[0].m_aName, "nameless tee");
+	EXPECT_STREQ(aEntries[1].m_aName, "brainless tee");
+	EXPECT_STREQ(aEntries[2].m_aName, "headless tee");
+	EXPECT_EQ(aRanks[2], 3);
+
+	ASSERT_EQ(Board.Get(1, 5, true, aEntries, aRanks), 2);
+	EXPECT_STREQ(aEntries[0].m_aName, "brainless tee");
+	EXPECT_EQ(aRanks[0], 2);
+	EXPECT_STREQ(aEntries[1].m_aName, "nameless tee");
+	EXPECT_EQ(Board.Get(3, 5, false, aEntries, aRanks), 0);
+}
+
+TEST(Leaderboard, Points)
+{
+	CLeaderboard Board(true);
+	std::vector<CLeaderboard::CEntry> aEntries;
+	aEntries.push_back(Entry("nameless tee", 100));
+	aEntries.push_back(Entry("brainless tee", 250));
+	aEntries.push_back(Entry("headless tee", 5));
+	Board.Load(aEntries);
+
+	int Rank;
+	float Score;
+	ASSERT_TRUE(Board.Find("brainless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 1);
+	EXPECT_EQ(Score, 250);
+
+	Board.Set("headless tee", 250);
+	ASSERT_TRUE(Board.Find("headless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 1);
+	ASSERT_TRUE(Board.Find("nameless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 3);
+
+	// merging keeps the better score
+	std::vector<CLeaderboard::CEntry> aMore;
+	aMore.push_back(Entry("nameless tee", 300));
+	aMore.push_back(Entry("headless tee", 5));
+	aMore.push_back(Entry("mindless tee", 1));
+	Board.Merge(aMore);
+	EXPECT_EQ(Board.Size(), 4);
+	ASSERT_TRUE(Board.Find("nameless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 1);
+	ASSERT_TRUE(Board.Find("headless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 2);
+	EXPECT_EQ(Score, 250);
+
+	// loading replaces everything
+	Board.Load(aMore);
+	EXPECT_EQ(Board.Size(), 3);
+	ASSERT_TRUE(Board.Find("headless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 2);
+	EXPECT_FALSE(Board.Find("brainless tee", &Rank, &Score));
+
+	// swapping exchanges the entries and their order
+	CLeaderboard Other(true);
+	Other.Load(aEntries);
+	Board.Swap(Other);
+	EXPECT_EQ(Board.Size(), 3);
+	ASSERT_TRUE(Board.Find("brainless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 1);
+	EXPECT_FALSE(Board.Find("mindless tee", &Rank, &Score));
+	ASSERT_TRUE(Other.Find("mindless tee", &Rank, &Score));
+	EXPECT_EQ(Rank, 3);
+
+	Board.Clear();
+	EXPECT_EQ(Board.Size(), 0);
+}
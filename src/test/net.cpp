@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+class NetSendQueue : public ::testing::Test
+{
+protected:
+	NETSOCKET m_Sender;
+	NETSOCKET m_Receiver;
+	NETADDR m_ReceiverAddr;
+	MMSGS m_Mmsgs;
+	NETSENDQUEUE m_Queue;
+
+	void SetUp()
+	{
+		NETADDR BindAddr;
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = NETTYPE_IPV4;
+		m_Sender = net_udp_create(BindAddr);
+		ASSERT_TRUE(m_Sender.type);
+
+		net_addr_from_str(&m_ReceiverAddr, "127.0.0.1");
+		m_Receiver.type = NETTYPE_INVALID;
+		for(int Port = 28400; Port < 28500 && !m_Receiver.type; Port++)
+		{
+			m_ReceiverAddr.port = Port;
+			m_Receiver = net_udp_create(m_ReceiverAddr);
+		}
+		ASSERT_TRUE(m_Receiver.type);
+
+		net_init_mmsgs(&m_Mmsgs);
+		net_udp_send_queue_init(&m_Queue);
+	}
+
+	void TearDown()
+	{
+		net_udp_close(m_Sender);
+		net_udp_close(m_Receiver);
+	}
+
+	void ExpectReceived(int First, int NumPackets)
+	{
+		char aBuffer[PACKETSIZE];
+		for(int i = First; i < First + NumPackets; i++)
+		{
+			NETADDR Addr;
+			unsigned char *pData;
+			int Bytes = 0;
+			for(int Try = 0; Try < 100 && Bytes <= 0; Try++)
+			{
+				Bytes = net_udp_recv(m_Receiver, &Addr, aBuffer, sizeof(aBuffer), &m_Mmsgs, &pData);
+				if(Bytes <= 0)
+					net_socket_read_wait(m_Receiver, 10000);
+			}
+			ASSERT_EQ(Bytes, 1 + i % 100);
+			for(int j = 0; j < Bytes; j++)
+				ASSERT_EQ(pData[j], (unsigned char)(i + j));
+		}
+	}
+
+	static void FillPacket(unsigned char *pData, int i)
+	{
+		for(int j = 0; j < 1 + i % 100; j++)
+			pData[j] = i + j;
+	}
+};
+
+TEST_F(NetSendQueue, Flush)
+{
+	unsigned char aData[100];
+	NETSTATS Before, After;
+	net_stats(&Before);
+	for(int i = 0; i < 50; i++)
+	{
+		FillPacket(aData, i);
+		EXPECT_EQ(net_udp_send_queued(m_Sender, &m_Queue, &m_ReceiverAddr, aData, 1 + i % 100), 1 + i % 100);
+	}
+	EXPECT_EQ(m_Queue.size, 50);
+	EXPECT_EQ(net_udp_send_flush(&m_Queue), 50);
+	EXPECT_EQ(m_Queue.size, 0);
+	net_stats(&After);
+
+	EXPECT_EQ(After.sent_packets - Before.sent_packets, 50);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_EQ(After.sent_syscalls - Before.sent_syscalls, 1);
+#else
+	EXPECT_EQ(After.sent_syscalls - Before.sent_syscalls, 50);
+#endif
+	ExpectReceived(0, 50);
+}
+
+TEST_F(NetSendQueue, Overflow)
+{
+	unsigned char aData[100];
+	const int NumPackets = VLEN * 2 + 10;
+	NETSTATS Before, After;
+	net_stats(&Before);
+	for(int i = 0; i < NumPackets; i++)
+	{
+		FillPacket(aData, i);
+		net_udp_send_queued(m_Sender, &m_Queue, &m_ReceiverAddr, aData, 1 + i % 100);
+		// a full queue is sent before the next packet is added, receive
+		// them right away so the socket buffer doesn't overflow
+		if(i > 0 && i % VLEN == 0)
+		{
+			EXPECT_EQ(m_Queue.size, 1);
+			ExpectReceived(i - VLEN, VLEN);
+		}
+	}
+	net_udp_send_flush(&m_Queue);
+	net_stats(&After);
+
+	EXPECT_EQ(After.sent_packets - Before.sent_packets, NumPackets);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_EQ(After.sent_syscalls - Before.sent_syscalls, 3);
+#endif
+	ExpectReceived(VLEN * 2, NumPackets - VLEN * 2);
+}
+
+TEST_F(NetSendQueue, Unqueued)
+{
+	unsigned char aData[100];
+	NETSTATS Before, After;
+	net_stats(&Before);
+	for(int i = 0; i < 20; i++)
+	{
+		FillPacket(aData, i);
+		net_udp_send(m_Sender, &m_ReceiverAddr, aData, 1 + i % 100);
+	}
+	net_stats(&After);
+	EXPECT_EQ(After.sent_syscalls - Before.sent_syscalls, 20);
+	ExpectReceived(0, 20);
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <game/server/playermaps.h>
+#include <game/teamscore.h>
+
+#include <algorithm>
+#include <utility>
+
+static unsigned s_Seed = 1;
+static float Random(float Max)
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) % 100000 / 100000.0f * Max;
+}
+
+static bool DistCompare(const std::pair<float, int> &a, const std::pair<float, int> &b)
+{
+	return a.first < b.first;
+}
+
+static float Key(const CPlayerMaps::CClient *pClients, CTeamsCore *pTeams, int Viewer, int Target)
+{
+	if(pClients[Target].m_Target == CPlayerMaps::TARGET_ABSENT)
+		return 1e10;
+	if(pClients[Target].m_Target == CPlayerMaps::TARGET_NO_CHARACTER)
+		return 1e9;
+	float Dist = 0;
+	if(pClients[Viewer].m_HideOthers && !pTeams->CanCollide(Target, Viewer))
+		Dist = 1e8;
+	return Dist + distance(pClients[Viewer].m_ViewPos, pClients[Target].m_Pos);
+}
+
+class CTestServer
+{
+public:
+	CPlayerMaps::CClient m_aClients[MAX_CLIENTS];
+	int m_aaMaps[MAX_CLIENTS][VANILLA_MAX_CLIENTS];
+	CTeamsCore m_Teams;
+
+	CTestServer(float Size)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			CPlayerMaps::CClient *pClient = &m_aClients[i];
+			pClient->m_Target = i % 13 == 5 ? CPlayerMaps::TARGET_NO_CHARACTER : CPlayerMaps::TARGET_CHARACTER;
+			pClient->m_Pos = vec2(Random(Size), Random(Size));
+			pClient->m_ViewPos = pClient->m_Pos;
+			pClient->m_HideOthers = i % 3 == 0;
+			pClient->m_pMap = m_aaMaps[i];
+			ResetMap(i);
+			m_Teams.Team(i, i % 4);
+		}
+	}
+
+	// like a joining player
+	void ResetMap(int ClientID)
+	{
+		for(int j = 1; j < VANILLA_MAX_CLIENTS; j++)
+			m_aaMaps[ClientID][j] = -1;
+		m_aaMaps[ClientID][0] = ClientID;
+	}
+
+	void Move(float Speed)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aClients[i].m_Pos += vec2(Random(2 * Speed) - Speed, Random(2 * Speed) - Speed);
+			m_aClients[i].m_ViewPos = m_aClients[i].m_Pos;
+		}
+	}
+
+	bool Mapped(int Viewer, int Target) const
+	{
+		for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+			if(m_aaMaps[Viewer][j] == Target)
+				return true;
+		return false;
+	}
+
+	// every present player has an id, or the ids go to the closest ones.
+	// players closer than Slack to the last one with an id might be swapped
+	void ExpectClosest(float Slack = 0.0f)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			SCOPED_TRACE(i);
+			std::pair<float, int> Dist[MAX_CLIENTS];
+			for(int j = 0; j < MAX_CLIENTS; j++)
+			{
+				Dist[j].first = j == i ? 0 : Key(m_aClients, &m_Teams, i, j);
+				Dist[j].second = j;
+			}
+			std::sort(&Dist[0], &Dist[MAX_CLIENTS], DistCompare);
+			float Last = Dist[VANILLA_MAX_CLIENTS - 2].first;
+			for(int j = 0; j < MAX_CLIENTS; j++)
+			{
+				bool Expected = j < VANILLA_MAX_CLIENTS - 1 && Dist[j].first < 5e9;
+				// players without characters are equally far away
+				if(Dist[j].first == 1e9f || absolute(Dist[j].first - Last) < Slack)
+					continue;
+				ASSERT_EQ(Mapped(i, Dist[j].second), Expected) << "target " << Dist[j].second;
+			}
+			EXPECT_EQ(m_aaMaps[i][VANILLA_MAX_CLIENTS - 1], -1);
+		}
+	}
+};
+
+TEST(PlayerMaps, Closest)
+{
+	s_Seed = 1;
+	CTestServer Server(3000.0f);
+	CPlayerMaps Maps;
+	for(int i = 0; i < 3; i++)
+		Maps.Update(Server.m_aClients, &Server.m_Teams);
+	Server.ExpectClosest();
+
+	// nothing moved, nothing to do
+	EXPECT_EQ(Maps.Update(Server.m_aClients, &Server.m_Teams), 0);
+
+	// the ids follow the players
+	for(int Round = 0; Round < 200; Round++)
+	{
+		Server.Move(30.0f);
+		Maps.Update(Server.m_aClients, &Server.m_Teams);
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			ASSERT_TRUE(Server.Mapped(i, i));
+	}
+	// the ranking only goes by the last noticeable moves
+	for(int i = 0; i < 3; i++)
+		Maps.Update(Server.m_aClients, &Server.m_Teams);
+	Server.ExpectClosest(4 * CPlayerMaps::MOVE_DISTANCE);
+}
+
+TEST(PlayerMaps, Stable)
+{
+	s_Seed = 2;
+	CTestServer Server(3000.0f);
+	CPlayerMaps Maps;
+	for(int i = 0; i < 3; i++)
+		Maps.Update(Server.m_aClients, &Server.m_Teams);
+
+	// small moves don't reassign any id
+	int aaBefore[MAX_CLIENTS][VANILLA_MAX_CLIENTS];
+	mem_copy(aaBefore, Server.m_aaMaps, sizeof(aaBefore));
+	for(int Round = 0; Round < 20; Round++)
+	{
+		Server.Move(1.0f);
+		Maps.Update(Server.m_aClients, &Server.m_Teams);
+	}
+	EXPECT_EQ(mem_comp(aaBefore, Server.m_aaMaps, sizeof(aaBefore)), 0);
+}
+
+TEST(PlayerMaps, JoinAndLeave)
+{
+	s_Seed = 3;
+	// few enough players for everyone to get an id
+	CTestServer Server(3000.0f);
+	for(int i = 12; i < MAX_CLIENTS; i++)
+		Server.m_aClients[i].m_Target = CPlayerMaps::TARGET_ABSENT;
+	CPlayerMaps Maps;
+	Maps.Update(Server.m_aClients, &Server.m_Teams);
+	Server.ExpectClosest();
+
+	// leaving players lose their ids right away
+	Server.m_aClients[3].m_Target = CPlayerMaps::TARGET_ABSENT;
+	Maps.Update(Server.m_aClients, &Server.m_Teams);
+	for(int i = 0; i < 12; i++)
+	{
+		if(i != 3)
+		{
+			EXPECT_FALSE(Server.Mapped(i, 3));
+		}
+	}
+
+	// joining players get ids and their own map is filled
+	Server.m_aClients[3].m_Target = CPlayerMaps::TARGET_NO_CHARACTER;
+	Server.ResetMap(3);
+	Maps.Update(Server.m_aClients, &Server.m_Teams);
+	for(int i = 0; i < 12; i++)
+		EXPECT_TRUE(Server.Mapped(i, 3));
+	for(int i = 0; i < 12; i++)
+		EXPECT_TRUE(Server.Mapped(3, i));
+
+	// team changes can hide the characters
+	Server.m_Teams.Team(4, 3);
+	Server.m_Teams.Team(5, 3);
+	for(int i = 0; i < 3; i++)
+		Maps.Update(Server.m_aClients, &Server.m_Teams);
+	Server.ExpectClosest();
+}
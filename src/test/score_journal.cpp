@@ -0,0 +1,109 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/score/journal.h>
+
+#include <string>
+#include <vector>
+
+static void RaceFinish(CScoreJournal::CRaceFinish *pFinish, const char *pName, float Time)
+{
+	mem_zero(pFinish, sizeof(*pFinish));
+	pFinish->m_ClientID = 3;
+	str_copy(pFinish->m_aMap, "Kobra 4", sizeof(pFinish->m_aMap));
+	str_copy(pFinish->m_aName, pName, sizeof(pFinish->m_aName));
+	str_copy(pFinish->m_aTimestamp, "2020-05-17 12:34:56", sizeof(pFinish->m_aTimestamp));
+	pFinish->m_Time = Time;
+	for(int i = 0; i < NUM_CHECKPOINTS; i++)
+		pFinish->m_aCpTime[i] = i < 5 ? Time * (i + 1) / 6 : 0;
+	str_copy(pFinish->m_aGameUuid, "12345678-90ab-cdef-1234-567890abcdef", sizeof(pFinish->m_aGameUuid));
+}
+
+TEST(ScoreJournal, SealAndRead)
+{
+	CTestInfo Info;
+	char aPath[512];
+	std::vector<std::string> aSegments;
+	{
+		CScoreJournal Journal;
+		ASSERT_TRUE(Journal.Init(Info.m_aFilename, 8303, &aSegments));
+		EXPECT_TRUE(aSegments.empty());
+		EXPECT_FALSE(Journal.Seal());
+
+		CScoreJournal::CRaceFinish Race;
+		RaceFinish(&Race, "nameless tee", 65.42f);
+		Journal.Add(&Race);
+
+		CScoreJournal::CTeamFinish Team;
+		mem_zero(&Team, sizeof(Team));
+		str_copy(Team.m_aMap, "Kobra 4", sizeof(Team.m_aMap));
+		str_copy(Team.m_aTimestamp, "2020-05-17 12:35:00", sizeof(Team.m_aTimestamp));
+		Team.m_Time = 70.08f;
+		str_copy(Team.m_aGameUuid, Race.m_aGameUuid, sizeof(Team.m_aGameUuid));
+		Team.m_Size = 2;
+		str_copy(Team.m_aaNames[0], "nameless tee", sizeof(Team.m_aaNames[0]));
+		str_copy(Team.m_aaNames[1], "brainless tee", sizeof(Team.m_aaNames[1]));
+		Journal.Add(&Team);
+		EXPECT_EQ(Journal.NumFinishes(), 2);
+
+		ASSERT_TRUE(Journal.Seal());
+		EXPECT_EQ(Journal.NumFinishes(), 0);
+		Journal.Wait();
+		ASSERT_TRUE(Journal.PopSealed(aPath, sizeof(aPath)));
+		EXPECT_FALSE(Journal.PopSealed(aPath, sizeof(aPath)));
+
+		// the next segment isn't sealed before the "crash"
+		RaceFinish(&Race, "'; DROP TABLE", 12.5f);
+		Journal.Add(&Race);
+		Journal.Wait();
+		EXPECT_FALSE(Journal.PopSealed(aPath, sizeof(aPath)));
+	}
+
+	// another server using the folder doesn't take them
+	{
+		CScoreJournal Other;
+		ASSERT_TRUE(Other.Init(Info.m_aFilename, 8304, &aSegments));
+		EXPECT_TRUE(aSegments.empty());
+	}
+
+	// and its last line was cut off
+	CScoreJournal Journal;
+	ASSERT_TRUE(Journal.Init(Info.m_aFilename, 8303, &aSegments));
+	ASSERT_EQ(aSegments.size(), 2u);
+	EXPECT_STREQ(aSegments[0].c_str(), aPath);
+	IOHANDLE File = io_open(aSegments[1].c_str(), IOFLAG_APPEND);
+	ASSERT_TRUE(File);
+	const char aCut[] = "race\t4\tKobra 4\tcut";
+	io_write(File, aCut, sizeof(aCut) - 1);
+	io_close(File);
+
+	CScoreJournal::CSegment First;
+	ASSERT_TRUE(CScoreJournal::Read(aSegments[0].c_str(), &First));
+	ASSERT_EQ(First.m_aRaceFinishes.size(), 1u);
+	ASSERT_EQ(First.m_aTeamFinishes.size(), 1u);
+	const CScoreJournal::CRaceFinish *pRace = &First.m_aRaceFinishes[0];
+	EXPECT_EQ(pRace->m_ClientID, 3);
+	EXPECT_STREQ(pRace->m_aMap, "Kobra 4");
+	EXPECT_STREQ(pRace->m_aName, "nameless tee");
+	EXPECT_STREQ(pRace->m_aTimestamp, "2020-05-17 12:34:56");
+	EXPECT_FLOAT_EQ(pRace->m_Time, 65.42f);
+	EXPECT_NEAR(pRace->m_aCpTime[2], 65.42f / 2, 0.01f);
+	EXPECT_EQ(pRace->m_aCpTime[5], 0.0f);
+	EXPECT_STREQ(pRace->m_aGameUuid, "12345678-90ab-cdef-1234-567890abcdef");
+	const CScoreJournal::CTeamFinish *pTeam = &First.m_aTeamFinishes[0];
+	EXPECT_FLOAT_EQ(pTeam->m_Time, 70.08f);
+	ASSERT_EQ(pTeam->m_Size, 2);
+	EXPECT_STREQ(pTeam->m_aaNames[0], "nameless tee");
+	EXPECT_STREQ(pTeam->m_aaNames[1], "brainless tee");
+
+	CScoreJournal::CSegment Second;
+	ASSERT_TRUE(CScoreJournal::Read(aSegments[1].c_str(), &Second));
+	ASSERT_EQ(Second.m_aRaceFinishes.size(), 1u);
+	EXPECT_STREQ(Second.m_aRaceFinishes[0].m_aName, "'; DROP TABLE");
+	EXPECT_TRUE(Second.m_aTeamFinishes.empty());
+
+	for(unsigned i = 0; i < aSegments.size(); i++)
+		EXPECT_FALSE(fs_remove(aSegments[i].c_str()));
+	EXPECT_FALSE(fs_remove(Info.m_aFilename));
+}
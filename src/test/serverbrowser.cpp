@@ -0,0 +1,265 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/config.h>
+#include <engine/friends.h>
+#include <engine/masterserver.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+#include <engine/storage.h>
+#include <mastersrv/mastersrv.h>
+
+#include <engine/client/serverbrowser.h>
+
+class CNoFriends : public IFriends
+{
+public:
+	void Init(bool Foes) {}
+	int NumFriends() const { return 0; }
+	const CFriendInfo *GetFriend(int Index) const { return 0; }
+	int GetFriendState(const char *pName, const char *pClan) const { return FRIEND_NO; }
+	bool IsFriend(const char *pName, const char *pClan, bool PlayersOnly) const { return false; }
+	void AddFriend(const char *pName, const char *pClan) {}
+	void RemoveFriend(const char *pName, const char *pClan) {}
+};
+
+class CNoMasters : public IMasterServer
+{
+public:
+	void Init() {}
+	void SetDefault() {}
+	int Load() { return 0; }
+	int Save() { return 0; }
+	int RefreshAddresses(int Nettype) { return 0; }
+	void Update() {}
+	int IsRefreshing() { return 0; }
+	NETADDR GetAddr(int Index)
+	{
+		NETADDR Addr;
+		mem_zero(&Addr, sizeof(Addr));
+		return Addr;
+	}
+	void SetCount(int Index, int Count) {}
+	int GetCount(int Index) { return -1; }
+	const char *GetName(int Index) { return ""; }
+	bool IsValid(int Index) { return false; }
+};
+
+class ServerBrowser : public ::testing::Test
+{
+protected:
+	IKernel *m_pKernel;
+	CServerBrowser *m_pBrowser;
+	CNetClient m_NetClient;
+
+	ServerBrowser()
+	{
+		secure_random_init();
+		m_pKernel = IKernel::Create();
+		IConfig *pConfig = CreateConfig();
+		m_pKernel->RegisterInterface(pConfig);
+		pConfig->Reset();
+		g_Config.m_BrSort = IServerBrowser::SORT_NAME;
+		g_Config.m_BrSortOrder = 0;
+		g_Config.m_BrFilterString[0] = 0;
+
+		m_pKernel->RegisterInterface(static_cast<IFriends *>(new CNoFriends()));
+		m_pKernel->RegisterInterface(static_cast<IMasterServer *>(new CNoMasters()));
+		m_pBrowser = new CServerBrowser();
+		m_pKernel->RegisterInterface(static_cast<IServerBrowser *>(m_pBrowser));
+		m_pBrowser->SetBaseInfo(&m_NetClient, "0.6 626fce9a778df4d4");
+		m_pBrowser->Refresh(IServerBrowser::TYPE_FAVORITES);
+	}
+
+	~ServerBrowser()
+	{
+		delete m_pKernel;
+	}
+
+	static NETADDR Addr(int i)
+	{
+		NETADDR Addr;
+		mem_zero(&Addr, sizeof(Addr));
+		Addr.type = NETTYPE_IPV4;
+		Addr.ip[0] = 10;
+		Addr.ip[1] = i >> 16;
+		Addr.ip[2] = i >> 8;
+		Addr.ip[3] = i;
+		Addr.port = 8303;
+		return Addr;
+	}
+
+	void Set(int i, const char *pName, int Players)
+	{
+		CServerInfo Info;
+		mem_zero(&Info, sizeof(Info));
+		Info.m_Type = SERVERINFO_EXTENDED;
+		str_copy(Info.m_aName, pName, sizeof(Info.m_aName));
+		str_copy(Info.m_aGameType, "DDraceNetwork", sizeof(Info.m_aGameType));
+		str_copy(Info.m_aVersion, "0.6.4", sizeof(Info.m_aVersion));
+		Info.m_MaxClients = Info.m_MaxPlayers = MAX_CLIENTS;
+		Info.m_NumClients = Info.m_NumPlayers = Players;
+		for(int p = 0; p < Players; p++)
+			Info.m_aClients[p].m_Player = true;
+		Info.m_Latency = 50;
+
+		NETADDR Address = Addr(i);
+		m_pBrowser->Set(Address, IServerBrowser::SET_FAV_ADD, -1, 0);
+		m_pBrowser->Set(Address, IServerBrowser::SET_TOKEN, m_pBrowser->GenerateToken(Address), &Info);
+	}
+
+	void ExpectSorted()
+	{
+		for(int i = 0; i < m_pBrowser->NumSortedServers(); i++)
+		{
+			const CServerInfo *pInfo = m_pBrowser->SortedGet(i);
+			EXPECT_EQ(pInfo->m_SortedIndex, i);
+			if(i > 0)
+			{
+				EXPECT_LE(str_comp(m_pBrowser->SortedGet(i - 1)->m_aName, pInfo->m_aName), 0);
+			}
+		}
+	}
+};
+
+TEST_F(ServerBrowser, Resort)
+{
+	Set(0, "charlie", 1);
+	Set(1, "alpha", 2);
+	Set(2, "bravo", 3);
+	ASSERT_EQ(m_pBrowser->NumSortedServers(), 3);
+	EXPECT_STREQ(m_pBrowser->SortedGet(0)->m_aName, "alpha");
+	EXPECT_STREQ(m_pBrowser->SortedGet(2)->m_aName, "charlie");
+	ExpectSorted();
+
+	// a new info moves the server
+	Set(1, "delta", 2);
+	ASSERT_EQ(m_pBrowser->NumSortedServers(), 3);
+	EXPECT_STREQ(m_pBrowser->SortedGet(0)->m_aName, "bravo");
+	EXPECT_STREQ(m_pBrowser->SortedGet(2)->m_aName, "delta");
+	ExpectSorted();
+
+	// a full sort agrees
+	m_pBrowser->Update(true);
+	EXPECT_STREQ(m_pBrowser->SortedGet(0)->m_aName, "bravo");
+	EXPECT_STREQ(m_pBrowser->SortedGet(2)->m_aName, "delta");
+	ExpectSorted();
+}
+
+TEST_F(ServerBrowser, ResortFiltered)
+{
+	str_copy(g_Config.m_BrFilterString, "Block", sizeof(g_Config.m_BrFilterString));
+	m_pBrowser->Update(true);
+
+	Set(0, "Blockworlds", 1);
+	Set(1, "Race", 1);
+	Set(2, "A BLOCK server", 1);
+	ASSERT_EQ(m_pBrowser->NumServers(), 3);
+	ASSERT_EQ(m_pBrowser->NumSortedServers(), 2);
+	EXPECT_STREQ(m_pBrowser->SortedGet(0)->m_aName, "A BLOCK server");
+	EXPECT_STREQ(m_pBrowser->SortedGet(1)->m_aName, "Blockworlds");
+
+	// falling out of the filter and back into it
+	Set(0, "Race", 1);
+	ASSERT_EQ(m_pBrowser->NumSortedServers(), 1);
+	Set(1, "0 Block", 1);
+	ASSERT_EQ(m_pBrowser->NumSortedServers(), 2);
+	EXPECT_STREQ(m_pBrowser->SortedGet(0)->m_aName, "0 Block");
+	ExpectSorted();
+
+	g_Config.m_BrFilterString[0] = 0;
+	m_pBrowser->Update(true);
+	EXPECT_EQ(m_pBrowser->NumSortedServers(), 3);
+	ExpectSorted();
+}
+
+TEST_F(ServerBrowser, RequestPacing)
+{
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = NETTYPE_IPV4;
+	ASSERT_TRUE(m_NetClient.Open(BindAddr, 0));
+	g_Config.m_BrMaxRequests = 10;
+	g_Config.m_BrRequestRate = 1000;
+
+	// nothing listens on these ports
+	const int NUM_SERVERS = 50;
+	NETADDR aAddrs[NUM_SERVERS];
+	for(int i = 0; i < NUM_SERVERS; i++)
+	{
+		net_addr_from_str(&aAddrs[i], "127.0.0.1");
+		aAddrs[i].port = 40000 + i;
+		m_pBrowser->Set(aAddrs[i], IServerBrowser::SET_FAV_ADD, -1, 0);
+	}
+	EXPECT_TRUE(m_pBrowser->IsRefreshing());
+
+	m_pBrowser->Update(false);
+	int Requested = 0;
+	for(int i = 0; i < NUM_SERVERS; i++)
+		if(m_pBrowser->Find(aAddrs[i])->m_RequestTime > 0)
+			Requested++;
+	EXPECT_EQ(Requested, 10);
+
+	// answers make room for new requests
+	CServerInfo Info;
+	mem_zero(&Info, sizeof(Info));
+	Info.m_Type = SERVERINFO_EXTENDED;
+	for(int i = 0; i < 5; i++)
+		m_pBrowser->Set(aAddrs[i], IServerBrowser::SET_TOKEN, m_pBrowser->GenerateToken(aAddrs[i]), &Info);
+	EXPECT_EQ(m_pBrowser->LoadingProgression(), 10);
+	m_pBrowser->Update(false);
+	Requested = 0;
+	for(int i = 0; i < NUM_SERVERS; i++)
+		if(m_pBrowser->Find(aAddrs[i])->m_RequestTime > 0)
+			Requested++;
+	EXPECT_EQ(Requested, 10);
+	EXPECT_GT(m_pBrowser->Find(aAddrs[14])->m_RequestTime, 0);
+	EXPECT_EQ(m_pBrowser->Find(aAddrs[15])->m_RequestTime, 0);
+
+	m_NetClient.Close();
+}
+
+TEST_F(ServerBrowser, Cache)
+{
+	IStorage *pStorage = CreateLocalStorage();
+	m_pKernel->RegisterInterface(pStorage);
+	m_pBrowser->Refresh(IServerBrowser::TYPE_INTERNET);
+
+	CServerInfo Info;
+	mem_zero(&Info, sizeof(Info));
+	Info.m_Type = SERVERINFO_EXTENDED;
+	str_copy(Info.m_aName, "cached", sizeof(Info.m_aName));
+	str_copy(Info.m_aMap, "Multeasymap", sizeof(Info.m_aMap));
+	Info.m_MaxClients = Info.m_MaxPlayers = MAX_CLIENTS;
+	Info.m_NumClients = Info.m_NumPlayers = Info.m_NumReceivedClients = 1;
+	str_copy(Info.m_aClients[0].m_aName, "nameless tee", sizeof(Info.m_aClients[0].m_aName));
+	Info.m_aClients[0].m_Score = 1234;
+	Info.m_aClients[0].m_Player = true;
+	Info.m_Latency = 42;
+
+	NETADDR Address = Addr(1);
+	m_pBrowser->Set(Address, IServerBrowser::SET_MASTER_ADD, -1, 0);
+	m_pBrowser->Set(Address, IServerBrowser::SET_TOKEN, m_pBrowser->GenerateToken(Address), &Info);
+	EXPECT_FALSE(m_pBrowser->IsRefreshing());
+	m_pBrowser->Update(false);
+
+	// the next refresh starts with the server of the last one
+	m_pBrowser->Refresh(IServerBrowser::TYPE_INTERNET);
+	ASSERT_EQ(m_pBrowser->NumServers(), 1);
+	ASSERT_EQ(m_pBrowser->NumSortedServers(), 1);
+	const CServerInfo *pInfo = m_pBrowser->SortedGet(0);
+	EXPECT_TRUE(pInfo->m_Stale);
+	EXPECT_STREQ(pInfo->m_aName, "cached");
+	EXPECT_STREQ(pInfo->m_aMap, "Multeasymap");
+	EXPECT_EQ(pInfo->m_Latency, 42);
+	ASSERT_EQ(pInfo->m_NumReceivedClients, 1);
+	EXPECT_STREQ(pInfo->m_aClients[0].m_aName, "nameless tee");
+	EXPECT_EQ(pInfo->m_aClients[0].m_Score, 1234);
+	EXPECT_TRUE(m_pBrowser->IsRefreshing());
+
+	// and refreshes it
+	m_pBrowser->Set(Address, IServerBrowser::SET_TOKEN, m_pBrowser->GenerateToken(Address), &Info);
+	EXPECT_FALSE(m_pBrowser->SortedGet(0)->m_Stale);
+
+	pStorage->RemoveFile("serverbrowser_internet.cache", IStorage::TYPE_SAVE);
+}
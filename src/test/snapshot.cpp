@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/snapshot.h>
+
+// item layout roughly like a full DDRace server: players, characters and
+// lots of projectiles, lasers and pickups
+static const int s_aItemTypes[] = {2, 3, 4, 9, 10, 11};
+static const int s_aItemSizes[] = {6, 5, 4, 22, 5, 17};
+
+static int CreateSnapshot(CSnapshotBuilder *pBuilder, void *pData, int NumItems, int Seed)
+{
+	pBuilder->Init();
+	for(int i = 0; i < NumItems; i++)
+	{
+		int TypeIndex = i % (int)(sizeof(s_aItemTypes) / sizeof(s_aItemTypes[0]));
+		// entity IDs are handed out in no particular order
+		int ID = (i * 7919 + Seed) & 0x3fff;
+		int *pItem = (int *)pBuilder->NewItem(s_aItemTypes[TypeIndex], ID, s_aItemSizes[TypeIndex] * sizeof(int));
+		if(!pItem)
+			continue;
+		for(int j = 0; j < s_aItemSizes[TypeIndex]; j++)
+			pItem[j] = ID * 31 + j + Seed;
+	}
+	return pBuilder->Finish(pData);
+}
+
+TEST(Snapshot, FinishSortsItems)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnap = (CSnapshot *)s_aData;
+
+	CreateSnapshot(&s_Builder, s_aData, 1000, 1);
+	ASSERT_EQ(pSnap->NumItems(), 1000);
+	EXPECT_TRUE(pSnap->IsSorted());
+
+	for(int i = 0; i < pSnap->NumItems(); i++)
+	{
+		CSnapshotItem *pItem = pSnap->GetItem(i);
+		int Size = pSnap->GetItemSize(i) / (int)sizeof(int);
+		for(int j = 0; j < Size; j++)
+			EXPECT_EQ(pItem->Data()[j], pItem->ID() * 31 + j + 1);
+	}
+}
+
+TEST(Snapshot, GetItemIndex)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnap = (CSnapshot *)s_aData;
+
+	CreateSnapshot(&s_Builder, s_aData, 777, 2);
+	for(int i = 0; i < pSnap->NumItems(); i++)
+		EXPECT_EQ(pSnap->GetItemIndex(pSnap->GetItem(i)->Key()), i);
+
+	EXPECT_EQ(pSnap->GetItemIndex((1<<16)|5), -1);
+	EXPECT_EQ(pSnap->GetItemIndex((100<<16)|5), -1);
+	EXPECT_EQ(pSnap->GetItemIndex(-1), -1);
+
+	CSnapshot Empty;
+	Empty.Clear();
+	EXPECT_EQ(Empty.GetItemIndex((2<<16)|1), -1);
+}
+
+TEST(Snapshot, SortUnsorted)
+{
+	static char s_aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnap = (CSnapshot *)s_aData;
+
+	// build an unsorted snapshot by hand, like the ones stored in older demos
+	int *pRaw = (int *)s_aData;
+	pRaw[0] = 3 * 3 * sizeof(int); // data size
+	pRaw[1] = 3; // num items
+	int aKeys[] = {(9<<16)|3, (2<<16)|7, (9<<16)|1};
+	for(int i = 0; i < 3; i++)
+	{
+		pRaw[2 + i] = i * 3 * sizeof(int);
+		int *pItem = &pRaw[5 + i * 3];
+		pItem[0] = aKeys[i];
+		pItem[1] = i;
+		pItem[2] = aKeys[i] + 1;
+	}
+	EXPECT_FALSE(pSnap->IsSorted());
+
+	int Size = CSnapshotBuilder::Sort(s_aData);
+	EXPECT_EQ(Size, (int)(sizeof(int) * (2 + 3 + 9)));
+	EXPECT_TRUE(pSnap->IsSorted());
+	for(int i = 0; i < 3; i++)
+	{
+		int Index = pSnap->GetItemIndex(aKeys[i]);
+		ASSERT_GE(Index, 0);
+		EXPECT_EQ(pSnap->GetItemSize(Index), 2 * (int)sizeof(int));
+		EXPECT_EQ(pSnap->GetItem(Index)->Data()[0], i);
+		EXPECT_EQ(pSnap->GetItem(Index)->Data()[1], aKeys[i] + 1);
+	}
+}
+
+TEST(Snapshot, StorageGet)
+{
+	static char s_aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnap = (CSnapshot *)s_aData;
+	pSnap->Clear();
+
+	CSnapshotStorage Storage;
+	Storage.Init();
+	for(int Tick = 10; Tick < 160; Tick += 2)
+		Storage.Add(Tick, Tick * 100, sizeof(CSnapshot), s_aData, 0);
+
+	for(int Tick = 0; Tick < 170; Tick++)
+	{
+		int64 Tagtime;
+		CSnapshot *pFound;
+		int Size = Storage.Get(Tick, &Tagtime, &pFound, 0);
+		if(Tick >= 10 && Tick < 160 && Tick % 2 == 0)
+		{
+			EXPECT_EQ(Size, (int)sizeof(CSnapshot));
+			EXPECT_EQ(Tagtime, Tick * 100);
+		}
+		else
+			EXPECT_EQ(Size, -1);
+	}
+
+	Storage.PurgeUntil(100);
+	EXPECT_EQ(Storage.Get(98, 0, 0, 0), -1);
+	EXPECT_EQ(Storage.Get(100, 0, 0, 0), (int)sizeof(CSnapshot));
+	Storage.PurgeAll();
+}
+
+static void ExpectSnapshotsEqual(CSnapshot *pA, CSnapshot *pB)
+{
+	ASSERT_EQ(pA->NumItems(), pB->NumItems());
+	for(int i = 0; i < pA->NumItems(); i++)
+	{
+		ASSERT_EQ(pA->GetItem(i)->Key(), pB->GetItem(i)->Key());
+		ASSERT_EQ(pA->GetItemSize(i), pB->GetItemSize(i));
+		EXPECT_EQ(mem_comp(pA->GetItem(i)->Data(), pB->GetItem(i)->Data(), pA->GetItemSize(i)), 0);
+	}
+}
+
+TEST(SnapshotDelta, RoundTrip)
+{
+	static CSnapshotDelta s_Delta;
+	static CSnapshotBuilder s_Builder;
+	static char s_aFrom[CSnapshot::MAX_SIZE];
+	static char s_aTo[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	static char s_aDelta[CSnapshot::MAX_SIZE];
+	CSnapshot *pFrom = (CSnapshot *)s_aFrom;
+	CSnapshot *pTo = (CSnapshot *)s_aTo;
+	CSnapshot *pUnpacked = (CSnapshot *)s_aUnpacked;
+
+	// from an empty snapshot
+	pFrom->Clear();
+	CreateSnapshot(&s_Builder, s_aTo, 1000, 4);
+	int DeltaSize = s_Delta.CreateDelta(pFrom, pTo, s_aDelta);
+	ASSERT_GT(DeltaSize, 0);
+	ASSERT_GE(s_Delta.UnpackDelta(pFrom, pUnpacked, s_aDelta, DeltaSize), 0);
+	ExpectSnapshotsEqual(pTo, pUnpacked);
+
+	// partly overlapping snapshots: some items deleted, some changed, some new
+	CreateSnapshot(&s_Builder, s_aFrom, 1000, 4);
+	CreateSnapshot(&s_Builder, s_aTo, 1023, 5);
+	DeltaSize = s_Delta.CreateDelta(pFrom, pTo, s_aDelta);
+	ASSERT_GT(DeltaSize, 0);
+	ASSERT_GE(s_Delta.UnpackDelta(pFrom, pUnpacked, s_aDelta, DeltaSize), 0);
+	ExpectSnapshotsEqual(pTo, pUnpacked);
+}
+
+TEST(SnapshotDelta, CollidingKeys)
+{
+	static CSnapshotDelta s_Delta;
+	static CSnapshotBuilder s_Builder;
+	static char s_aFrom[CSnapshot::MAX_SIZE];
+	static char s_aTo[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	static char s_aDelta[CSnapshot::MAX_SIZE];
+	CSnapshot *pFrom = (CSnapshot *)s_aFrom;
+	CSnapshot *pTo = (CSnapshot *)s_aTo;
+	CSnapshot *pUnpacked = (CSnapshot *)s_aUnpacked;
+
+	// all keys share type and the low ID bits, so they used to end up in a
+	// single hash bucket which only had room for 64 items
+	for(int Snap = 0; Snap < 2; Snap++)
+	{
+		s_Builder.Init();
+		for(int i = 0; i < CSnapshot::MAX_ITEMS - 1; i++)
+		{
+			int *pItem = (int *)s_Builder.NewItem(4, i * 16, 4 * sizeof(int));
+			ASSERT_TRUE(pItem);
+			for(int j = 0; j < 4; j++)
+				pItem[j] = i + j + (Snap && i % 3 == 0);
+		}
+		s_Builder.Finish(Snap ? s_aTo : s_aFrom);
+	}
+
+	// unchanged snapshots produce an empty delta
+	EXPECT_EQ(s_Delta.CreateDelta(pFrom, pFrom, s_aDelta), 0);
+
+	int DeltaSize = s_Delta.CreateDelta(pFrom, pTo, s_aDelta);
+	ASSERT_GT(DeltaSize, 0);
+	CSnapshotDelta::CData *pData = (CSnapshotDelta::CData *)s_aDelta;
+	EXPECT_EQ(pData->m_NumDeletedItems, 0);
+	EXPECT_EQ(pData->m_NumUpdateItems, (CSnapshot::MAX_ITEMS - 1 + 2) / 3);
+
+	ASSERT_GE(s_Delta.UnpackDelta(pFrom, pUnpacked, s_aDelta, DeltaSize), 0);
+	ExpectSnapshotsEqual(pTo, pUnpacked);
+}
+
+static unsigned s_Random = 1;
+static int RandomInt()
+{
+	// values around the CVariableInt size steps and the int limits
+	static const int s_aInteresting[] = {0, 1, -1, 63, 64, -64, -65, 8191, 8192, -8193, (1<<20)-1, 1<<20, (1<<27)-1, 1<<27, -(1<<27)-1, 0x7fffffff, (int)0x80000000};
+	s_Random = s_Random * 1103515245 + 12345;
+	if((s_Random >> 16) % 4 == 0)
+		return s_aInteresting[(s_Random >> 8) % (sizeof(s_aInteresting) / sizeof(s_aInteresting[0]))];
+	return (int)(s_Random ^ (s_Random << 13));
+}
+
+TEST(SnapshotDelta, SimdDiffItem)
+{
+	int aPast[40], aCurrent[40], aExpected[40], aOut[41];
+	for(int Level = CSnapshotDelta::SIMD_NONE; Level <= CSnapshotDelta::SimdSupported(); Level++)
+	{
+		CSnapshotDelta::SetSimd(Level);
+		ASSERT_EQ(CSnapshotDelta::Simd(), Level);
+		for(int Size = 0; Size < 40; Size++)
+		{
+			for(int Round = 0; Round < 20; Round++)
+			{
+				int Needed = 0;
+				for(int i = 0; i < Size; i++)
+				{
+					aPast[i] = RandomInt();
+					aCurrent[i] = Round % 2 ? aPast[i] : RandomInt();
+					aExpected[i] = (int)((unsigned)aCurrent[i] - (unsigned)aPast[i]);
+					Needed |= aExpected[i];
+				}
+				aOut[Size] = 0x12345678;
+				EXPECT_EQ(CSnapshotDelta::DiffItem(aPast, aCurrent, aOut, Size), Needed);
+				EXPECT_EQ(mem_comp(aOut, aExpected, Size * sizeof(int)), 0);
+				EXPECT_EQ(aOut[Size], 0x12345678);
+			}
+		}
+	}
+	CSnapshotDelta::SetSimd(CSnapshotDelta::SimdSupported());
+}
+
+TEST(SnapshotDelta, SimdUnpackAndCrc)
+{
+	static CSnapshotDelta s_aDeltas[CSnapshotDelta::SIMD_AVX2 + 1];
+	static CSnapshotBuilder s_Builder;
+	static char s_aFrom[CSnapshot::MAX_SIZE];
+	static char s_aTo[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	static char s_aDelta[CSnapshot::MAX_SIZE];
+	CSnapshot *pFrom = (CSnapshot *)s_aFrom;
+	CSnapshot *pTo = (CSnapshot *)s_aTo;
+	CSnapshot *pUnpacked = (CSnapshot *)s_aUnpacked;
+
+	// items of all sizes with values that pack to all lengths
+	for(int Snap = 0; Snap < 2; Snap++)
+	{
+		s_Builder.Init();
+		for(int i = 0; i < 300; i++)
+		{
+			int Size = i % 37;
+			int *pItem = (int *)s_Builder.NewItem(1 + i % 5, i, Size * sizeof(int));
+			for(int j = 0; j < Size; j++)
+				pItem[j] = RandomInt();
+		}
+		s_Builder.Finish(Snap ? s_aTo : s_aFrom);
+	}
+
+	int Crc = 0;
+	for(int i = 0; i < pTo->NumItems(); i++)
+		for(int j = 0; j < pTo->GetItemSize(i) / 4; j++)
+			Crc = (int)((unsigned)Crc + (unsigned)pTo->GetItem(i)->Data()[j]);
+
+	for(int Level = CSnapshotDelta::SIMD_NONE; Level <= CSnapshotDelta::SimdSupported(); Level++)
+	{
+		CSnapshotDelta::SetSimd(Level);
+		EXPECT_EQ(pTo->Crc(), Crc);
+
+		int DeltaSize = s_aDeltas[Level].CreateDelta(pFrom, pTo, s_aDelta);
+		ASSERT_GT(DeltaSize, 0);
+		ASSERT_GE(s_aDeltas[Level].UnpackDelta(pFrom, pUnpacked, s_aDelta, DeltaSize), 0);
+		ExpectSnapshotsEqual(pTo, pUnpacked);
+		for(int Type = 0; Type < 8; Type++)
+			EXPECT_EQ(s_aDeltas[Level].GetDataRate(Type), s_aDeltas[0].GetDataRate(Type));
+	}
+	CSnapshotDelta::SetSimd(CSnapshotDelta::SimdSupported());
+}
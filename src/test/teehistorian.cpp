@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <base/detect.h>
+#include <engine/external/json-parser/json.h>
 #include <engine/server.h>
 #include <engine/shared/config.h>
 #include <game/gamecore.h>
@@ -361,3 +362,86 @@ TEST_F(TeeHistorian, Auth)
 	Finish();
 	Expect(EXPECTED, sizeof(EXPECTED));
 }
+
+TEST_F(TeeHistorian, ReadBack)
+{
+	CNetObj_PlayerInput Input;
+	mem_zero(&Input, sizeof(Input));
+	Input.m_Direction = -1;
+	Input.m_TargetX = 100;
+
+	Tick(1); Player(0, 1, 2); Player(3, 5, 6);
+	Inputs(); m_TH.RecordPlayerInput(3, &Input); m_TH.RecordPlayerJoin(5);
+	Tick(2); Player(0, 2, 1); DeadPlayer(3);
+	Tick(3); Player(0, 2, 1);
+	Tick(7); Player(1, 8, 9);
+	Inputs();
+	Input.m_Jump = 1;
+	m_TH.RecordPlayerInput(3, &Input);
+	m_TH.RecordPlayerMessage(5, "msg", 4);
+	m_TH.RecordPlayerDrop(5, "bye");
+	Finish();
+
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Reader.Init(m_Buffer.Data(), m_Buffer.Size()));
+	EXPECT_STREQ(json_string_get(json_object_get(Reader.Header(), "map_name")), "Kobra 3 Solo");
+
+	struct
+	{
+		int m_Type;
+		int m_Tick;
+		int m_ClientID;
+		int m_X;
+		int m_Y;
+	} aExpected[] = {
+		{CTeeHistorianReader::ITEM_PLAYER, 1, 0, 1, 2},
+		{CTeeHistorianReader::ITEM_PLAYER, 1, 3, 5, 6},
+		{CTeeHistorianReader::ITEM_INPUT, 1, 3, 0, 0},
+		{CTeeHistorianReader::ITEM_JOIN, 1, 5, 0, 0},
+		{CTeeHistorianReader::ITEM_PLAYER, 2, 0, 2, 1},
+		{CTeeHistorianReader::ITEM_PLAYER_DEAD, 2, 3, 0, 0},
+		{CTeeHistorianReader::ITEM_PLAYER, 7, 1, 8, 9},
+		{CTeeHistorianReader::ITEM_INPUT, 7, 3, 0, 0},
+		{CTeeHistorianReader::ITEM_MESSAGE, 7, 5, 0, 0},
+		{CTeeHistorianReader::ITEM_DROP, 7, 5, 0, 0},
+		{CTeeHistorianReader::ITEM_FINISH, 7, -1, 0, 0},
+	};
+
+	CTeeHistorianReader::CItem Item;
+	for(unsigned i = 0; i < sizeof(aExpected) / sizeof(aExpected[0]); i++)
+	{
+		SCOPED_TRACE(i);
+		ASSERT_TRUE(Reader.Next(&Item));
+		EXPECT_EQ(Item.m_Type, aExpected[i].m_Type);
+		EXPECT_EQ(Item.m_Tick, aExpected[i].m_Tick);
+		EXPECT_EQ(Item.m_ClientID, aExpected[i].m_ClientID);
+		if(Item.m_Type == CTeeHistorianReader::ITEM_PLAYER)
+		{
+			EXPECT_EQ(Item.m_X, aExpected[i].m_X);
+			EXPECT_EQ(Item.m_Y, aExpected[i].m_Y);
+		}
+		else if(Item.m_Type == CTeeHistorianReader::ITEM_INPUT)
+		{
+			EXPECT_EQ(Item.m_Input.m_Direction, -1);
+			EXPECT_EQ(Item.m_Input.m_TargetX, 100);
+			EXPECT_EQ(Item.m_Input.m_Jump, Item.m_Tick == 7);
+		}
+		else if(Item.m_Type == CTeeHistorianReader::ITEM_MESSAGE)
+		{
+			ASSERT_EQ(Item.m_DataSize, 4);
+			EXPECT_EQ(mem_comp(Item.m_pData, "msg", 4), 0);
+		}
+		else if(Item.m_Type == CTeeHistorianReader::ITEM_DROP)
+		{
+			EXPECT_STREQ(Item.m_pString, "bye");
+		}
+	}
+	EXPECT_FALSE(Reader.Next(&Item));
+	EXPECT_FALSE(Reader.Error());
+
+	// a cut off file
+	ASSERT_TRUE(Reader.Init(m_Buffer.Data(), m_Buffer.Size() - 1));
+	while(Reader.Next(&Item))
+		EXPECT_NE(Item.m_Type, CTeeHistorianReader::ITEM_FINISH);
+	EXPECT_TRUE(Reader.Error());
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <engine/server/tickprofiler.h>
+
+TEST(Histogram, Empty)
+{
+	CHistogram Histogram;
+	EXPECT_EQ(Histogram.Count(), 0);
+	EXPECT_EQ(Histogram.Max(), 0);
+	EXPECT_EQ(Histogram.Percentile(0.5f), 0);
+}
+
+TEST(Histogram, Buckets)
+{
+	for(int64 Value = 0; Value < 100000; Value++)
+	{
+		int Index = CHistogram::BucketIndex(Value);
+		ASSERT_LE(Value, CHistogram::BucketUpperBound(Index));
+		if(Index > 0)
+		{
+			ASSERT_GT(Value, CHistogram::BucketUpperBound(Index - 1));
+		}
+	}
+	EXPECT_EQ(CHistogram::BucketIndex(-5), 0);
+	EXPECT_EQ(CHistogram::BucketIndex((int64)1 << 60), CHistogram::NUM_BUCKETS - 1);
+}
+
+TEST(Histogram, Percentile)
+{
+	CHistogram Histogram;
+	for(int i = 1; i <= 1000; i++)
+		Histogram.Add(i);
+
+	EXPECT_EQ(Histogram.Count(), 1000);
+	EXPECT_EQ(Histogram.Max(), 1000);
+	EXPECT_GE(Histogram.Percentile(0.5f), 500);
+	EXPECT_LE(Histogram.Percentile(0.5f), 500 * 9 / 8);
+	EXPECT_GE(Histogram.Percentile(0.99f), 990);
+	EXPECT_LE(Histogram.Percentile(0.99f), 1000);
+	EXPECT_EQ(Histogram.Percentile(1.0f), 1000);
+
+	Histogram.Reset();
+	EXPECT_EQ(Histogram.Count(), 0);
+}
+
+TEST(TickProfiler, Disabled)
+{
+	CTickProfiler Profiler;
+	int64 Start = Profiler.Start();
+	EXPECT_EQ(Profiler.Lap(CTickProfiler::PHASE_TICK, Start), 0);
+	Profiler.AddSnapshotSize(100);
+	EXPECT_EQ(Profiler.Phase(CTickProfiler::SET_TOTAL, CTickProfiler::PHASE_TICK).Count(), 0);
+	EXPECT_EQ(Profiler.SnapshotSizes(CTickProfiler::SET_TOTAL).Count(), 0);
+}
+
+TEST(TickProfiler, Sets)
+{
+	CTickProfiler Profiler;
+	Profiler.SetEnabled(true);
+	Profiler.Add(CTickProfiler::PHASE_SNAP, 300);
+	Profiler.AddSnapshotSize(700);
+	Profiler.Reset(CTickProfiler::SET_INTERVAL);
+	Profiler.Add(CTickProfiler::PHASE_SNAP, 100);
+
+	EXPECT_EQ(Profiler.Phase(CTickProfiler::SET_TOTAL, CTickProfiler::PHASE_SNAP).Count(), 2);
+	EXPECT_EQ(Profiler.Phase(CTickProfiler::SET_TOTAL, CTickProfiler::PHASE_SNAP).Max(), 300);
+	EXPECT_EQ(Profiler.Phase(CTickProfiler::SET_INTERVAL, CTickProfiler::PHASE_SNAP).Count(), 1);
+	EXPECT_EQ(Profiler.Phase(CTickProfiler::SET_INTERVAL, CTickProfiler::PHASE_SNAP).Max(), 100);
+	EXPECT_EQ(Profiler.SnapshotSizes(CTickProfiler::SET_TOTAL).Max(), 700);
+	EXPECT_EQ(Profiler.SnapshotSizes(CTickProfiler::SET_INTERVAL).Count(), 0);
+
+	char aBuf[256];
+	Profiler.Format(CTickProfiler::SET_INTERVAL, CTickProfiler::PHASE_SNAP, aBuf, sizeof(aBuf));
+	EXPECT_STREQ(aBuf, "phase=snap n=1 p50=100us p99=100us max=100us");
+	Profiler.Format(CTickProfiler::SET_TOTAL, CTickProfiler::NUM_PHASES, aBuf, sizeof(aBuf));
+	EXPECT_STREQ(aBuf, "snapshot_size n=1 p50=700B p99=700B max=700B");
+}
@@ -0,0 +1,516 @@
+#include <base/math.h>
+#include <base/system.h>
+#include <mastersrv/mastersrv.h>
+
+#include <algorithm>
+#include <vector>
+
+enum
+{
+	CONNLESS_HEADER_SIZE=6,
+	MAX_THREADS=64,
+	// requests without an answer after this are lost
+	TIMEOUT_MS=1000,
+};
+
+static NETADDR s_MasterAddr;
+static bool s_UseMaster = false;
+static NETADDR s_InfoAddr;
+static bool s_UseInfoAddr = false;
+static int s_NumServers = 0;
+static int s_ServerPort = 18400;
+static int s_NumClients = 0;
+static int s_NumThreads = 1;
+static int s_HeartbeatInterval = 20;
+static int s_ListInterval = 10;
+static int s_InfoRate = 10;
+static int s_Duration = 30;
+
+static volatile bool s_Stop = false;
+
+struct CStats
+{
+	int64 m_HeartbeatsSent;
+	int64 m_ChecksAnswered;
+	int64 m_InfosAnswered;
+
+	int64 m_ListsSent;
+	int64 m_ListsReceived;
+	int64 m_ListsLost;
+	int64 m_ListPackets;
+	int64 m_ListedServers;
+	std::vector<int> m_aListLatencies;
+
+	int64 m_InfosSent;
+	int64 m_InfosReceived;
+	int64 m_InfosLost;
+	std::vector<int> m_aInfoLatencies;
+
+	CStats() :
+		m_HeartbeatsSent(0), m_ChecksAnswered(0), m_InfosAnswered(0),
+		m_ListsSent(0), m_ListsReceived(0), m_ListsLost(0), m_ListPackets(0), m_ListedServers(0),
+		m_InfosSent(0), m_InfosReceived(0), m_InfosLost(0) {}
+
+	void Add(const CStats &Other)
+	{
+		m_HeartbeatsSent += Other.m_HeartbeatsSent;
+		m_ChecksAnswered += Other.m_ChecksAnswered;
+		m_InfosAnswered += Other.m_InfosAnswered;
+		m_ListsSent += Other.m_ListsSent;
+		m_ListsReceived += Other.m_ListsReceived;
+		m_ListsLost += Other.m_ListsLost;
+		m_ListPackets += Other.m_ListPackets;
+		m_ListedServers += Other.m_ListedServers;
+		m_aListLatencies.insert(m_aListLatencies.end(), Other.m_aListLatencies.begin(), Other.m_aListLatencies.end());
+		m_InfosSent += Other.m_InfosSent;
+		m_InfosReceived += Other.m_InfosReceived;
+		m_InfosLost += Other.m_InfosLost;
+		m_aInfoLatencies.insert(m_aInfoLatencies.end(), Other.m_aInfoLatencies.begin(), Other.m_aInfoLatencies.end());
+	}
+};
+
+// a heartbeating server answering the firewall checks and info requests
+struct CSimServer
+{
+	NETSOCKET m_Socket;
+	int m_Port;
+	int64 m_NextHeartbeat;
+	unsigned char m_aInfo[256];
+	int m_InfoSize;
+};
+
+struct CPendingInfo
+{
+	NETADDR m_Addr;
+	int64 m_SendTime;
+};
+
+// a browser getting the list and the infos of the listed servers
+struct CSimClient
+{
+	NETSOCKET m_Socket;
+	int64 m_NextList;
+	// 0 if no list was requested or it arrived
+	int64 m_ListSendTime;
+	std::vector<NETADDR> m_aServers;
+	int m_NextServer;
+	int64 m_NextInfo;
+	std::vector<CPendingInfo> m_aPending;
+};
+
+struct CWorker
+{
+	std::vector<CSimServer> m_aServers;
+	std::vector<CSimClient> m_aClients;
+	MMSGS *m_pMmsgs;
+	CStats m_Stats;
+	void *m_pThread;
+};
+
+static int64 Micros(int64 Time)
+{
+	return Time * 1000000 / time_freq();
+}
+
+static void SendConnless(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize)
+{
+	unsigned char aBuffer[PACKETSIZE];
+	for(int i = 0; i < CONNLESS_HEADER_SIZE; i++)
+		aBuffer[i] = 0xff;
+	mem_copy(aBuffer + CONNLESS_HEADER_SIZE, pData, DataSize);
+	net_udp_send(Socket, pAddr, aBuffer, CONNLESS_HEADER_SIZE + DataSize);
+}
+
+// returns the size of the next connless packet on the socket, 0 if it
+// wasn't one and -1 if there are no more. the socket has to be drained
+// before the next one is read, the received packets are buffered in pMmsgs
+static int Receive(NETSOCKET Socket, MMSGS *pMmsgs, unsigned char *pBuffer, NETADDR *pAddr, const unsigned char **ppData)
+{
+	unsigned char *pData;
+	int Bytes = net_udp_recv(Socket, pAddr, pBuffer, PACKETSIZE, pMmsgs, &pData);
+	if(Bytes <= 0)
+		return -1;
+	if(Bytes < CONNLESS_HEADER_SIZE + 8 || pData[0] != 0xff)
+		return 0;
+	*ppData = pData + CONNLESS_HEADER_SIZE;
+	return Bytes - CONNLESS_HEADER_SIZE;
+}
+
+static bool Is(const unsigned char *pData, int Size, const unsigned char *pHeader, int HeaderSize)
+{
+	return Size >= HeaderSize && mem_comp(pData, pHeader, HeaderSize) == 0;
+}
+
+static void WriteStr(CSimServer *pServer, const char *pStr)
+{
+	int Length = str_length(pStr) + 1;
+	mem_copy(&pServer->m_aInfo[pServer->m_InfoSize], pStr, Length);
+	pServer->m_InfoSize += Length;
+}
+
+static void BuildInfo(CSimServer *pServer, int Index)
+{
+	char aName[64];
+	str_format(aName, sizeof(aName), "load server %d", Index);
+	pServer->m_InfoSize = 0;
+	WriteStr(pServer, "0.6.4");
+	WriteStr(pServer, aName);
+	WriteStr(pServer, "dm1");
+	WriteStr(pServer, "DM");
+	WriteStr(pServer, "0"); // flags
+	WriteStr(pServer, "0"); // players
+	WriteStr(pServer, "16");
+	WriteStr(pServer, "0"); // clients
+	WriteStr(pServer, "16");
+}
+
+// returns whether there was something to do
+static bool UpdateServer(CWorker *pWorker, CSimServer *pServer, int64 Now)
+{
+	bool Active = false;
+	if(s_UseMaster && Now >= pServer->m_NextHeartbeat)
+	{
+		pServer->m_NextHeartbeat = Now + s_HeartbeatInterval * time_freq();
+		unsigned char aData[sizeof(SERVERBROWSE_HEARTBEAT) + 2];
+		mem_copy(aData, SERVERBROWSE_HEARTBEAT, sizeof(SERVERBROWSE_HEARTBEAT));
+		aData[sizeof(SERVERBROWSE_HEARTBEAT)] = (pServer->m_Port>>8)&0xff;
+		aData[sizeof(SERVERBROWSE_HEARTBEAT)+1] = pServer->m_Port&0xff;
+		SendConnless(pServer->m_Socket, &s_MasterAddr, aData, sizeof(aData));
+		pWorker->m_Stats.m_HeartbeatsSent++;
+		Active = true;
+	}
+
+	unsigned char aBuffer[PACKETSIZE];
+	NETADDR Addr;
+	const unsigned char *pData;
+	int Size;
+	while((Size = Receive(pServer->m_Socket, pWorker->m_pMmsgs, aBuffer, &Addr, &pData)) >= 0)
+	{
+		Active = true;
+		if(Is(pData, Size, SERVERBROWSE_FWCHECK, sizeof(SERVERBROWSE_FWCHECK)))
+		{
+			SendConnless(pServer->m_Socket, &Addr, SERVERBROWSE_FWRESPONSE, sizeof(SERVERBROWSE_FWRESPONSE));
+			pWorker->m_Stats.m_ChecksAnswered++;
+		}
+		else if(Size == sizeof(SERVERBROWSE_GETINFO) + 1 && Is(pData, Size, SERVERBROWSE_GETINFO, sizeof(SERVERBROWSE_GETINFO)))
+		{
+			unsigned char aInfo[512];
+			mem_copy(aInfo, SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
+			int InfoSize = sizeof(SERVERBROWSE_INFO);
+			char aToken[16];
+			str_format(aToken, sizeof(aToken), "%d", pData[sizeof(SERVERBROWSE_GETINFO)]);
+			mem_copy(aInfo + InfoSize, aToken, str_length(aToken) + 1);
+			InfoSize += str_length(aToken) + 1;
+			mem_copy(aInfo + InfoSize, pServer->m_aInfo, pServer->m_InfoSize);
+			InfoSize += pServer->m_InfoSize;
+			SendConnless(pServer->m_Socket, &Addr, aInfo, InfoSize);
+			pWorker->m_Stats.m_InfosAnswered++;
+		}
+	}
+	return Active;
+}
+
+static void ReadList(CSimClient *pClient, const unsigned char *pData, int Size)
+{
+	const unsigned char aIPV4Mapping[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+	int Num = (Size - (int)sizeof(SERVERBROWSE_LIST)) / (int)sizeof(CMastersrvAddr);
+	const CMastersrvAddr *pAddrs = (const CMastersrvAddr *)(pData + sizeof(SERVERBROWSE_LIST));
+	for(int i = 0; i < Num; i++)
+	{
+		NETADDR Addr;
+		mem_zero(&Addr, sizeof(Addr));
+		if(mem_comp(pAddrs[i].m_aIp, aIPV4Mapping, sizeof(aIPV4Mapping)) == 0)
+		{
+			Addr.type = NETTYPE_IPV4;
+			mem_copy(Addr.ip, &pAddrs[i].m_aIp[12], 4);
+		}
+		else
+		{
+			Addr.type = NETTYPE_IPV6;
+			mem_copy(Addr.ip, pAddrs[i].m_aIp, 16);
+		}
+		Addr.port = (pAddrs[i].m_aPort[0]<<8) | pAddrs[i].m_aPort[1];
+		pClient->m_aServers.push_back(Addr);
+	}
+}
+
+static bool UpdateClient(CWorker *pWorker, CSimClient *pClient, int64 Now)
+{
+	bool Active = false;
+	CStats *pStats = &pWorker->m_Stats;
+	int64 Timeout = time_freq() * TIMEOUT_MS / 1000;
+
+	if(s_UseMaster && Now >= pClient->m_NextList)
+	{
+		if(pClient->m_ListSendTime)
+			pStats->m_ListsLost++;
+		pClient->m_NextList = Now + s_ListInterval * time_freq();
+		pClient->m_ListSendTime = Now;
+		pClient->m_aServers.clear();
+		pClient->m_NextServer = 0;
+		SendConnless(pClient->m_Socket, &s_MasterAddr, SERVERBROWSE_GETLIST, sizeof(SERVERBROWSE_GETLIST));
+		pStats->m_ListsSent++;
+		Active = true;
+	}
+	else if(pClient->m_ListSendTime && Now - pClient->m_ListSendTime > Timeout)
+	{
+		pClient->m_ListSendTime = 0;
+		pStats->m_ListsLost++;
+	}
+
+	// the info requests are spread evenly
+	int64 InfoInterval = time_freq() / s_InfoRate;
+	const NETADDR *pTarget = 0;
+	if(Now >= pClient->m_NextInfo)
+	{
+		if(s_UseInfoAddr)
+			pTarget = &s_InfoAddr;
+		else if(!pClient->m_aServers.empty())
+			pTarget = &pClient->m_aServers[pClient->m_NextServer++ % pClient->m_aServers.size()];
+	}
+	if(pTarget)
+	{
+		pClient->m_NextInfo = maximum(pClient->m_NextInfo + InfoInterval, Now - InfoInterval);
+		unsigned char aData[sizeof(SERVERBROWSE_GETINFO) + 1];
+		mem_copy(aData, SERVERBROWSE_GETINFO, sizeof(SERVERBROWSE_GETINFO));
+		aData[sizeof(SERVERBROWSE_GETINFO)] = pStats->m_InfosSent&0xff;
+		SendConnless(pClient->m_Socket, pTarget, aData, sizeof(aData));
+		CPendingInfo Pending;
+		Pending.m_Addr = *pTarget;
+		Pending.m_SendTime = Now;
+		pClient->m_aPending.push_back(Pending);
+		pStats->m_InfosSent++;
+		Active = true;
+	}
+
+	unsigned char aBuffer[PACKETSIZE];
+	NETADDR Addr;
+	const unsigned char *pData;
+	int Size;
+	while((Size = Receive(pClient->m_Socket, pWorker->m_pMmsgs, aBuffer, &Addr, &pData)) >= 0)
+	{
+		Active = true;
+		if(Size == 0)
+			continue;
+		int64 Time = time_get();
+		if(Is(pData, Size, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST)))
+		{
+			if(pClient->m_ListSendTime)
+			{
+				pStats->m_aListLatencies.push_back(Micros(Time - pClient->m_ListSendTime));
+				pStats->m_ListsReceived++;
+				pClient->m_ListSendTime = 0;
+			}
+			pStats->m_ListPackets++;
+			int Before = pClient->m_aServers.size();
+			ReadList(pClient, pData, Size);
+			pStats->m_ListedServers += pClient->m_aServers.size() - Before;
+			continue;
+		}
+
+		// the first answer of a server counts, the others are more parts
+		for(unsigned i = 0; i < pClient->m_aPending.size(); i++)
+		{
+			if(net_addr_comp(&pClient->m_aPending[i].m_Addr, &Addr) == 0)
+			{
+				pStats->m_aInfoLatencies.push_back(Micros(Time - pClient->m_aPending[i].m_SendTime));
+				pStats->m_InfosReceived++;
+				pClient->m_aPending.erase(pClient->m_aPending.begin() + i);
+				break;
+			}
+		}
+	}
+
+	// they are in the order they were sent
+	unsigned NumLost = 0;
+	while(NumLost < pClient->m_aPending.size() && Now - pClient->m_aPending[NumLost].m_SendTime > Timeout)
+		NumLost++;
+	pStats->m_InfosLost += NumLost;
+	pClient->m_aPending.erase(pClient->m_aPending.begin(), pClient->m_aPending.begin() + NumLost);
+	return Active;
+}
+
+static void WorkerThread(void *pUser)
+{
+	CWorker *pWorker = (CWorker *)pUser;
+	while(!s_Stop)
+	{
+		int64 Now = time_get();
+		bool Active = false;
+		for(unsigned i = 0; i < pWorker->m_aServers.size(); i++)
+			Active |= UpdateServer(pWorker, &pWorker->m_aServers[i], Now);
+		for(unsigned i = 0; i < pWorker->m_aClients.size(); i++)
+			Active |= UpdateClient(pWorker, &pWorker->m_aClients[i], Now);
+		// leave the cpu to the tested server
+		if(!Active)
+			thread_sleep(200);
+	}
+}
+
+static bool CreateSocket(NETSOCKET *pSocket, int Port)
+{
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = NETTYPE_IPV4;
+	BindAddr.port = Port;
+	*pSocket = net_udp_create(BindAddr);
+	return pSocket->type != NETTYPE_INVALID;
+}
+
+static void PrintLatencies(std::vector<int> &aLatencies)
+{
+	if(aLatencies.empty())
+		return;
+	std::sort(aLatencies.begin(), aLatencies.end());
+	int Num = aLatencies.size();
+	dbg_msg("load", "  latency p50 %.2fms, p90 %.2fms, p99 %.2fms, max %.2fms",
+		aLatencies[Num*50/100] / 1000.0f, aLatencies[Num*90/100] / 1000.0f,
+		aLatencies[Num*99/100] / 1000.0f, aLatencies[Num-1] / 1000.0f);
+}
+
+static float Percent(int64 Part, int64 Total)
+{
+	return Total ? Part * 100.0f / Total : 0.0f;
+}
+
+static void Usage(const char *pProgram)
+{
+	dbg_msg("usage", "%s [-m master[:port]] [-s servers] [-c clients] [-i server[:port]] [-p first server port] [-b heartbeat secs] [-l list secs] [-r infos per sec] [-t secs] [-j threads]", pProgram);
+	dbg_msg("usage", "  -m  master to send the heartbeats to and get the lists from");
+	dbg_msg("usage", "  -s  number of simulated servers");
+	dbg_msg("usage", "  -c  number of simulated browsers");
+	dbg_msg("usage", "  -i  server to request all infos from instead of the listed ones");
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	net_init();
+
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		const char *pArg = argv[i]; // ignore_convention
+		if(i + 1 >= argc) // ignore_convention
+		{
+			Usage(argv[0]); // ignore_convention
+			return -1;
+		}
+		const char *pValue = argv[++i]; // ignore_convention
+		if(str_comp(pArg, "-m") == 0 || str_comp(pArg, "-i") == 0)
+		{
+			bool Master = str_comp(pArg, "-m") == 0;
+			NETADDR *pAddr = Master ? &s_MasterAddr : &s_InfoAddr;
+			if(net_host_lookup(pValue, pAddr, NETTYPE_IPV4) != 0)
+			{
+				dbg_msg("load", "couldn't resolve '%s'", pValue);
+				return -1;
+			}
+			if(pAddr->port == 0)
+				pAddr->port = Master ? MASTERSERVER_PORT : 8303;
+			(Master ? s_UseMaster : s_UseInfoAddr) = true;
+		}
+		else if(str_comp(pArg, "-s") == 0)
+			s_NumServers = maximum(str_toint(pValue), 0);
+		else if(str_comp(pArg, "-c") == 0)
+			s_NumClients = maximum(str_toint(pValue), 0);
+		else if(str_comp(pArg, "-p") == 0)
+			s_ServerPort = clamp(str_toint(pValue), 1, 65535);
+		else if(str_comp(pArg, "-b") == 0)
+			s_HeartbeatInterval = maximum(str_toint(pValue), 1);
+		else if(str_comp(pArg, "-l") == 0)
+			s_ListInterval = maximum(str_toint(pValue), 1);
+		else if(str_comp(pArg, "-r") == 0)
+			s_InfoRate = maximum(str_toint(pValue), 1);
+		else if(str_comp(pArg, "-t") == 0)
+			s_Duration = maximum(str_toint(pValue), 1);
+		else if(str_comp(pArg, "-j") == 0)
+			s_NumThreads = clamp(str_toint(pValue), 1, (int)MAX_THREADS);
+		else
+		{
+			Usage(argv[0]); // ignore_convention
+			return -1;
+		}
+	}
+
+	if(!s_UseMaster && !s_UseInfoAddr)
+	{
+		Usage(argv[0]); // ignore_convention
+		return -1;
+	}
+
+	CWorker aWorkers[MAX_THREADS];
+	int64 Now = time_get();
+	for(int i = 0; i < s_NumServers; i++)
+	{
+		CSimServer Server;
+		Server.m_Port = s_ServerPort + i;
+		if(!CreateSocket(&Server.m_Socket, Server.m_Port))
+		{
+			dbg_msg("load", "couldn't create the socket of server %d on port %d, check the open file limit", i, Server.m_Port);
+			return -1;
+		}
+		// spread the heartbeats over the interval
+		Server.m_NextHeartbeat = Now + (int64)i * s_HeartbeatInterval * time_freq() / maximum(s_NumServers, 1);
+		BuildInfo(&Server, i);
+		aWorkers[i % s_NumThreads].m_aServers.push_back(Server);
+	}
+	for(int i = 0; i < s_NumClients; i++)
+	{
+		CSimClient Client;
+		if(!CreateSocket(&Client.m_Socket, 0))
+		{
+			dbg_msg("load", "couldn't create the socket of browser %d, check the open file limit", i);
+			return -1;
+		}
+		Client.m_NextList = Now;
+		Client.m_ListSendTime = 0;
+		Client.m_NextServer = i;
+		Client.m_NextInfo = Now + (int64)i * time_freq() / s_InfoRate / maximum(s_NumClients, 1);
+		aWorkers[i % s_NumThreads].m_aClients.push_back(Client);
+	}
+
+	dbg_msg("load", "running %d servers and %d browsers on %d threads for %d seconds", s_NumServers, s_NumClients, s_NumThreads, s_Duration);
+	for(int i = 0; i < s_NumThreads; i++)
+	{
+		aWorkers[i].m_pMmsgs = new MMSGS;
+		net_init_mmsgs(aWorkers[i].m_pMmsgs);
+		aWorkers[i].m_pThread = thread_init(WorkerThread, &aWorkers[i], "load");
+	}
+
+	thread_sleep(s_Duration * 1000000);
+	s_Stop = true;
+
+	CStats Stats;
+	for(int i = 0; i < s_NumThreads; i++)
+	{
+		thread_wait(aWorkers[i].m_pThread);
+		Stats.Add(aWorkers[i].m_Stats);
+		delete aWorkers[i].m_pMmsgs;
+		for(unsigned j = 0; j < aWorkers[i].m_aServers.size(); j++)
+			net_udp_close(aWorkers[i].m_aServers[j].m_Socket);
+		for(unsigned j = 0; j < aWorkers[i].m_aClients.size(); j++)
+			net_udp_close(aWorkers[i].m_aClients[j].m_Socket);
+	}
+
+	if(s_NumServers)
+		dbg_msg("load", "servers: %lld heartbeats, %lld checks answered, %lld infos answered",
+			Stats.m_HeartbeatsSent, Stats.m_ChecksAnswered, Stats.m_InfosAnswered);
+	if(Stats.m_ListsSent)
+	{
+		// the master doesn't answer while its list is empty
+		dbg_msg("load", "lists: %lld requested, %lld answered, %.1f%% unanswered, %.1f per second, %.1f packets and %.1f servers each",
+			Stats.m_ListsSent, Stats.m_ListsReceived, Percent(Stats.m_ListsLost, Stats.m_ListsSent),
+			Stats.m_ListsReceived / (float)s_Duration,
+			Stats.m_ListsReceived ? Stats.m_ListPackets / (float)Stats.m_ListsReceived : 0.0f,
+			Stats.m_ListsReceived ? Stats.m_ListedServers / (float)Stats.m_ListsReceived : 0.0f);
+		PrintLatencies(Stats.m_aListLatencies);
+	}
+	if(Stats.m_InfosSent)
+	{
+		dbg_msg("load", "infos: %lld requested, %lld answered, %.1f%% lost, %.1f per second",
+			Stats.m_InfosSent, Stats.m_InfosReceived, Percent(Stats.m_InfosLost, Stats.m_InfosSent),
+			Stats.m_InfosReceived / (float)s_Duration);
+		PrintLatencies(Stats.m_aInfoLatencies);
+	}
+	return 0;
+}